@@ -1,1490 +1,1687 @@
-PHP
+// Analyzers for PHP, JavaScript, HTML, Java, Python, C++, Perl and CSS.
+// Each section is a complete program; compile one of them by defining its
+// macro, e.g. gcc -DAKUNDI_PHP -o php akundi.c ../COMMON/*.c
+
+// PHP
+#ifdef AKUNDI_PHP
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
-const char *keywords[] = { "function", "return", "echo", "foreach", "as" };
+static const char *keywords[] = { "function", "return", "echo", "foreach", "as" };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// Only double-quoted strings are recognised
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '/') { // Single-line comment
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (ch == '*') { // Multi-line comment
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '*' && (ch = fgetc(file)) == '/') break;
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
     } else if (ch == '#') { // Shell-style comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
+        inputSkipLine(in);
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
         if (ch == '/' || ch == '#') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     if (ch == '$') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = VARIABLE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != '"') {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = '"';
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_QUOTE)) {
+        while ((ch = inputGet(in)) != EOF && ch != '"');
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
-
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
+
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
+        if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+            while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == VARIABLE) {
-                    strcpy(parameters[paramCount++], token.lexeme);
+                    *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                        tokenIntern(in, &token);
                 }
             }
         }
-        strcpy(symbolTable[functionCount].name, functionName);
-        symbolTable[functionCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-        }
-        functionCount++;
+        Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+        function->name = functionName;
+        function->parameters = parameters;
+        function->param_count = paramCount;
     }
 }
 
-void analyzePHPFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [VARIABLE] = "VARIABLE",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzePHPFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
 
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "function") == 0) {
-            extractFunction(file);
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
+
+        if (token.type == KEYWORD && tokenIs(&in, &token, "function")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer phpAnalyzer = {
+    "PHP", analyzePHPFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the PHP file name: ");
     scanf("%s", filename);
-    analyzePHPFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzePHPFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_PHP
 
 
-JS
+// JS
+#ifdef AKUNDI_JS
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
-const char *keywords[] = { "function", "return", "let", "const", "var", "if", "else", "for", "while" };
+static const char *keywords[] = { "function", "return", "let", "const", "var", "if", "else", "for", "while" };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '/') {
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (ch == '*') {
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '*' && (ch = fgetc(file)) == '/') break;
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
         if (ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"' || ch == '\'') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != '"' && ch != '\'') {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_QUOTE)) {
+        while ((ch = inputGet(in)) != EOF && !charIs(ch, CC_QUOTE));
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
-
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
+
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
+        if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+            while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == IDENTIFIER) {
-                    strcpy(parameters[paramCount++], token.lexeme);
+                    *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                        tokenIntern(in, &token);
                 }
             }
         }
-        strcpy(symbolTable[functionCount].name, functionName);
-        symbolTable[functionCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-        }
-        functionCount++;
+        Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+        function->name = functionName;
+        function->parameters = parameters;
+        function->param_count = paramCount;
     }
 }
 
-void analyzeJSFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [VARIABLE] = "VARIABLE",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeJSFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
 
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "function") == 0) {
-            extractFunction(file);
+        if (token.type == KEYWORD && tokenIs(&in, &token, "function")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer jsAnalyzer = {
+    "JavaScript", analyzeJSFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the JS file name: ");
     scanf("%s", filename);
-    analyzeJSFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeJSFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_JS
 
 
-HTML
+// HTML
+#ifdef AKUNDI_HTML
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_TAGS 100
-#define MAX_ATTRIBUTES 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     TAG, ATTRIBUTE, TEXT_CONTENT, SPECIAL_SYMBOL, TEXT
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
+    NameId name;
+    NameId value;
+} HTMLAttribute;
 
 typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char attributes[MAX_ATTRIBUTES][MAX_TOKEN_LEN];
+    NameId name;
+    HTMLAttribute *attributes;
     int attr_count;
 } HTMLTag;
 
-HTMLTag symbolTable[MAX_TAGS];
-int tagCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local HTMLTag *symbolTable = NULL;
+static _Thread_local int tagCount = 0;
+static _Thread_local int tagCapacity = 0;
+
+// Attribute names may contain '-' and '_'; '<' and '>' delimit markup
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c), CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c) || (c) == '-' || (c) == '_', CC_IDCONT) \
+    | CC_IF((c) == '<' || (c) == '>', CC_OPERATOR) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
 
-void skipWhitespace(FILE *file) {
-    char ch;
-    while ((ch = fgetc(file)) != EOF && isspace(ch));
-    if (ch != EOF) ungetc(ch, file);
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipWhitespace(Input *in) {
+    inputSkipSpace(in);
 }
 
-void skipComment(FILE *file) {
-    char ch = fgetc(file);
+static void skipComment(Input *in) {
+    int ch = inputGet(in);
     if (ch == '!') {
-        ch = fgetc(file);
-        if (ch == '-' && fgetc(file) == '-') {
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '-' && fgetc(file) == '-' && fgetc(file) == '>') {
-                    return; // End of comment
-                }
-            }
+        ch = inputGet(in);
+        if (ch == '-' && inputGet(in) == '-') {
+            inputSkipPast(in, "-->");
         }
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    skipWhitespace(file);
+    skipWhitespace(in);
 
-    ch = fgetc(file);
+    ch = inputGet(in);
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     if (ch == '<') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
+        ch = inputGet(in);
 
         if (ch == '!') {
-            ungetc(ch, file);
-            skipComment(file);
-            return getNextToken(file, token);
+            inputUnget(in, ch);
+            skipComment(in);
+            return lexToken(in, token);
         }
         
-        while (ch != EOF && ch != '>' && !isspace(ch)) {
-            buffer[bufIndex++] = ch;
-            ch = fgetc(file);
+        while (ch != EOF && ch != '>' && !charIs(ch, CC_SPACE)) {
+            ch = inputGet(in);
         }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = TAG;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (isalpha(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '-' || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
 
-        skipWhitespace(file);
-        ch = fgetc(file);
+        skipWhitespace(in);
+        ch = inputGet(in);
         if (ch == '=') {
             token->type = ATTRIBUTE;
-            strcpy(token->lexeme, buffer);
             return 1;
         }
 
-        ungetc(ch, file);
+        inputUnget(in, ch);
         token->type = TEXT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = quote;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = TEXT_CONTENT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (!isspace(ch) && ch != '<' && ch != '>') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && !isspace(ch) && ch != '<' && ch != '>') {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (!charIs(ch, CC_SPACE | CC_OPERATOR)) {
+        while ((ch = inputGet(in)) != EOF && !charIs(ch, CC_SPACE | CC_OPERATOR));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = TEXT_CONTENT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractTag(FILE *file, Token tagToken) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractTag(Input *in, Token tagToken) {
     Token token;
-    char tagName[MAX_TOKEN_LEN];
-    char attributes[MAX_ATTRIBUTES][MAX_TOKEN_LEN];
-    char attributeValues[MAX_ATTRIBUTES][MAX_TOKEN_LEN];
-    int attrCount = 0;
+    HTMLTag tag = {0};
+    int attrCapacity = 0;
 
-    strcpy(tagName, tagToken.lexeme);
+    tag.name = tokenIntern(in, &tagToken);
 
-    while (getNextToken(file, &token)) {
+    while (getNextToken(in, &token)) {
         if (token.type == ATTRIBUTE) {
-            strcpy(attributes[attrCount], token.lexeme);
-            attrCount++;
-            if (!getNextToken(file, &token) || token.type != SPECIAL_SYMBOL || token.lexeme[0] != '=') {
-                continue;
+            HTMLAttribute *attribute = ARENA_PUSH(&symbolArena, tag.attributes, tag.attr_count, attrCapacity);
+            attribute->name = tokenIntern(in, &token);
+            attribute->value = NAME_EMPTY;
+            // the ATTRIBUTE token has already consumed its '='
+            if (getNextToken(in, &token) && token.type == TEXT_CONTENT) {
+                attribute->value = tokenIntern(in, &token);
             }
-            if (getNextToken(file, &token) && token.type == TEXT_CONTENT) {
-                strcpy(attributeValues[attrCount - 1], token.lexeme);
-            } else {
-                strcpy(attributeValues[attrCount - 1], "");
-            }
-        } else if (token.type == SPECIAL_SYMBOL && token.lexeme[0] == '>') {
+        } else if (token.type == SPECIAL_SYMBOL && tokenText(in, &token)[0] == '>') {
             break;
         }
     }
 
-    strcpy(symbolTable[tagCount].name, tagName);
-    symbolTable[tagCount].attr_count = attrCount;
-    for (int i = 0; i < attrCount; i++) {
-        sprintf(symbolTable[tagCount].attributes[i], "%s=%s", attributes[i], attributeValues[i]);
-    }
-    tagCount++;
+    *ARENA_PUSH(&symbolArena, symbolTable, tagCount, tagCapacity) = tag;
 }
 
-void analyzeHTMLFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [TAG] = "TAG",
+    [ATTRIBUTE] = "ATTRIBUTE",
+    [TEXT_CONTENT] = "TEXT CONTENT",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [TEXT] = "TEXT",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeHTMLFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case TAG: printf("TAG\n"); break;
-            case ATTRIBUTE: printf("ATTRIBUTE\n"); break;
-            case TEXT_CONTENT: printf("TEXT CONTENT\n"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL\n"); break;
-            case TEXT: printf("TEXT\n"); break;
-            default: printf("UNKNOWN\n"); break;
-        }
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
     }
-    rewind(file);
+    inputRewind(&in);
     tagCount = 0;
-    while (getNextToken(file, &token)) {
+    while (getNextToken(&in, &token)) {
         if (token.type == TAG) {
-            extractTag(file, token);
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractTag(&in, token);
+            statsLeave(phase);
         }
     }
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (HTML Tags and Attributes):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (HTML Tags and Attributes):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < tagCount; i++) {
-        printf("Tag: %s> (", symbolTable[i].name);
+        fprintf(out, "Tag: %s> (", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].attr_count; j++) {
-            printf("%s", symbolTable[i].attributes[j]);
-            if (j < symbolTable[i].attr_count - 1) printf(", ");
+            fprintf(out, "%s=%s", nameText(symbolTable[i].attributes[j].name),
+                    nameText(symbolTable[i].attributes[j].value));
+            if (j < symbolTable[i].attr_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    tagCount = tagCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return tagCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < tagCount; i++) {
+        Symbol symbol = {SYMBOL_TAG, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer htmlAnalyzer = {
+    "HTML", analyzeHTMLFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the HTML file name: ");
     scanf("%s", filename);
-    analyzeHTMLFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeHTMLFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_HTML
+
 
-JAVA
+// JAVA
+#ifdef AKUNDI_JAVA
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
-const char *keywords[] = { "public", "private", "protected", "static", "void", "int", "double", "char", "float", "class", "return" };
+static const char *keywords[] = { "public", "private", "protected", "static", "void", "int", "double", "char", "float", "class", "return" };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// Only double-quoted strings are recognised
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '/') {
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (ch == '*') {
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '*' && (ch = fgetc(file)) == '/') break;
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
         if (ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != '"') {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = '"';
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_QUOTE)) {
+        while ((ch = inputGet(in)) != EOF && ch != '"');
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char returnType[MAX_TOKEN_LEN];
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
 
-    if (!getNextToken(file, &token) || token.type != KEYWORD) return; // Read return type
-    strcpy(returnType, token.lexeme);
+    if (!getNextToken(in, &token) || token.type != KEYWORD) return; // Read return type
 
-    if (!getNextToken(file, &token) || token.type != IDENTIFIER) return; // Read function name
-    strcpy(functionName, token.lexeme);
+    if (!getNextToken(in, &token) || token.type != IDENTIFIER) return; // Read function name
+    functionName = tokenIntern(in, &token);
 
-    if (!getNextToken(file, &token) || token.lexeme[0] != '(') return; // Read '('
+    if (!getNextToken(in, &token) || tokenText(in, &token)[0] != '(') return; // Read '('
 
-    while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+    while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
         if (token.type == KEYWORD) {  
-            if (!getNextToken(file, &token) || token.type != IDENTIFIER) return; 
-            strcpy(parameters[paramCount++], token.lexeme);
+            if (!getNextToken(in, &token) || token.type != IDENTIFIER) return; 
+            *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                tokenIntern(in, &token);
         }
     }
 
     // Store function in symbol table
-    strcpy(symbolTable[functionCount].name, functionName);
-    symbolTable[functionCount].param_count = paramCount;
-    for (int i = 0; i < paramCount; i++) {
-        strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-    }
-    functionCount++;
+    Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+    function->name = functionName;
+    function->parameters = parameters;
+    function->param_count = paramCount;
 }
 
-void analyzeJavaFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeJavaFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
 
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
         if (token.type == KEYWORD && 
-            (strcmp(token.lexeme, "public") == 0 || 
-             strcmp(token.lexeme, "private") == 0 || 
-             strcmp(token.lexeme, "protected") == 0 ||
-             strcmp(token.lexeme, "static") == 0)) {
-            extractFunction(file);
+            (tokenIs(&in, &token, "public") || 
+             tokenIs(&in, &token, "private") || 
+             tokenIs(&in, &token, "protected") ||
+             tokenIs(&in, &token, "static"))) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer javaAnalyzer = {
+    "Java", analyzeJavaFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Java file name: ");
     scanf("%s", filename);
-    analyzeJavaFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeJavaFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_JAVA
 
 
-PYTHON
+// PYTHON
+#ifdef AKUNDI_PYTHON
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
-const char *keywords[] = { "def", "return", "if", "else", "elif", "for", "while", "import", "from", "class", "try", "except", "finally", "with", "as" };
+static const char *keywords[] = { "def", "return", "if", "else", "elif", "for", "while", "import", "from", "class", "try", "except", "finally", "with", "as" };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '#') {
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
+        inputSkipLine(in);
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
         if (ch == '#') {
-            skipComments(file);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"' || ch == '\'') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != buffer[0]) {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_QUOTE)) {
+        char quote = ch;
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
   Token token;
-  char functionName[MAX_TOKEN_LEN];
-  char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-  int paramCount = 0;
+  NameId functionName = NAME_EMPTY;
+  NameId *parameters = NULL;
+  int paramCount = 0, paramCapacity = 0;
 
   // Get function name (we've already found "def")
-  if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-      strcpy(functionName, token.lexeme);
+  if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+      functionName = tokenIntern(in, &token);
       
       // Look for opening parenthesis
-      if (getNextToken(file, &token) && token.lexeme[0] == '(') {
+      if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
           // Read parameters until closing parenthesis
-          while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+          while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
               if (token.type == IDENTIFIER) {
-                  strcpy(parameters[paramCount++], token.lexeme);
+                  *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                      tokenIntern(in, &token);
               }
               // Skip commas between parameters
-              else if (token.lexeme[0] == ',') {
+              else if (tokenText(in, &token)[0] == ',') {
                   continue;
               }
           }
           
           // Store in symbol table
-          strcpy(symbolTable[functionCount].name, functionName);
-          symbolTable[functionCount].param_count = paramCount;
-          for (int i = 0; i < paramCount; i++) {
-              strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-          }
-          functionCount++;
+          Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+          function->name = functionName;
+          function->parameters = parameters;
+          function->param_count = paramCount;
       }
   }
 }
 
-void analyzePythonFile(const char *filename) {
-  FILE *file = fopen(filename, "r");
-  if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzePythonFile(const char *filename, TokenStream *stream) {
+  Input in;
+  if (inputOpen(&in, filename) != 0) {
       perror("Error opening file");
-      return;
+      return -1;
   }
 
   Token token;
 
-  printf("\nLexical Analysis Output:\n");
-  printf("------------------------\n");
-  printf("Lexeme\t\tType\n");
-  printf("------------------------\n");
-
-  while (getNextToken(file, &token)) {
-      printf("%s\t\t", token.lexeme);
-      switch (token.type) {
-          case KEYWORD: printf("KEYWORD"); break;
-          case IDENTIFIER: printf("IDENTIFIER"); break;
-          case OPERATOR: printf("OPERATOR"); break;
-          case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-          case STRING_LITERAL: printf("STRING LITERAL"); break;
-          case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-          default: printf("UNKNOWN"); break;
-      }
-      printf("\n");
+  streamBeginTokens(stream, &tokenFormat);
+
+  while (getNextToken(&in, &token)) {
+      streamToken(stream, &in, &token);
 
       // Check for 'def' keyword to extract function details
-      if (token.type == KEYWORD && strcmp(token.lexeme, "def") == 0) {
+      if (token.type == KEYWORD && tokenIs(&in, &token, "def")) {
           // Save current position in the file
-          long currentPos = ftell(file);
+          size_t currentPos = inputTell(&in);
           
           // Extract function
-          extractFunction(file);
+          int phase = statsEnter(PHASE_SYMBOLS);
+          extractFunction(&in);
+          statsLeave(phase);
           
           // Return to current position for continued lexical analysis
-          fseek(file, currentPos, SEEK_SET);
+          inputSeek(&in, currentPos);
       }
   }
 
-  fclose(file);
+  inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer pythonAnalyzer = {
+    "Python", analyzePythonFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Python file name: ");
     scanf("%s", filename);
-    analyzePythonFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzePythonFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_PYTHON
 
 
-C++
+// C++
+#ifdef AKUNDI_CPP
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
 // List of C++ Keywords
-const char *keywords[] = { 
+static const char *keywords[] = { 
     "int", "float", "double", "char", "if", "else", "while", "for", "return", 
     "switch", "case", "break", "continue", "void", "class", "struct", "public",
     "private", "protected", "virtual", "new", "delete", "try", "catch", "throw"
 };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        char next = fgetc(file);
+        int next = inputGet(in);
         if (next == '/') { // Single-line comment
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (next == '*') { // Multi-line comment
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '*' && (ch = fgetc(file)) == '/') break;
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(next, file);
+            inputUnget(in, next);
         }
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
         if (ch == '/') {
-            skipComments(file);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"' || ch == '\'') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != buffer[0]) {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_QUOTE)) {
+        char quote = ch;
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
 
     // Get function name (after return type)
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
         
         // Look for opening parenthesis
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
+        if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
             // Read parameters until closing parenthesis
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+            while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == IDENTIFIER) {
-                    strcpy(parameters[paramCount++], token.lexeme);
+                    *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                        tokenIntern(in, &token);
                 }
                 // Skip commas between parameters
-                else if (token.lexeme[0] == ',') {
+                else if (tokenText(in, &token)[0] == ',') {
                     continue;
                 }
             }
             
             // Store function in symbol table
-            strcpy(symbolTable[functionCount].name, functionName);
-            symbolTable[functionCount].param_count = paramCount;
-            for (int i = 0; i < paramCount; i++) {
-                strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-            }
-            functionCount++;
+            Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+            function->name = functionName;
+            function->parameters = parameters;
+            function->param_count = paramCount;
         }
     }
 }
 
-void analyzeCppFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeCppFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
 
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
         // Check for function definitions
         if (token.type == KEYWORD) {
-            long currentPos = ftell(file);
-            extractFunction(file);
-            fseek(file, currentPos, SEEK_SET);
+            size_t currentPos = inputTell(&in);
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
+            inputSeek(&in, currentPos);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer cppAnalyzer = {
+    "C++", analyzeCppFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the C++ file name: ");
     scanf("%s", filename);
-    analyzeCppFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeCppFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_CPP
 
 
-PEARL
+// PEARL
+#ifdef AKUNDI_PERL
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, STRING_LITERAL, SPECIAL_SYMBOL, VARIABLE
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
-const char *keywords[] = {
+static const char *keywords[] = {
     "sub", "my", "our", "if", "else", "elsif", "while", "for", "foreach", "return",
     "last", "next", "redo", "goto", "do", "unless", "package", "use", "require"
 };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-  int ch = fgetc(file);
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+  int ch = inputGet(in);
 
   // If the first line contains a shebang (#!), skip the entire line
-  if (ch == '#' && ftell(file) == 1) {
-      while ((ch = fgetc(file)) != EOF && ch != '\n');
+  if (ch == '#' && inputTell(in) == 1) {
+      inputSkipLine(in);
       return;
   }
 
-  // Regular comment handling (skip until newline)
+  // Regular comment handling (skip until newline, which is left for the caller)
   if (ch == '#') {
-      while ((ch = fgetc(file)) != EOF && ch != '\n');
+      inputSkipTo(in, '\n');
+      return;
   }
 
-  // Put back the last character if it's not EOF
-  if (ch != EOF) {
-      ungetc(ch, file);
-  }
+  // Not a comment: put the character back
+  inputUnget(in, ch);
 }
 
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-      if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+      if (charIs(ch, CC_SPACE)) {
+          inputSkipSpace(in);
+          continue;
+      }
 
       // Handle comments properly
       if (ch == '#') {
-          skipComments(file);
+          skipComments(in);
           continue; // Restart token reading after skipping the comment
       }
       break;
   }
 
   if (ch == EOF) return 0; // End of file
+    size_t start = inputTell(in) - 1;
 
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
-
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
+
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
+        if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+            while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == IDENTIFIER) {
-                    strcpy(parameters[paramCount++], token.lexeme);
+                    *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                        tokenIntern(in, &token);
                 }
-                else if (token.lexeme[0] == ',') {
+                else if (tokenText(in, &token)[0] == ',') {
                     continue;
                 }
             }
         }
-        strcpy(symbolTable[functionCount].name, functionName);
-        symbolTable[functionCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-        }
-        functionCount++;
+        Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+        function->name = functionName;
+        function->parameters = parameters;
+        function->param_count = paramCount;
     }
 }
 
-void analyzePerlFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzePerlFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
 
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "sub") == 0) {
-            extractFunction(file);
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
+
+        if (token.type == KEYWORD && tokenIs(&in, &token, "sub")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
     }
 }
 
+const Analyzer perlAnalyzer = {
+    "Perl", analyzePerlFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Perl file name: ");
     scanf("%s", filename);
-    analyzePerlFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzePerlFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
 }
+#endif
+#endif // AKUNDI_PERL
 
 
-CSS
+// CSS
+#ifdef AKUNDI_CSS
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 #define MAX_TOKEN_LEN 100
 
@@ -1492,132 +1689,135 @@ typedef enum {
     SELECTOR, PROPERTY, VALUE, SPECIAL_SYMBOL, COMMENT
 } TokenType;
 
-typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-void skipWhitespace(FILE *file) {
-    char ch;
-    while ((ch = fgetc(file)) != EOF && isspace(ch));
-    if (ch != EOF) ungetc(ch, file);
-}
-
-void skipComment(FILE *file) {
-    char ch = fgetc(file);
-    if (ch == '*') {
-        while ((ch = fgetc(file)) != EOF) {
-            if (ch == '*' && fgetc(file) == '/') {
-                return; // End of comment
-            }
-        }
-    }
+// Selectors start with a letter, '#' or '.' and continue with '-' and '_'
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '#' || (c) == '.', CC_IDSTART) \
+    | CC_IF(CC_IS_LETTER(c) || CC_IS_DIGIT(c) || (c) == '-' || (c) == '_', CC_IDCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipWhitespace(Input *in) {
+    inputSkipSpace(in);
+}
+
+// Called with the opening "/*" already consumed
+static void skipComment(Input *in) {
+    inputSkipPast(in, "*/");
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    skipWhitespace(file);
-    ch = fgetc(file);
+    skipWhitespace(in);
+    ch = inputGet(in);
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle comments
     if (ch == '/') {
-        if (fgetc(file) == '*') {
-            skipComment(file);
-            strcpy(token->lexeme, "/* Comment */");
+        int next = inputGet(in);
+        if (next == '*') {
+            skipComment(in);
+            tokenSpan(token, in, start);
             token->type = COMMENT;
             return 1;
         } else {
-            ungetc('/', file);
+            inputUnget(in, next);
         }
     }
 
     // Handle special symbols
     if (ch == '{' || ch == '}' || ch == ':' || ch == ';') {
-        buffer[0] = ch;
-        buffer[1] = '\0';
+        tokenSpan(token, in, start);
         token->type = SPECIAL_SYMBOL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle selectors (ID, class, element)
-    if (isalpha(ch) || ch == '#' || ch == '.') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '-' || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = SELECTOR;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle properties inside `{ }`
-    if (isalpha(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '-')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_ALPHA)) {
+        while ((ch = inputGet(in)) != EOF && (charIs(ch, CC_ALNUM) || ch == '-'));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = PROPERTY;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle values (colors, numbers, URLs)
-    if (isdigit(ch) || ch == '"' || ch == '\'' || ch == '(') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && !isspace(ch) && ch != ';' && ch != '}') {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT | CC_QUOTE) || ch == '(') {
+        while ((ch = inputGet(in)) != EOF && !charIs(ch, CC_SPACE) && ch != ';' && ch != '}');
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = VALUE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     return 0;
 }
 
-void analyzeCSSFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static const char *const tokenTypeNames[] = {
+    [SELECTOR] = "SELECTOR",
+    [PROPERTY] = "PROPERTY",
+    [VALUE] = "VALUE",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [COMMENT] = "COMMENT",
+};
+
+// Comments are listed without their text
+static const char *const tokenPlaceholders[] = {
+    [COMMENT] = "/* Comment */",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), tokenPlaceholders, 0
+};
+
+int analyzeCSSFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case SELECTOR: printf("SELECTOR\n"); break;
-            case PROPERTY: printf("PROPERTY\n"); break;
-            case VALUE: printf("VALUE\n"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL\n"); break;
-            case COMMENT: printf("COMMENT\n"); break;
-            default: printf("UNKNOWN\n"); break;
-        }
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
+const Analyzer cssAnalyzer = {
+    "CSS", analyzeCSSFile, NULL, NULL, NULL, NULL, 1,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the CSS file name: ");
     scanf("%s", filename);
-    analyzeCSSFile(filename);
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeCSSFile(filename, &stream);
+    streamClose(&stream);
     return 0;
-} 
\ No newline at end of file
+}
+#endif
+#endif // AKUNDI_CSS
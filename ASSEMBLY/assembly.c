@@ -1,11 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_LABELS 100
-#define MAX_OPERANDS 4
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
+
+#define MAX_OPERANDS 4          // x86 instructions take at most four
 
 typedef enum {
     INSTRUCTION, REGISTER, LABEL, DIRECTIVE,
@@ -14,23 +20,21 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char operands[MAX_OPERANDS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *operands;
     int operand_count;
     int address;
 } Label;
 
-Label symbolTable[MAX_LABELS];
-int labelCount = 0;
-int currentAddress = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Label *symbolTable = NULL;
+static _Thread_local int labelCount = 0;
+static _Thread_local int labelCapacity = 0;
+static _Thread_local int currentAddress = 0;
 
 // Assembly specific instructions (x86)
-const char *instructions[] = {
+static const char *instructions[] = {
     "mov", "add", "sub", "mul", "div", "inc", "dec",
     "and", "or", "xor", "not", "shl", "shr",
     "push", "pop", "call", "ret", "jmp", "je", "jne",
@@ -39,7 +43,7 @@ const char *instructions[] = {
 #define INSTRUCTIONS_COUNT (sizeof(instructions) / sizeof(instructions[0]))
 
 // Assembly registers (x86)
-const char *registers[] = {
+static const char *registers[] = {
     "eax", "ebx", "ecx", "edx", "esi", "edi", "esp", "ebp",
     "ax", "bx", "cx", "dx", "al", "bl", "cl", "dl",
     "ah", "bh", "ch", "dh", "rax", "rbx", "rcx", "rdx"
@@ -47,258 +51,253 @@ const char *registers[] = {
 #define REGISTERS_COUNT (sizeof(registers) / sizeof(registers[0]))
 
 // Assembly directives
-const char *directives[] = {
+static const char *directives[] = {
     "section", "global", "extern", "db", "dw", "dd",
     "equ", "times", "org", "align", "bits", "end"
 };
 #define DIRECTIVES_COUNT (sizeof(directives) / sizeof(directives[0]))
 
-int isInstruction(const char *lexeme) {
-    char lowerLexeme[MAX_TOKEN_LEN];
-    strcpy(lowerLexeme, lexeme);
-    for(int i = 0; lowerLexeme[i]; i++) {
-        lowerLexeme[i] = tolower(lowerLexeme[i]);
-    }
-    
-    for (int i = 0; i < INSTRUCTIONS_COUNT; i++) {
-        if (strcmp(lowerLexeme, instructions[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet instructionSet = KEYWORD_SET(instructions, INSTRUCTIONS_COUNT, 1);
+
+static int isInstruction(const char *lexeme, size_t length) {
+    return keywordSetContains(&instructionSet, lexeme, length);
 }
 
-int isRegister(const char *lexeme) {
-    char lowerLexeme[MAX_TOKEN_LEN];
-    strcpy(lowerLexeme, lexeme);
-    for(int i = 0; lowerLexeme[i]; i++) {
-        lowerLexeme[i] = tolower(lowerLexeme[i]);
-    }
-    
-    for (int i = 0; i < REGISTERS_COUNT; i++) {
-        if (strcmp(lowerLexeme, registers[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet registerSet = KEYWORD_SET(registers, REGISTERS_COUNT, 1);
+
+static int isRegister(const char *lexeme, size_t length) {
+    return keywordSetContains(&registerSet, lexeme, length);
 }
 
-int isDirective(const char *lexeme) {
-    char lowerLexeme[MAX_TOKEN_LEN];
-    strcpy(lowerLexeme, lexeme);
-    for(int i = 0; lowerLexeme[i]; i++) {
-        lowerLexeme[i] = tolower(lowerLexeme[i]);
-    }
-    
-    for (int i = 0; i < DIRECTIVES_COUNT; i++) {
-        if (strcmp(lowerLexeme, directives[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet directiveSet = KEYWORD_SET(directives, DIRECTIVES_COUNT, 1);
+
+static int isDirective(const char *lexeme, size_t length) {
+    return keywordSetContains(&directiveSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// Labels, mnemonics and directives may contain '_' and '.'; numbers are
+// continued as hex digits after "0x"
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_' || (c) == '.', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF(((c) >= 'a' && (c) <= 'f') || ((c) >= 'A' && (c) <= 'F'), CC_NUMCONT) \
+    | CC_IF((c) == '\'' || (c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == ';') {  // Assembly comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
+        inputSkipLine(in);
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == ';') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle labels (ending with :)
-    if (isalpha(ch) || ch == '_' || ch == '.') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_' || ch == '.')) {
-            buffer[bufIndex++] = ch;
-        }
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
         
         if (ch == ':') {
-            buffer[bufIndex++] = ch;
-            buffer[bufIndex] = '\0';
+            tokenSpan(token, in, start);
             token->type = LABEL;
-            strcpy(token->lexeme, buffer);
             return 1;
         }
         
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isInstruction(buffer)) {
+        if (isInstruction(tokenText(in, token), token->length)) {
             token->type = INSTRUCTION;
-        } else if (isRegister(buffer)) {
+        } else if (isRegister(tokenText(in, token), token->length)) {
             token->type = REGISTER;
-        } else if (isDirective(buffer)) {
+        } else if (isDirective(tokenText(in, token), token->length)) {
             token->type = DIRECTIVE;
         } else {
             token->type = OPERAND;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle memory references [...]
     if (ch == '[') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != ']') {
-            buffer[bufIndex++] = ch;
-        }
-        if (ch == ']') buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != ']');
+        tokenSpan(token, in, start);
         token->type = MEMORY_REFERENCE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers (including hex)
-    if (isdigit(ch) || ch == '$' || ch == '0') {
-        buffer[bufIndex++] = ch;
+    if (charIs(ch, CC_DIGIT) || ch == '$') {
         if (ch == '0') {
-            ch = fgetc(file);
+            ch = inputGet(in);
             if (ch == 'x' || ch == 'X') {
-                buffer[bufIndex++] = ch;
-                while ((ch = fgetc(file)) != EOF && 
-                       (isdigit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F'))) {
-                    buffer[bufIndex++] = ch;
-                }
+                while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
             }
         } else {
-            while ((ch = fgetc(file)) != EOF && (isdigit(ch) || ch == 'h')) {
-                buffer[bufIndex++] = ch;
-            }
+            while ((ch = inputGet(in)) != EOF && (charIs(ch, CC_DIGIT) || ch == 'h'));
         }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings
-    if (ch == '\'' || ch == '"') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
-            buffer[bufIndex++] = ch;
-        }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractLabel(FILE *file, Token labelToken) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractLabel(Input *in, Token labelToken) {
     Token token;
-    char labelName[MAX_TOKEN_LEN];
-    char operands[MAX_OPERANDS][MAX_TOKEN_LEN];
-    int operandCount = 0;
+    Label label = {0};
+    int operandCapacity = 0;
 
     // Remove colon from label
-    strncpy(labelName, labelToken.lexeme, strlen(labelToken.lexeme) - 1);
-    labelName[strlen(labelToken.lexeme) - 1] = '\0';
+    labelToken.length--;
+    label.name = tokenIntern(in, &labelToken);
 
     // Get instruction and operands
-    while (getNextToken(file, &token) && token.type != SPECIAL_SYMBOL) {
+    while (getNextToken(in, &token) && token.type != SPECIAL_SYMBOL) {
         if (token.type == INSTRUCTION || token.type == DIRECTIVE) {
-            while (getNextToken(file, &token) && 
+            while (getNextToken(in, &token) && 
                    token.type != SPECIAL_SYMBOL && 
-                   operandCount < MAX_OPERANDS) {
-                strcpy(operands[operandCount++], token.lexeme);
+                   label.operand_count < MAX_OPERANDS) {
+                *ARENA_PUSH(&symbolArena, label.operands, label.operand_count, operandCapacity) =
+                    tokenIntern(in, &token);
             }
             break;
         }
     }
 
     // Store in symbol table
-    strcpy(symbolTable[labelCount].name, labelName);
-    symbolTable[labelCount].operand_count = operandCount;
-    for (int i = 0; i < operandCount; i++) {
-        strcpy(symbolTable[labelCount].operands[i], operands[i]);
-    }
-    symbolTable[labelCount].address = currentAddress;
-    labelCount++;
+    label.address = currentAddress;
+    *ARENA_PUSH(&symbolArena, symbolTable, labelCount, labelCapacity) = label;
     currentAddress += 4;  // Simple address increment
 }
 
-void analyzeAssemblyFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [INSTRUCTION] = "INSTRUCTION",
+    [REGISTER] = "REGISTER",
+    [LABEL] = "LABEL",
+    [DIRECTIVE] = "DIRECTIVE",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [MEMORY_REFERENCE] = "MEMORY REFERENCE",
+    [OPERAND] = "OPERAND",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeAssemblyFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case INSTRUCTION: printf("INSTRUCTION"); break;
-            case REGISTER: printf("REGISTER"); break;
-            case LABEL: printf("LABEL"); break;
-            case DIRECTIVE: printf("DIRECTIVE"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case MEMORY_REFERENCE: printf("MEMORY REFERENCE"); break;
-            case OPERAND: printf("OPERAND"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
         if (token.type == LABEL) {
-            extractLabel(file, token);
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractLabel(&in, token);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Labels and Addresses):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Labels and Addresses):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < labelCount; i++) {
-        printf("Label: %s\tAddress: 0x%04X\n", symbolTable[i].name, symbolTable[i].address);
+        fprintf(out, "Label: %s\tAddress: 0x%04X\n", nameText(symbolTable[i].name), symbolTable[i].address);
         if (symbolTable[i].operand_count > 0) {
-            printf("Operands: ");
+            fprintf(out, "Operands: ");
             for (int j = 0; j < symbolTable[i].operand_count; j++) {
-                printf("%s", symbolTable[i].operands[j]);
-                if (j < symbolTable[i].operand_count - 1) printf(", ");
+                fprintf(out, "%s", nameText(symbolTable[i].operands[j]));
+                if (j < symbolTable[i].operand_count - 1) fprintf(out, ", ");
             }
-            printf("\n");
+            fprintf(out, "\n");
         }
-        printf("--------------------------------------\n");
+        fprintf(out, "--------------------------------------\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    labelCount = labelCapacity = 0;
+    currentAddress = 0;
+}
+
+static int symbolCount(void) {
+    return labelCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < labelCount; i++) {
+        Symbol symbol = {SYMBOL_LABEL, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer assemblyAnalyzer = {
+    "Assembly", analyzeAssemblyFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Assembly file name: ");
     scanf("%s", filename);
-    analyzeAssemblyFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeAssemblyFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
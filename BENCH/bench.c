@@ -0,0 +1,349 @@
+// cdlab-bench: throughput benchmark for every analyzer.
+//
+//   cdlab-bench [--sizes LIST] [--seed N] [--repeat N] [--lang LIST]
+//               [--format FMT] [--dir DIR] [--label NAME] [--output FILE]
+//
+// For each language and size, a seeded generator writes a synthetic source
+// file into DIR (kept there and reused by later runs with the same seed),
+// then the analyzer runs over it REPEAT times with its tokens going to
+// /dev/null. The best time is reported as MB/s and tokens/s, next to the
+// number of heap allocations and the peak RSS of one run.
+//
+// Sizes take K, M and G suffixes (powers of 1024). The results also go to
+// a tab-separated file with one row per language and size. --label tags
+// each row, so that files from different builds can be concatenated and
+// compared.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "../COMMON/analyzer.h"
+#include "generators.h"
+
+#define MAX_PATH_LEN 4096
+#define MAX_SIZES 16
+#define DEFAULT_SIZES "64K,1M,16M"
+#define DEFAULT_DIR "bench-corpus"
+#define DEFAULT_OUTPUT "bench-results.tsv"
+
+typedef struct {
+    const char *key;            // same names as cdlab --lang
+    const Analyzer *analyzer;
+    GenerateUnit generate;
+    const char *extension;
+} BenchLanguage;
+
+static const BenchLanguage languages[] = {
+    {"sql", &sqlAnalyzer, generateSQL, ".sql"},
+    {"plsql", &plsqlAnalyzer, generatePLSQL, ".pls"},
+    {"verilog", &verilogAnalyzer, generateVerilog, ".v"},
+    {"asm", &assemblyAnalyzer, generateAssembly, ".asm"},
+    {"csh", &cshellAnalyzer, generateCShell, ".csh"},
+    {"jquery", &jqueryAnalyzer, generateJQuery, ".js"},
+    {"matlab", &matlabAnalyzer, generateMATLAB, ".m"},
+    {"powershell", &powershellAnalyzer, generatePowerShell, ".ps1"},
+    {"shell", &shellAnalyzer, generateShell, ".sh"},
+    {"php", &phpAnalyzer, generatePHP, ".php"},
+    {"js", &jsAnalyzer, generateJS, ".js"},
+    {"html", &htmlAnalyzer, generateHTML, ".html"},
+    {"java", &javaAnalyzer, generateJava, ".java"},
+    {"python", &pythonAnalyzer, generatePython, ".py"},
+    {"cpp", &cppAnalyzer, generateCPP, ".cpp"},
+    {"perl", &perlAnalyzer, generatePerl, ".pl"},
+    {"css", &cssAnalyzer, generateCSS, ".css"}
+};
+#define LANGUAGES_COUNT (sizeof(languages) / sizeof(languages[0]))
+
+typedef struct {
+    double seconds;
+    size_t tokens;
+    unsigned long long allocations;
+    unsigned long long allocatedBytes;
+    long peakKB;
+} RunResult;
+
+// Every allocation in the process goes through these, so the counts
+// include what libc allocates on an analyzer's behalf (stdio buffers...)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static _Atomic unsigned long long allocationCount;
+static _Atomic unsigned long long allocatedBytes;
+
+static inline void countAllocation(size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocatedBytes, size, memory_order_relaxed);
+}
+
+void *malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Writing 5 to clear_refs resets VmHWM, so each run gets its own peak.
+// Returns 0 if the kernel does not allow it; the peak is then the
+// process-wide high-water mark.
+static int resetPeakRSS(void) {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f) return 0;
+    int ok = fputs("5", f) >= 0;
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
+
+static long readPeakRSS(void) {
+    char line[256];
+    long kb = -1;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        }
+        fclose(f);
+    }
+    if (kb < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+    }
+    return kb;
+}
+
+static long long parseSize(const char *text) {
+    char *end;
+    long long size = strtoll(text, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+        case 'g': case 'G': size <<= 30; end++; break;
+    }
+    return (end == text || *end || size <= 0) ? -1 : size;
+}
+
+static int parseSizes(const char *list, long long *sizes) {
+    char buffer[256];
+    int count = 0;
+    snprintf(buffer, sizeof(buffer), "%s", list);
+    for (char *item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        if (count == MAX_SIZES || (sizes[count] = parseSize(item)) < 0) return -1;
+        count++;
+    }
+    return count;
+}
+
+static void formatSize(long long size, char *text, size_t length) {
+    if (size >= (1LL << 30) && size % (1LL << 30) == 0) {
+        snprintf(text, length, "%lldG", size >> 30);
+    } else if (size >= (1LL << 20) && size % (1LL << 20) == 0) {
+        snprintf(text, length, "%lldM", size >> 20);
+    } else if (size >= 1024 && size % 1024 == 0) {
+        snprintf(text, length, "%lldK", size >> 10);
+    } else {
+        snprintf(text, length, "%lld", size);
+    }
+}
+
+static int selected(const char *list, const char *key) {
+    if (!list) return 1;
+    size_t length = strlen(key);
+    for (const char *p = list; *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t itemLength = comma ? (size_t)(comma - p) : strlen(p);
+        if (itemLength == length && strncmp(p, key, length) == 0) return 1;
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return 0;
+}
+
+// Generates the input unless an earlier run already left it in place
+static int prepareCorpus(const BenchLanguage *language, const char *path,
+                         unsigned long long seed, long long size, long long *actual) {
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size < size) {
+        char sizeText[32];
+        formatSize(size, sizeText, sizeof(sizeText));
+        fprintf(stderr, "generating %s (%s)\n", path, sizeText);
+        if (generateCorpus(path, language->generate, seed, size) != 0 || stat(path, &st) != 0) {
+            perror(path);
+            return -1;
+        }
+    }
+    *actual = st.st_size;
+    return 0;
+}
+
+static void runOnce(const Analyzer *analyzer, const char *path, StreamFormat format,
+                    FILE *sink, RunResult *result) {
+    if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+    resetPeakRSS();
+    unsigned long long allocations = atomic_load(&allocationCount);
+    unsigned long long bytes = atomic_load(&allocatedBytes);
+
+    double start = now();
+    TokenStream stream;
+    streamOpen(&stream, sink, format);
+    analyzer->analyzeFile(path, &stream);
+    size_t tokens = stream.tokenCount;
+    streamClose(&stream);
+    if (analyzer->displaySymbolTable) analyzer->displaySymbolTable(sink);
+    fflush(sink);
+    result->seconds = now() - start;
+
+    result->tokens = tokens;
+    result->allocations = atomic_load(&allocationCount) - allocations;
+    result->allocatedBytes = atomic_load(&allocatedBytes) - bytes;
+    result->peakKB = readPeakRSS();
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: cdlab-bench [--sizes LIST] [--seed N] [--repeat N] [--lang LIST]\n"
+            "                   [--format text|binary|binary-lexemes] [--dir DIR]\n"
+            "                   [--label NAME] [--output FILE]\n"
+            "languages:");
+    for (size_t i = 0; i < LANGUAGES_COUNT; i++) fprintf(stderr, " %s", languages[i].key);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *sizeList = DEFAULT_SIZES;
+    const char *languageList = NULL;
+    const char *dir = DEFAULT_DIR;
+    const char *label = "build";
+    const char *outputPath = DEFAULT_OUTPUT;
+    unsigned long long seed = 1;
+    int repeat = 3;
+    StreamFormat format = STREAM_TEXT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            usage();
+            return 1;
+        }
+        if (strcmp(arg, "--sizes") == 0) sizeList = value;
+        else if (strcmp(arg, "--seed") == 0) seed = strtoull(value, NULL, 0);
+        else if (strcmp(arg, "--repeat") == 0) repeat = atoi(value);
+        else if (strcmp(arg, "--lang") == 0) languageList = value;
+        else if (strcmp(arg, "--dir") == 0) dir = value;
+        else if (strcmp(arg, "--label") == 0) label = value;
+        else if (strcmp(arg, "--output") == 0) outputPath = value;
+        else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "text") == 0) format = STREAM_TEXT;
+            else if (strcmp(value, "binary") == 0) format = STREAM_BINARY;
+            else if (strcmp(value, "binary-lexemes") == 0) format = STREAM_BINARY_LEXEMES;
+            else {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+        i++;
+    }
+
+    long long sizes[MAX_SIZES];
+    int sizeCount = parseSizes(sizeList, sizes);
+    if (sizeCount <= 0 || repeat < 1) {
+        usage();
+        return 1;
+    }
+    for (size_t i = 0; i < LANGUAGES_COUNT; i++) {
+        if (selected(languageList, languages[i].key)) break;
+        if (i + 1 == LANGUAGES_COUNT) {
+            fprintf(stderr, "no language matches --lang %s\n", languageList);
+            return 1;
+        }
+    }
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+    FILE *sink = fopen("/dev/null", "w");
+    FILE *results = fopen(outputPath, "w");
+    if (!sink || !results) {
+        perror(sink ? outputPath : "/dev/null");
+        return 1;
+    }
+    if (!resetPeakRSS()) {
+        fprintf(stderr, "warning: cannot reset peak RSS; reporting the process-wide peak\n");
+    }
+
+    fprintf(results, "label\tlanguage\tbytes\tseconds\tmb_per_s\ttokens\ttokens_per_s"
+                     "\tallocations\tallocated_bytes\tpeak_rss_kb\n");
+    printf("%-11s %8s %10s %10s %12s %10s %10s\n",
+           "language", "size", "seconds", "MB/s", "tokens/s", "allocs", "peak KB");
+
+    int failed = 0;
+    for (size_t i = 0; i < LANGUAGES_COUNT; i++) {
+        const BenchLanguage *language = &languages[i];
+        if (!selected(languageList, language->key)) continue;
+
+        for (int s = 0; s < sizeCount; s++) {
+            char sizeText[32], path[MAX_PATH_LEN];
+            formatSize(sizes[s], sizeText, sizeof(sizeText));
+            snprintf(path, sizeof(path), "%s/%s-%s-%llu%s", dir, language->key, sizeText, seed,
+                     language->extension);
+
+            long long bytes;
+            if (prepareCorpus(language, path, seed, sizes[s], &bytes) != 0) {
+                failed = 1;
+                continue;
+            }
+
+            // Best time, but the worst peak seen over all repeats
+            RunResult best, run;
+            long peakKB = 0;
+            for (int r = 0; r < repeat; r++) {
+                runOnce(language->analyzer, path, format, sink, &run);
+                if (r == 0 || run.seconds < best.seconds) best = run;
+                if (run.peakKB > peakKB) peakKB = run.peakKB;
+            }
+            best.peakKB = peakKB;
+
+            double seconds = best.seconds > 0 ? best.seconds : 1e-9;
+            double mbPerSecond = bytes / seconds / (1 << 20);
+            double tokensPerSecond = best.tokens / seconds;
+            printf("%-11s %8s %10.4f %10.1f %12.0f %10llu %10ld\n", language->key, sizeText,
+                   best.seconds, mbPerSecond, tokensPerSecond, best.allocations, best.peakKB);
+            fflush(stdout);
+            fprintf(results, "%s\t%s\t%lld\t%.6f\t%.2f\t%zu\t%.0f\t%llu\t%llu\t%ld\n", label,
+                    language->key, bytes, best.seconds, mbPerSecond, best.tokens,
+                    tokensPerSecond, best.allocations, best.allocatedBytes, best.peakKB);
+        }
+    }
+
+    fclose(sink);
+    if (fclose(results) != 0) {
+        perror(outputPath);
+        failed = 1;
+    }
+    return failed;
+}
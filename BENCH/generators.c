@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "generators.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define NAME_VARIANTS 64
+
+#define CHOOSE(gen, words) choose(gen, words, sizeof(words) / sizeof(words[0]))
+
+static uint64_t nextRandom(Generator *gen) {
+    uint64_t x = gen->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    gen->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int pick(Generator *gen, int count) {
+    return (int)((nextRandom(gen) >> 33) % (uint64_t)count);
+}
+
+static const char *choose(Generator *gen, const char *const *words, int count) {
+    return words[pick(gen, count)];
+}
+
+// Identifiers come from a small vocabulary with numbered variants, so the
+// same names keep turning up the way they do in real code
+static const char *const stems[] = {
+    "count", "total", "name", "value", "index", "buffer", "result", "item",
+    "user", "order", "price", "status", "config", "data", "node", "temp"
+};
+
+static void identifier(Generator *gen) {
+    fprintf(gen->out, "%s_%d", CHOOSE(gen, stems), pick(gen, NAME_VARIANTS));
+}
+
+static void number(Generator *gen) {
+    if (pick(gen, 4) == 0) {
+        fprintf(gen->out, "%d.%d", pick(gen, 1000), pick(gen, 100));
+    } else {
+        fprintf(gen->out, "%d", pick(gen, 100000));
+    }
+}
+
+static const char *const phrases[] = {
+    "hello world", "processing record", "value out of range", "done",
+    "retrying after failure", "cache miss", "see ticket 42", "TODO tidy up"
+};
+
+static const char *phrase(Generator *gen) {
+    return CHOOSE(gen, phrases);
+}
+
+static const char *const sqlTypes[] = {"INT", "VARCHAR(64)", "DATE", "DECIMAL(10,2)", "TEXT"};
+static const char *const sqlOperators[] = {"=", "<>", "<", ">=", "LIKE"};
+
+void generateSQL(Generator *gen) {
+    FILE *out = gen->out;
+    switch (pick(gen, 4)) {
+        case 0:
+            fprintf(out, "CREATE TABLE table_%lu (\n", gen->serial++);
+            for (int i = 0, n = 2 + pick(gen, 6); i < n; i++) {
+                fputs("    ", out);
+                identifier(gen);
+                fprintf(out, " %s%s\n", CHOOSE(gen, sqlTypes), i + 1 < n ? "," : "");
+            }
+            fputs(");\n", out);
+            break;
+        case 1:
+            fputs("SELECT ", out);
+            for (int i = 0, n = 1 + pick(gen, 5); i < n; i++) {
+                if (i) fputs(", ", out);
+                identifier(gen);
+            }
+            fputs(" FROM ", out);
+            identifier(gen);
+            fputs(" WHERE ", out);
+            identifier(gen);
+            fprintf(out, " %s '%s' AND ", CHOOSE(gen, sqlOperators), phrase(gen));
+            identifier(gen);
+            fputs(" > ", out);
+            number(gen);
+            fputs(" ORDER BY ", out);
+            identifier(gen);
+            fputs(";\n", out);
+            break;
+        case 2:
+            fputs("INSERT INTO ", out);
+            identifier(gen);
+            fputs(" VALUES (", out);
+            number(gen);
+            fprintf(out, ", '%s', ", phrase(gen));
+            number(gen);
+            fputs(");\n", out);
+            break;
+        default:
+            fprintf(out, "-- %s\nUPDATE ", phrase(gen));
+            identifier(gen);
+            fputs(" SET ", out);
+            identifier(gen);
+            fputs(" = ", out);
+            number(gen);
+            fputs(" WHERE ", out);
+            identifier(gen);
+            fputs(" IS NOT NULL;\n", out);
+            break;
+    }
+}
+
+static const char *const plsqlTypes[] = {"NUMBER", "VARCHAR2", "DATE", "BOOLEAN", "INTEGER"};
+
+void generatePLSQL(Generator *gen) {
+    FILE *out = gen->out;
+    int function = pick(gen, 2);
+    fprintf(out, "CREATE OR REPLACE %s block_%lu (", function ? "FUNCTION" : "PROCEDURE",
+            gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        if (i) fputs(", ", out);
+        identifier(gen);
+        fprintf(out, " %s", CHOOSE(gen, plsqlTypes));
+    }
+    fputs(")", out);
+    if (function) fprintf(out, " RETURN %s", CHOOSE(gen, plsqlTypes));
+    fputs(" IS\n    ", out);
+    identifier(gen);
+    fprintf(out, " %s := ", CHOOSE(gen, plsqlTypes));
+    number(gen);
+    fputs(";\nBEGIN\n", out);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fputs("    IF ", out);
+        identifier(gen);
+        fputs(" > ", out);
+        number(gen);
+        fprintf(out, " THEN\n        DBMS_OUTPUT.PUT_LINE('%s');\n    END IF;\n", phrase(gen));
+    }
+    if (function) {
+        fputs("    RETURN ", out);
+        identifier(gen);
+        fputs(";\n", out);
+    }
+    fputs("END;\n/\n", out);
+}
+
+static const char *const verilogOperators[] = {"&", "|", "^", "+", "-"};
+
+void generateVerilog(Generator *gen) {
+    FILE *out = gen->out;
+    int ports = 2 + pick(gen, 6);
+    unsigned long module = gen->serial++;
+    fprintf(out, "// %s\nmodule cell_%lu (clk", phrase(gen), module);
+    for (int i = 0; i < ports; i++) fprintf(out, ", p%d", i);
+    fputs(");\n    input wire clk;\n", out);
+    for (int i = 0; i < ports; i++) {
+        fprintf(out, "    %s %s p%d;\n", i + 1 < ports ? "input" : "output",
+                i + 1 < ports ? "wire" : "reg", i);
+    }
+    fputs("    wire [7:0] ", out);
+    identifier(gen);
+    fputs(";\n", out);
+    fprintf(out, "    always @(posedge clk) begin\n        p%d <= p0 %s p1;\n    end\n",
+            ports - 1, CHOOSE(gen, verilogOperators));
+    fprintf(out, "    assign p0 = 8'h%02x;\nendmodule\n\n", pick(gen, 256));
+}
+
+static const char *const instructions[] = {"mov", "add", "sub", "cmp", "xor", "and", "or", "lea"};
+static const char *const registers[] = {"eax", "ebx", "ecx", "edx", "esi", "edi", "esp", "ebp"};
+
+void generateAssembly(Generator *gen) {
+    FILE *out = gen->out;
+    unsigned long label = gen->serial++;
+    fprintf(out, "label_%lu: %s %s, %d\n", label, CHOOSE(gen, instructions),
+            CHOOSE(gen, registers), pick(gen, 4096));
+    for (int i = 0, n = 2 + pick(gen, 6); i < n; i++) {
+        if (pick(gen, 2)) {
+            fprintf(out, "    %s %s, %s", CHOOSE(gen, instructions), CHOOSE(gen, registers),
+                    CHOOSE(gen, registers));
+        } else {
+            fprintf(out, "    %s %s, [%s+%d]", CHOOSE(gen, instructions), CHOOSE(gen, registers),
+                    CHOOSE(gen, registers), 4 * pick(gen, 16));
+        }
+        if (pick(gen, 3) == 0) fprintf(out, "  ; %s", phrase(gen));
+        fputc('\n', out);
+    }
+    fprintf(out, "    jne label_%lu\n", label);
+}
+
+static const char *const commands[] = {"ls -l", "grep -n", "cat", "make", "wc -l", "cp -r"};
+
+void generateCShell(Generator *gen) {
+    FILE *out = gen->out;
+    switch (pick(gen, 3)) {
+        case 0:
+            fprintf(out, "alias alias_%lu '%s'\n", gen->serial++, CHOOSE(gen, commands));
+            break;
+        case 1:
+            fputs("set ", out);
+            identifier(gen);
+            fputs(" = ", out);
+            number(gen);
+            fputs("\nif ($", out);
+            identifier(gen);
+            fprintf(out, " > %d) then\n    echo \"%s\"\nendif\n", pick(gen, 100), phrase(gen));
+            break;
+        default:
+            fprintf(out, "# %s\nforeach f (*.c)\n    %s $f\nend\n", phrase(gen), CHOOSE(gen, commands));
+            break;
+    }
+}
+
+static const char *const selectors[] = {"#main", ".item", "div.card", "ul > li", "a[href]", "form input"};
+static const char *const jqueryMethods[] = {"addClass", "removeClass", "toggle", "fadeIn", "hide", "show"};
+static const char *const jqueryEvents[] = {"click", "change", "submit", "keyup", "hover"};
+
+void generateJQuery(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "$(document).ready(function() {\n    $('%s').on('%s', function(event) {\n",
+            CHOOSE(gen, selectors), CHOOSE(gen, jqueryEvents));
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fprintf(out, "        $(this).%s('%s');\n", CHOOSE(gen, jqueryMethods), phrase(gen));
+    }
+    fputs("        var ", out);
+    identifier(gen);
+    fputs(" = ", out);
+    number(gen);
+    fprintf(out, ";\n    });\n    // %s\n});\n", phrase(gen));
+}
+
+static const char *const matlabFunctions[] = {"sin", "cos", "sqrt", "abs", "sum", "zeros"};
+
+void generateMATLAB(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "function [result] = func_%lu(", gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        if (i) fputs(", ", out);
+        identifier(gen);
+    }
+    fprintf(out, ")\n    %% %s\n    result = ", phrase(gen));
+    number(gen);
+    fputs(" .* ", out);
+    number(gen);
+    fprintf(out, ";\n    for i = 1:%d\n        result(i) = %s(i) + ", 1 + pick(gen, 100),
+            CHOOSE(gen, matlabFunctions));
+    number(gen);
+    fprintf(out, ";\n    end\n    disp('%s');\nend\n\n", phrase(gen));
+}
+
+static const char *const verbs[] = {"Get", "Set", "New", "Remove", "Test", "Invoke"};
+static const char *const cmdlets[] = {"Write-Host", "Write-Output", "Get-ChildItem", "Get-Content"};
+
+void generatePowerShell(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "function %s-Thing%lu {\n    param(", CHOOSE(gen, verbs), gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fprintf(out, "%s$%s%d", i ? ", " : "", CHOOSE(gen, stems), pick(gen, NAME_VARIANTS));
+    }
+    fprintf(out, ")\n    # %s\n    foreach ($i in 1..%d) {\n", phrase(gen), 1 + pick(gen, 50));
+    fprintf(out, "        if ($i -gt %d) { %s \"%s $i\" }\n    }\n}\n\n", pick(gen, 50),
+            CHOOSE(gen, cmdlets), phrase(gen));
+}
+
+void generateShell(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "func_%lu() {\n    local ", gen->serial++);
+    identifier(gen);
+    fprintf(out, "=$1\n    # %s\n    if [ \"$1\" -gt %d ]; then\n        echo \"%s\"\n    fi\n",
+            phrase(gen), pick(gen, 100), phrase(gen));
+    fprintf(out, "    for f in *.txt; do\n        %s \"$f\" | wc -l\n    done\n}\n\n",
+            CHOOSE(gen, commands));
+}
+
+void generatePHP(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "<?php\nfunction func_%lu(", gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fprintf(out, "%s$%s_%d", i ? ", " : "", CHOOSE(gen, stems), pick(gen, NAME_VARIANTS));
+    }
+    fprintf(out, ") {\n    // %s\n    $total = ", phrase(gen));
+    number(gen);
+    fprintf(out, ";\n    if ($total > %d) {\n        echo \"%s\";\n    }\n    return $total;\n}\n?>\n",
+            pick(gen, 1000), phrase(gen));
+}
+
+static const char *const jsOperators[] = {"+", "-", "*", "===", "!==", "&&", "||"};
+
+void generateJS(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "function func_%lu(", gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        if (i) fputs(", ", out);
+        identifier(gen);
+    }
+    fprintf(out, ") {\n    // %s\n    var ", phrase(gen));
+    identifier(gen);
+    fputs(" = ", out);
+    number(gen);
+    fprintf(out, " %s ", CHOOSE(gen, jsOperators));
+    number(gen);
+    fprintf(out, ";\n    if (value_1 > %d) {\n        return \"%s\";\n    }\n    return null;\n}\n\n",
+            pick(gen, 1000), phrase(gen));
+}
+
+static const char *const htmlTags[] = {"div", "section", "p", "span", "li", "article"};
+
+void generateHTML(Generator *gen) {
+    FILE *out = gen->out;
+    const char *tag = CHOOSE(gen, htmlTags);
+    fprintf(out, "<%s class=\"%s-%d\" id=\"node%lu\">\n", tag, CHOOSE(gen, stems),
+            pick(gen, NAME_VARIANTS), gen->serial++);
+    fprintf(out, "    <!-- %s -->\n    <a href=\"/page/%d\">%s</a>\n", phrase(gen),
+            pick(gen, 1000), phrase(gen));
+    fprintf(out, "    <img src=\"img%d.png\" alt=\"%s\">\n</%s>\n", pick(gen, 100), phrase(gen), tag);
+}
+
+static const char *const javaTypes[] = {"int", "long", "double", "boolean", "String"};
+
+void generateJava(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "public class Type%lu {\n    private int ", gen->serial++);
+    identifier(gen);
+    fputs(" = ", out);
+    number(gen);
+    fprintf(out, ";\n\n    public %s method%d(", CHOOSE(gen, javaTypes), pick(gen, NAME_VARIANTS));
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fprintf(out, "%s%s ", i ? ", " : "", CHOOSE(gen, javaTypes));
+        identifier(gen);
+    }
+    fprintf(out, ") {\n        // %s\n        if (count_1 > %d) {\n", phrase(gen), pick(gen, 100));
+    fprintf(out, "            System.out.println(\"%s\");\n        }\n        return null;\n    }\n}\n\n",
+            phrase(gen));
+}
+
+void generatePython(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "def func_%lu(", gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        if (i) fputs(", ", out);
+        identifier(gen);
+    }
+    fprintf(out, "):\n    # %s\n    total = ", phrase(gen));
+    number(gen);
+    fprintf(out, "\n    for i in range(%d):\n        if i > %d:\n            print(\"%s\")\n",
+            1 + pick(gen, 100), pick(gen, 100), phrase(gen));
+    fputs("    return total\n\n", out);
+}
+
+static const char *const cppTypes[] = {"int", "long", "double", "char", "bool", "float"};
+
+void generateCPP(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "%s func_%lu(", CHOOSE(gen, cppTypes), gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        if (i) fputs(", ", out);
+        identifier(gen);
+    }
+    fprintf(out, ") {\n    // %s\n    int total = ", phrase(gen));
+    number(gen);
+    fprintf(out, ";\n    for (int i = 0; i < %d; i++) {\n        total += i * %d;\n    }\n",
+            1 + pick(gen, 100), pick(gen, 10));
+    fprintf(out, "    printf(\"%s\\n\");\n    return total;\n}\n\n", phrase(gen));
+}
+
+void generatePerl(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "sub func_%lu {\n    my (", gen->serial++);
+    for (int i = 0, n = 1 + pick(gen, 4); i < n; i++) {
+        fprintf(out, "%s$%s_%d", i ? ", " : "", CHOOSE(gen, stems), pick(gen, NAME_VARIANTS));
+    }
+    fprintf(out, ") = @_;\n    # %s\n    my $total = ", phrase(gen));
+    number(gen);
+    fprintf(out, ";\n    if ($total =~ /^\\d+$/) {\n        print \"%s\\n\";\n    }\n    return $total;\n}\n\n",
+            phrase(gen));
+}
+
+static const char *const cssProperties[] = {"color", "margin", "padding", "display", "font-size", "border"};
+static const char *const cssValues[] = {"#fff", "0 4px", "block", "12px", "1px solid #ccc", "inherit"};
+
+void generateCSS(Generator *gen) {
+    FILE *out = gen->out;
+    fprintf(out, "/* %s */\n.%s-%lu %s {\n", phrase(gen), CHOOSE(gen, stems), gen->serial++,
+            CHOOSE(gen, htmlTags));
+    for (int i = 0, n = 1 + pick(gen, 5); i < n; i++) {
+        fprintf(out, "    %s: %s;\n", CHOOSE(gen, cssProperties), CHOOSE(gen, cssValues));
+    }
+    fputs("}\n\n", out);
+}
+
+int generateCorpus(const char *path, GenerateUnit unit, uint64_t seed, long long size) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    setvbuf(out, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    Generator gen = { out, seed ? seed : 1, 0 };
+    while (ftello(out) < size) unit(&gen);
+
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed) {
+        if (!errno) errno = EIO;
+        return -1;
+    }
+    return 0;
+}
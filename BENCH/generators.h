@@ -0,0 +1,41 @@
+#ifndef CDLAB_GENERATORS_H
+#define CDLAB_GENERATORS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Synthetic source generators for the benchmark. Each one writes a single
+// self-contained unit (a query, a module, a function...) per call, drawing
+// every choice from the generator's seeded PRNG, so a given seed and size
+// always produce the same bytes.
+typedef struct {
+    FILE *out;
+    uint64_t state;             // xorshift64* state; never zero
+    unsigned long serial;       // keeps generated names unique
+} Generator;
+
+typedef void (*GenerateUnit)(Generator *gen);
+
+void generateSQL(Generator *gen);
+void generatePLSQL(Generator *gen);
+void generateVerilog(Generator *gen);
+void generateAssembly(Generator *gen);
+void generateCShell(Generator *gen);
+void generateJQuery(Generator *gen);
+void generateMATLAB(Generator *gen);
+void generatePowerShell(Generator *gen);
+void generateShell(Generator *gen);
+void generatePHP(Generator *gen);
+void generateJS(Generator *gen);
+void generateHTML(Generator *gen);
+void generateJava(Generator *gen);
+void generatePython(Generator *gen);
+void generateCPP(Generator *gen);
+void generatePerl(Generator *gen);
+void generateCSS(Generator *gen);
+
+// Writes units to `path` until it holds at least `size` bytes.
+// Returns 0 on success, -1 (with errno set) if the file cannot be written.
+int generateCorpus(const char *path, GenerateUnit unit, uint64_t seed, long long size);
+
+#endif
@@ -0,0 +1,3 @@
+// Builds the C++ section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_CPP
+#include "../AKUNDI/akundi.c"
@@ -0,0 +1,3 @@
+// Builds the CSS section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_CSS
+#include "../AKUNDI/akundi.c"
@@ -0,0 +1,3 @@
+// Builds the HTML section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_HTML
+#include "../AKUNDI/akundi.c"
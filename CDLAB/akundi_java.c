@@ -0,0 +1,3 @@
+// Builds the Java section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_JAVA
+#include "../AKUNDI/akundi.c"
@@ -0,0 +1,3 @@
+// Builds the JavaScript section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_JS
+#include "../AKUNDI/akundi.c"
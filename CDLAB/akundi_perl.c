@@ -0,0 +1,3 @@
+// Builds the Perl section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_PERL
+#include "../AKUNDI/akundi.c"
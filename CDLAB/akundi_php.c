@@ -0,0 +1,3 @@
+// Builds the PHP section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_PHP
+#include "../AKUNDI/akundi.c"
@@ -0,0 +1,3 @@
+// Builds the Python section of AKUNDI/akundi.c into the cdlab driver.
+#define AKUNDI_PYTHON
+#include "../AKUNDI/akundi.c"
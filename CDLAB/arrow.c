@@ -0,0 +1,624 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "../COMMON/alloc.h"
+#include "../COMMON/tokenstream.h"
+#include "languages.h"
+#include "pool.h"
+#include "arrow.h"
+
+#define ARROW_MAX_TYPES 64
+#define ARROW_TYPE_MAPS 4               // token tables a worker remembers at once
+#define ARROW_CONTINUATION 0xffffffffu  // starts every message
+
+// From the Arrow flatbuffer schemas (Schema.fbs, Message.fbs)
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+
+#define FILE_DICTIONARY 0
+#define TYPE_DICTIONARY 1
+#define LEXEME_DICTIONARY 2
+#define DICTIONARY_COUNT 3
+
+// Paths and lexemes are whatever bytes the file system and the sources
+// hold, so only the type names are declared text
+static const int dictionaryTypes[DICTIONARY_COUNT] = {ARROW_TYPE_BINARY, ARROW_TYPE_UTF8, ARROW_TYPE_BINARY};
+
+typedef struct {
+    const char *name;
+    int bitWidth;
+    int dictionary;             // -1 for plain integers
+} ArrowColumn;
+
+static const ArrowColumn columns[] = {
+    {"file", 32, FILE_DICTIONARY},
+    {"offset", 64, -1},
+    {"length", 64, -1},
+    {"type", 32, TYPE_DICTIONARY},
+    {"lexeme", 32, LEXEME_DICTIONARY}
+};
+#define COLUMN_COUNT (int)(sizeof(columns) / sizeof(columns[0]))
+
+// A flatbuffer built front to back: tables are written before what they
+// point to, so every offset points forward and is filled in once the
+// target is placed. Scalars are little-endian whatever the host.
+typedef struct {
+    unsigned char *bytes;
+    size_t used;
+    size_t capacity;
+} Flat;
+
+// Where one message went, as the footer lists it
+typedef struct {
+    uint64_t offset;
+    uint32_t metadataLength;    // including the continuation and length words
+    uint64_t bodyLength;
+} ArrowBlock;
+
+typedef struct {
+    const void *data;
+    uint64_t size;
+} ArrowBuffer;
+
+// One token table's types, as indexes into the type dictionary
+typedef struct {
+    const TokenFormat *format;
+    int32_t ids[ARROW_MAX_TYPES + 1];   // the last for types out of range
+} TypeMap;
+
+typedef struct ExportBuild ExportBuild;
+
+typedef struct {
+    ExportBuild *build;
+    int32_t file;
+    int32_t *files;             // the columns of the batch being gathered
+    int64_t *offsets;
+    int64_t *lengths;
+    int32_t *types;
+    int32_t *lexemes;
+    size_t count;
+    TypeMap maps[ARROW_TYPE_MAPS];
+    int nextMap;
+    Flat metadata;
+} ExportWorker;
+
+struct ExportBuild {
+    char *const *paths;
+    int pathCount;
+    const char *forced;
+    int fd;
+    ExportWorker *workers;
+    pthread_mutex_t lock;       // guards everything below
+    uint64_t size;              // bytes of the file claimed so far
+    ArrowBlock *batches;
+    size_t batchCount;
+    size_t batchCapacity;
+    const char **typeNames;     // the type dictionary
+    int typeCount;
+    int typeCapacity;
+    uint64_t tokens;
+    int failed;                 // a file could not be lexed
+    int writeError;             // errno of the first failed write
+};
+
+static const unsigned char zeros[8];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t padded(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+// Appends `size` zero bytes, starting where the offset plus `skew` is a
+// multiple of `align`, and returns their offset
+static size_t flatAppend(Flat *flat, size_t size, size_t align, size_t skew) {
+    size_t start = flat->used;
+    while ((start + skew) % align) start++;
+    if (start + size > flat->capacity) {
+        while (start + size > flat->capacity) flat->capacity = flat->capacity ? flat->capacity * 2 : 1024;
+        flat->bytes = checkedAlloc(realloc(flat->bytes, flat->capacity));
+    }
+    memset(flat->bytes + flat->used, 0, start + size - flat->used);
+    flat->used = start + size;
+    return start;
+}
+
+static void flatPut(Flat *flat, size_t at, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) flat->bytes[at + i] = (unsigned char)(value >> (8 * i));
+}
+
+// Points the offset at `at` to `target`
+static void flatLink(Flat *flat, size_t at, size_t target) {
+    flatPut(flat, at, target - at, 4);
+}
+
+// Writes a table and its vtable. Field i takes sizes[i] bytes, or is
+// absent if that is 0; where each field went is stored in `fields`.
+// Fields are laid out largest first so none needs padding.
+static size_t flatTable(Flat *flat, int count, const int *sizes, size_t *fields) {
+    size_t vtable = flatAppend(flat, 4 + 2 * count, 2, 0);
+    int wide = 0;
+    for (int i = 0; i < count; i++) wide |= sizes[i] == 8;
+    size_t table = flatAppend(flat, 4, wide ? 8 : 4, wide ? 4 : 0);
+    for (int size = 8; size >= 1; size /= 2) {
+        for (int i = 0; i < count; i++) {
+            if (sizes[i] != size) continue;
+            fields[i] = flatAppend(flat, size, size, 0);
+            flatPut(flat, vtable + 4 + 2 * i, fields[i] - table, 2);
+        }
+    }
+    flatPut(flat, vtable, 4 + 2 * count, 2);
+    flatPut(flat, vtable + 2, flat->used - table, 2);
+    flatPut(flat, table, table - vtable, 4);
+    return table;
+}
+
+// Writes a vector's length and room for its elements; returns where the
+// elements start
+static size_t flatVector(Flat *flat, size_t count, size_t elementSize, size_t align) {
+    size_t start = align == 8 ? flatAppend(flat, 4 + count * elementSize, 8, 4)
+                              : flatAppend(flat, 4 + count * elementSize, 4, 0);
+    flatPut(flat, start, count, 4);
+    return start + 4;
+}
+
+static size_t flatString(Flat *flat, const char *text) {
+    size_t length = strlen(text);
+    size_t start = flatAppend(flat, 4 + length + 1, 4, 0);
+    flatPut(flat, start, length, 4);
+    memcpy(flat->bytes + start + 4, text, length);
+    return start;
+}
+
+// Starts a Message carrying a header of `headerType` and returns the
+// offset field to link the header to
+static size_t startMessage(Flat *flat, int headerType, uint64_t bodyLength) {
+    static const int sizes[] = {2, 1, 4, 8};    // version, header_type, header, bodyLength
+    size_t fields[4];
+    flat->used = 0;
+    size_t root = flatAppend(flat, 4, 4, 0);
+    flatLink(flat, root, flatTable(flat, 4, sizes, fields));
+    flatPut(flat, fields[0], ARROW_METADATA_V5, 2);
+    flatPut(flat, fields[1], headerType, 1);
+    flatPut(flat, fields[3], bodyLength, 8);
+    return fields[2];
+}
+
+static size_t addInt(Flat *flat, int bitWidth) {
+    static const int sizes[] = {4, 1};          // bitWidth, is_signed
+    size_t fields[2];
+    size_t table = flatTable(flat, 2, sizes, fields);
+    flatPut(flat, fields[0], bitWidth, 4);
+    flatPut(flat, fields[1], 1, 1);
+    return table;
+}
+
+static void addField(Flat *flat, size_t at, const ArrowColumn *column) {
+    // name, nullable, type_type, type, dictionary, children
+    int sizes[] = {4, 1, 1, 4, column->dictionary < 0 ? 0 : 4, 4};
+    size_t fields[6];
+    flatLink(flat, at, flatTable(flat, 6, sizes, fields));
+    flatLink(flat, fields[0], flatString(flat, column->name));
+    if (column->dictionary < 0) {
+        flatPut(flat, fields[2], ARROW_TYPE_INT, 1);
+        flatLink(flat, fields[3], addInt(flat, column->bitWidth));
+    } else {
+        // A dictionary column's type is its values' type
+        static const int encodingSizes[] = {8, 4};     // id, indexType
+        size_t encoding[2];
+        flatPut(flat, fields[2], dictionaryTypes[column->dictionary], 1);
+        flatLink(flat, fields[3], flatTable(flat, 0, NULL, NULL));
+        flatLink(flat, fields[4], flatTable(flat, 2, encodingSizes, encoding));
+        flatPut(flat, encoding[0], column->dictionary, 8);
+        flatLink(flat, encoding[1], addInt(flat, column->bitWidth));
+    }
+    flatVector(flat, 0, 4, 4);
+    flatLink(flat, fields[5], flat->used - 4);
+}
+
+static size_t addSchema(Flat *flat) {
+    static const int sizes[] = {2, 4};          // endianness, fields
+    size_t fields[2];
+    size_t table = flatTable(flat, 2, sizes, fields);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    flatPut(flat, fields[0], 1, 2);
+#endif
+    size_t vector = flatVector(flat, COLUMN_COUNT, 4, 4);
+    flatLink(flat, fields[1], vector - 4);
+    for (int i = 0; i < COLUMN_COUNT; i++) addField(flat, vector + 4 * i, &columns[i]);
+    return table;
+}
+
+// Writes a RecordBatch of `rows` rows whose columns each have one node,
+// with the buffers laid out one after another in the body. Returns the
+// body's length.
+static uint64_t addRecordBatch(Flat *flat, size_t at, uint64_t rows, int columnCount,
+                               const ArrowBuffer *buffers, int bufferCount) {
+    static const int sizes[] = {8, 4, 4};       // length, nodes, buffers
+    size_t fields[3];
+    flatLink(flat, at, flatTable(flat, 3, sizes, fields));
+    flatPut(flat, fields[0], rows, 8);
+    size_t nodes = flatVector(flat, columnCount, 16, 8);
+    flatLink(flat, fields[1], nodes - 4);
+    for (int i = 0; i < columnCount; i++) flatPut(flat, nodes + 16 * i, rows, 8);
+    size_t spans = flatVector(flat, bufferCount, 16, 8);
+    flatLink(flat, fields[2], spans - 4);
+    uint64_t offset = 0;
+    for (int i = 0; i < bufferCount; i++) {
+        flatPut(flat, spans + 16 * i, offset, 8);
+        flatPut(flat, spans + 16 * i + 8, buffers[i].size, 8);
+        offset += padded(buffers[i].size);
+    }
+    return offset;
+}
+
+static int writeAt(int fd, const void *data, size_t size, uint64_t offset) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return 1;
+}
+
+static void writeFailed(ExportBuild *build) {
+    int error = errno ? errno : EIO;
+    pthread_mutex_lock(&build->lock);
+    if (!build->writeError) build->writeError = error;
+    pthread_mutex_unlock(&build->lock);
+}
+
+// Claims room at the end of the file for a message whose metadata is in
+// `flat`, then writes it there, so workers write their batches at once.
+static void writeMessage(ExportBuild *build, Flat *flat, const ArrowBuffer *buffers, int bufferCount,
+                         uint64_t bodyLength, ArrowBlock *block) {
+    uint64_t metadataSize = padded(flat->used);
+    flatAppend(flat, metadataSize - flat->used, 1, 0);
+    unsigned char prefix[8];
+    Flat header = {prefix, 0, sizeof(prefix)};
+    flatAppend(&header, 8, 1, 0);
+    flatPut(&header, 0, ARROW_CONTINUATION, 4);
+    flatPut(&header, 4, metadataSize, 4);
+
+    pthread_mutex_lock(&build->lock);
+    block->offset = build->size;
+    block->metadataLength = 8 + metadataSize;
+    block->bodyLength = bodyLength;
+    build->size += 8 + metadataSize + bodyLength;
+    pthread_mutex_unlock(&build->lock);
+
+    uint64_t at = block->offset;
+    int written = writeAt(build->fd, prefix, 8, at) && writeAt(build->fd, flat->bytes, metadataSize, at + 8);
+    at += 8 + metadataSize;
+    for (int i = 0; written && i < bufferCount; i++) {
+        written = writeAt(build->fd, buffers[i].data, buffers[i].size, at) &&
+                  writeAt(build->fd, zeros, padded(buffers[i].size) - buffers[i].size, at + buffers[i].size);
+        at += padded(buffers[i].size);
+    }
+    if (!written) writeFailed(build);
+}
+
+static void flushBatch(ExportWorker *worker) {
+    if (worker->count == 0) return;
+    ExportBuild *build = worker->build;
+    size_t rows = worker->count;
+    // Each column is an empty validity bitmap, as nothing is null, and its values
+    ArrowBuffer buffers[] = {
+        {NULL, 0}, {worker->files, rows * sizeof(int32_t)},
+        {NULL, 0}, {worker->offsets, rows * sizeof(int64_t)},
+        {NULL, 0}, {worker->lengths, rows * sizeof(int64_t)},
+        {NULL, 0}, {worker->types, rows * sizeof(int32_t)},
+        {NULL, 0}, {worker->lexemes, rows * sizeof(int32_t)}
+    };
+    int bufferCount = sizeof(buffers) / sizeof(buffers[0]);
+    uint64_t bodyLength = 0;
+    for (int i = 0; i < bufferCount; i++) bodyLength += padded(buffers[i].size);
+    Flat *flat = &worker->metadata;
+    size_t header = startMessage(flat, ARROW_HEADER_RECORD_BATCH, bodyLength);
+    addRecordBatch(flat, header, rows, COLUMN_COUNT, buffers, bufferCount);
+
+    ArrowBlock block;
+    writeMessage(build, flat, buffers, bufferCount, bodyLength, &block);
+    pthread_mutex_lock(&build->lock);
+    if (build->batchCount == build->batchCapacity) {
+        build->batchCapacity = build->batchCapacity ? build->batchCapacity * 2 : 64;
+        build->batches = checkedAlloc(realloc(build->batches, build->batchCapacity * sizeof(ArrowBlock)));
+    }
+    build->batches[build->batchCount++] = block;
+    build->tokens += rows;
+    pthread_mutex_unlock(&build->lock);
+    worker->count = 0;
+}
+
+// The type dictionary's index for a type name, adding it if it is new
+static int32_t typeIndex(ExportBuild *build, const char *name) {
+    for (int i = 0; i < build->typeCount; i++) {
+        if (strcmp(build->typeNames[i], name) == 0) return i;
+    }
+    if (build->typeCount == build->typeCapacity) {
+        build->typeCapacity = build->typeCapacity ? build->typeCapacity * 2 : 32;
+        build->typeNames = checkedAlloc(realloc(build->typeNames, build->typeCapacity * sizeof(char *)));
+    }
+    build->typeNames[build->typeCount] = name;
+    return build->typeCount++;
+}
+
+static const TypeMap *typeMap(ExportWorker *worker, const TokenFormat *format) {
+    for (int i = 0; i < ARROW_TYPE_MAPS; i++) {
+        if (worker->maps[i].format == format) return &worker->maps[i];
+    }
+    TypeMap *map = &worker->maps[worker->nextMap];
+    worker->nextMap = (worker->nextMap + 1) % ARROW_TYPE_MAPS;
+    map->format = format;
+    pthread_mutex_lock(&worker->build->lock);
+    for (int i = 0; i < ARROW_MAX_TYPES; i++) {
+        // Named as the text tables name them
+        const char *name = format && i < format->typeCount && format->typeNames[i]
+                           ? format->typeNames[i] : "UNKNOWN";
+        map->ids[i] = typeIndex(worker->build, name);
+    }
+    map->ids[ARROW_MAX_TYPES] = typeIndex(worker->build, "UNKNOWN");
+    pthread_mutex_unlock(&worker->build->lock);
+    return map;
+}
+
+static void collectToken(const Input *in, const Token *token, const TokenFormat *format, void *context) {
+    ExportWorker *worker = context;
+    if (worker->count == ARROW_BATCH_ROWS) flushBatch(worker);
+    const TypeMap *map = typeMap(worker, format);
+    size_t row = worker->count++;
+    worker->files[row] = worker->file;
+    worker->offsets[row] = token->offset;
+    worker->lengths[row] = token->length;
+    worker->types[row] = map->ids[token->type >= 0 && token->type < ARROW_MAX_TYPES ? token->type
+                                                                                    : ARROW_MAX_TYPES];
+    worker->lexemes[row] = internName(tokenText(in, token), token->length);
+}
+
+static void exportTask(int task, int worker, void *context) {
+    ExportBuild *build = context;
+    ExportWorker *state = &build->workers[worker];
+    const char *path = build->paths[task];
+    const Analyzer *analyzer = build->forced ? findLanguage(build->forced) : routeByExtension(path);
+    if (!analyzer || access(path, R_OK) != 0) {
+        if (analyzer) perror(path);
+        else fprintf(stderr, "No analyzer for %s (use --lang)\n", path);
+        pthread_mutex_lock(&build->lock);
+        build->failed = 1;
+        pthread_mutex_unlock(&build->lock);
+        return;
+    }
+
+    TokenStream stream;
+    streamOpen(&stream, NULL, STREAM_TEXT);
+    stream.visit = collectToken;
+    stream.visitContext = state;
+    state->file = task;
+    int status = analyzer->analyzeFile(path, &stream);
+    streamClose(&stream);
+    if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+    if (status != 0) {
+        pthread_mutex_lock(&build->lock);
+        build->failed = 1;
+        pthread_mutex_unlock(&build->lock);
+    }
+}
+
+// Writes one dictionary of `count` strings as a batch of one binary or
+// utf8 column. Returns 0, or -1 if they do not fit the column's 32-bit
+// offsets.
+static int writeDictionary(ExportBuild *build, Flat *flat, int id, size_t count,
+                           const char *(*text)(ExportBuild *, size_t, size_t *), ArrowBlock *block) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        text(build, i, &length);
+        total += length;
+    }
+    if (total > INT32_MAX || count > INT32_MAX) return -1;
+
+    int32_t *offsets = checkedAlloc(malloc((count + 1) * sizeof(int32_t)));
+    char *data = checkedAlloc(malloc(total + 1));
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        const char *string = text(build, i, &length);
+        memcpy(data + offsets[i], string, length);
+        offsets[i + 1] = offsets[i] + length;
+    }
+
+    ArrowBuffer buffers[] = {{NULL, 0}, {offsets, (count + 1) * sizeof(int32_t)}, {data, total}};
+    int bufferCount = sizeof(buffers) / sizeof(buffers[0]);
+    uint64_t bodyLength = 0;
+    for (int i = 0; i < bufferCount; i++) bodyLength += padded(buffers[i].size);
+    static const int sizes[] = {8, 4};          // id, data
+    size_t fields[2];
+    size_t header = startMessage(flat, ARROW_HEADER_DICTIONARY_BATCH, bodyLength);
+    flatLink(flat, header, flatTable(flat, 2, sizes, fields));
+    flatPut(flat, fields[0], id, 8);
+    addRecordBatch(flat, fields[1], count, 1, buffers, bufferCount);
+    writeMessage(build, flat, buffers, bufferCount, bodyLength, block);
+    free(offsets);
+    free(data);
+    return 0;
+}
+
+static const char *pathText(ExportBuild *build, size_t i, size_t *length) {
+    *length = strlen(build->paths[i]);
+    return build->paths[i];
+}
+
+static const char *typeText(ExportBuild *build, size_t i, size_t *length) {
+    *length = strlen(build->typeNames[i]);
+    return build->typeNames[i];
+}
+
+static const char *lexemeText(ExportBuild *build, size_t i, size_t *length) {
+    (void)build;                // the lexemes are the name pool's
+    *length = nameLength(i);
+    return nameText(i);
+}
+
+static void addBlocks(Flat *flat, size_t at, const ArrowBlock *blocks, size_t count) {
+    size_t vector = flatVector(flat, count, 24, 8);
+    flatLink(flat, at, vector - 4);
+    for (size_t i = 0; i < count; i++) {
+        flatPut(flat, vector + 24 * i, blocks[i].offset, 8);
+        flatPut(flat, vector + 24 * i + 8, blocks[i].metadataLength, 4);
+        flatPut(flat, vector + 24 * i + 16, blocks[i].bodyLength, 8);
+    }
+}
+
+// Writes the dictionaries, the end-of-stream marker and the footer after
+// the batches
+static int finishFile(ExportBuild *build, const char *exportPath) {
+    Flat flat = {0};
+    ArrowBlock dictionaries[DICTIONARY_COUNT];
+    static const char *const dictionaryNames[] = {"path", "type name", "lexeme"};
+    int status[DICTIONARY_COUNT];
+    status[FILE_DICTIONARY] = writeDictionary(build, &flat, FILE_DICTIONARY, build->pathCount, pathText,
+                                              &dictionaries[FILE_DICTIONARY]);
+    status[TYPE_DICTIONARY] = writeDictionary(build, &flat, TYPE_DICTIONARY, build->typeCount, typeText,
+                                              &dictionaries[TYPE_DICTIONARY]);
+    status[LEXEME_DICTIONARY] = writeDictionary(build, &flat, LEXEME_DICTIONARY, nameCount() + 1,
+                                                lexemeText, &dictionaries[LEXEME_DICTIONARY]);
+    for (int i = 0; i < DICTIONARY_COUNT; i++) {
+        if (status[i] < 0) {
+            fprintf(stderr, "%s: %ss exceed 2 GB\n", exportPath, dictionaryNames[i]);
+            free(flat.bytes);
+            return 0;
+        }
+    }
+
+    static const int sizes[] = {2, 4, 4, 4};   // version, schema, dictionaries, recordBatches
+    size_t fields[4];
+    flat.used = 0;
+    size_t root = flatAppend(&flat, 4, 4, 0);
+    flatLink(&flat, root, flatTable(&flat, 4, sizes, fields));
+    flatPut(&flat, fields[0], ARROW_METADATA_V5, 2);
+    flatLink(&flat, fields[1], addSchema(&flat));
+    addBlocks(&flat, fields[2], dictionaries, DICTIONARY_COUNT);
+    addBlocks(&flat, fields[3], build->batches, build->batchCount);
+
+    unsigned char end[8], trailer[4 + 6];
+    Flat endFlat = {end, 0, sizeof(end)}, trailerFlat = {trailer, 0, sizeof(trailer)};
+    flatAppend(&endFlat, 8, 1, 0);
+    flatPut(&endFlat, 0, ARROW_CONTINUATION, 4);
+    flatAppend(&trailerFlat, 4, 1, 0);
+    flatPut(&trailerFlat, 0, flat.used, 4);
+    memcpy(trailer + 4, ARROW_MAGIC, 6);
+    uint64_t at = build->size;
+    int written = writeAt(build->fd, end, sizeof(end), at) &&
+                  writeAt(build->fd, flat.bytes, flat.used, at + sizeof(end)) &&
+                  writeAt(build->fd, trailer, sizeof(trailer), at + sizeof(end) + flat.used);
+    if (!written) writeFailed(build);
+    build->size = at + sizeof(end) + flat.used + sizeof(trailer);
+    free(flat.bytes);
+    return 1;
+}
+
+int arrowExport(const char *exportPath, char *const *paths, int pathCount, int jobs,
+                const char *forced) {
+    double start = now();
+    char temporary[4096];
+    if (snprintf(temporary, sizeof(temporary), "%s.XXXXXX", exportPath) >= (int)sizeof(temporary)) {
+        fprintf(stderr, "%s: path too long\n", exportPath);
+        return 1;
+    }
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        perror(temporary);
+        return 1;
+    }
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+
+    ExportBuild build = {0};
+    build.paths = paths;
+    build.pathCount = pathCount;
+    build.forced = forced;
+    build.fd = fd;
+    pthread_mutex_init(&build.lock, NULL);
+    build.workers = checkedAlloc(calloc(jobs, sizeof(ExportWorker)));
+    for (int i = 0; i < jobs; i++) {
+        ExportWorker *worker = &build.workers[i];
+        worker->build = &build;
+        worker->files = checkedAlloc(malloc(ARROW_BATCH_ROWS * sizeof(int32_t)));
+        worker->offsets = checkedAlloc(malloc(ARROW_BATCH_ROWS * sizeof(int64_t)));
+        worker->lengths = checkedAlloc(malloc(ARROW_BATCH_ROWS * sizeof(int64_t)));
+        worker->types = checkedAlloc(malloc(ARROW_BATCH_ROWS * sizeof(int32_t)));
+        worker->lexemes = checkedAlloc(malloc(ARROW_BATCH_ROWS * sizeof(int32_t)));
+    }
+
+    // The magic, padded to 8, and the schema open the file
+    Flat flat = {0};
+    flatLink(&flat, startMessage(&flat, ARROW_HEADER_SCHEMA, 0), addSchema(&flat));
+    ArrowBlock schema;
+    build.size = 8;
+    if (!writeAt(fd, ARROW_MAGIC "\0", 8, 0)) writeFailed(&build);
+    writeMessage(&build, &flat, NULL, 0, 0, &schema);
+    free(flat.bytes);
+
+    poolRun(jobs, pathCount, exportTask, &build);
+    for (int i = 0; i < jobs; i++) flushBatch(&build.workers[i]);
+
+    int status = 1;
+    if (!finishFile(&build, exportPath)) {
+        unlink(temporary);
+    } else if (build.writeError) {
+        errno = build.writeError;
+        perror(temporary);
+        unlink(temporary);
+    } else if (close(fd) != 0) {
+        fd = -1;
+        perror(temporary);
+        unlink(temporary);
+    } else if (fd = -1, rename(temporary, exportPath) != 0) {
+        perror(exportPath);
+        unlink(temporary);
+    } else {
+        status = build.failed;
+        fprintf(stderr, "Exported %llu tokens from %d files in %zu batches, %llu bytes\n",
+                (unsigned long long)build.tokens, pathCount, build.batchCount,
+                (unsigned long long)build.size);
+    }
+    if (fd >= 0) close(fd);
+    fprintf(stderr, "Export written in %.2f s\n", now() - start);
+
+    for (int i = 0; i < jobs; i++) {
+        ExportWorker *worker = &build.workers[i];
+        free(worker->files);
+        free(worker->offsets);
+        free(worker->lengths);
+        free(worker->types);
+        free(worker->lexemes);
+        free(worker->metadata.bytes);
+    }
+    free(build.workers);
+    free(build.batches);
+    free(build.typeNames);
+    pthread_mutex_destroy(&build.lock);
+    return status;
+}
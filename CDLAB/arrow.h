@@ -0,0 +1,43 @@
+#ifndef CDLAB_ARROW_H
+#define CDLAB_ARROW_H
+
+// Token export in the Apache Arrow IPC file format, for loading into
+// analytics engines without converting the text tables. "cdlab export"
+// lexes every file and writes one row per token, column by column:
+//
+//   file    int32 index into a binary dictionary of the paths, in export
+//           order
+//   offset  int64 first byte of the lexeme in the file (the inflated text
+//           of a .gz file)
+//   length  int64 bytes in the lexeme
+//   type    int32 index into a utf8 dictionary of type names, as the text
+//           tables print them ("KEYWORD", "IDENTIFIER"...) and shared by
+//           every language
+//   lexeme  int32 index into a binary dictionary of lexemes: the ID the
+//           name pool gives it (see COMMON/intern.h), so equal lexemes
+//           share an index
+//
+// No column has nulls. The writer needs no Arrow library: the file is the
+// magic "ARROW1", a schema message, the record batches as the workers fill
+// them, the three dictionary batches, an end-of-stream marker and the
+// footer that lists every batch, all in the layout of the Arrow columnar
+// format version 1.x (metadata V5). Buffers are native-endian and 8-byte
+// aligned, so a reader can use them straight from a map of the file.
+//
+// The dictionaries come after the batches that use them, which the file
+// format allows and the stream format does not: read the file through its
+// footer (pyarrow.ipc.open_file, arrow::ipc::RecordBatchFileReader), not
+// as a stream. The lexeme dictionary holds every name in the pool, which
+// may include a few that only the symbol tables used. Paths and lexemes
+// are copied byte for byte and need not be valid UTF-8, so their
+// dictionaries are binary; decode them where the encoding is known.
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_BATCH_ROWS (1 << 18)      // tokens a worker gathers before writing a batch
+
+// Lexes `paths` on `jobs` threads and writes the tokens to `exportPath`,
+// replacing it by rename. With `forced`, every file is lexed in that
+// language. Returns 0, or 1 if a file or the export could not be written.
+int arrowExport(const char *exportPath, char *const *paths, int pathCount, int jobs,
+                const char *forced);
+
+#endif
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../COMMON/alloc.h"
+#include "../COMMON/input.h"
+#include "cache.h"
+
+#define INDEX_MAGIC "CDLABIX1"
+#define INDEX_FILE "index"
+#define OBJECTS_DIR "objects"
+#define CACHE_FORMAT 1          // bump when the object or index layout changes
+#define RACY_WINDOW 2           // seconds; newer files may still change within one mtime tick
+
+// One stat index record: what the file looked like when it hashed to `hash`
+typedef struct {
+    char *path;
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtimeSec, mtimeNsec;
+    int64_t ctimeSec, ctimeNsec;
+    unsigned char hash[16];
+} IndexEntry;
+
+// On-disk layout of an IndexEntry; the path bytes follow it
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtimeSec, mtimeNsec;
+    int64_t ctimeSec, ctimeNsec;
+    unsigned char hash[16];
+    uint32_t pathLength;
+} IndexRecord;
+
+// Leaves room under CACHE_PATH_LEN for "/objects/xx/<hash>-<language>-<version>"
+#define CACHE_DIR_LEN (CACHE_PATH_LEN - 128)
+
+struct Cache {
+    char dir[CACHE_DIR_LEN];
+    IndexEntry *entries;
+    int count;
+    int capacity;
+    int *slots;                 // open addressing over entries: index + 1, 0 if empty
+    size_t slotCount;
+    int dirty;
+    pthread_mutex_t lock;
+};
+
+static unsigned long storeCounter = 0;
+
+static uint64_t pathHash(const char *path) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (; *path; path++) h = (h ^ (unsigned char)*path) * 0x100000001b3ULL;
+    return h;
+}
+
+// 128-bit FNV-1a over the file contents
+static void contentHash(const char *data, size_t size, unsigned char out[16]) {
+    unsigned __int128 h = ((unsigned __int128)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+    const unsigned __int128 prime = ((unsigned __int128)1 << 88) | 0x13b;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ (unsigned char)data[i]) * prime;
+    }
+    for (int i = 0; i < 16; i++) out[i] = (unsigned char)(h >> (8 * (15 - i)));
+}
+
+static IndexEntry *indexFind(Cache *cache, const char *path) {
+    if (cache->slotCount == 0) return NULL;
+    size_t mask = cache->slotCount - 1;
+    for (size_t i = pathHash(path) & mask; cache->slots[i]; i = (i + 1) & mask) {
+        IndexEntry *entry = &cache->entries[cache->slots[i] - 1];
+        if (strcmp(entry->path, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+static void indexGrow(Cache *cache) {
+    size_t slotCount = cache->slotCount ? cache->slotCount * 2 : 1024;
+    int *slots = checkedAlloc(calloc(slotCount, sizeof(int)));
+    for (int e = 0; e < cache->count; e++) {
+        size_t i = pathHash(cache->entries[e].path) & (slotCount - 1);
+        while (slots[i]) i = (i + 1) & (slotCount - 1);
+        slots[i] = e + 1;
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->slotCount = slotCount;
+}
+
+// Returns the entry for path, adding an empty one if it is not indexed yet
+static IndexEntry *indexPut(Cache *cache, const char *path) {
+    IndexEntry *entry = indexFind(cache, path);
+    if (entry) return entry;
+
+    if ((size_t)(cache->count + 1) * 2 > cache->slotCount) indexGrow(cache);
+    if (cache->count == cache->capacity) {
+        cache->capacity = cache->capacity ? cache->capacity * 2 : 1024;
+        cache->entries = checkedAlloc(realloc(cache->entries, cache->capacity * sizeof(IndexEntry)));
+    }
+
+    entry = &cache->entries[cache->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->path = checkedAlloc(strdup(path));
+
+    size_t mask = cache->slotCount - 1;
+    size_t i = pathHash(path) & mask;
+    while (cache->slots[i]) i = (i + 1) & mask;
+    cache->slots[i] = ++cache->count;
+    return entry;
+}
+
+static int statMatches(const IndexEntry *entry, const struct stat *st) {
+    return entry->dev == (uint64_t)st->st_dev && entry->ino == (uint64_t)st->st_ino &&
+           entry->size == st->st_size &&
+           entry->mtimeSec == st->st_mtim.tv_sec && entry->mtimeNsec == st->st_mtim.tv_nsec &&
+           entry->ctimeSec == st->st_ctim.tv_sec && entry->ctimeNsec == st->st_ctim.tv_nsec;
+}
+
+static void indexLoad(Cache *cache, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return;      // first run
+
+    char magic[8];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0) {
+        fprintf(stderr, "%s: not a cdlab index, starting a new one\n", filename);
+        fclose(file);
+        return;
+    }
+
+    IndexRecord record;
+    char path[CACHE_PATH_LEN];
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.pathLength >= sizeof(path) ||
+            fread(path, 1, record.pathLength, file) != record.pathLength) {
+            fprintf(stderr, "%s: truncated, ignoring the rest\n", filename);
+            break;
+        }
+        path[record.pathLength] = '\0';
+
+        IndexEntry *entry = indexPut(cache, path);
+        entry->dev = record.dev;
+        entry->ino = record.ino;
+        entry->size = record.size;
+        entry->mtimeSec = record.mtimeSec;
+        entry->mtimeNsec = record.mtimeNsec;
+        entry->ctimeSec = record.ctimeSec;
+        entry->ctimeNsec = record.ctimeNsec;
+        memcpy(entry->hash, record.hash, sizeof(entry->hash));
+    }
+    fclose(file);
+}
+
+static int indexSave(Cache *cache) {
+    char filename[CACHE_PATH_LEN], temp[CACHE_PATH_LEN];
+    snprintf(filename, sizeof(filename), "%s/%s", cache->dir, INDEX_FILE);
+    snprintf(temp, sizeof(temp), "%s/%s.%d", cache->dir, INDEX_FILE, (int)getpid());
+
+    FILE *file = fopen(temp, "wb");
+    if (!file) {
+        perror(temp);
+        return -1;
+    }
+
+    fwrite(INDEX_MAGIC, 1, 8, file);
+    for (int i = 0; i < cache->count; i++) {
+        const IndexEntry *entry = &cache->entries[i];
+        IndexRecord record;
+        memset(&record, 0, sizeof(record));
+        record.dev = entry->dev;
+        record.ino = entry->ino;
+        record.size = entry->size;
+        record.mtimeSec = entry->mtimeSec;
+        record.mtimeNsec = entry->mtimeNsec;
+        record.ctimeSec = entry->ctimeSec;
+        record.ctimeNsec = entry->ctimeNsec;
+        memcpy(record.hash, entry->hash, sizeof(record.hash));
+        record.pathLength = strlen(entry->path);
+        fwrite(&record, sizeof(record), 1, file);
+        fwrite(entry->path, 1, record.pathLength, file);
+    }
+
+    if (fclose(file) != 0 || rename(temp, filename) != 0) {
+        perror(filename);
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
+
+Cache *cacheOpen(const char *dir) {
+    if (strlen(dir) >= CACHE_DIR_LEN) {
+        fprintf(stderr, "Cache directory name too long: %s\n", dir);
+        return NULL;
+    }
+
+    char path[CACHE_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, OBJECTS_DIR);
+    if ((mkdir(dir, 0777) != 0 && errno != EEXIST) ||
+        (mkdir(path, 0777) != 0 && errno != EEXIST)) {
+        perror(path);
+        return NULL;
+    }
+
+    Cache *cache = calloc(1, sizeof(Cache));
+    if (!cache) {
+        perror("calloc");
+        return NULL;
+    }
+    strcpy(cache->dir, dir);
+    pthread_mutex_init(&cache->lock, NULL);
+
+    snprintf(path, sizeof(path), "%s/%s", dir, INDEX_FILE);
+    indexLoad(cache, path);
+    return cache;
+}
+
+void cacheClose(Cache *cache) {
+    if (cache->dirty) indexSave(cache);
+    for (int i = 0; i < cache->count; i++) free(cache->entries[i].path);
+    free(cache->entries);
+    free(cache->slots);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// Reads a whole object file; returns 0 if it is missing or unreadable
+static int readObject(const char *path, char **data, size_t *length) {
+    Input in;
+    if (inputOpen(&in, path) != 0) return 0;
+    *data = malloc(in.size ? in.size : 1);
+    if (!*data) {
+        inputClose(&in);
+        return 0;
+    }
+    memcpy(*data, in.data, in.size);
+    *length = in.size;
+    inputClose(&in);
+    return 1;
+}
+
+int cacheLookup(Cache *cache, const char *path, const char *language, int version,
+                CacheEntry *entry) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+
+    unsigned char hash[16];
+    int known = 0;
+    pthread_mutex_lock(&cache->lock);
+    IndexEntry *indexed = indexFind(cache, path);
+    if (indexed && statMatches(indexed, &st)) {
+        memcpy(hash, indexed->hash, sizeof(hash));
+        known = 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!known) {
+        Input in;
+        if (inputOpen(&in, path) != 0) return -1;
+        contentHash(in.data, in.size, hash);
+        inputClose(&in);
+
+        // A file written within the last tick could change again without its
+        // mtime moving, so only remember stat results that have settled
+        time_t now = time(NULL);
+        if (st.st_mtime < now - RACY_WINDOW && st.st_ctime < now - RACY_WINDOW) {
+            pthread_mutex_lock(&cache->lock);
+            indexed = indexPut(cache, path);
+            indexed->dev = st.st_dev;
+            indexed->ino = st.st_ino;
+            indexed->size = st.st_size;
+            indexed->mtimeSec = st.st_mtim.tv_sec;
+            indexed->mtimeNsec = st.st_mtim.tv_nsec;
+            indexed->ctimeSec = st.st_ctim.tv_sec;
+            indexed->ctimeNsec = st.st_ctim.tv_nsec;
+            memcpy(indexed->hash, hash, sizeof(hash));
+            cache->dirty = 1;
+            pthread_mutex_unlock(&cache->lock);
+        }
+    }
+
+    char hex[33];
+    for (int i = 0; i < 16; i++) sprintf(hex + 2 * i, "%02x", hash[i]);
+    snprintf(entry->objectPath, sizeof(entry->objectPath), "%s/%s/%.2s/%s-%s-%d.%d",
+             cache->dir, OBJECTS_DIR, hex, hex + 2, language, version, CACHE_FORMAT);
+
+    entry->report = NULL;
+    entry->length = 0;
+    return readObject(entry->objectPath, &entry->report, &entry->length);
+}
+
+void cacheStore(const CacheEntry *entry, const char *report, size_t length) {
+    // objects/xx/ is created on first use
+    char dir[CACHE_PATH_LEN];
+    strcpy(dir, entry->objectPath);
+    *strrchr(dir, '/') = '\0';
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return;
+    }
+
+    // Write under a private name and rename, so readers never see half a report
+    char temp[CACHE_PATH_LEN];
+    snprintf(temp, sizeof(temp), "%s/tmp.%d.%lu", dir, (int)getpid(),
+             __atomic_fetch_add(&storeCounter, 1, __ATOMIC_RELAXED));
+    FILE *file = fopen(temp, "wb");
+    if (!file) {
+        perror(temp);
+        return;
+    }
+    fwrite(report, 1, length, file);
+    if (fclose(file) != 0 || rename(temp, entry->objectPath) != 0) {
+        perror(entry->objectPath);
+        unlink(temp);
+    }
+}
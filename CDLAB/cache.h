@@ -0,0 +1,37 @@
+#ifndef CDLAB_CACHE_H
+#define CDLAB_CACHE_H
+
+#include <stddef.h>
+
+#define CACHE_PATH_LEN 4096
+
+// Persistent cache of analyzer reports under one directory.
+//
+// Reports are stored by content: the object name is a 128-bit hash of the
+// file plus the analyzer and its version, so renamed or copied files hit
+// as well. A stat index (device, inode, size, mtime -> content hash) lets
+// an unchanged file be served without opening it at all.
+typedef struct Cache Cache;
+
+typedef struct {
+    char objectPath[CACHE_PATH_LEN];    // where the report for this content lives
+    char *report;                       // malloc'd report on a hit
+    size_t length;
+} CacheEntry;
+
+// Returns NULL (after printing why) if the directory cannot be used
+Cache *cacheOpen(const char *dir);
+
+// Saves the stat index and frees the cache
+void cacheClose(Cache *cache);
+
+// Returns 1 on a hit with entry->report filled in, 0 on a miss, and -1 if
+// the file cannot be read. Safe to call from several threads.
+int cacheLookup(Cache *cache, const char *path, const char *language, int version,
+                CacheEntry *entry);
+
+// Stores the report for an entry that cacheLookup missed; the entry knows
+// where it goes
+void cacheStore(const CacheEntry *entry, const char *report, size_t length);
+
+#endif
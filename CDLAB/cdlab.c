@@ -0,0 +1,918 @@
+// cdlab: runs every analyzer in this repository from one process.
+//
+//   cdlab [-j JOBS] [--cache DIR] [--format FMT] [--lang NAME] [--stats] [--split SIZE] [--symbols-db DB] [--changed-since REF|last] [--prefetch N] [--files-from LIST] PATH|DIR|GLOB ...
+//   cdlab --stream [--window SIZE] [--format FMT] [--lang NAME] [PATH|FIFO ...]
+//   cdlab decode [STREAM]
+//   cdlab lookup DB NAME [KIND]
+//   cdlab index INDEX [-j JOBS] [--lang NAME] [PATH|DIR|GLOB ...]
+//   cdlab search INDEX [-i] [-j JOBS] TEXT
+//   cdlab export FILE [-j JOBS] [--lang NAME] [PATH|DIR|GLOB ...]
+//   cdlab serve SOCKET [-j JOBS] [--cache DIR] [--watch [--debounce MS]] [PATH|DIR|GLOB ...]
+//   cdlab client SOCKET [--repeat N] [--clients N] REQUEST
+//
+// Files are routed to an analyzer by extension; directories are walked
+// recursively and globs are expanded here, so quoted patterns work even
+// when the shell does not expand them. A PATH of "-" reads one path per
+// line from stdin.
+//
+// With -j the files are analyzed on a work-stealing pool, largest first,
+// and each file's report is printed whole as soon as it is finished.
+// With --cache, reports are kept in DIR keyed by file content, and files
+// that have not changed since the last run are served from there.
+// --format binary writes the token stream described in tokenstream.h
+// instead of text tables; "cdlab decode" turns such a stream back into text.
+// --stats prints where each file's time went (see COMMON/stats.h) and a
+// summary over the run, all on stderr.
+// --split lexes every SQL, PL/SQL or Verilog file of at least SIZE bytes in
+// chunks on all CPUs (see COMMON/chunklex.h); the output does not change.
+// --stream reads stdin, pipes and FIFOs front to back through a window of
+// fixed size (see COMMON/window.h), writing tokens and symbol entries as it
+// goes, so memory does not grow with the input.
+// --symbols-db writes every symbol found to a database (see symboldb.h)
+// that "cdlab lookup" answers from without analyzing anything.
+// --changed-since asks git which files differ from REF, or from the commit
+// of the last such run, analyzes only those and patches the symbol
+// database (see gitchanges.h).
+// "cdlab index" writes a trigram index of every file's names and strings
+// (see trigram.h); "cdlab search" uses it to lex only the files that can
+// contain TEXT.
+// "cdlab export" writes every token to an Arrow IPC file of columns (see
+// arrow.h) for analytics engines to load.
+// "cdlab serve" keeps the analyzers and a symbol index resident behind a
+// Unix socket (see server.h), warmed with any paths given; "cdlab client"
+// sends it one request.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "../COMMON/analyzer.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/chunklex.h"
+#include "../COMMON/window.h"
+#include "../COMMON/gzip.h"
+#include "languages.h"
+#include "pool.h"
+#include "cache.h"
+#include "report.h"
+#include "decode.h"
+#include "server.h"
+#include "symboldb.h"
+#include "trigram.h"
+#include "arrow.h"
+#include "gitchanges.h"
+#include "watch.h"
+#include "loader.h"
+
+#define MAX_PATH_LEN 4096
+#define GIT_STATE_FILE "git-state"
+
+typedef struct {
+    char *path;
+    off_t size;         // used to schedule large files first
+    char *symbols;      // the file's symbol listing, with --symbols-db
+    size_t symbolsLength;
+} FileEntry;
+
+typedef struct {
+    FileEntry *files;
+    int count;
+    int capacity;
+} FileList;
+
+// Per-worker totals, merged into one summary once the pool has drained
+typedef struct {
+    int analyzed;
+    int cached;
+    int files[LANGUAGES_COUNT];
+    long long bytes[LANGUAGES_COUNT];
+    StatsTotals statsTotals;    // only filled in with --stats
+} ScanStats;
+
+typedef struct {
+    FileList *list;
+    ScanStats *stats;           // one per worker
+    pthread_mutex_t outputLock;
+    Loader *loader;             // NULL if files are read as they come
+} ParallelScan;
+
+static const Analyzer *forcedAnalyzer = NULL;
+static Cache *cache = NULL;
+static StreamFormat outputFormat = STREAM_TEXT;
+static int statsEnabled = 0;
+static size_t windowSize = WINDOW_DEFAULT_SIZE;
+static const char *symbolsDbPath = NULL;
+static int loaderDepth = LOADER_DEFAULT_DEPTH;
+
+// Accepted by --format, in StreamFormat order. The suffix keeps each
+// format's reports apart in the cache.
+typedef struct {
+    const char *name;
+    StreamFormat format;
+    const char *cacheSuffix;
+} FormatName;
+
+static const FormatName formats[] = {
+    {"text", STREAM_TEXT, ""},
+    {"binary", STREAM_BINARY, ".bin"},
+    {"binary-lexemes", STREAM_BINARY_LEXEMES, ".binlex"}
+};
+#define FORMATS_COUNT (sizeof(formats) / sizeof(formats[0]))
+
+static const Analyzer *analyzerFor(const char *path) {
+    return forcedAnalyzer ? forcedAnalyzer : routeByExtension(path);
+}
+
+static void addFile(FileList *list, const char *path, off_t size) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->files = realloc(list->files, list->capacity * sizeof(FileEntry));
+        if (!list->files) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    list->files[list->count].path = strdup(path);
+    list->files[list->count].size = size;
+    list->files[list->count].symbols = NULL;
+    list->files[list->count].symbolsLength = 0;
+    if (!list->files[list->count].path) {
+        perror("strdup");
+        exit(1);
+    }
+    list->count++;
+}
+
+static void walkDirectory(FileList *list, const char *dirname) {
+    DIR *dir = opendir(dirname);
+    if (!dir) {
+        perror(dirname);
+        return;
+    }
+
+    // "src/" joins as "src/file", not "src//file"; "/" joins as "/file"
+    int dirLength = strlen(dirname);
+    while (dirLength > 0 && dirname[dirLength - 1] == '/') dirLength--;
+
+    struct dirent *entry;
+    char path[MAX_PATH_LEN];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            strcmp(entry->d_name, ".git") == 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%.*s/%s", dirLength, dirname, entry->d_name) >= (int)sizeof(path)) {
+            fprintf(stderr, "Path too long, skipped: %.*s/%s\n", dirLength, dirname, entry->d_name);
+            continue;
+        }
+
+        // lstat so symlinked directories cannot send the walk round in circles
+        struct stat st;
+        if (lstat(path, &st) != 0) {
+            perror(path);
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            walkDirectory(list, path);
+        } else if (S_ISREG(st.st_mode) && routeByExtension(path)) {
+            addFile(list, path, st.st_size);
+        }
+    }
+    closedir(dir);
+}
+
+static void addPath(FileList *list, const char *path) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        if (S_ISDIR(st.st_mode)) {
+            walkDirectory(list, path);
+        } else {
+            addFile(list, path, st.st_size);
+        }
+        return;
+    }
+
+    if (strpbrk(path, "*?[")) {
+        glob_t matches;
+        if (glob(path, 0, NULL, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++) {
+                addPath(list, matches.gl_pathv[i]);
+            }
+            globfree(&matches);
+        } else {
+            fprintf(stderr, "No files match: %s\n", path);
+        }
+        return;
+    }
+
+    perror(path);
+}
+
+static void addPathsFrom(FileList *list, FILE *stream) {
+    char line[MAX_PATH_LEN];
+    while (fgets(line, sizeof(line), stream)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0') addPath(list, line);
+    }
+}
+
+static int comparePaths(const void *a, const void *b) {
+    return strcmp(((const FileEntry *)a)->path, ((const FileEntry *)b)->path);
+}
+
+// Largest first, so a single huge file starts early instead of running alone at the end
+static int compareSizes(const void *a, const void *b) {
+    const FileEntry *x = a, *y = b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return strcmp(x->path, y->path);
+}
+
+// Writes one file's complete report to the stream; returns 0 if nothing could analyze it or it could not be read
+static int analyzeOne(FileEntry *file, TokenStream *stream, ScanStats *stats) {
+    const Analyzer *analyzer = analyzerFor(file->path);
+    if (!analyzer) {
+        fprintf(stderr, "No analyzer for %s (use --lang)\n", file->path);
+        return 0;
+    }
+
+    FileStats fileStats;
+    if (statsEnabled) statsBegin(&fileStats);
+
+    streamBeginFile(stream, file->path, analyzer->name);
+    int cached = 0, status;
+    if (cache) {
+        char key[64];
+        snprintf(key, sizeof(key), "%s%s", languages[languageIndex(analyzer)].key,
+                 formats[outputFormat].cacheSuffix);
+        SymbolListing listing;
+        status = writeCachedReport(cache, key, analyzer, file->path, stream,
+                                   symbolsDbPath ? &listing : NULL);
+        cached = status > 0;
+        if (symbolsDbPath) {
+            file->symbols = listing.text;
+            file->symbolsLength = listing.length;
+        }
+        stats->cached += cached;
+    } else {
+        FILE *listing = symbolsDbPath ? open_memstream(&file->symbols, &file->symbolsLength) : NULL;
+        if (symbolsDbPath && !listing) perror("open_memstream");
+        status = writeReport(analyzer, file->path, stream, listing);
+        if (listing) fclose(listing);
+    }
+    streamEndFile(stream);
+    // The analyzer has said why; the file does not count as analyzed
+    if (status < 0) {
+        if (statsEnabled) statsEnd(&fileStats);
+        return 0;
+    }
+
+    // Cached reports did no analysis, so there is nothing to show for them
+    if (statsEnabled) {
+        statsEnd(&fileStats);
+        if (!cached) {
+            statsAdd(&stats->statsTotals, &fileStats, file->path);
+            statsPrintFile(stderr, &fileStats, file->path, analyzer->name);
+        }
+    }
+
+    int language = languageIndex(analyzer);
+    stats->analyzed++;
+    stats->files[language]++;
+    stats->bytes[language] += file->size;
+    return 1;
+}
+
+// Starts loading the files ahead, in the order they will be analyzed. The
+// cache answers for unchanged files without reading them in full, so
+// loading ahead would only add I/O there.
+static Loader *startLoader(FileList *files) {
+    if (loaderDepth == 0 || cache || files->count < 2) return NULL;
+    char **paths = malloc(files->count * sizeof(char *));
+    long long *sizes = malloc(files->count * sizeof(long long));
+    if (!paths || !sizes) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < files->count; i++) {
+        paths[i] = files->files[i].path;
+        // Compressed files are inflated by inputOpen, so they are read there
+        sizes[i] = strcmp(paths[i], "-") == 0 || gzipPath(paths[i]) ? -1 : files->files[i].size;
+    }
+    Loader *loader = loaderStart(paths, sizes, files->count, loaderDepth);
+    free(paths);
+    free(sizes);
+    return loader;
+}
+
+static void stopLoader(Loader *loader, int fileCount) {
+    if (!loader) return;
+    if (statsEnabled) {
+        fprintf(stderr, "Loaded %d of %d files ahead through %s\n", loaderTakenCount(loader), fileCount,
+                loaderBackend(loader));
+    }
+    loaderStop(loader);
+}
+
+// analyzeOne on file `index`, from memory if the loader has it
+static int analyzeLoaded(Loader *loader, int index, FileEntry *file, TokenStream *stream, ScanStats *stats) {
+    char *data;
+    size_t size;
+    if (!loader || !loaderTake(loader, index, &data, &size)) return analyzeOne(file, stream, stats);
+    inputLend(file->path, data, size);
+    int analyzed = analyzeOne(file, stream, stats);
+    inputLendEnd();
+    free(data);
+    return analyzed;
+}
+
+// Reports are built in memory and written out under the lock so that two
+// files never interleave on stdout
+static void analyzeTask(int task, int worker, void *context) {
+    ParallelScan *scan = context;
+    char *report = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&report, &length);
+    if (!out) {
+        perror("open_memstream");
+        return;
+    }
+
+    TokenStream stream;
+    streamOpen(&stream, out, outputFormat);
+    analyzeLoaded(scan->loader, task, &scan->list->files[task], &stream, &scan->stats[worker]);
+    streamClose(&stream);
+    fclose(out);
+
+    pthread_mutex_lock(&scan->outputLock);
+    fwrite(report, 1, length, stdout);
+    pthread_mutex_unlock(&scan->outputLock);
+    free(report);
+}
+
+static void analyzeParallel(FileList *files, int jobs, ScanStats *total) {
+    ParallelScan scan = { files, calloc(jobs, sizeof(ScanStats)), PTHREAD_MUTEX_INITIALIZER, NULL };
+    if (!scan.stats) {
+        perror("calloc");
+        exit(1);
+    }
+
+    qsort(files->files, files->count, sizeof(FileEntry), compareSizes);
+    scan.loader = startLoader(files);
+    poolRun(jobs, files->count, analyzeTask, &scan);
+    stopLoader(scan.loader, files->count);
+
+    for (int w = 0; w < jobs; w++) {
+        total->analyzed += scan.stats[w].analyzed;
+        total->cached += scan.stats[w].cached;
+        for (int i = 0; i < LANGUAGES_COUNT; i++) {
+            total->files[i] += scan.stats[w].files[i];
+            total->bytes[i] += scan.stats[w].bytes[i];
+        }
+        statsMerge(&total->statsTotals, &scan.stats[w].statsTotals);
+    }
+    free(scan.stats);
+}
+
+// --stream: analyzes each path, or stdin if there are none, in one pass
+// through a fixed window. Languages that cannot be streamed are read whole.
+static int streamInputs(FileList *files) {
+    FileEntry standardInput = {"-", 0, NULL, 0};
+    FileEntry *inputs = files->count ? files->files : &standardInput;
+    int count = files->count ? files->count : 1;
+    int failed = 0;
+    ScanStats stats = {0};
+
+    TokenStream stream;
+    streamWriteHeader(stdout, outputFormat);
+    streamOpen(&stream, stdout, outputFormat);
+    for (int i = 0; i < count; i++) {
+        const char *path = inputs[i].path;
+        const Analyzer *analyzer = analyzerFor(path);
+        if (!analyzer || !analyzer->document) {
+            if (analyzer) fprintf(stderr, "%s cannot be streamed, reading %s whole\n", analyzer->name, path);
+            failed += !analyzeOne(&inputs[i], &stream, &stats);
+            continue;
+        }
+
+        int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+        if (fd < 0) {
+            perror(path);
+            failed++;
+            continue;
+        }
+        streamBeginFile(&stream, path, analyzer->name);
+        if (windowAnalyze(fd, gzipPath(path), windowSize, analyzer->document, &stream) != 0) {
+            perror(path);
+            failed++;
+        }
+        streamEndFile(&stream);
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    streamClose(&stream);
+    return failed ? 1 : 0;
+}
+
+// "./a/b" and "a/b" are the same file; the database stores the second
+static const char *plainPath(const char *path) {
+    while (path[0] == '.' && path[1] == '/') path += 2;
+    return path;
+}
+
+static int compareStrings(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// The paths a --changed-since run replaces in the database, sorted
+typedef struct {
+    const char **paths;
+    int count;
+} ReplacedPaths;
+
+static int keepUnchanged(const char *path, void *context) {
+    const ReplacedPaths *replaced = context;
+    path = plainPath(path);
+    return !bsearch(&path, replaced->paths, replaced->count, sizeof(char *), compareStrings);
+}
+
+// --symbols-db: gathers every file's listing into one database. With
+// `changes`, the database is patched instead: the symbols of every file
+// that did not change are copied from the old one.
+static int writeSymbolsDb(FileList *files, const GitChanges *changes) {
+    SymbolDb *old = NULL;
+    if (changes && !(old = symbolDbOpen(symbolsDbPath))) return -1;
+    SymbolDbWriter *writer = symbolDbCreate();
+    if (old) {
+        ReplacedPaths replaced = {malloc((changes->changedCount + changes->deletedCount + 1) * sizeof(char *)), 0};
+        if (!replaced.paths) {
+            perror("malloc");
+            exit(1);
+        }
+        for (int i = 0; i < changes->changedCount; i++) replaced.paths[replaced.count++] = plainPath(changes->changed[i]);
+        for (int i = 0; i < changes->deletedCount; i++) replaced.paths[replaced.count++] = plainPath(changes->deleted[i]);
+        qsort(replaced.paths, replaced.count, sizeof(char *), compareStrings);
+        symbolDbCopy(writer, old, keepUnchanged, &replaced);
+        symbolDbClose(old);
+        free(replaced.paths);
+    }
+    for (int i = 0; i < files->count; i++) {
+        FileEntry *file = &files->files[i];
+        if (file->symbols) symbolDbAddFile(writer, plainPath(file->path), file->symbols, file->symbolsLength);
+        free(file->symbols);
+        file->symbols = NULL;
+    }
+    return symbolDbWrite(writer, symbolsDbPath);
+}
+
+// Only files some analyzer would take matter to a --changed-since run
+static void addAnalyzable(GitChanges *to, const GitChanges *from) {
+    for (int i = 0; i < from->changedCount; i++) {
+        if (forcedAnalyzer || routeByExtension(from->changed[i])) gitChangesAdd(to, from->changed[i]);
+    }
+    for (int i = 0; i < from->deletedCount; i++) {
+        if (forcedAnalyzer || routeByExtension(from->deleted[i])) gitChangesAdd(to, from->deleted[i]);
+    }
+}
+
+// --changed-since: fills `files` with the changed files under `pathspecs`
+// that an analyzer takes, and `changes` with what the stored results must
+// drop. Returns 1 if only those need analyzing, 0 if everything does (no
+// earlier run, or no database to patch) and -1 if git could not tell.
+static int selectChanged(const char *since, const char *statePath, char **pathspecs, int pathspecCount,
+                         FileList *files, GitChanges *changes) {
+    char base[GIT_HASH_LEN];
+    GitChanges differences = {0};
+    memset(changes, 0, sizeof(*changes));
+    if (strcmp(since, "last") != 0) {
+        snprintf(base, sizeof(base), "%s", since);
+    } else if (gitReadState(statePath, base, sizeof(base), &differences) != 0) {
+        fprintf(stderr, "No earlier --changed-since run recorded in %s, analyzing everything\n", statePath);
+        return 0;
+    }
+    addAnalyzable(changes, &differences);
+    gitChangesFree(&differences);
+
+    if (gitChanges(base, pathspecs, pathspecCount, &differences) != 0) {
+        gitChangesFree(changes);
+        return -1;
+    }
+    addAnalyzable(changes, &differences);
+    gitChangesFree(&differences);
+
+    if (symbolsDbPath && access(symbolsDbPath, F_OK) != 0) {
+        fprintf(stderr, "No symbol database at %s yet, analyzing everything\n", symbolsDbPath);
+        gitChangesFree(changes);
+        return 0;
+    }
+    for (int i = 0; i < changes->changedCount; i++) {
+        struct stat st;
+        const char *path = changes->changed[i];
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            addFile(files, path, st.st_size);
+        }
+    }
+    fprintf(stderr, "%d files changed since %s, %d deleted\n", changes->changedCount, base,
+            changes->deletedCount);
+    return 1;
+}
+
+// Records the commit this run saw and the files that differed from it
+static void recordRun(const char *statePath, char **pathspecs, int pathspecCount) {
+    char head[GIT_HASH_LEN];
+    GitChanges differences, dirty = {0};
+    if (gitHead(head, sizeof(head)) != 0) return;
+    if (gitChanges(head, pathspecs, pathspecCount, &differences) != 0) return;
+    addAnalyzable(&dirty, &differences);
+    gitWriteState(statePath, head, &dirty);
+    gitChangesFree(&differences);
+    gitChangesFree(&dirty);
+}
+
+// "64K", "256M", "2G" or a plain byte count; -1 if malformed
+static long long parseSize(const char *text) {
+    char *end;
+    long long size = strtoll(text, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+        case 'g': case 'G': size <<= 30; end++; break;
+    }
+    return (end == text || *end || size <= 0) ? -1 : size;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-j JOBS] [--cache DIR] [--format FMT] [--lang NAME] [--stats] [--split SIZE] [--symbols-db DB] [--changed-since REF|last] [--prefetch N] [--files-from LIST] PATH|DIR|GLOB ...\n", program);
+    fprintf(stderr, "       %s --stream [--window SIZE] [--format FMT] [--lang NAME] [PATH|FIFO ...]\n", program);
+    fprintf(stderr, "       %s decode [STREAM]\n", program);
+    fprintf(stderr, "       %s lookup DB NAME [KIND]\n", program);
+    fprintf(stderr, "       %s index INDEX [-j JOBS] [--lang NAME] [PATH|DIR|GLOB ...]\n", program);
+    fprintf(stderr, "       %s search INDEX [-i] [-j JOBS] TEXT\n", program);
+    fprintf(stderr, "       %s export FILE [-j JOBS] [--lang NAME] [PATH|DIR|GLOB ...]\n", program);
+    fprintf(stderr, "       %s serve SOCKET [-j JOBS] [--cache DIR] [--watch [--debounce MS]] [PATH|DIR|GLOB ...]\n", program);
+    fprintf(stderr, "       %s client SOCKET [--repeat N] [--clients N] REQUEST\n", program);
+    fprintf(stderr, "  -j, --jobs JOBS  analyze on JOBS threads (0 = one per CPU)\n");
+    fprintf(stderr, "  --cache DIR      reuse reports for unchanged files from DIR\n");
+    fprintf(stderr, "  --format FMT     text, binary or binary-lexemes\n");
+    fprintf(stderr, "  --stats          report per-phase timings and token statistics on stderr\n");
+    fprintf(stderr, "  --split SIZE     lex files of at least SIZE bytes (e.g. 256M) on every CPU\n");
+    fprintf(stderr, "  --stream         read stdin or each path once, in bounded memory\n");
+    fprintf(stderr, "  --window SIZE    bytes --stream holds at a time (default 1M)\n");
+    fprintf(stderr, "  --symbols-db DB  write every symbol found to the database DB\n");
+    fprintf(stderr, "  --changed-since REF|last\n");
+    fprintf(stderr, "                   analyze only files git says changed since REF or the\n");
+    fprintf(stderr, "                   last such run, and patch the symbol database\n");
+    fprintf(stderr, "  --prefetch N     keep N small files loading ahead of the analyzers (default %d, 0 = off)\n",
+            LOADER_DEFAULT_DEPTH);
+    fprintf(stderr, "  --watch          serve: follow the directories given and re-analyze what changes\n");
+    fprintf(stderr, "  --debounce MS    serve: wait for MS quiet milliseconds first (default %d)\n",
+            WATCH_DEFAULT_DEBOUNCE_MS);
+    fprintf(stderr, "  -i               search: ignore case\n");
+    fprintf(stderr, "  --repeat N       client: send the request N times and report latency\n");
+    fprintf(stderr, "  --clients N      client: on N connections at once\n");
+    fprintf(stderr, "Requests: ANALYZE PATH, BUFFER LANG|- [NAME] (text on stdin), SYMBOLS NAME [KIND], STATS, SUBSCRIBE\n");
+    fprintf(stderr, "Kinds:");
+    for (int i = 0; i < SYMBOL_KIND_COUNT; i++) fprintf(stderr, " %s", symbolKindName(i));
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Languages:");
+    for (int i = 0; i < LANGUAGES_COUNT; i++) fprintf(stderr, " %s", languages[i].key);
+    fprintf(stderr, "\n");
+}
+
+static void printMatch(const SymbolDbMatch *match, void *context) {
+    (void)context;
+    printf("%s\t%s\t%s\t%s\n", symbolKindName(match->kind), match->name, match->parent, match->path);
+}
+
+// cdlab lookup DB NAME [KIND]: prints "kind\tname\tparent\tpath" for each
+// definition, like the daemon's SYMBOLS request. Exits 1 if there is none.
+static int lookupMain(int argc, char *argv[]) {
+    if (argc < 4 || argc > 5) {
+        usage(argv[0]);
+        return 2;
+    }
+    int kind = -1;
+    if (argc == 5 && (kind = symbolKindFind(argv[4])) < 0) {
+        fprintf(stderr, "Unknown kind: %s\n", argv[4]);
+        return 2;
+    }
+    SymbolDb *db = symbolDbOpen(argv[2]);
+    if (!db) return 2;
+    int matches = symbolDbLookup(db, argv[3], kind, printMatch, NULL);
+    symbolDbClose(db);
+    return matches ? 0 : 1;
+}
+
+// cdlab search INDEX [-i] [-j JOBS] TEXT
+static int searchMain(int argc, char *argv[]) {
+    int ignoreCase = 0, jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *text = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0) {
+            ignoreCase = 1;
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            char *end;
+            jobs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || jobs < 0) {
+                fprintf(stderr, "Bad job count: %s\n", argv[i]);
+                return 2;
+            }
+            if (jobs == 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        } else if (!text) {
+            text = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc < 4 || !text || !*text) {
+        usage(argv[0]);
+        return 2;
+    }
+    return trigramSearch(argv[2], text, ignoreCase, jobs < 1 ? 1 : jobs);
+}
+
+// cdlab client SOCKET [--repeat N] [--clients N] REQUEST...
+static int clientMain(int argc, char *argv[]) {
+    int repeat = 1, clients = 1;
+    char request[MAX_PATH_LEN + 64] = "";
+    size_t used = 0;
+    if (argc < 4) {
+        usage(argv[0]);
+        return 2;
+    }
+    for (int i = 3; i < argc; i++) {
+        if ((strcmp(argv[i], "--repeat") == 0 || strcmp(argv[i], "--clients") == 0) && i + 1 < argc) {
+            int *target = argv[i][2] == 'r' ? &repeat : &clients;
+            char *end;
+            *target = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || *target < 1) {
+                fprintf(stderr, "Bad count: %s\n", argv[i]);
+                return 2;
+            }
+            continue;
+        }
+        // The remaining words are the request, joined by spaces
+        int written = snprintf(request + used, sizeof(request) - used, "%s%s", used ? " " : "", argv[i]);
+        if (written < 0 || (size_t)written >= sizeof(request) - used) {
+            fprintf(stderr, "Request too long\n");
+            return 2;
+        }
+        used += written;
+    }
+    return clientRequest(argv[2], request, repeat, clients);
+}
+
+int main(int argc, char *argv[]) {
+    FileList files = {0};
+    int jobs = 1;
+    const char *cacheDir = NULL;
+    int streaming = 0;
+    const char *changedSince = NULL;
+    int watching = 0, debounceMs = WATCH_DEFAULT_DEBOUNCE_MS;
+    char **pathArgs = calloc(argc, sizeof(char *));
+    int pathArgCount = 0;
+    if (!pathArgs) {
+        perror("calloc");
+        exit(1);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "decode") == 0) {
+        return decodeStream(argc > 2 ? argv[2] : "-", stdout);
+    }
+    if (argc > 1 && strcmp(argv[1], "client") == 0) return clientMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "lookup") == 0) return lookupMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "search") == 0) return searchMain(argc, argv);
+
+    // serve, index and export take the usual options; serve's paths warm
+    // its index
+    const char *socketPath = NULL, *indexPath = NULL, *exportPath = NULL;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "serve") == 0) {
+        socketPath = argv[2];
+        first = 3;
+    } else if (argc > 2 && strcmp(argv[1], "index") == 0) {
+        indexPath = argv[2];
+        first = 3;
+    } else if (argc > 2 && strcmp(argv[1], "export") == 0) {
+        exportPath = argv[2];
+        first = 3;
+    }
+
+    for (int i = first; i < argc; i++) {
+        if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            char *end;
+            jobs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || jobs < 0) {
+                fprintf(stderr, "Bad job count: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+            if (jobs == 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+            if (jobs < 1) jobs = 1;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            size_t f;
+            for (f = 0; f < FORMATS_COUNT && strcmp(argv[i + 1], formats[f].name) != 0; f++);
+            if (f == FORMATS_COUNT) {
+                fprintf(stderr, "Unknown format: %s\n", argv[i + 1]);
+                usage(argv[0]);
+                return 2;
+            }
+            outputFormat = formats[f].format;
+            i++;
+        } else if (strcmp(argv[i], "--lang") == 0 && i + 1 < argc) {
+            forcedAnalyzer = findLanguage(argv[++i]);
+            if (!forcedAnalyzer) {
+                fprintf(stderr, "Unknown language: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = 1;
+        } else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+            long long threshold = parseSize(argv[++i]);
+            if (threshold < 0) {
+                fprintf(stderr, "Bad size: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+            chunkLexThreshold = threshold;
+            chunkLexThreads = sysconf(_SC_NPROCESSORS_ONLN);
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streaming = 1;
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            long long size = parseSize(argv[++i]);
+            if (size < WINDOW_MINIMUM_SIZE) {
+                fprintf(stderr, "Bad window size: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+            windowSize = size;
+        } else if (strcmp(argv[i], "--symbols-db") == 0 && i + 1 < argc) {
+            symbolsDbPath = argv[++i];
+        } else if (strcmp(argv[i], "--changed-since") == 0 && i + 1 < argc) {
+            changedSince = argv[++i];
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            char *end;
+            loaderDepth = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || loaderDepth < 0) {
+                fprintf(stderr, "Bad prefetch depth: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watching = 1;
+        } else if (strcmp(argv[i], "--debounce") == 0 && i + 1 < argc) {
+            char *end;
+            debounceMs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || debounceMs < 0) {
+                fprintf(stderr, "Bad debounce: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--files-from") == 0 && i + 1 < argc) {
+            FILE *list = fopen(argv[++i], "r");
+            if (!list) {
+                perror(argv[i]);
+                return 1;
+            }
+            addPathsFrom(&files, list);
+            fclose(list);
+        } else if (strcmp(argv[i], "-") == 0) {
+            addPathsFrom(&files, stdin);
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 2;
+        } else {
+            pathArgs[pathArgCount++] = argv[i];
+        }
+    }
+
+    if ((symbolsDbPath || changedSince) && (streaming || socketPath || indexPath || exportPath)) {
+        fprintf(stderr, "%s needs a batch run over files\n", symbolsDbPath ? "--symbols-db" : "--changed-since");
+        return 2;
+    }
+    if (watching && !socketPath) {
+        fprintf(stderr, "--watch only applies to serve\n");
+        return 2;
+    }
+    if (changedSince && files.count) {
+        fprintf(stderr, "--changed-since takes paths, not path lists\n");
+        return 2;
+    }
+
+    // The state of the last --changed-since run lives with the results it
+    // patches
+    char statePath[MAX_PATH_LEN] = "";
+    if (changedSince && cacheDir) {
+        snprintf(statePath, sizeof(statePath), "%s/%s", cacheDir, GIT_STATE_FILE);
+    } else if (changedSince && symbolsDbPath) {
+        snprintf(statePath, sizeof(statePath), "%s.%s", symbolsDbPath, GIT_STATE_FILE);
+    } else if (changedSince && strcmp(changedSince, "last") == 0) {
+        fprintf(stderr, "--changed-since last needs --cache or --symbols-db to remember the run\n");
+        return 2;
+    }
+    GitChanges changes = {0};
+    int patching = 0;
+    if (changedSince) {
+        patching = selectChanged(changedSince, statePath, pathArgs, pathArgCount, &files, &changes);
+        if (patching < 0) return 2;
+    }
+    if (!patching) {
+        for (int i = 0; i < pathArgCount; i++) addPath(&files, pathArgs[i]);
+        if (changedSince && pathArgCount == 0) addPath(&files, ".");
+    }
+    if (streaming) return streamInputs(&files);
+    if (indexPath || exportPath) {
+        char **paths = malloc((files.count + 1) * sizeof(char *));
+        if (!paths) {
+            perror("malloc");
+            exit(1);
+        }
+        qsort(files.files, files.count, sizeof(FileEntry), compareSizes);
+        for (int i = 0; i < files.count; i++) paths[i] = files.files[i].path;
+        const char *forced = forcedAnalyzer ? languages[languageIndex(forcedAnalyzer)].key : NULL;
+        int status = indexPath ? trigramBuild(indexPath, paths, files.count, jobs, forced)
+                               : arrowExport(exportPath, paths, files.count, jobs, forced);
+        for (int i = 0; i < files.count; i++) free(files.files[i].path);
+        free(files.files);
+        free(paths);
+        free(pathArgs);
+        return status;
+    }
+    if (files.count == 0 && !socketPath && !patching) {
+        usage(argv[0]);
+        return 1;
+    }
+    // An unusable cache directory only costs speed, so carry on without it
+    if (cacheDir) cache = cacheOpen(cacheDir);
+
+    if (socketPath) {
+        char **paths = malloc((files.count + 1) * sizeof(char *));
+        if (!paths) {
+            perror("malloc");
+            exit(1);
+        }
+        qsort(files.files, files.count, sizeof(FileEntry), compareSizes);
+        for (int i = 0; i < files.count; i++) paths[i] = files.files[i].path;
+        // Of the paths given, the directories are the ones watched
+        int status = serveSocket(socketPath, cache, paths, files.count, jobs, pathArgs,
+                                 watching ? pathArgCount : 0, debounceMs);
+        if (cache) cacheClose(cache);
+        for (int i = 0; i < files.count; i++) free(files.files[i].path);
+        free(files.files);
+        free(paths);
+        return status;
+    }
+
+    ScanStats total = {0};
+    streamWriteHeader(stdout, outputFormat);
+    if (jobs > 1) {
+        analyzeParallel(&files, jobs, &total);
+    } else {
+        TokenStream stream;
+        streamOpen(&stream, stdout, outputFormat);
+        qsort(files.files, files.count, sizeof(FileEntry), comparePaths);
+        Loader *loader = startLoader(&files);
+        for (int i = 0; i < files.count; i++) analyzeLoaded(loader, i, &files.files[i], &stream, &total);
+        stopLoader(loader, files.count);
+        streamClose(&stream);
+    }
+
+    if (cache) {
+        cacheClose(cache);
+        fprintf(stderr, "Analyzed %d of %d files (%d from cache)\n",
+                total.analyzed, files.count, total.cached);
+    } else {
+        fprintf(stderr, "Analyzed %d of %d files\n", total.analyzed, files.count);
+    }
+    if (jobs > 1) {
+        for (int i = 0; i < LANGUAGES_COUNT; i++) {
+            if (total.files[i] == 0) continue;
+            fprintf(stderr, "  %-12s %8d files %12lld bytes\n",
+                    languages[i].key, total.files[i], total.bytes[i]);
+        }
+    }
+    if (statsEnabled) statsPrintTotals(stderr, &total.statsTotals);
+    int failed = total.analyzed != files.count;
+    if (symbolsDbPath && writeSymbolsDb(&files, patching ? &changes : NULL) != 0) failed = 1;
+    // A failed run is not recorded, so that the next one tries those files again
+    if (changedSince && statePath[0] && !failed) recordRun(statePath, pathArgs, pathArgCount);
+    gitChangesFree(&changes);
+    for (int i = 0; i < files.count; i++) free(files.files[i].path);
+    free(files.files);
+    free(pathArgs);
+    return failed ? 1 : 0;
+}
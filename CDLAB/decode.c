@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/tokenstream.h"
+#include "decode.h"
+
+typedef struct {
+    const unsigned char *cur;
+    const unsigned char *end;
+    int bad;                    // set once anything runs past the end
+} Reader;
+
+// What is known about the file whose records are being decoded
+typedef struct {
+    char *path;
+    int flags;
+    Input source;               // only opened for streams without lexemes
+    int haveSource;
+    TokenFormat format;
+    char **names;
+    char **placeholders;
+    size_t offset;              // offset of the previous token
+} DecodedFile;
+
+static int readByte(Reader *r) {
+    if (r->cur >= r->end) {
+        r->bad = 1;
+        return -1;
+    }
+    return *r->cur++;
+}
+
+static uint64_t readVarint(Reader *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = readByte(r);
+        if (byte < 0) return 0;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    r->bad = 1;
+    return 0;
+}
+
+static const char *readBytes(Reader *r, size_t *length) {
+    *length = readVarint(r);
+    if (r->bad || *length > (size_t)(r->end - r->cur)) {
+        r->bad = 1;
+        return NULL;
+    }
+    const char *bytes = (const char *)r->cur;
+    r->cur += *length;
+    return bytes;
+}
+
+static char *readString(Reader *r) {
+    size_t length;
+    const char *bytes = readBytes(r, &length);
+    if (!bytes) return NULL;
+    char *text = strndup(bytes, length);
+    if (!text) {
+        perror("strndup");
+        exit(1);
+    }
+    return text;
+}
+
+static void freeFormat(DecodedFile *file) {
+    for (int i = 0; i < file->format.typeCount; i++) {
+        free(file->names[i]);
+        free(file->placeholders[i]);
+    }
+    free(file->names);
+    free(file->placeholders);
+    file->names = file->placeholders = NULL;
+    memset(&file->format, 0, sizeof(file->format));
+}
+
+static void endFile(DecodedFile *file) {
+    if (file->haveSource) inputClose(&file->source);
+    freeFormat(file);
+    free(file->path);
+    memset(file, 0, sizeof(*file));
+}
+
+static int decodeFormat(Reader *r, DecodedFile *file) {
+    freeFormat(file);
+    uint64_t count = readVarint(r);
+    if (r->bad || count > (uint64_t)(r->end - r->cur)) return 0;
+
+    file->names = calloc(count ? count : 1, sizeof(char *));
+    file->placeholders = calloc(count ? count : 1, sizeof(char *));
+    if (!file->names || !file->placeholders) {
+        perror("calloc");
+        exit(1);
+    }
+    file->format.typeCount = count;
+    for (uint64_t i = 0; i < count && !r->bad; i++) {
+        file->names[i] = readString(r);
+        file->placeholders[i] = readString(r);
+        // Empty strings mean "no name" and "show the lexeme"
+        if (file->names[i] && !file->names[i][0]) {
+            free(file->names[i]);
+            file->names[i] = NULL;
+        }
+        if (file->placeholders[i] && !file->placeholders[i][0]) {
+            free(file->placeholders[i]);
+            file->placeholders[i] = NULL;
+        }
+    }
+    file->format.typeNames = (const char *const *)file->names;
+    file->format.placeholders = (const char *const *)file->placeholders;
+    file->format.lexemeWidth = readVarint(r);
+    return !r->bad;
+}
+
+static int decodeToken(Reader *r, DecodedFile *file, TokenStream *text) {
+    Token token;
+    token.type = readVarint(r);
+    uint64_t zigzag = readVarint(r);
+    int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+    token.length = readVarint(r);
+    if (r->bad || !file->format.typeNames) return 0;
+
+    file->offset += delta;
+    token.offset = file->offset;
+
+    Input view;
+    if (file->flags & STREAM_FLAG_LEXEMES) {
+        if (token.length > (size_t)(r->end - r->cur)) return 0;
+        view.data = view.cur = (const char *)r->cur;
+        view.size = token.length;
+        view.end = view.data + view.size;
+        r->cur += token.length;
+        token.offset = 0;
+    } else if (file->haveSource && token.offset <= file->source.size &&
+               token.length <= file->source.size - token.offset) {
+        view = file->source;
+    } else {
+        // Source missing or changed since the stream was written
+        view.data = view.cur = view.end = "";
+        view.size = 0;
+        token.offset = 0;
+        token.length = 0;
+    }
+    streamToken(text, &view, &token);
+    return 1;
+}
+
+int decodeStream(const char *filename, FILE *out) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
+        perror(filename);
+        return 1;
+    }
+
+    Reader r = { (const unsigned char *)in.data, (const unsigned char *)in.end, 0 };
+    if (in.size < 5 || memcmp(in.data, STREAM_MAGIC, 4) != 0 || in.data[4] != STREAM_VERSION) {
+        fprintf(stderr, "%s: not a cdlab token stream (version %d)\n", filename, STREAM_VERSION);
+        inputClose(&in);
+        return 1;
+    }
+    r.cur += 5;
+
+    TokenStream text;
+    streamOpen(&text, out, STREAM_TEXT);
+    DecodedFile file;
+    memset(&file, 0, sizeof(file));
+
+    int ok = 1;
+    while (ok && r.cur < r.end) {
+        switch (readByte(&r)) {
+            case 'F': {
+                endFile(&file);
+                file.path = readString(&r);
+                char *language = readString(&r);
+                file.flags = readByte(&r);
+                if (r.bad) {
+                    free(language);
+                    ok = 0;
+                    break;
+                }
+                if (!(file.flags & STREAM_FLAG_LEXEMES)) {
+                    file.haveSource = inputOpen(&file.source, file.path) == 0;
+                    if (!file.haveSource) perror(file.path);
+                }
+                streamBeginFile(&text, file.path, language);
+                free(language);
+                break;
+            }
+            case 'N':
+                ok = decodeFormat(&r, &file);
+                if (ok) {
+                    file.offset = 0;
+                    streamBeginTokens(&text, &file.format);
+                }
+                break;
+            case 'T':
+                ok = decodeToken(&r, &file, &text);
+                break;
+            case 'S': {
+                size_t length;
+                const char *symbols = readBytes(&r, &length);
+                ok = symbols != NULL;
+                if (ok) streamSymbols(&text, symbols, length);
+                break;
+            }
+            case 'E':
+                endFile(&file);
+                break;
+            default:
+                ok = 0;
+                break;
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr, "%s: malformed token stream at byte %ld\n",
+                filename, (long)((const char *)r.cur - in.data));
+    }
+    endFile(&file);
+    streamClose(&text);
+    inputClose(&in);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef CDLAB_DECODE_H
+#define CDLAB_DECODE_H
+
+#include <stdio.h>
+
+// Renders a binary token stream (see COMMON/tokenstream.h) as the text
+// tables cdlab prints by default. Streams written without lexemes read them
+// back from the source files named in the stream. "-" reads stdin.
+// Returns 0 on success, 1 if the stream is unreadable or malformed.
+int decodeStream(const char *filename, FILE *out);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../COMMON/alloc.h"
+#include "gitchanges.h"
+
+#define GIT_MAX_ARGS 16
+#define GIT_FIRST_SLOTS 64
+
+// Runs git with `args` followed by "--" and the pathspecs, collecting its
+// stdout. Returns 0, or -1 if git could not run or failed; git has already
+// said why on stderr.
+static int runGit(const char *const *args, char *const *pathspecs, int pathspecCount,
+                  char **output, size_t *length) {
+    int argc = 0;
+    const char **argv = checkedAlloc(malloc((GIT_MAX_ARGS + pathspecCount + 2) * sizeof(char *)));
+    for (; args[argc]; argc++) argv[argc] = args[argc];
+    if (pathspecCount) {
+        argv[argc++] = "--";
+        for (int i = 0; i < pathspecCount; i++) argv[argc++] = pathspecs[i];
+    }
+    argv[argc] = NULL;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        free(argv);
+        return -1;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        free(argv);
+        return -1;
+    }
+    if (child == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execvp("git", (char *const *)argv);
+        perror("git");
+        _exit(127);
+    }
+    close(fds[1]);
+    free(argv);
+
+    size_t used = 0, capacity = 4096;
+    char *buffer = checkedAlloc(malloc(capacity + 1));
+    for (;;) {
+        if (used == capacity) {
+            capacity *= 2;
+            buffer = checkedAlloc(realloc(buffer, capacity + 1));
+        }
+        ssize_t n = read(fds[0], buffer + used, capacity - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        used += n;
+    }
+    close(fds[0]);
+    buffer[used] = '\0';
+
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free(buffer);
+        return -1;
+    }
+    *output = buffer;
+    *length = used;
+    return 0;
+}
+
+// FNV-1a
+static size_t hashPath(const char *path) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 1099511628211ULL;
+    return hash;
+}
+
+// The slot holding `path`, or the free slot where it belongs
+static char **listedSlot(const GitChanges *changes, const char *path) {
+    size_t mask = changes->listedSlots - 1;
+    for (size_t i = hashPath(path) & mask;; i = (i + 1) & mask) {
+        char **slot = &changes->listed[i];
+        if (!*slot || strcmp(*slot, path) == 0) return slot;
+    }
+}
+
+static void growListed(GitChanges *changes) {
+    char **old = changes->listed;
+    size_t oldSlots = changes->listedSlots;
+    changes->listedSlots = oldSlots ? oldSlots * 2 : GIT_FIRST_SLOTS;
+    changes->listed = checkedAlloc(calloc(changes->listedSlots, sizeof(char *)));
+    for (size_t i = 0; i < oldSlots; i++) {
+        if (old[i]) *listedSlot(changes, old[i]) = old[i];
+    }
+    free(old);
+}
+
+// Adds `path` to the deleted list or the changed list, unless either has it
+static void appendPath(GitChanges *changes, int deleted, const char *path) {
+    size_t listedCount = changes->changedCount + changes->deletedCount;
+    if ((listedCount + 1) * 2 > changes->listedSlots) growListed(changes);
+    char **slot = listedSlot(changes, path);
+    if (*slot) return;
+
+    char ***list = deleted ? &changes->deleted : &changes->changed;
+    int *count = deleted ? &changes->deletedCount : &changes->changedCount;
+    // Lists grow by doubling; a count that is a power of two is full
+    if ((*count & (*count - 1)) == 0) {
+        *list = checkedAlloc(realloc(*list, (*count ? *count * 2 : 1) * sizeof(char *)));
+    }
+    *slot = (*list)[(*count)++] = checkedAlloc(strdup(path));
+}
+
+void gitChangesAdd(GitChanges *changes, const char *path) {
+    if (changes->listedSlots && *listedSlot(changes, path)) return;
+    struct stat st;
+    appendPath(changes, lstat(path, &st) != 0, path);
+}
+
+int gitChanges(const char *base, char *const *pathspecs, int pathspecCount, GitChanges *changes) {
+    memset(changes, 0, sizeof(*changes));
+
+    // --no-renames reports a rename as a deletion and an addition, which is
+    // what the stored results need. --end-of-options keeps a ref that
+    // starts with '-' from being read as an option.
+    const char *diff[] = {"git", "diff", "--name-status", "-z", "--no-renames", "--relative",
+                          "--end-of-options", base, NULL};
+    char *output;
+    size_t length;
+    if (runGit(diff, pathspecs, pathspecCount, &output, &length) != 0) {
+        fprintf(stderr, "git diff against %s failed\n", base);
+        return -1;
+    }
+    for (char *cur = output; cur < output + length;) {
+        char status = cur[0];
+        cur += strlen(cur) + 1;
+        if (cur >= output + length) break;
+        appendPath(changes, status == 'D', cur);
+        cur += strlen(cur) + 1;
+    }
+    free(output);
+
+    const char *untracked[] = {"git", "ls-files", "--others", "--exclude-standard", "-z", NULL};
+    if (runGit(untracked, pathspecs, pathspecCount, &output, &length) != 0) {
+        fprintf(stderr, "git ls-files failed\n");
+        gitChangesFree(changes);
+        return -1;
+    }
+    for (char *cur = output; cur < output + length; cur += strlen(cur) + 1) {
+        appendPath(changes, 0, cur);
+    }
+    free(output);
+    return 0;
+}
+
+void gitChangesFree(GitChanges *changes) {
+    for (int i = 0; i < changes->changedCount; i++) free(changes->changed[i]);
+    for (int i = 0; i < changes->deletedCount; i++) free(changes->deleted[i]);
+    free(changes->changed);
+    free(changes->deleted);
+    free(changes->listed);
+    memset(changes, 0, sizeof(*changes));
+}
+
+int gitHead(char *hash, size_t size) {
+    const char *args[] = {"git", "rev-parse", "--verify", "HEAD", NULL};
+    char *output;
+    size_t length;
+    if (runGit(args, NULL, 0, &output, &length) != 0) {
+        fprintf(stderr, "Cannot find the HEAD commit\n");
+        return -1;
+    }
+    output[strcspn(output, "\n")] = '\0';
+    snprintf(hash, size, "%s", output);
+    free(output);
+    return 0;
+}
+
+int gitReadState(const char *path, char *hash, size_t size, GitChanges *changes) {
+    FILE *in = fopen(path, "r");
+    if (!in) return -1;
+    char line[4096];
+    if (!fgets(line, sizeof(line), in) || line[0] == '\n') {
+        fclose(in);
+        return -1;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(hash, size, "%s", line);
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0]) gitChangesAdd(changes, line);
+    }
+    fclose(in);
+    return 0;
+}
+
+int gitWriteState(const char *path, const char *hash, const GitChanges *changes) {
+    char temporary[4096];
+    if (snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path) >= (int)sizeof(temporary)) {
+        fprintf(stderr, "%s: path too long\n", path);
+        return -1;
+    }
+    int fd = mkstemp(temporary);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        perror(temporary);
+        if (fd >= 0) {
+            close(fd);
+            unlink(temporary);
+        }
+        return -1;
+    }
+    fprintf(out, "%s\n", hash);
+    for (int i = 0; i < changes->changedCount; i++) fprintf(out, "%s\n", changes->changed[i]);
+    for (int i = 0; i < changes->deletedCount; i++) fprintf(out, "%s\n", changes->deleted[i]);
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        perror(path);
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
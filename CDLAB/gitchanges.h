@@ -0,0 +1,47 @@
+#ifndef CDLAB_GITCHANGES_H
+#define CDLAB_GITCHANGES_H
+
+#include <stddef.h>
+
+#define GIT_HASH_LEN 64
+
+// Which files differ from a commit, as local git sees them, so that a run
+// can analyze only those. Paths are relative to the current directory,
+// like the ones a full run was given. Changed files are those that are
+// modified, added or untracked (but not ignored) in the working tree;
+// deleted files are those git has in the commit but the tree lacks.
+typedef struct {
+    char **changed;
+    int changedCount;
+    char **deleted;
+    int deletedCount;
+    char **listed;              // both lists' paths by hash, so adding skips repeats at once
+    size_t listedSlots;
+} GitChanges;
+
+// Fills `changes` with the differences between `base` and the working
+// tree, limited to `pathspecs` unless pathspecCount is 0. Returns 0, or -1
+// after printing why (not a repository, unknown ref, no git).
+int gitChanges(const char *base, char *const *pathspecs, int pathspecCount, GitChanges *changes);
+
+// Adds a path to the changed list, or to the deleted list if it no longer
+// exists, unless it is already listed
+void gitChangesAdd(GitChanges *changes, const char *path);
+
+void gitChangesFree(GitChanges *changes);
+
+// The commit HEAD points at, into `hash`. Returns 0, or -1 after printing why.
+int gitHead(char *hash, size_t size);
+
+// The state file a --changed-since run leaves behind: the commit it ran
+// at, then the paths that differed from that commit at the time, one per
+// line. "--changed-since last" diffs against that commit and treats those
+// paths as changed too, since they may have been reverted since.
+//
+// gitReadState returns 0 with the commit in `hash` and the paths added to
+// `changes`, or -1 if there is no state yet. gitWriteState replaces the
+// file by rename and returns 0, or -1 after printing why.
+int gitReadState(const char *path, char *hash, size_t size, GitChanges *changes);
+int gitWriteState(const char *path, const char *hash, const GitChanges *changes);
+
+#endif
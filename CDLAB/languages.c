@@ -0,0 +1,84 @@
+#include <string.h>
+#include <strings.h>
+
+#include "../COMMON/gzip.h"
+#include "languages.h"
+
+// Extension table, taken from extensions.txt. Where two languages share an
+// extension (.sql for SQL and PL/SQL, .js for JavaScript and jQuery) the
+// general analyzer is listed; pass --lang to pick the other one.
+typedef struct {
+    const char *extension;
+    const Analyzer *analyzer;
+} ExtensionRoute;
+
+static const ExtensionRoute routes[] = {
+    {".php", &phpAnalyzer},
+    {".js", &jsAnalyzer},
+    {".html", &htmlAnalyzer}, {".htm", &htmlAnalyzer},
+    {".java", &javaAnalyzer},
+    {".sql", &sqlAnalyzer},
+    {".pls", &plsqlAnalyzer}, {".plb", &plsqlAnalyzer},
+    {".ps1", &powershellAnalyzer}, {".psm1", &powershellAnalyzer},
+    {".psd1", &powershellAnalyzer},
+    {".asm", &assemblyAnalyzer}, {".s", &assemblyAnalyzer},
+    {".v", &verilogAnalyzer}, {".vh", &verilogAnalyzer},
+    {".m", &matlabAnalyzer},
+    {".sh", &shellAnalyzer}, {".bash", &shellAnalyzer},
+    {".ksh", &shellAnalyzer}, {".zsh", &shellAnalyzer},
+    {".csh", &cshellAnalyzer}, {".tcsh", &cshellAnalyzer},
+    {".py", &pythonAnalyzer}, {".pyw", &pythonAnalyzer},
+    {".pyx", &pythonAnalyzer},
+    {".c", &cppAnalyzer}, {".cpp", &cppAnalyzer},
+    {".h", &cppAnalyzer}, {".hpp", &cppAnalyzer},
+    {".pl", &perlAnalyzer}, {".pm", &perlAnalyzer}, {".t", &perlAnalyzer},
+    {".css", &cssAnalyzer}
+};
+#define ROUTES_COUNT (sizeof(routes) / sizeof(routes[0]))
+
+const LanguageName languages[LANGUAGES_COUNT] = {
+    {"sql", &sqlAnalyzer}, {"plsql", &plsqlAnalyzer},
+    {"verilog", &verilogAnalyzer}, {"asm", &assemblyAnalyzer},
+    {"csh", &cshellAnalyzer}, {"jquery", &jqueryAnalyzer},
+    {"matlab", &matlabAnalyzer}, {"powershell", &powershellAnalyzer},
+    {"shell", &shellAnalyzer}, {"php", &phpAnalyzer}, {"js", &jsAnalyzer},
+    {"html", &htmlAnalyzer}, {"java", &javaAnalyzer},
+    {"python", &pythonAnalyzer}, {"cpp", &cppAnalyzer},
+    {"perl", &perlAnalyzer}, {"css", &cssAnalyzer}
+};
+
+const Analyzer *findLanguage(const char *key) {
+    for (int i = 0; i < LANGUAGES_COUNT; i++) {
+        if (strcasecmp(key, languages[i].key) == 0) return languages[i].analyzer;
+    }
+    return NULL;
+}
+
+const Analyzer *routeByExtension(const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    // dump.sql.gz routes as dump.sql; inputOpen inflates it
+    size_t length = strlen(base);
+    if (gzipPath(base)) length -= strlen(GZIP_SUFFIX);
+    const char *dot = NULL;
+    for (size_t i = 0; i < length; i++) {
+        if (base[i] == '.') dot = base + i;
+    }
+    if (!dot) return NULL;
+    size_t extensionLength = base + length - dot;
+    for (size_t i = 0; i < ROUTES_COUNT; i++) {
+        // case-insensitive so that .S, .PY and friends route as well
+        if (strlen(routes[i].extension) == extensionLength &&
+            strncasecmp(dot, routes[i].extension, extensionLength) == 0) {
+            return routes[i].analyzer;
+        }
+    }
+    return NULL;
+}
+
+int languageIndex(const Analyzer *analyzer) {
+    for (int i = 0; i < LANGUAGES_COUNT; i++) {
+        if (languages[i].analyzer == analyzer) return i;
+    }
+    return 0;
+}
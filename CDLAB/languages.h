@@ -0,0 +1,25 @@
+#ifndef CDLAB_LANGUAGES_H
+#define CDLAB_LANGUAGES_H
+
+#include "../COMMON/analyzer.h"
+
+// Names accepted by --lang
+typedef struct {
+    const char *key;
+    const Analyzer *analyzer;
+} LanguageName;
+
+#define LANGUAGES_COUNT 17
+
+extern const LanguageName languages[LANGUAGES_COUNT];
+
+// The analyzer for a --lang name, or NULL
+const Analyzer *findLanguage(const char *key);
+
+// The analyzer for a path's extension, or NULL
+const Analyzer *routeByExtension(const char *path);
+
+// Position of the analyzer in languages[]
+int languageIndex(const Analyzer *analyzer);
+
+#endif
@@ -0,0 +1,165 @@
+#define _GNU_SOURCE             // open_memstream
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "../COMMON/alloc.h"
+#include "../COMMON/analyzer.h"
+#include "languages.h"
+#include "libcdlab.h"
+
+#define BUFFER_NAME "<buffer>"  // what an unnamed buffer is lent to the analyzer as
+
+struct Cdlab {
+    const Analyzer *forced;     // NULL to route by extension
+    const Analyzer *analyzer;   // of the last analysis
+    Input input;                // the last file analyzed, kept open for the tokens' text
+    int inputOpen;
+    char *copy;                 // or the last buffer analyzed
+    CdlabToken *tokens;
+    size_t tokenCount;
+    size_t tokenCapacity;
+    CdlabSymbol *symbols;
+    size_t symbolCount;
+    size_t symbolCapacity;
+    char *symbolTable;
+    NamePool *names;            // the symbols' names, emptied for each analysis
+};
+
+Cdlab *cdlabOpen(const char *language) {
+    const Analyzer *forced = NULL;
+    if (language && !(forced = findLanguage(language))) return NULL;
+    Cdlab *cdlab = checkedAlloc(calloc(1, sizeof(Cdlab)));
+    cdlab->forced = forced;
+    cdlab->names = namePoolCreate();
+    return cdlab;
+}
+
+// Drops the last analysis's results, keeping the arrays for the next one
+static void clearResults(Cdlab *cdlab) {
+    if (cdlab->inputOpen) inputClose(&cdlab->input);
+    cdlab->inputOpen = 0;
+    free(cdlab->copy);
+    cdlab->copy = NULL;
+    free(cdlab->symbolTable);
+    cdlab->symbolTable = NULL;
+    cdlab->tokenCount = 0;
+    cdlab->symbolCount = 0;
+    cdlab->analyzer = NULL;
+    namePoolClear(cdlab->names);
+}
+
+void cdlabClose(Cdlab *cdlab) {
+    if (!cdlab) return;
+    clearResults(cdlab);
+    free(cdlab->tokens);
+    free(cdlab->symbols);
+    namePoolFree(cdlab->names);
+    free(cdlab);
+}
+
+static void collectToken(const Input *in, const Token *token, const TokenFormat *format, void *context) {
+    Cdlab *cdlab = context;
+    if (cdlab->tokenCount == cdlab->tokenCapacity) {
+        cdlab->tokenCapacity = cdlab->tokenCapacity ? cdlab->tokenCapacity * 2 : 1024;
+        cdlab->tokens = checkedAlloc(realloc(cdlab->tokens, cdlab->tokenCapacity * sizeof(CdlabToken)));
+    }
+    int known = format && token->type >= 0 && token->type < format->typeCount;
+    CdlabToken *entry = &cdlab->tokens[cdlab->tokenCount++];
+    entry->offset = token->offset;
+    entry->length = token->length;
+    entry->text = tokenText(in, token);
+    entry->type = known && format->typeNames[token->type] ? format->typeNames[token->type] : "UNKNOWN";
+}
+
+static void collectSymbol(const Symbol *symbol, void *context) {
+    Cdlab *cdlab = context;
+    if (cdlab->symbolCount == cdlab->symbolCapacity) {
+        cdlab->symbolCapacity = cdlab->symbolCapacity ? cdlab->symbolCapacity * 2 : 64;
+        cdlab->symbols = checkedAlloc(realloc(cdlab->symbols, cdlab->symbolCapacity * sizeof(CdlabSymbol)));
+    }
+    CdlabSymbol *entry = &cdlab->symbols[cdlab->symbolCount++];
+    entry->kind = symbolKindName(symbol->kind);
+    entry->name = nameText(symbol->name);
+    entry->parent = nameText(symbol->parent);
+}
+
+// Runs the analyzer over text the context already holds, lent to it under
+// `name`, and copies out everything its thread-local tables gathered
+// before clearing them for the next context to use on this thread. The
+// names go into the context's own pool, not the process's.
+static void analyze(Cdlab *cdlab, const Analyzer *analyzer, const char *name, const char *data, size_t size) {
+    cdlab->analyzer = analyzer;
+    NamePool *previous = namePoolCurrent;
+    namePoolCurrent = cdlab->names;
+    inputLend(name, data, size);
+    TokenStream stream;
+    streamOpen(&stream, NULL, STREAM_TEXT);
+    stream.visit = collectToken;
+    stream.visitContext = cdlab;
+    analyzer->analyzeFile(name, &stream);
+    streamClose(&stream);
+    inputLendEnd();
+
+    if (analyzer->listSymbols) analyzer->listSymbols(collectSymbol, cdlab);
+    if (analyzer->displaySymbolTable) {
+        size_t length;
+        FILE *out = checkedAlloc(open_memstream(&cdlab->symbolTable, &length));
+        analyzer->displaySymbolTable(out);
+        fclose(out);
+    }
+    if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+    namePoolCurrent = previous;
+}
+
+int cdlabAnalyzeFile(Cdlab *cdlab, const char *path) {
+    clearResults(cdlab);
+    const Analyzer *analyzer = cdlab->forced ? cdlab->forced : routeByExtension(path);
+    if (!analyzer) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Read rather than mapped: the tokens point into it for as long as the
+    // host likes, and a mapping would fault if the file were truncated
+    if (inputRead(&cdlab->input, path) != 0) return -1;
+    cdlab->inputOpen = 1;
+    analyze(cdlab, analyzer, path, cdlab->input.data, cdlab->input.size);
+    return 0;
+}
+
+int cdlabAnalyzeBuffer(Cdlab *cdlab, const char *data, size_t size, const char *name) {
+    clearResults(cdlab);
+    const Analyzer *analyzer = cdlab->forced ? cdlab->forced : name ? routeByExtension(name) : NULL;
+    if (!analyzer) {
+        errno = EINVAL;
+        return -1;
+    }
+    cdlab->copy = checkedAlloc(malloc(size + 1));
+    memcpy(cdlab->copy, data, size);
+    cdlab->copy[size] = '\0';
+    analyze(cdlab, analyzer, name ? name : BUFFER_NAME, cdlab->copy, size);
+    return 0;
+}
+
+const CdlabToken *cdlabTokens(const Cdlab *cdlab, size_t *count) {
+    *count = cdlab->tokenCount;
+    return cdlab->tokens;
+}
+
+const CdlabSymbol *cdlabSymbols(const Cdlab *cdlab, size_t *count) {
+    *count = cdlab->symbolCount;
+    return cdlab->symbols;
+}
+
+const char *cdlabSymbolTable(const Cdlab *cdlab) {
+    return cdlab->symbolTable ? cdlab->symbolTable : "";
+}
+
+const char *cdlabLanguage(const Cdlab *cdlab) {
+    return cdlab->analyzer ? cdlab->analyzer->name : NULL;
+}
+
+const char *cdlabLanguageKey(int i) {
+    return i >= 0 && i < LANGUAGES_COUNT ? languages[i].key : NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef LIBCDLAB_H
+#define LIBCDLAB_H
+
+#include <stddef.h>
+
+// libcdlab: every analyzer in this repository behind one interface for
+// programs that link the lexers in instead of running cdlab.
+//
+// A Cdlab context holds the results of one analysis: the tokens, the
+// symbols and the symbol table as cdlab prints it. Each context owns all
+// of its state, so a program can keep any number of them and analyze on
+// as many threads as it likes, each context used by one thread at a time.
+// The analyzers' own tables only live for the length of an analyze call,
+// on the calling thread, and are cleared before it returns.
+//
+// Strings returned here stay valid until the context's next analyze call
+// or cdlabClose, except type and kind names, which are constants. Symbol
+// names are kept in a name pool that belongs to the context, so a program
+// that runs for a long time holds only the names of the analyses it still
+// has. Allocation failures print an error and exit, as everywhere else in
+// cdlab.
+//
+// The README shows how to build it as a shared library. Built with
+// -fvisibility=hidden, only the functions below are exported, so the
+// analyzers' own names cannot clash with the program's.
+typedef struct Cdlab Cdlab;
+
+#define CDLAB_API __attribute__((visibility("default")))
+
+typedef struct {
+    size_t offset;              // first byte of the lexeme in the text
+    size_t length;
+    const char *text;           // the lexeme as in the text, even where cdlab
+                                // prints a placeholder; not NUL-terminated
+    const char *type;           // "KEYWORD", "IDENTIFIER"... as cdlab prints it
+} CdlabToken;
+
+typedef struct {
+    const char *kind;           // "function", "table"... as "cdlab lookup" takes it
+    const char *name;
+    const char *parent;         // "" for top-level symbols
+} CdlabSymbol;
+
+// A context for the language with this --lang name ("sql", "php"...), or
+// for whichever language each path's extension names if `language` is
+// NULL. Returns NULL if there is no such language.
+CDLAB_API Cdlab *cdlabOpen(const char *language);
+CDLAB_API void cdlabClose(Cdlab *cdlab);
+
+// Analyzes a file, replacing the context's previous results. A file named
+// *.gz is inflated first. Returns 0, or -1 with errno set: EINVAL if no
+// analyzer takes the file, or why it could not be read.
+CDLAB_API int cdlabAnalyzeFile(Cdlab *cdlab, const char *path);
+
+// Analyzes `size` bytes of text, which are copied. Without a language,
+// `name` is routed by its extension as a path would be; it may be NULL
+// otherwise. Returns 0, or -1 with errno EINVAL if no analyzer takes it.
+CDLAB_API int cdlabAnalyzeBuffer(Cdlab *cdlab, const char *data, size_t size, const char *name);
+
+// The results of the last analysis, in the order the analyzer found them
+CDLAB_API const CdlabToken *cdlabTokens(const Cdlab *cdlab, size_t *count);
+CDLAB_API const CdlabSymbol *cdlabSymbols(const Cdlab *cdlab, size_t *count);
+CDLAB_API const char *cdlabSymbolTable(const Cdlab *cdlab);   // "" if the language keeps none
+CDLAB_API const char *cdlabLanguage(const Cdlab *cdlab);      // "SQL", "PHP"...; NULL before any analysis
+
+// The --lang names, for i from 0 until it returns NULL
+CDLAB_API const char *cdlabLanguageKey(int i);
+
+#endif
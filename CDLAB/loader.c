@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "../COMMON/alloc.h"
+#include "loader.h"
+
+typedef enum {
+    ITEM_QUEUED,
+    ITEM_SKIPPED,       // claimed by a reader before the loader got to it
+    ITEM_LOADING,
+    ITEM_LOADED,
+    ITEM_FAILED,
+    ITEM_TAKEN
+} ItemState;
+
+typedef struct {
+    ItemState state;
+    int fd;
+    char *data;
+    size_t capacity;    // the expected size plus one, to notice growth
+    size_t size;
+} Item;
+
+// The kernel's submission and completion rings, mapped into our memory
+typedef struct {
+    int fd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    unsigned pending;   // queued since the last submit
+} Ring;
+
+struct Loader {
+    char **paths;
+    Item *items;
+    int count;
+    int depth;
+
+    pthread_mutex_t lock;       // guards item states and everything below
+    pthread_cond_t changed;     // an item was loaded or taken, or stopping
+    int next;                   // first item the loader has not considered
+    int outstanding;            // loading, or loaded and not taken
+    int taken;
+    int stopping;
+
+    Ring ring;
+    int useRing;
+    pthread_t threads[LOADER_THREADS];
+    int threadCount;
+};
+
+static void ringClose(Ring *ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing) munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// io_uring is driven through the raw system calls, without liburing.
+// Returns 0 once the ring is set up and the kernel can open and read
+// through it, -1 otherwise
+static int ringOpen(Ring *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return -1;
+
+    // IORING_OP_OPENAT and IORING_OP_READ arrived in Linux 5.6
+    size_t probeSize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = checkedAlloc(calloc(1, probeSize));
+    int probed = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                 probe->last_op >= IORING_OP_READ &&
+                 (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+                 (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    if (!probed) {
+        ringClose(ring);
+        return -1;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cqRingSize > ring->sqRingSize) ring->sqRingSize = ring->cqRingSize;
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        ring->sqRing = NULL;
+        ringClose(ring);
+        return -1;
+    }
+    ring->cqRing = single ? ring->sqRing
+                          : mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 ring->fd, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->cqRing == MAP_FAILED) ring->cqRing = NULL;
+        if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+        ringClose(ring);
+        return -1;
+    }
+
+    char *sq = ring->sqRing, *cq = ring->cqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Queues one request. The ring has room for `depth` entries and each item
+// has at most one request in flight, so it never fills up.
+static struct io_uring_sqe *ringQueue(Ring *ring, int opcode, int fd, int index) {
+    unsigned tail = *ring->sqTail, slot = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = index;
+    ring->sqArray[slot] = slot;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+    return sqe;
+}
+
+static void queueOpen(Loader *loader, int index) {
+    struct io_uring_sqe *sqe = ringQueue(&loader->ring, IORING_OP_OPENAT, AT_FDCWD, index);
+    sqe->addr = (unsigned long)loader->paths[index];
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+static void queueRead(Loader *loader, int index) {
+    Item *item = &loader->items[index];
+    struct io_uring_sqe *sqe = ringQueue(&loader->ring, IORING_OP_READ, item->fd, index);
+    sqe->addr = (unsigned long)(item->data + item->size);
+    sqe->len = item->capacity - item->size;
+    sqe->off = item->size;
+}
+
+// Picks the next file to load, or returns -1 if there is none or no room
+// for one. Called with the lock held.
+static int nextItem(Loader *loader) {
+    while (!loader->stopping && loader->outstanding < loader->depth && loader->next < loader->count) {
+        int index = loader->next++;
+        Item *item = &loader->items[index];
+        if (item->state != ITEM_QUEUED) continue;
+        item->state = ITEM_LOADING;
+        loader->outstanding++;
+        return index;
+    }
+    return -1;
+}
+
+static void finishItem(Loader *loader, int index, int loaded) {
+    Item *item = &loader->items[index];
+    if (item->fd >= 0) close(item->fd);
+    item->fd = -1;
+    // Filling the whole buffer means the file grew since it was listed
+    if (loaded && item->size == item->capacity) loaded = 0;
+    if (!loaded) {
+        free(item->data);
+        item->data = NULL;
+    }
+    pthread_mutex_lock(&loader->lock);
+    item->state = loaded ? ITEM_LOADED : ITEM_FAILED;
+    pthread_cond_broadcast(&loader->changed);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+// One thread keeps every open and read in flight on the ring
+static void *ringMain(void *argument) {
+    Loader *loader = argument;
+    Ring *ring = &loader->ring;
+    int inFlight = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&loader->lock);
+        int index;
+        while ((index = nextItem(loader)) >= 0) {
+            Item *item = &loader->items[index];
+            item->data = checkedAlloc(malloc(item->capacity));
+            queueOpen(loader, index);
+            inFlight++;
+        }
+        if (inFlight == 0) {
+            // Nothing to reap: finished, or waiting for a reader to take something
+            if (loader->stopping || loader->next == loader->count) {
+                pthread_mutex_unlock(&loader->lock);
+                break;
+            }
+            pthread_cond_wait(&loader->changed, &loader->lock);
+            pthread_mutex_unlock(&loader->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&loader->lock);
+
+        int entered = syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter");
+            exit(1);
+        }
+        if (entered > 0) ring->pending -= entered;
+
+        unsigned head = *ring->cqHead, tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+            int index = cqe->user_data, result = cqe->res;
+            Item *item = &loader->items[index];
+            if (item->fd < 0 && result >= 0) {
+                item->fd = result;
+                queueRead(loader, index);
+            } else if (result > 0 && item->size + result < item->capacity) {
+                // A short read; ask for the rest
+                item->size += result;
+                queueRead(loader, index);
+            } else {
+                if (result > 0) item->size += result;
+                finishItem(loader, index, result >= 0);
+                inFlight--;
+            }
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// The fallback: blocking reads, on several threads so they still overlap
+static int readItem(Loader *loader, int index) {
+    Item *item = &loader->items[index];
+    item->fd = open(loader->paths[index], O_RDONLY | O_CLOEXEC);
+    if (item->fd < 0) return 0;
+    for (;;) {
+        ssize_t n = read(item->fd, item->data + item->size, item->capacity - item->size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return 0;
+        item->size += n;
+        if (n == 0 || item->size == item->capacity) return 1;
+    }
+}
+
+static void *threadMain(void *argument) {
+    Loader *loader = argument;
+    for (;;) {
+        pthread_mutex_lock(&loader->lock);
+        int index;
+        while ((index = nextItem(loader)) < 0 && !loader->stopping && loader->next < loader->count) {
+            pthread_cond_wait(&loader->changed, &loader->lock);
+        }
+        pthread_mutex_unlock(&loader->lock);
+        if (index < 0) break;
+
+        Item *item = &loader->items[index];
+        item->data = checkedAlloc(malloc(item->capacity));
+        finishItem(loader, index, readItem(loader, index));
+    }
+    return NULL;
+}
+
+Loader *loaderStart(char *const *paths, const long long *sizes, int count, int depth) {
+    Loader *loader = checkedAlloc(calloc(1, sizeof(Loader)));
+    loader->paths = checkedAlloc(malloc((count ? count : 1) * sizeof(char *)));
+    memcpy(loader->paths, paths, count * sizeof(char *));
+    loader->count = count;
+    loader->depth = depth < 1 ? 1 : depth;
+    loader->items = checkedAlloc(calloc(count ? count : 1, sizeof(Item)));
+    for (int i = 0; i < count; i++) {
+        Item *item = &loader->items[i];
+        item->fd = -1;
+        item->capacity = sizes[i] + 1;
+        if (sizes[i] < 0 || sizes[i] > LOADER_MAX_FILE_SIZE) item->state = ITEM_SKIPPED;
+    }
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->changed, NULL);
+
+    loader->useRing = ringOpen(&loader->ring, loader->depth) == 0;
+    int threads = loader->useRing ? 1 : LOADER_THREADS;
+    for (; loader->threadCount < threads; loader->threadCount++) {
+        if (pthread_create(&loader->threads[loader->threadCount], NULL,
+                           loader->useRing ? ringMain : threadMain, loader) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    return loader;
+}
+
+int loaderTake(Loader *loader, int index, char **data, size_t *size) {
+    Item *item = &loader->items[index];
+    pthread_mutex_lock(&loader->lock);
+    if (item->state == ITEM_QUEUED || item->state == ITEM_SKIPPED) {
+        // Reading it here is quicker than waiting for the loader to get to it
+        item->state = ITEM_SKIPPED;
+        pthread_mutex_unlock(&loader->lock);
+        return 0;
+    }
+    while (item->state == ITEM_LOADING) pthread_cond_wait(&loader->changed, &loader->lock);
+    int loaded = item->state == ITEM_LOADED;
+    item->state = ITEM_TAKEN;
+    loader->outstanding--;
+    loader->taken += loaded;
+    pthread_cond_broadcast(&loader->changed);
+    pthread_mutex_unlock(&loader->lock);
+
+    *data = item->data;
+    *size = item->size;
+    item->data = NULL;
+    return loaded;
+}
+
+void loaderStop(Loader *loader) {
+    pthread_mutex_lock(&loader->lock);
+    loader->stopping = 1;
+    pthread_cond_broadcast(&loader->changed);
+    pthread_mutex_unlock(&loader->lock);
+    for (int i = 0; i < loader->threadCount; i++) pthread_join(loader->threads[i], NULL);
+
+    if (loader->useRing) ringClose(&loader->ring);
+    for (int i = 0; i < loader->count; i++) free(loader->items[i].data);
+    free(loader->items);
+    free(loader->paths);
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->changed);
+    free(loader);
+}
+
+const char *loaderBackend(const Loader *loader) {
+    return loader->useRing ? "io_uring" : "threads";
+}
+
+int loaderTakenCount(Loader *loader) {
+    pthread_mutex_lock(&loader->lock);
+    int taken = loader->taken;
+    pthread_mutex_unlock(&loader->lock);
+    return taken;
+}
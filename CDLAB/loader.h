@@ -0,0 +1,38 @@
+#ifndef CDLAB_LOADER_H
+#define CDLAB_LOADER_H
+
+#include <stddef.h>
+
+#define LOADER_DEFAULT_DEPTH 256        // files read ahead at once, loaded or in flight
+#define LOADER_MAX_FILE_SIZE (256 << 10)    // larger files are left to mmap
+#define LOADER_THREADS 16               // readers when io_uring is unavailable
+
+// Reads a batch of small files ahead of the analyzers, so that on a cold
+// cache or a network filesystem the latency of one open and read overlaps
+// with lexing the files before it instead of adding up.
+//
+// Files are loaded in batch order, at most `depth` at a time counting the
+// ones loaded but not yet taken, so memory stays bounded whatever the
+// batch. Opens and reads go through io_uring with one thread submitting
+// and reaping them; where io_uring is missing or forbidden, a pool of
+// LOADER_THREADS threads does blocking reads instead.
+typedef struct Loader Loader;
+
+// The strings in `paths` must outlive the loader. Files with a size above
+// LOADER_MAX_FILE_SIZE, or a negative one, are not loaded.
+Loader *loaderStart(char *const *paths, const long long *sizes, int count, int depth);
+
+// Hands over the contents of file `index`, waiting if they are on their
+// way. Returns 1 with a malloc'd buffer the caller frees, or 0 if the file
+// was not loaded (too large, failed, changed while read, or not reached
+// yet), in which case the caller reads it as usual.
+int loaderTake(Loader *loader, int index, char **data, size_t *size);
+
+// Stops loading, waits for reads in flight and frees what nobody took
+void loaderStop(Loader *loader);
+
+// "io_uring" or "threads", and how many files were handed over loaded
+const char *loaderBackend(const Loader *loader);
+int loaderTakenCount(Loader *loader);
+
+#endif
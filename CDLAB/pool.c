@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+// A worker's queue holds tasks worker, worker + workers, worker + 2*workers...
+// Nothing is pushed once the run starts, so a queue is just the range of
+// positions still unclaimed: head in the low half of `range`, tail in the
+// high half. Owner and thieves claim from opposite ends with one CAS.
+typedef struct {
+    _Atomic uint64_t range;
+    char pad[64 - sizeof(uint64_t)];    // one queue per cache line
+} TaskQueue;
+
+typedef struct {
+    TaskQueue *queues;
+    int workers;
+    PoolTask run;
+    void *context;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int worker;
+} WorkerArgs;
+
+#define RANGE(head, tail) ((uint64_t)(tail) << 32 | (uint32_t)(head))
+#define HEAD(range) ((uint32_t)(range))
+#define TAIL(range) ((uint32_t)((range) >> 32))
+
+// Claims the next position from the front (owner) or back (thief); -1 if empty
+static int claim(TaskQueue *queue, int fromBack) {
+    uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t head = HEAD(range), tail = TAIL(range);
+        if (head >= tail) return -1;
+        uint64_t next = fromBack ? RANGE(head, tail - 1) : RANGE(head + 1, tail);
+        if (__atomic_compare_exchange_n(&queue->range, &range, next, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return fromBack ? tail - 1 : head;
+        }
+    }
+}
+
+static void *workerMain(void *arg) {
+    WorkerArgs *args = arg;
+    Pool *pool = args->pool;
+    int self = args->worker;
+
+    for (;;) {
+        int owner = self;
+        int position = claim(&pool->queues[self], 0);
+        for (int i = 1; position < 0 && i < pool->workers; i++) {
+            owner = (self + i) % pool->workers;
+            position = claim(&pool->queues[owner], 1);
+        }
+        // Queues only ever shrink, so finding them all empty means we are done
+        if (position < 0) break;
+        pool->run(owner + position * pool->workers, self, pool->context);
+    }
+    return NULL;
+}
+
+void poolRun(int workers, int count, PoolTask run, void *context) {
+    if (workers > count) workers = count;
+    if (workers < 1) workers = 1;
+
+    Pool pool = { NULL, workers, run, context };
+    pool.queues = calloc(workers, sizeof(TaskQueue));
+    pthread_t *threads = calloc(workers, sizeof(pthread_t));
+    WorkerArgs *args = calloc(workers, sizeof(WorkerArgs));
+    if (!pool.queues || !threads || !args) {
+        perror("calloc");
+        exit(1);
+    }
+
+    for (int w = 0; w < workers; w++) {
+        int length = count / workers + (w < count % workers);
+        __atomic_store_n(&pool.queues[w].range, RANGE(0, length), __ATOMIC_RELAXED);
+        args[w].pool = &pool;
+        args[w].worker = w;
+    }
+
+    // A worker that fails to start just leaves its queue to the thieves
+    int started[workers];
+    for (int w = 1; w < workers; w++) {
+        started[w] = pthread_create(&threads[w], NULL, workerMain, &args[w]) == 0;
+        if (!started[w]) perror("pthread_create");
+    }
+    workerMain(&args[0]);
+    for (int w = 1; w < workers; w++) {
+        if (started[w]) pthread_join(threads[w], NULL);
+    }
+
+    free(args);
+    free(threads);
+    free(pool.queues);
+}
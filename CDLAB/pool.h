@@ -0,0 +1,15 @@
+#ifndef CDLAB_POOL_H
+#define CDLAB_POOL_H
+
+// Work-stealing pool for a fixed batch of tasks numbered 0..count-1.
+//
+// Tasks are dealt round-robin onto one queue per worker in index order, so
+// callers number the most expensive tasks first. A worker takes from the
+// front of its own queue and, once that is empty, steals from the back of
+// the others until every queue is drained.
+typedef void (*PoolTask)(int task, int worker, void *context);
+
+// Returns once every task has run. The calling thread works as worker 0.
+void poolRun(int workers, int count, PoolTask run, void *context);
+
+#endif
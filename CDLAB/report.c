@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../COMMON/stats.h"
+#include "report.h"
+
+#define SYMBOLS_CACHE_SUFFIX ".sym"
+
+// Tabs and newlines would break the listing's lines apart
+static void writeField(FILE *out, const char *text) {
+    for (; *text; text++) {
+        fputc(*text == '\t' || *text == '\n' || *text == '\r' ? ' ' : *text, out);
+    }
+}
+
+void writeSymbol(FILE *out, const Symbol *symbol) {
+    fputs(symbolKindName(symbol->kind), out);
+    fputc('\t', out);
+    writeField(out, nameText(symbol->name));
+    fputc('\t', out);
+    writeField(out, nameText(symbol->parent));
+    fputc('\n', out);
+}
+
+static void listSymbol(const Symbol *symbol, void *context) {
+    writeSymbol(context, symbol);
+}
+
+int writeReport(const Analyzer *analyzer, const char *path, TokenStream *stream, FILE *symbols) {
+    if (analyzer->analyzeFile(path, stream) != 0) {
+        if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+        return -1;
+    }
+    if (!analyzer->displaySymbolTable) return 0;
+
+    if (statsCurrent) statsCurrent->symbols = analyzer->symbolCount();
+    int phase = statsEnter(PHASE_OUTPUT);
+
+    if (stream->format == STREAM_TEXT) {
+        streamFlush(stream);
+        analyzer->displaySymbolTable(stream->out);
+    } else {
+        char *text = NULL;
+        size_t length = 0;
+        FILE *memory = open_memstream(&text, &length);
+        if (memory) {
+            analyzer->displaySymbolTable(memory);
+            fclose(memory);
+            streamSymbols(stream, text, length);
+            free(text);
+        } else {
+            perror("open_memstream");
+        }
+    }
+    if (symbols && analyzer->listSymbols) analyzer->listSymbols(listSymbol, symbols);
+    statsLeave(phase);
+    analyzer->resetSymbolTable();
+    return 0;
+}
+
+int writeCachedReport(Cache *cache, const char *key, const Analyzer *analyzer, const char *path,
+                      TokenStream *stream, SymbolListing *symbols) {
+    CacheEntry entry, listed;
+    int found = cacheLookup(cache, path, key, analyzer->version, &entry);
+
+    // A report is only a hit if its listing is cached as well
+    if (symbols) {
+        symbols->text = NULL;
+        symbols->length = 0;
+    }
+    if (symbols && found >= 0) {
+        char listedKey[128];
+        snprintf(listedKey, sizeof(listedKey), "%s%s", key, SYMBOLS_CACHE_SUFFIX);
+        int listedFound = cacheLookup(cache, path, listedKey, analyzer->version, &listed);
+        if (found > 0 && listedFound > 0) {
+            symbols->text = listed.report;
+            symbols->length = listed.length;
+        } else {
+            if (found > 0) free(entry.report);
+            if (listedFound > 0) free(listed.report);
+            found = listedFound < 0 ? -1 : 0;
+        }
+    }
+    if (found > 0) {
+        streamWrite(stream, entry.report, entry.length);
+        free(entry.report);
+        return 1;
+    }
+
+    FILE *listing = NULL;
+    if (symbols) {
+        listing = open_memstream(&symbols->text, &symbols->length);
+        if (!listing) perror("open_memstream");
+    }
+    char *report = NULL;
+    size_t length = 0;
+    FILE *memory = found == 0 ? open_memstream(&report, &length) : NULL;
+    if (!memory) {
+        // Unreadable files go straight to the analyzer, which reports the error
+        int status = writeReport(analyzer, path, stream, listing);
+        if (listing) fclose(listing);
+        return status;
+    }
+    TokenStream rendered;
+    streamOpen(&rendered, memory, stream->format);
+    int status = writeReport(analyzer, path, &rendered, listing);
+    streamClose(&rendered);
+    fclose(memory);
+    if (status != 0) {
+        free(report);
+        if (listing) {
+            fclose(listing);
+            free(symbols->text);
+            symbols->text = NULL;
+            symbols->length = 0;
+        }
+        return status;
+    }
+
+    streamWrite(stream, report, length);
+    cacheStore(&entry, report, length);
+    free(report);
+    if (listing) {
+        fclose(listing);
+        cacheStore(&listed, symbols->text, symbols->length);
+    }
+    return 0;
+}
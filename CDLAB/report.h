@@ -0,0 +1,34 @@
+#ifndef CDLAB_REPORT_H
+#define CDLAB_REPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "../COMMON/analyzer.h"
+#include "cache.h"
+
+// One file's symbols as text, one "kind\tname\tparent\n" line per symbol
+typedef struct {
+    char *text;                 // malloc'd
+    size_t length;
+} SymbolListing;
+
+// Runs the analyzer on one file and writes its tokens and symbol table to
+// the stream, leaving the analyzer's table empty again. If `symbols` is not
+// NULL the table is listed there as well. Returns -1 if the file could not
+// be read, which the analyzer has reported.
+int writeReport(const Analyzer *analyzer, const char *path, TokenStream *stream, FILE *symbols);
+
+// Like writeReport, but serves the report from the cache when the file is
+// unchanged and stores it there otherwise. `key` tells languages and output
+// formats apart in the cache. If `symbols` is not NULL it receives the
+// listing, which is cached alongside. Returns 1 if the report came from the
+// cache, 0 if the file was analyzed and -1 if it could not be read, which
+// is not cached.
+int writeCachedReport(Cache *cache, const char *key, const Analyzer *analyzer, const char *path,
+                      TokenStream *stream, SymbolListing *symbols);
+
+// Writes one line of a listing
+void writeSymbol(FILE *out, const Symbol *symbol);
+
+#endif
@@ -0,0 +1,1040 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "../COMMON/alloc.h"
+#include "languages.h"
+#include "pool.h"
+#include "report.h"
+#include "server.h"
+#include "watch.h"
+
+#define MAX_REQUEST_LEN 4352            // a command plus a PATH_MAX path
+#define MAX_BUFFER_SIZE (256 << 20)     // largest BUFFER body accepted
+#define MAX_SUBSCRIBER_BACKLOG (64 << 20)   // event bytes a subscriber may fall behind by
+#define LATENCY_WINDOW 4096             // STATS covers this many recent requests
+#define INDEX_FIRST_SLOTS 1024
+
+// One analyzed file and the listing its index postings point into. Files
+// that are deleted keep their entry, empty, since entries are never removed.
+typedef struct {
+    char *path;
+    SymbolListing listing;
+    int present;
+} IndexedFile;
+
+// A symbol's line in its file's listing
+typedef struct {
+    const IndexedFile *file;
+    const char *line;
+} Posting;
+
+typedef struct {
+    Posting *postings;
+    int count;
+    int capacity;
+} PostingList;
+
+// Open-addressed map from a string to one pointer; entries are never removed
+typedef struct {
+    char **keys;
+    void **values;
+    size_t slotCount;
+    size_t used;
+} StringMap;
+
+// A connection that asked for change events. Events queue here and the
+// connection's own thread sends them, so a slow reader holds up nobody.
+typedef struct {
+    int fd;
+    int wake[2];                // a byte here means events were queued
+    char *queued;               // event bytes not yet taken for sending
+    size_t queuedLength;
+    size_t queuedCapacity;
+} Subscriber;
+
+typedef struct {
+    Cache *cache;
+
+    StringMap files;            // path -> IndexedFile
+    size_t presentFiles;
+    PostingList *names;         // indexed by the symbol name's NameId
+    size_t nameSlots;
+    size_t nameCount;           // names with postings, now or before
+    pthread_rwlock_t indexLock;
+
+    pthread_mutex_t lock;       // guards everything below
+    pthread_cond_t idle;        // signalled when the last connection ends
+    int *connections;
+    int connectionCount;
+    int connectionCapacity;
+    Subscriber **subscribers;
+    int subscriberCount;
+    int subscriberCapacity;
+    double latencies[LATENCY_WINDOW];   // microseconds, a ring
+    long long requests;
+
+    Watcher *watcher;           // NULL unless serving with --watch
+    long long updates;          // files re-analyzed or dropped on the watcher's word
+} Server;
+
+typedef struct {
+    Server *server;
+    int fd;
+} Connection;
+
+static int signalPipe[2] = {-1, -1};
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// FNV-1a
+static size_t hashString(const char *text) {
+    size_t hash = 14695981039346656037ULL;
+    for (; *text; text++) hash = (hash ^ (unsigned char)*text) * 1099511628211ULL;
+    return hash;
+}
+
+static size_t mapSlot(const StringMap *map, const char *key) {
+    size_t slot = hashString(key) & (map->slotCount - 1);
+    while (map->keys[slot] && strcmp(map->keys[slot], key) != 0) slot = (slot + 1) & (map->slotCount - 1);
+    return slot;
+}
+
+static void *mapGet(const StringMap *map, const char *key) {
+    if (map->slotCount == 0) return NULL;
+    size_t slot = mapSlot(map, key);
+    return map->keys[slot] ? map->values[slot] : NULL;
+}
+
+static void mapPut(StringMap *map, const char *key, void *value) {
+    if ((map->used + 1) * 2 > map->slotCount) {
+        StringMap grown = {NULL, NULL, map->slotCount ? map->slotCount * 2 : INDEX_FIRST_SLOTS, map->used};
+        grown.keys = checkedAlloc(calloc(grown.slotCount, sizeof(char *)));
+        grown.values = checkedAlloc(calloc(grown.slotCount, sizeof(void *)));
+        for (size_t i = 0; i < map->slotCount; i++) {
+            if (!map->keys[i]) continue;
+            size_t slot = mapSlot(&grown, map->keys[i]);
+            grown.keys[slot] = map->keys[i];
+            grown.values[slot] = map->values[i];
+        }
+        free(map->keys);
+        free(map->values);
+        *map = grown;
+    }
+    size_t slot = mapSlot(map, key);
+    if (!map->keys[slot]) {
+        map->keys[slot] = checkedAlloc(strdup(key));
+        map->used++;
+    }
+    map->values[slot] = value;
+}
+
+static void mapFree(StringMap *map, void (*freeValue)(void *value)) {
+    for (size_t i = 0; i < map->slotCount; i++) {
+        if (!map->keys[i]) continue;
+        free(map->keys[i]);
+        freeValue(map->values[i]);
+    }
+    free(map->keys);
+    free(map->values);
+}
+
+// The ID of the name field of a listing line
+static NameId lineName(const char *line) {
+    const char *start = strchr(line, '\t') + 1;
+    return internName(start, strcspn(start, "\t\n"));
+}
+
+static PostingList *postingsFor(Server *server, NameId name) {
+    if (name >= server->nameSlots) {
+        size_t slots = server->nameSlots ? server->nameSlots : INDEX_FIRST_SLOTS;
+        while (slots <= name) slots *= 2;
+        server->names = checkedAlloc(realloc(server->names, slots * sizeof(PostingList)));
+        memset(server->names + server->nameSlots, 0, (slots - server->nameSlots) * sizeof(PostingList));
+        server->nameSlots = slots;
+    }
+    return &server->names[name];
+}
+
+// Walks the start of each line in a listing; every line ends in '\n'
+#define FOR_EACH_LINE(listing, line) \
+    for (const char *line = (listing)->text, *listingEnd_ = (listing)->text + (listing)->length; \
+         line && line < listingEnd_; line = (const char *)memchr(line, '\n', listingEnd_ - line) + 1)
+
+static void removePostings(Server *server, IndexedFile *file) {
+    FOR_EACH_LINE(&file->listing, line) {
+        PostingList *list = postingsFor(server, lineName(line));
+        int kept = 0;
+        for (int i = 0; i < list->count; i++) {
+            if (list->postings[i].file != file) list->postings[kept++] = list->postings[i];
+        }
+        list->count = kept;
+    }
+}
+
+// Replaces a file's postings with those of a new listing, which the index
+// takes over
+static void indexFile(Server *server, const char *path, SymbolListing *listing) {
+    pthread_rwlock_wrlock(&server->indexLock);
+    IndexedFile *file = mapGet(&server->files, path);
+    if (file) {
+        removePostings(server, file);
+        free(file->listing.text);
+    } else {
+        file = checkedAlloc(calloc(1, sizeof(IndexedFile)));
+        file->path = checkedAlloc(strdup(path));
+        mapPut(&server->files, path, file);
+    }
+    if (!file->present) server->presentFiles++;
+    file->present = 1;
+    file->listing = *listing;
+
+    FOR_EACH_LINE(&file->listing, line) {
+        PostingList *list = postingsFor(server, lineName(line));
+        if (list->capacity == 0) server->nameCount++;
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 4;
+            list->postings = checkedAlloc(realloc(list->postings, list->capacity * sizeof(Posting)));
+        }
+        list->postings[list->count].file = file;
+        list->postings[list->count].line = line;
+        list->count++;
+    }
+    pthread_rwlock_unlock(&server->indexLock);
+}
+
+// Whether an indexed file in slot `i` is present and is `path`, of
+// `length` bytes, or under it
+static int presentUnder(const Server *server, size_t i, const char *path, size_t length) {
+    const IndexedFile *file = server->files.values[i];
+    return server->files.keys[i] && file->present && strncmp(file->path, path, length) == 0 &&
+           (file->path[length] == '\0' || file->path[length] == '/');
+}
+
+// The indexed files that are `path` or under it, NULL-terminated, for the
+// caller to free
+static char **indexedUnder(Server *server, const char *path) {
+    size_t length = strlen(path), count = 0;
+    char **found = checkedAlloc(malloc(sizeof(char *)));
+    pthread_rwlock_rdlock(&server->indexLock);
+    for (size_t i = 0; i < server->files.slotCount; i++) {
+        if (!presentUnder(server, i, path, length)) continue;
+        found = checkedAlloc(realloc(found, (count + 2) * sizeof(char *)));
+        found[count++] = checkedAlloc(strdup(((IndexedFile *)server->files.values[i])->path));
+    }
+    pthread_rwlock_unlock(&server->indexLock);
+    found[count] = NULL;
+    return found;
+}
+
+// Drops every file that is `path` or under it from the index. Returns the
+// paths dropped, NULL-terminated, for the caller to free.
+static char **unindexPath(Server *server, const char *path) {
+    size_t length = strlen(path), count = 0;
+    char **dropped = checkedAlloc(malloc(sizeof(char *)));
+    pthread_rwlock_wrlock(&server->indexLock);
+    for (size_t i = 0; i < server->files.slotCount; i++) {
+        if (!presentUnder(server, i, path, length)) continue;
+        IndexedFile *file = server->files.values[i];
+        removePostings(server, file);
+        free(file->listing.text);
+        file->listing = (SymbolListing){NULL, 0};
+        file->present = 0;
+        server->presentFiles--;
+        dropped = checkedAlloc(realloc(dropped, (count + 2) * sizeof(char *)));
+        dropped[count++] = checkedAlloc(strdup(file->path));
+    }
+    pthread_rwlock_unlock(&server->indexLock);
+    dropped[count] = NULL;
+    return dropped;
+}
+
+static void freeIndexedFile(void *value) {
+    IndexedFile *file = value;
+    free(file->path);
+    free(file->listing.text);
+    free(file);
+}
+
+
+// Reports a file on disk and re-indexes its symbols. Returns an error
+// message or NULL. The files are often being edited, so each is read into
+// memory rather than mapped, where a truncation would kill the daemon, and
+// lent to the analyzer and the cache.
+static const char *analyzePath(Server *server, const char *path, FILE *out) {
+    char resolved[PATH_MAX];
+    if (!realpath(path, resolved)) return strerror(errno);
+    const Analyzer *analyzer = routeByExtension(resolved);
+    if (!analyzer) return "no analyzer for this file";
+    Input in;
+    if (inputRead(&in, resolved) != 0) return strerror(errno);
+    inputLend(resolved, in.data, in.size);
+
+    TokenStream stream;
+    SymbolListing listing = {NULL, 0};
+    streamOpen(&stream, out, STREAM_TEXT);
+    streamBeginFile(&stream, resolved, analyzer->name);
+    if (server->cache) {
+        writeCachedReport(server->cache, languages[languageIndex(analyzer)].key, analyzer, resolved,
+                          &stream, &listing);
+    } else {
+        FILE *symbols = open_memstream(&listing.text, &listing.length);
+        writeReport(analyzer, resolved, &stream, symbols);
+        if (symbols) fclose(symbols);
+    }
+    streamEndFile(&stream);
+    streamClose(&stream);
+    inputLendEnd();
+    inputClose(&in);
+    indexFile(server, resolved, &listing);
+    return NULL;
+}
+
+// Reports `length` bytes read from the connection. The analyzers only take
+// paths, so the text goes into an anonymous memory file first. Sets *fatal
+// if the connection can no longer be read in step.
+static const char *analyzeBuffer(const char *language, long long length, const char *name, FILE *in,
+                                 FILE *out, int *fatal) {
+    const Analyzer *analyzer = strcmp(language, "-") == 0 ? routeByExtension(name) : findLanguage(language);
+    if (length < 0 || length > MAX_BUFFER_SIZE) {
+        *fatal = 1;
+        return "bad buffer length";
+    }
+
+    int fd = memfd_create("cdlab-buffer", MFD_CLOEXEC);
+    char block[65536];
+    for (long long left = length; left > 0;) {
+        size_t want = left < (long long)sizeof(block) ? (size_t)left : sizeof(block);
+        size_t got = fread(block, 1, want, in);
+        if (got == 0) {
+            *fatal = 1;
+            if (fd >= 0) close(fd);
+            return "buffer ended early";
+        }
+        if (fd >= 0 && write(fd, block, got) != (ssize_t)got) {
+            close(fd);
+            fd = -1;
+        }
+        left -= got;
+    }
+    if (fd < 0) return "cannot hold buffer";
+    if (!analyzer) {
+        close(fd);
+        return "no analyzer for this buffer";
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    TokenStream stream;
+    streamOpen(&stream, out, STREAM_TEXT);
+    streamBeginFile(&stream, name, analyzer->name);
+    writeReport(analyzer, path, &stream, NULL);
+    streamEndFile(&stream);
+    streamClose(&stream);
+    close(fd);
+    return NULL;
+}
+
+static void listDefinitions(Server *server, const char *name, const char *kind, FILE *out) {
+    pthread_rwlock_rdlock(&server->indexLock);
+    NameId id = nameFind(name, strlen(name));
+    PostingList *list = id < server->nameSlots ? &server->names[id] : NULL;
+    for (int i = 0; list && i < list->count; i++) {
+        const char *line = list->postings[i].line;
+        size_t kindLength = strchr(line, '\t') - line;
+        if (kind && (strlen(kind) != kindLength || strncmp(line, kind, kindLength) != 0)) continue;
+        fwrite(line, 1, strchr(line, '\n') - line, out);
+        fprintf(out, "\t%s\n", list->postings[i].file->path);
+    }
+    pthread_rwlock_unlock(&server->indexLock);
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void writeStats(Server *server, FILE *out) {
+    double recent[LATENCY_WINDOW];
+    pthread_mutex_lock(&server->lock);
+    long long requests = server->requests;
+    int count = requests < LATENCY_WINDOW ? (int)requests : LATENCY_WINDOW;
+    memcpy(recent, server->latencies, count * sizeof(double));
+    int connections = server->connectionCount, subscribers = server->subscriberCount;
+    long long updates = server->updates;
+    pthread_mutex_unlock(&server->lock);
+
+    pthread_rwlock_rdlock(&server->indexLock);
+    size_t files = server->presentFiles, names = server->nameCount;
+    pthread_rwlock_unlock(&server->indexLock);
+
+    fprintf(out, "requests %lld\nconnections %d\nindexed_files %zu\nindexed_names %zu\n",
+            requests, connections, files, names);
+    if (server->watcher) {
+        fprintf(out, "watched_dirs %d\nwatch_events %lld\nwatch_updates %lld\nsubscribers %d\n",
+                watchDirectoryCount(server->watcher), watchEventCount(server->watcher), updates, subscribers);
+    }
+    if (count == 0) return;
+    qsort(recent, count, sizeof(double), compareDoubles);
+    fprintf(out, "p50_us %.1f\np99_us %.1f\nmax_us %.1f\n",
+            recent[count / 2], recent[(int)(count * 0.99)], recent[count - 1]);
+}
+
+// Runs one request line, writing the response body to `out`. Returns an
+// error message or NULL.
+static const char *handleRequest(Server *server, char *request, FILE *in, FILE *out, int *fatal) {
+    char *save;
+    char *command = strtok_r(request, " ", &save);
+    if (!command) return "empty request";
+
+    if (strcmp(command, "ANALYZE") == 0) {
+        char *path = strtok_r(NULL, "", &save);
+        return path ? analyzePath(server, path, out) : "usage: ANALYZE <path>";
+    }
+    if (strcmp(command, "BUFFER") == 0) {
+        char *language = strtok_r(NULL, " ", &save);
+        char *length = strtok_r(NULL, " ", &save);
+        char *name = strtok_r(NULL, "", &save);
+        if (!language || !length) {
+            *fatal = 1;
+            return "usage: BUFFER <lang> <length> [<name>]";
+        }
+        char *end;
+        long long bytes = strtoll(length, &end, 10);
+        if (*end) bytes = -1;
+        return analyzeBuffer(language, bytes, name ? name : "<buffer>", in, out, fatal);
+    }
+    if (strcmp(command, "SYMBOLS") == 0) {
+        char *name = strtok_r(NULL, " ", &save);
+        char *kind = strtok_r(NULL, " ", &save);
+        if (!name) return "usage: SYMBOLS <name> [<kind>]";
+        if (kind && symbolKindFind(kind) < 0) return "unknown symbol kind";
+        listDefinitions(server, name, kind, out);
+        return NULL;
+    }
+    if (strcmp(command, "STATS") == 0) {
+        writeStats(server, out);
+        return NULL;
+    }
+    return "unknown request";
+}
+
+static int sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return 0;
+        data += sent;
+        length -= sent;
+    }
+    return 1;
+}
+
+// Closes a connection and wakes the shutdown once the last one is gone
+static void forgetConnection(Server *server, int fd) {
+    pthread_mutex_lock(&server->lock);
+    for (int i = 0; i < server->connectionCount; i++) {
+        if (server->connections[i] == fd) {
+            server->connections[i] = server->connections[--server->connectionCount];
+            break;
+        }
+    }
+    close(fd);
+    if (server->connectionCount == 0) pthread_cond_signal(&server->idle);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void removeSubscriber(Server *server, const Subscriber *subscriber) {
+    for (int i = 0; i < server->subscriberCount; i++) {
+        if (server->subscribers[i] == subscriber) {
+            server->subscribers[i] = server->subscribers[--server->subscriberCount];
+            return;
+        }
+    }
+}
+
+static void queueBytes(Subscriber *subscriber, const char *data, size_t length) {
+    if (subscriber->queuedLength + length > subscriber->queuedCapacity) {
+        size_t capacity = subscriber->queuedCapacity ? subscriber->queuedCapacity : 4096;
+        while (capacity < subscriber->queuedLength + length) capacity *= 2;
+        subscriber->queued = checkedAlloc(realloc(subscriber->queued, capacity));
+        subscriber->queuedCapacity = capacity;
+    }
+    memcpy(subscriber->queued + subscriber->queuedLength, data, length);
+    subscriber->queuedLength += length;
+}
+
+// Queues "EVENT <length>\n" and the body for every subscriber. One whose
+// queue would pass MAX_SUBSCRIBER_BACKLOG bytes is not keeping up, and is
+// cut off rather than left to hold ever more memory; it sees the
+// connection end and can subscribe again and re-query. An event of any
+// size is still queued for a subscriber that has caught up.
+static void notifySubscribers(Server *server, const char *body, size_t length) {
+    char header[32];
+    int headerLength = snprintf(header, sizeof(header), "EVENT %zu\n", length);
+
+    pthread_mutex_lock(&server->lock);
+    for (int i = 0; i < server->subscriberCount;) {
+        Subscriber *subscriber = server->subscribers[i];
+        size_t waiting = subscriber->queuedLength;
+        if (waiting > 0 && waiting + headerLength + length > MAX_SUBSCRIBER_BACKLOG) {
+            shutdown(subscriber->fd, SHUT_RDWR);
+            removeSubscriber(server, subscriber);
+            continue;
+        }
+        queueBytes(subscriber, header, headerLength);
+        queueBytes(subscriber, body, length);
+        if (waiting == 0 && write(subscriber->wake[1], "", 1) < 0) {
+            // The pipe is full, so a wakeup is already pending
+        }
+        i++;
+    }
+    pthread_mutex_unlock(&server->lock);
+}
+
+// SUBSCRIBE: acknowledges, then sends the events notifySubscribers queues
+// until the client hangs up or is cut off
+static void subscribe(Server *server, int fd) {
+    Subscriber subscriber = {fd, {-1, -1}, NULL, 0, 0};
+    if (pipe2(subscriber.wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        sendAll(fd, "ERR cannot subscribe\n", 21);
+        return;
+    }
+    int sent = sendAll(fd, "OK 0\n", 5);
+    pthread_mutex_lock(&server->lock);
+    if (server->subscriberCount == server->subscriberCapacity) {
+        server->subscriberCapacity = server->subscriberCapacity ? server->subscriberCapacity * 2 : 8;
+        server->subscribers = checkedAlloc(realloc(server->subscribers,
+                                                   server->subscriberCapacity * sizeof(Subscriber *)));
+    }
+    if (sent) server->subscribers[server->subscriberCount++] = &subscriber;
+    pthread_mutex_unlock(&server->lock);
+
+    // Anything the client sends is ignored; the end of its input, or of
+    // ours when it is cut off or the daemon stops, ends the subscription
+    struct pollfd waiting[2] = {{fd, POLLIN, 0}, {subscriber.wake[0], POLLIN, 0}};
+    while (sent) {
+        if (poll(waiting, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (waiting[0].revents) {
+            char discard[256];
+            ssize_t got = read(fd, discard, sizeof(discard));
+            if (got == 0 || (got < 0 && errno != EINTR)) break;
+        }
+        if (waiting[1].revents) {
+            char drained[16];
+            while (read(subscriber.wake[0], drained, sizeof(drained)) > 0);
+            pthread_mutex_lock(&server->lock);
+            char *events = subscriber.queued;
+            size_t length = subscriber.queuedLength;
+            subscriber.queued = NULL;
+            subscriber.queuedLength = subscriber.queuedCapacity = 0;
+            pthread_mutex_unlock(&server->lock);
+            sent = sendAll(fd, events, length);
+            free(events);
+        }
+    }
+    pthread_mutex_lock(&server->lock);
+    removeSubscriber(server, &subscriber);
+    pthread_mutex_unlock(&server->lock);
+    free(subscriber.queued);
+    close(subscriber.wake[0]);
+    close(subscriber.wake[1]);
+}
+
+static void *serveConnection(void *argument) {
+    Connection *connection = argument;
+    Server *server = connection->server;
+    int fd = connection->fd;
+    free(connection);
+
+    FILE *in = fdopen(dup(fd), "r");
+    char request[MAX_REQUEST_LEN];
+    while (in && fgets(request, sizeof(request), in)) {
+        double start = now();
+        char header[64 + MAX_REQUEST_LEN];
+        int fatal = 0, sent;
+        if (!strchr(request, '\n') && !feof(in)) {
+            sendAll(fd, "ERR request too long\n", 21);
+            break;
+        }
+        request[strcspn(request, "\r\n")] = '\0';
+        if (strcmp(request, "SUBSCRIBE") == 0) {
+            subscribe(server, fd);
+            break;
+        }
+
+        char *body = NULL;
+        size_t length = 0;
+        FILE *out = checkedAlloc(open_memstream(&body, &length));
+        const char *error = handleRequest(server, request, in, out, &fatal);
+        fclose(out);
+        if (error) {
+            snprintf(header, sizeof(header), "ERR %s\n", error);
+            sent = sendAll(fd, header, strlen(header));
+        } else {
+            snprintf(header, sizeof(header), "OK %zu\n", length);
+            sent = sendAll(fd, header, strlen(header)) && sendAll(fd, body, length);
+        }
+        free(body);
+
+        pthread_mutex_lock(&server->lock);
+        server->latencies[server->requests++ % LATENCY_WINDOW] = (now() - start) * 1e6;
+        pthread_mutex_unlock(&server->lock);
+        if (!sent || fatal) break;
+    }
+    if (in) fclose(in);
+    forgetConnection(server, fd);
+    return NULL;
+}
+
+static void startConnection(Server *server, int fd) {
+    Connection *connection = checkedAlloc(malloc(sizeof(Connection)));
+    connection->server = server;
+    connection->fd = fd;
+
+    pthread_mutex_lock(&server->lock);
+    if (server->connectionCount == server->connectionCapacity) {
+        server->connectionCapacity = server->connectionCapacity ? server->connectionCapacity * 2 : 16;
+        server->connections = checkedAlloc(realloc(server->connections, server->connectionCapacity * sizeof(int)));
+    }
+    server->connections[server->connectionCount++] = fd;
+    pthread_mutex_unlock(&server->lock);
+
+    // Only the main thread should see SIGINT and SIGTERM
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attributes, serveConnection, connection) != 0) {
+        perror("pthread_create");
+        forgetConnection(server, fd);
+        free(connection);
+    }
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+static void onSignal(int signal) {
+    int saved = errno;
+    char byte = (char)signal;
+    if (write(signalPipe[1], &byte, 1) < 0) {
+        // The pipe is full, so a wakeup is already pending
+    }
+    errno = saved;
+}
+
+static int fillAddress(struct sockaddr_un *address, const char *socketPath) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 0;
+    }
+    strcpy(address->sun_path, socketPath);
+    return 1;
+}
+
+static int connectSocket(const char *socketPath) {
+    struct sockaddr_un address;
+    if (!fillAddress(&address, socketPath)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Binds the listening socket. A socket file that nobody answers on is left
+// over from a daemon that died, and is replaced.
+static int listenSocket(const char *socketPath) {
+    struct sockaddr_un address;
+    if (!fillAddress(&address, socketPath)) return -1;
+
+    int running = connectSocket(socketPath);
+    if (running >= 0) {
+        close(running);
+        fprintf(stderr, "A daemon is already serving %s\n", socketPath);
+        return -1;
+    }
+    struct stat st;
+    if (lstat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    mode_t mask = umask(0177);
+    int bound = bind(fd, (struct sockaddr *)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror(socketPath);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+typedef struct {
+    Server *server;
+    char *const *paths;
+} WarmUp;
+
+static void warmTask(int task, int worker, void *context) {
+    (void)worker;               // the reports are dropped, so workers share nothing
+    WarmUp *warm = context;
+    char *report = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&report, &length);
+    if (!out) return;
+    const char *error = analyzePath(warm->server, warm->paths[task], out);
+    fclose(out);
+    free(report);
+    if (error) fprintf(stderr, "%s: %s\n", warm->paths[task], error);
+}
+
+// Drops `path` and everything under it from the index, and tells the
+// subscribers "deleted <path>" for each file that went
+static void dropPath(Server *server, const char *path) {
+    char **dropped = unindexPath(server, path);
+    int count = 0;
+    for (; dropped[count]; count++) {
+        char event[PATH_MAX + 16];
+        int eventLength = snprintf(event, sizeof(event), "deleted %s\n", dropped[count]);
+        notifySubscribers(server, event, eventLength);
+        free(dropped[count]);
+    }
+    free(dropped);
+    pthread_mutex_lock(&server->lock);
+    server->updates += count;
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Brings the index up to date with a path the watcher reports, and tells
+// the subscribers: "changed <path>" and the file's symbol lines, or
+// "deleted <path>" for each file that went
+static void onWatchedChange(const char *path, void *context) {
+    Server *server = context;
+    struct stat st;
+    int exists = stat(path, &st) == 0;
+    if (exists && S_ISDIR(st.st_mode)) {
+        // Files under it may have gone while the watcher lost events
+        char **indexed = indexedUnder(server, path);
+        for (int i = 0; indexed[i]; i++) {
+            if (stat(indexed[i], &st) != 0 || !S_ISREG(st.st_mode)) dropPath(server, indexed[i]);
+            free(indexed[i]);
+        }
+        free(indexed);
+        return;
+    }
+    if (exists && S_ISREG(st.st_mode)) {
+        if (!routeByExtension(path)) return;
+        char *report = NULL;
+        size_t length = 0;
+        FILE *out = checkedAlloc(open_memstream(&report, &length));
+        const char *error = analyzePath(server, path, out);
+        fclose(out);
+        free(report);
+        if (error) return;
+
+        char *event = NULL;
+        size_t eventLength = 0;
+        out = checkedAlloc(open_memstream(&event, &eventLength));
+        fprintf(out, "changed %s\n", path);
+        pthread_rwlock_rdlock(&server->indexLock);
+        IndexedFile *file = mapGet(&server->files, path);
+        if (file) fwrite(file->listing.text, 1, file->listing.length, out);
+        pthread_rwlock_unlock(&server->indexLock);
+        fclose(out);
+        notifySubscribers(server, event, eventLength);
+        free(event);
+
+        pthread_mutex_lock(&server->lock);
+        server->updates++;
+        pthread_mutex_unlock(&server->lock);
+        return;
+    }
+    dropPath(server, path);
+}
+
+int serveSocket(const char *socketPath, Cache *cache, char *const *paths, int pathCount, int jobs,
+                char *const *watchRoots, int watchCount, int debounceMs) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.cache = cache;
+    pthread_rwlock_init(&server.indexLock, NULL);
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.idle, NULL);
+
+    int listener = listenSocket(socketPath);
+    if (listener < 0) return 1;
+    if (pipe2(signalPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        perror("pipe");
+        close(listener);
+        unlink(socketPath);
+        return 1;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Watch before warming up, so nothing written meanwhile is missed
+    if (watchCount > 0) {
+        server.watcher = watchStart(watchRoots, watchCount, debounceMs, onWatchedChange, &server);
+        if (server.watcher) fprintf(stderr, "Watching %d directories\n", watchDirectoryCount(server.watcher));
+    }
+    if (pathCount > 0) {
+        WarmUp warm = {&server, paths};
+        double start = now();
+        poolRun(jobs, pathCount, warmTask, &warm);
+        fprintf(stderr, "Indexed %zu files, %zu names in %.2f s\n",
+                server.presentFiles, server.nameCount, now() - start);
+    }
+    fprintf(stderr, "Serving %s\n", socketPath);
+
+    struct pollfd waiting[2] = {{listener, POLLIN, 0}, {signalPipe[0], POLLIN, 0}};
+    while (1) {
+        if (poll(waiting, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (waiting[1].revents) break;
+        if (waiting[0].revents & POLLIN) {
+            int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0) startConnection(&server, fd);
+            else if (errno != EINTR && errno != ECONNABORTED) perror("accept");
+        }
+    }
+
+    // Stop reading from every client; each finishes the request it is on
+    watchStop(server.watcher);
+    close(listener);
+    unlink(socketPath);
+    pthread_mutex_lock(&server.lock);
+    for (int i = 0; i < server.connectionCount; i++) shutdown(server.connections[i], SHUT_RD);
+    while (server.connectionCount > 0) pthread_cond_wait(&server.idle, &server.lock);
+    pthread_mutex_unlock(&server.lock);
+    fprintf(stderr, "Served %lld requests\n", server.requests);
+
+    close(signalPipe[0]);
+    close(signalPipe[1]);
+    mapFree(&server.files, freeIndexedFile);
+    for (size_t i = 0; i < server.nameSlots; i++) free(server.names[i].postings);
+    free(server.names);
+    free(server.connections);
+    free(server.subscribers);
+    pthread_rwlock_destroy(&server.indexLock);
+    pthread_mutex_destroy(&server.lock);
+    pthread_cond_destroy(&server.idle);
+    return 0;
+}
+
+// Reads one response; returns 1 for OK with the body in *body, 0 for ERR
+// with the message in *body, and -1 if the connection broke
+static int readResponse(FILE *in, char **body, size_t *length) {
+    char header[MAX_REQUEST_LEN];
+    *body = NULL;
+    *length = 0;
+    if (!fgets(header, sizeof(header), in)) return -1;
+    if (strncmp(header, "ERR ", 4) == 0) {
+        *body = checkedAlloc(strdup(header + 4));
+        *length = strlen(*body);
+        return 0;
+    }
+    char *end;
+    if (strncmp(header, "OK ", 3) != 0) return -1;
+    *length = strtoull(header + 3, &end, 10);
+    if (*end != '\n') return -1;
+    *body = checkedAlloc(malloc(*length + 1));
+    if (fread(*body, 1, *length, in) != *length) {
+        free(*body);
+        *body = NULL;
+        return -1;
+    }
+    return 1;
+}
+
+// Copies each event body to stdout as it arrives, until the daemon hangs
+// up. Returns 1 if it hung up between events, 0 if an event was cut short
+// or garbled.
+static int followEvents(FILE *in) {
+    char header[64];
+    while (fgets(header, sizeof(header), in)) {
+        char *end;
+        if (strncmp(header, "EVENT ", 6) != 0) return 0;
+        size_t length = strtoull(header + 6, &end, 10);
+        if (*end != '\n') return 0;
+        char *body = checkedAlloc(malloc(length + 1));
+        if (fread(body, 1, length, in) != length) {
+            free(body);
+            return 0;
+        }
+        fwrite(body, 1, length, stdout);
+        fflush(stdout);
+        free(body);
+    }
+    return 1;
+}
+
+typedef struct {
+    const char *socketPath;
+    const char *message;
+    size_t messageLength;
+    int repeat;
+    double *latencies;          // repeat per client
+    int failures;
+} ClientRun;
+
+static void *runClient(void *argument) {
+    ClientRun *run = argument;
+    int fd = connectSocket(run->socketPath);
+    FILE *in = fd >= 0 ? fdopen(dup(fd), "r") : NULL;
+    for (int i = 0; i < run->repeat; i++) {
+        char *body;
+        size_t length;
+        double start = now();
+        int status = in && sendAll(fd, run->message, run->messageLength) ? readResponse(in, &body, &length) : -1;
+        if (status < 0) {
+            run->failures += run->repeat - i;
+            break;
+        }
+        run->latencies[i] = (now() - start) * 1e6;
+        if (status == 0) run->failures++;
+        free(body);
+    }
+    if (in) fclose(in);
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+// Builds the bytes to send: ANALYZE paths are made absolute, since the
+// daemon has its own working directory, and BUFFER gets stdin as its body
+static char *buildMessage(const char *request, size_t *length) {
+    char *message = NULL;
+    FILE *out = checkedAlloc(open_memstream(&message, length));
+    char resolved[PATH_MAX];
+    if (strncmp(request, "ANALYZE ", 8) == 0 && realpath(request + 8, resolved)) {
+        fprintf(out, "ANALYZE %s\n", resolved);
+    } else if (strncmp(request, "BUFFER ", 7) == 0) {
+        char *text = NULL;
+        size_t textLength = 0, got;
+        FILE *buffer = checkedAlloc(open_memstream(&text, &textLength));
+        char block[65536];
+        while ((got = fread(block, 1, sizeof(block), stdin)) > 0) fwrite(block, 1, got, buffer);
+        fclose(buffer);
+
+        // BUFFER <lang> [<name>] becomes BUFFER <lang> <length> [<name>]
+        const char *language = request + 7;
+        size_t languageLength = strcspn(language, " ");
+        const char *name = language + languageLength;
+        fprintf(out, "BUFFER %.*s %zu%s\n", (int)languageLength, language, textLength, name);
+        fwrite(text, 1, textLength, out);
+        free(text);
+    } else {
+        fprintf(out, "%s\n", request);
+    }
+    fclose(out);
+    return message;
+}
+
+int clientRequest(const char *socketPath, const char *request, int repeat, int clients) {
+    signal(SIGPIPE, SIG_IGN);
+    size_t messageLength;
+    char *message = buildMessage(request, &messageLength);
+
+    if (repeat <= 1 && clients <= 1) {
+        int fd = connectSocket(socketPath);
+        if (fd < 0) {
+            perror(socketPath);
+            free(message);
+            return 1;
+        }
+        FILE *in = fdopen(dup(fd), "r");
+        char *body = NULL;
+        size_t length = 0;
+        int status = in && sendAll(fd, message, messageLength) ? readResponse(in, &body, &length) : -1;
+        if (status > 0 && strcmp(request, "SUBSCRIBE") == 0) {
+            // A subscriber that lost events has to re-query, so say so
+            if (!followEvents(in)) {
+                fprintf(stderr, "Events from %s were cut short\n", socketPath);
+                status = 0;
+            }
+        } else if (status > 0) {
+            fwrite(body, 1, length, stdout);
+        } else if (status == 0) {
+            fprintf(stderr, "%s", body);
+        } else {
+            fprintf(stderr, "Connection to %s failed\n", socketPath);
+        }
+        free(body);
+        if (in) fclose(in);
+        close(fd);
+        free(message);
+        return status > 0 ? 0 : 1;
+    }
+
+    if (repeat < 1) repeat = 1;
+    if (clients < 1) clients = 1;
+    ClientRun *runs = checkedAlloc(calloc(clients, sizeof(ClientRun)));
+    pthread_t *threads = checkedAlloc(calloc(clients, sizeof(pthread_t)));
+    double *latencies = checkedAlloc(calloc((size_t)clients * repeat, sizeof(double)));
+    double start = now();
+    for (int c = 0; c < clients; c++) {
+        runs[c] = (ClientRun){socketPath, message, messageLength, repeat, latencies + (size_t)c * repeat, 0};
+        if (pthread_create(&threads[c], NULL, runClient, &runs[c]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    int failures = 0;
+    for (int c = 0; c < clients; c++) {
+        pthread_join(threads[c], NULL);
+        failures += runs[c].failures;
+    }
+    double elapsed = now() - start;
+
+    size_t count = (size_t)clients * repeat;
+    qsort(latencies, count, sizeof(double), compareDoubles);
+    fprintf(stderr, "%zu requests on %d connections in %.2f s (%.0f/s), %d failed\n",
+            count, clients, elapsed, count / elapsed, failures);
+    fprintf(stderr, "latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            latencies[count / 2], latencies[(size_t)(count * 0.99)], latencies[count - 1]);
+    free(latencies);
+    free(threads);
+    free(runs);
+    free(message);
+    return failures ? 1 : 0;
+}
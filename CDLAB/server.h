@@ -0,0 +1,51 @@
+#ifndef CDLAB_SERVER_H
+#define CDLAB_SERVER_H
+
+#include "cache.h"
+
+// cdlab serve: a daemon that keeps the analyzers, the report cache and a
+// symbol index resident and answers requests on a Unix domain socket, so
+// hooks and editors stop paying process startup and cold tables per call.
+//
+// A request is one line, followed by a body for BUFFER:
+//
+//   ANALYZE <path>                   the file's report, as cdlab prints it
+//   BUFFER <lang> <length> [<name>]  the report for the <length> bytes that
+//                                    follow; <lang> "-" routes by <name>
+//   SYMBOLS <name> [<kind>]          "kind\tname\tparent\tpath" for every
+//                                    analyzed file that defines <name>
+//   STATS                            request count and latency percentiles
+//   SUBSCRIBE                        "OK 0", then change events until the
+//                                    client hangs up (see below)
+//
+// A response is "OK <length>\n" and <length> bytes, or "ERR <message>\n".
+// A connection may send any number of requests and is served on its own
+// thread. ANALYZE resolves the path and replaces that file's entries in the
+// symbol index; BUFFER leaves the index alone, since the text is unsaved.
+//
+// With watch roots, the daemon follows those trees with inotify (watch.h)
+// and re-analyzes each file that settles after a change, so the index
+// stays current without anyone asking. Every update is pushed to the
+// subscribers as "EVENT <length>\n" and <length> bytes: "changed <path>\n"
+// followed by the file's "kind\tname\tparent" lines, or "deleted <path>\n".
+// Events queue for each subscriber and are sent by its own connection
+// thread, so one slow reader delays no one else. A subscriber that falls
+// more than 64 MB behind is disconnected rather than waited for.
+
+// Analyzes `paths` on `jobs` threads to warm the index, then serves until
+// SIGINT or SIGTERM, watching `watchRoots` unless `watchCount` is 0.
+// `cache` may be NULL. Returns 0 after a clean shutdown and 1 if the
+// socket could not be set up.
+int serveSocket(const char *socketPath, Cache *cache, char *const *paths, int pathCount, int jobs,
+                char *const *watchRoots, int watchCount, int debounceMs);
+
+// cdlab client: sends one request and copies the response to stdout. The
+// body of a BUFFER request is read from stdin and its length filled in.
+// With repeat > 1, `clients` connections each send the request `repeat`
+// times and the latency percentiles go to stderr instead. A SUBSCRIBE
+// request prints each event body as it arrives, until the daemon goes
+// away, and fails if the last event was cut short. Returns 0 if every
+// response was OK.
+int clientRequest(const char *socketPath, const char *request, int repeat, int clients);
+
+#endif
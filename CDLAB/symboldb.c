@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../COMMON/alloc.h"
+#include "symboldb.h"
+
+#define SYMBOLDB_MIN_BUCKETS 16
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileCount;
+    uint32_t nameCount;
+    uint32_t symbolCount;
+    uint32_t bucketCount;
+    uint32_t pad;
+    uint64_t filesOffset;
+    uint64_t namesOffset;
+    uint64_t bucketsOffset;
+    uint64_t symbolsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+} SymbolDbHeader;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t text;              // string offset
+    uint32_t length;
+    uint32_t first;             // index of the name's first symbol
+    uint32_t count;
+} SymbolDbName;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t parent;            // string offset
+    uint32_t file;              // index into the file table
+} SymbolDbSymbol;
+
+// A symbol as listed, before the names are laid out
+typedef struct {
+    NameId name;
+    NameId parent;
+    uint32_t kind;
+    uint32_t file;
+} PendingSymbol;
+
+struct SymbolDbWriter {
+    char **paths;
+    uint32_t fileCount;
+    uint32_t fileCapacity;
+    PendingSymbol *symbols;
+    size_t symbolCount;
+    size_t symbolCapacity;
+};
+
+struct SymbolDb {
+    void *map;
+    size_t size;
+    const SymbolDbHeader *header;
+    const uint32_t *files;
+    const SymbolDbName *names;
+    const uint32_t *buckets;
+    const SymbolDbSymbol *symbols;
+    const char *strings;
+};
+
+static uint32_t hashName(const char *text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    return hash;
+}
+
+SymbolDbWriter *symbolDbCreate(void) {
+    return checkedAlloc(calloc(1, sizeof(SymbolDbWriter)));
+}
+
+static uint32_t addPath(SymbolDbWriter *writer, const char *path) {
+    if (writer->fileCount == writer->fileCapacity) {
+        writer->fileCapacity = writer->fileCapacity ? writer->fileCapacity * 2 : 256;
+        writer->paths = checkedAlloc(realloc(writer->paths, writer->fileCapacity * sizeof(char *)));
+    }
+    writer->paths[writer->fileCount] = checkedAlloc(strdup(path));
+    return writer->fileCount++;
+}
+
+static void addSymbol(SymbolDbWriter *writer, uint32_t kind, NameId name, NameId parent, uint32_t file) {
+    if (writer->symbolCount == writer->symbolCapacity) {
+        writer->symbolCapacity = writer->symbolCapacity ? writer->symbolCapacity * 2 : 1024;
+        writer->symbols = checkedAlloc(realloc(writer->symbols, writer->symbolCapacity * sizeof(PendingSymbol)));
+    }
+    PendingSymbol *symbol = &writer->symbols[writer->symbolCount++];
+    symbol->name = name;
+    symbol->parent = parent;
+    symbol->kind = kind;
+    symbol->file = file;
+}
+
+void symbolDbAddFile(SymbolDbWriter *writer, const char *path, const char *listing, size_t length) {
+    uint32_t file = addPath(writer, path);
+
+    const char *end = listing + length;
+    while (listing < end) {
+        const char *newline = memchr(listing, '\n', end - listing);
+        const char *lineEnd = newline ? newline : end;
+        const char *nameStart = memchr(listing, '\t', lineEnd - listing);
+        const char *parentStart = nameStart ? memchr(nameStart + 1, '\t', lineEnd - nameStart - 1) : NULL;
+        char kindName[16];
+        int kind = -1;
+        if (parentStart && (size_t)(nameStart - listing) < sizeof(kindName)) {
+            memcpy(kindName, listing, nameStart - listing);
+            kindName[nameStart - listing] = '\0';
+            kind = symbolKindFind(kindName);
+        }
+        // Lines this version does not know, or unnamed symbols, are skipped
+        if (kind >= 0 && parentStart > nameStart + 1) {
+            addSymbol(writer, kind, internName(nameStart + 1, parentStart - nameStart - 1),
+                      internName(parentStart + 1, lineEnd - parentStart - 1), file);
+        }
+        listing = lineEnd + 1;
+    }
+}
+
+// Offsets were checked against nothing but the strings' size, so a damaged
+// entry reads as "" instead of outside the map
+static const char *stringAt(const SymbolDb *db, uint32_t offset) {
+    return offset < db->header->stringsSize ? db->strings + offset : "";
+}
+
+void symbolDbCopy(SymbolDbWriter *writer, const SymbolDb *db,
+                  int (*keep)(const char *path, void *context), void *context) {
+    const SymbolDbHeader *header = db->header;
+    uint32_t *files = checkedAlloc(malloc((header->fileCount + 1) * sizeof(uint32_t)));
+    for (uint32_t i = 0; i < header->fileCount; i++) {
+        const char *path = stringAt(db, db->files[i]);
+        files[i] = keep(path, context) ? addPath(writer, path) : UINT32_MAX;
+    }
+
+    for (uint32_t n = 0; n < header->nameCount; n++) {
+        const SymbolDbName *name = &db->names[n];
+        if (name->text >= header->stringsSize || name->first > header->symbolCount ||
+            name->count > header->symbolCount - name->first) {
+            continue;
+        }
+        NameId id = NAME_NONE;
+        for (uint32_t i = name->first; i < name->first + name->count; i++) {
+            const SymbolDbSymbol *symbol = &db->symbols[i];
+            if (symbol->file >= header->fileCount || files[symbol->file] == UINT32_MAX ||
+                symbol->kind >= SYMBOL_KIND_COUNT) {
+                continue;
+            }
+            if (id == NAME_NONE) id = internName(db->strings + name->text, strlen(db->strings + name->text));
+            const char *parent = stringAt(db, symbol->parent);
+            addSymbol(writer, symbol->kind, id, internName(parent, strlen(parent)), files[symbol->file]);
+        }
+    }
+    free(files);
+}
+
+// By name text rather than ID, so the file does not depend on the order
+// threads happened to intern names in
+static int comparePending(const void *a, const void *b) {
+    const PendingSymbol *x = a, *y = b;
+    if (x->name != y->name) {
+        int order = strcmp(nameText(x->name), nameText(y->name));
+        if (order) return order;
+    }
+    if (x->kind != y->kind) return x->kind < y->kind ? -1 : 1;
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+    return strcmp(nameText(x->parent), nameText(y->parent));
+}
+
+typedef struct {
+    const char *path;
+    uint32_t file;              // the writer's number for it
+} FileOrder;
+
+static int compareFiles(const void *a, const void *b) {
+    return strcmp(((const FileOrder *)a)->path, ((const FileOrder *)b)->path);
+}
+
+typedef struct {
+    char *text;
+    size_t used;
+    size_t capacity;
+} StringTable;
+
+static uint32_t addString(StringTable *table, const char *text, size_t length) {
+    if (table->used + length + 1 > table->capacity) {
+        while (table->used + length + 1 > table->capacity) {
+            table->capacity = table->capacity ? table->capacity * 2 : 64 * 1024;
+        }
+        table->text = checkedAlloc(realloc(table->text, table->capacity));
+    }
+    uint32_t offset = table->used;
+    memcpy(table->text + table->used, text, length);
+    table->text[table->used + length] = '\0';
+    table->used += length + 1;
+    return offset;
+}
+
+// Each name's text is stored once, however many symbols use it
+static uint32_t nameOffset(StringTable *table, uint32_t *offsets, NameId id) {
+    if (id == NAME_EMPTY) return 0;
+    if (!offsets[id]) offsets[id] = addString(table, nameText(id), nameLength(id));
+    return offsets[id];
+}
+
+static void freeWriter(SymbolDbWriter *writer) {
+    for (uint32_t i = 0; i < writer->fileCount; i++) free(writer->paths[i]);
+    free(writer->paths);
+    free(writer->symbols);
+    free(writer);
+}
+
+static int writeSection(FILE *out, const void *data, size_t size) {
+    return size == 0 || fwrite(data, 1, size, out) == size;
+}
+
+int symbolDbWrite(SymbolDbWriter *writer, const char *path) {
+    if (writer->symbolCount > UINT32_MAX) {
+        fprintf(stderr, "%s: too many symbols\n", path);
+        freeWriter(writer);
+        return -1;
+    }
+    // Files are listed by path, so a patched database comes out the same as
+    // one written from scratch
+    FileOrder *order = checkedAlloc(malloc((writer->fileCount + 1) * sizeof(FileOrder)));
+    uint32_t *renumber = checkedAlloc(malloc((writer->fileCount + 1) * sizeof(uint32_t)));
+    for (uint32_t i = 0; i < writer->fileCount; i++) {
+        order[i].path = writer->paths[i];
+        order[i].file = i;
+    }
+    qsort(order, writer->fileCount, sizeof(FileOrder), compareFiles);
+    for (uint32_t i = 0; i < writer->fileCount; i++) renumber[order[i].file] = i;
+    for (size_t i = 0; i < writer->symbolCount; i++) writer->symbols[i].file = renumber[writer->symbols[i].file];
+    qsort(writer->symbols, writer->symbolCount, sizeof(PendingSymbol), comparePending);
+
+    StringTable strings = {0};
+    addString(&strings, "", 0);
+    uint32_t *files = checkedAlloc(malloc((writer->fileCount + 1) * sizeof(uint32_t)));
+    for (uint32_t i = 0; i < writer->fileCount; i++) {
+        files[i] = addString(&strings, order[i].path, strlen(order[i].path));
+    }
+    free(order);
+    free(renumber);
+
+    // The symbols are grouped by name now, so each group becomes one name
+    NameId maxId = 0;
+    for (size_t i = 0; i < writer->symbolCount; i++) {
+        if (writer->symbols[i].name > maxId) maxId = writer->symbols[i].name;
+        if (writer->symbols[i].parent > maxId) maxId = writer->symbols[i].parent;
+    }
+    uint32_t *offsets = checkedAlloc(calloc((size_t)maxId + 1, sizeof(uint32_t)));
+    SymbolDbName *names = checkedAlloc(malloc((writer->symbolCount + 1) * sizeof(SymbolDbName)));
+    SymbolDbSymbol *symbols = checkedAlloc(malloc((writer->symbolCount + 1) * sizeof(SymbolDbSymbol)));
+    uint32_t nameCount = 0;
+    for (size_t i = 0; i < writer->symbolCount; i++) {
+        const PendingSymbol *pending = &writer->symbols[i];
+        if (i == 0 || pending->name != writer->symbols[i - 1].name) {
+            SymbolDbName *name = &names[nameCount++];
+            name->text = nameOffset(&strings, offsets, pending->name);
+            name->length = nameLength(pending->name);
+            name->hash = hashName(nameText(pending->name), name->length);
+            name->first = i;
+            name->count = 0;
+        }
+        names[nameCount - 1].count++;
+        symbols[i].kind = pending->kind;
+        symbols[i].parent = nameOffset(&strings, offsets, pending->parent);
+        symbols[i].file = pending->file;
+    }
+    free(offsets);
+
+    uint32_t bucketCount = SYMBOLDB_MIN_BUCKETS;
+    while (bucketCount < (uint64_t)nameCount * 2) bucketCount *= 2;
+    uint32_t *buckets = checkedAlloc(calloc(bucketCount, sizeof(uint32_t)));
+    for (uint32_t i = 0; i < nameCount; i++) {
+        uint32_t slot = names[i].hash & (bucketCount - 1);
+        while (buckets[slot]) slot = (slot + 1) & (bucketCount - 1);
+        buckets[slot] = i + 1;
+    }
+
+    SymbolDbHeader header = {.magic = SYMBOLDB_MAGIC, .version = SYMBOLDB_VERSION};
+    header.fileCount = writer->fileCount;
+    header.nameCount = nameCount;
+    header.symbolCount = writer->symbolCount;
+    header.bucketCount = bucketCount;
+    header.filesOffset = sizeof(header);
+    header.namesOffset = header.filesOffset + (uint64_t)header.fileCount * sizeof(uint32_t);
+    header.bucketsOffset = header.namesOffset + (uint64_t)nameCount * sizeof(SymbolDbName);
+    header.symbolsOffset = header.bucketsOffset + (uint64_t)bucketCount * sizeof(uint32_t);
+    header.stringsOffset = header.symbolsOffset + (uint64_t)header.symbolCount * sizeof(SymbolDbSymbol);
+    header.stringsSize = strings.used;
+
+    int status = -1;
+    if (strings.used > UINT32_MAX) {
+        fprintf(stderr, "%s: names and paths exceed 4 GB\n", path);
+        goto done;
+    }
+
+    // Written beside the old database and renamed over it, so that readers
+    // mapping the old one are not disturbed
+    char temporary[4096];
+    if (snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path) >= (int)sizeof(temporary)) {
+        fprintf(stderr, "%s: path too long\n", path);
+        goto done;
+    }
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        perror(temporary);
+        goto done;
+    }
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    FILE *out = fdopen(fd, "wb");
+    if (!out) {
+        perror(temporary);
+        close(fd);
+        unlink(temporary);
+        goto done;
+    }
+    int written = writeSection(out, &header, sizeof(header)) &&
+                  writeSection(out, files, (size_t)header.fileCount * sizeof(uint32_t)) &&
+                  writeSection(out, names, (size_t)nameCount * sizeof(SymbolDbName)) &&
+                  writeSection(out, buckets, (size_t)bucketCount * sizeof(uint32_t)) &&
+                  writeSection(out, symbols, (size_t)header.symbolCount * sizeof(SymbolDbSymbol)) &&
+                  writeSection(out, strings.text, strings.used);
+    if (fclose(out) != 0) written = 0;
+    if (!written) {
+        perror(temporary);
+        unlink(temporary);
+    } else if (rename(temporary, path) != 0) {
+        perror(path);
+        unlink(temporary);
+    } else {
+        status = 0;
+    }
+
+done:
+    free(strings.text);
+    free(files);
+    free(names);
+    free(symbols);
+    free(buckets);
+    freeWriter(writer);
+    return status;
+}
+
+// Whether a section of `count` items of `size` bytes lies inside the file
+static int sectionFits(const SymbolDb *db, uint64_t offset, uint64_t count, size_t size) {
+    return offset <= db->size && count <= (db->size - offset) / size;
+}
+
+SymbolDb *symbolDbOpen(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(SymbolDbHeader)) {
+        fprintf(stderr, "%s: not a symbol database\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+    // Lookups jump straight to a bucket, so reading ahead is wasted
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    SymbolDb *db = checkedAlloc(malloc(sizeof(SymbolDb)));
+    db->map = map;
+    db->size = st.st_size;
+    const SymbolDbHeader *header = db->header = map;
+    if (memcmp(header->magic, SYMBOLDB_MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "%s: not a symbol database\n", path);
+        symbolDbClose(db);
+        return NULL;
+    }
+    if (header->version != SYMBOLDB_VERSION) {
+        fprintf(stderr, "%s: symbol database version %u, expected %d; rebuild it\n",
+                path, header->version, SYMBOLDB_VERSION);
+        symbolDbClose(db);
+        return NULL;
+    }
+    if (header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) ||
+        header->bucketCount <= header->nameCount ||
+        !sectionFits(db, header->filesOffset, header->fileCount, sizeof(uint32_t)) ||
+        !sectionFits(db, header->namesOffset, header->nameCount, sizeof(SymbolDbName)) ||
+        !sectionFits(db, header->bucketsOffset, header->bucketCount, sizeof(uint32_t)) ||
+        !sectionFits(db, header->symbolsOffset, header->symbolCount, sizeof(SymbolDbSymbol)) ||
+        header->stringsSize == 0 || !sectionFits(db, header->stringsOffset, header->stringsSize, 1) ||
+        ((const char *)map)[header->stringsOffset + header->stringsSize - 1] != '\0') {
+        fprintf(stderr, "%s: symbol database is damaged; rebuild it\n", path);
+        symbolDbClose(db);
+        return NULL;
+    }
+    db->files = (const uint32_t *)((const char *)map + header->filesOffset);
+    db->names = (const SymbolDbName *)((const char *)map + header->namesOffset);
+    db->buckets = (const uint32_t *)((const char *)map + header->bucketsOffset);
+    db->symbols = (const SymbolDbSymbol *)((const char *)map + header->symbolsOffset);
+    db->strings = (const char *)map + header->stringsOffset;
+    return db;
+}
+
+void symbolDbClose(SymbolDb *db) {
+    if (!db) return;
+    munmap(db->map, db->size);
+    free(db);
+}
+
+int symbolDbLookup(const SymbolDb *db, const char *name, int kind, SymbolDbVisitor visit, void *context) {
+    const SymbolDbHeader *header = db->header;
+    size_t length = strlen(name);
+    uint32_t hash = hashName(name, length);
+    uint32_t mask = header->bucketCount - 1;
+
+    const SymbolDbName *found = NULL;
+    for (uint32_t slot = hash & mask, probes = 0; probes < header->bucketCount; slot = (slot + 1) & mask, probes++) {
+        uint32_t index = db->buckets[slot];
+        if (index == 0 || index > header->nameCount) break;
+        const SymbolDbName *entry = &db->names[index - 1];
+        if (entry->hash == hash && entry->length == length &&
+            entry->text < header->stringsSize && length < header->stringsSize - entry->text &&
+            memcmp(db->strings + entry->text, name, length) == 0) {
+            found = entry;
+            break;
+        }
+    }
+    if (!found || found->first > header->symbolCount || found->count > header->symbolCount - found->first) {
+        return 0;
+    }
+
+    int matches = 0;
+    const SymbolDbSymbol *symbol = &db->symbols[found->first];
+    for (uint32_t i = 0; i < found->count; i++, symbol++) {
+        if (kind >= 0 && symbol->kind != (uint32_t)kind) {
+            if (symbol->kind > (uint32_t)kind) break;   // runs are sorted by kind
+            continue;
+        }
+        if (symbol->kind >= SYMBOL_KIND_COUNT || symbol->file >= header->fileCount) continue;
+        SymbolDbMatch match = {
+            symbol->kind, db->strings + found->text, stringAt(db, symbol->parent),
+            stringAt(db, db->files[symbol->file])
+        };
+        visit(&match, context);
+        matches++;
+    }
+    return matches;
+}
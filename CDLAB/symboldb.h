@@ -0,0 +1,75 @@
+#ifndef CDLAB_SYMBOLDB_H
+#define CDLAB_SYMBOLDB_H
+
+#include <stddef.h>
+
+#include "../COMMON/symbols.h"
+
+// A persistent cross-file symbol database, written by "cdlab --symbols-db"
+// from every analyzer's listSymbols() and read by "cdlab lookup". It is
+// laid out to be used straight from mmap: a lookup hashes the name, probes
+// the bucket array and reads that name's run of symbols, touching a few
+// pages however large the database is. Nothing is parsed or loaded when it
+// is opened.
+//
+// Layout (integers are native-endian uint32 unless noted; offsets in the
+// header are uint64 bytes from the start of the file):
+//
+//   header   "CDSYMDB\0" version fileCount nameCount symbolCount
+//            bucketCount pad filesOffset namesOffset bucketsOffset
+//            symbolsOffset stringsOffset stringsSize
+//   files    path*fileCount                        string offsets
+//   names    (hash text length first count)*nameCount
+//   buckets  (name index + 1, or 0 if free)*bucketCount
+//   symbols  (kind parent file)*symbolCount
+//   strings  NUL-terminated names and paths; offset 0 is ""
+//
+// bucketCount is a power of two and at most half full; names are probed
+// linearly from hash & (bucketCount - 1), with FNV-1a as the hash. A
+// name's symbols are symbols[first .. first + count), sorted by kind and
+// then by file, so a lookup by name and kind stops at the end of its kind.
+// The file is replaced by rename, so a reader never sees it half written.
+#define SYMBOLDB_MAGIC "CDSYMDB"
+#define SYMBOLDB_VERSION 1
+
+typedef struct SymbolDbWriter SymbolDbWriter;
+typedef struct SymbolDb SymbolDb;
+
+// One match, pointing into the mapped file
+typedef struct {
+    SymbolKind kind;
+    const char *name;
+    const char *parent;         // "" for top-level symbols
+    const char *path;
+} SymbolDbMatch;
+
+typedef void (*SymbolDbVisitor)(const SymbolDbMatch *match, void *context);
+
+// Allocation failures print an error and exit
+SymbolDbWriter *symbolDbCreate(void);
+
+// Adds one file's symbols, as a listing of "kind\tname\tparent\n" lines
+// (see report.h)
+void symbolDbAddFile(SymbolDbWriter *writer, const char *path, const char *listing, size_t length);
+
+// Adds every symbol of an open database whose file `keep` accepts, so a
+// database can be patched: copy the files that did not change, then add
+// the ones that did
+void symbolDbCopy(SymbolDbWriter *writer, const SymbolDb *db,
+                  int (*keep)(const char *path, void *context), void *context);
+
+// Writes the database to `path` and frees the writer. Returns 0, or -1
+// after printing why.
+int symbolDbWrite(SymbolDbWriter *writer, const char *path);
+
+// Returns NULL (after printing why) if the file is missing or not a
+// database of this version
+SymbolDb *symbolDbOpen(const char *path);
+void symbolDbClose(SymbolDb *db);
+
+// Calls `visit` for every symbol called `name`, only those of `kind`
+// unless it is -1. Returns the number of matches. Safe to call from
+// several threads.
+int symbolDbLookup(const SymbolDb *db, const char *name, int kind, SymbolDbVisitor visit, void *context);
+
+#endif
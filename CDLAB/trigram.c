@@ -0,0 +1,667 @@
+#define _GNU_SOURCE             // memmem
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../COMMON/alloc.h"
+#include "../COMMON/tokenstream.h"
+#include "languages.h"
+#include "pool.h"
+#include "trigram.h"
+
+#define TRIGRAM_SPACE (1 << 24)
+#define TRIGRAM_FIRST_SLOTS 4096
+#define TRIGRAM_MAX_TYPES 64
+
+// Token types that are not names or strings, by their name in the tables
+static const char *const skippedTypes[] = {
+    "KEYWORD", "OPERATOR", "NUMERIC CONSTANT", "SPECIAL SYMBOL",
+    "PIPE", "REDIRECTION", "MATRIX OPERATOR", "COMMENT"
+};
+#define SKIPPED_TYPES_COUNT (sizeof(skippedTypes) / sizeof(skippedTypes[0]))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileCount;
+    uint32_t trigramCount;
+    uint32_t pad;
+    uint64_t filesOffset;
+    uint64_t trigramsOffset;
+    uint64_t postingsOffset;
+    uint64_t postingsSize;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+} TrigramHeader;
+
+typedef struct {
+    uint32_t path;              // string offsets
+    uint32_t language;
+} TrigramFile;
+
+typedef struct {
+    uint32_t trigram;
+    uint32_t fileCount;
+    uint64_t postings;          // offset into the postings
+} TrigramEntry;
+
+// Which of a table's token types are indexed, worked out once per table
+typedef struct {
+    const TokenFormat *format;
+    unsigned char indexed[TRIGRAM_MAX_TYPES];
+} TypeFilter;
+
+// One trigram's posting list while the index is built, already compressed
+typedef struct {
+    uint32_t trigram;
+    uint32_t fileCount;         // 0 if the slot is free
+    uint32_t lastFile;
+    uint32_t used;
+    uint32_t capacity;
+    unsigned char *bytes;
+} PostingBuilder;
+
+typedef struct {
+    uint64_t *seen;             // bit per trigram, set for the current file
+    uint32_t *found;            // the trigrams set in `seen`
+    size_t count;
+    size_t capacity;
+    TypeFilter filter;
+} IndexWorker;
+
+typedef struct {
+    char *const *paths;
+    const char *forced;
+    IndexWorker *workers;
+    pthread_mutex_t lock;       // guards everything below
+    PostingBuilder *slots;
+    size_t slotCount;
+    size_t used;
+    const char **filePaths;     // by file number
+    const char **fileLanguages;
+    uint32_t fileCount;
+    int failed;
+} IndexBuild;
+
+typedef struct {
+    void *map;
+    size_t size;
+    const TrigramHeader *header;
+    const TrigramFile *files;
+    const TrigramEntry *trigrams;
+    const unsigned char *postings;
+    const char *strings;
+} TrigramIndex;
+
+// Per candidate file while a search confirms it
+typedef struct {
+    const char *query;
+    size_t queryLength;
+    int ignoreCase;
+    const char *path;
+    FILE *out;
+    int matches;
+    size_t passed;              // tokens starting before this were seen already
+    size_t lineOffset;          // line counting resumes from here
+    int line;
+    TypeFilter filter;
+} SearchFile;
+
+typedef struct {
+    const TrigramIndex *index;
+    const uint32_t *candidates;
+    const char *query;
+    int ignoreCase;
+    char **results;             // by candidate
+    size_t *resultLengths;
+    int *matches;
+} Search;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline unsigned char foldByte(unsigned char byte) {
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+static inline uint32_t trigramAt(const char *text) {
+    return (uint32_t)foldByte(text[0]) << 16 | (uint32_t)foldByte(text[1]) << 8 | foldByte(text[2]);
+}
+
+static int typeIndexed(TypeFilter *filter, const TokenFormat *format, int type) {
+    if (!format) return 0;
+    if (filter->format != format) {
+        filter->format = format;
+        for (int i = 0; i < TRIGRAM_MAX_TYPES; i++) {
+            const char *name = i < format->typeCount ? format->typeNames[i] : NULL;
+            filter->indexed[i] = name != NULL;
+            for (size_t s = 0; name && s < SKIPPED_TYPES_COUNT; s++) {
+                if (strcmp(name, skippedTypes[s]) == 0) filter->indexed[i] = 0;
+            }
+        }
+    }
+    return type >= 0 && type < TRIGRAM_MAX_TYPES && filter->indexed[type];
+}
+
+static void addTrigrams(IndexWorker *worker, const char *text, size_t length) {
+    for (size_t i = 0; i + 3 <= length; i++) {
+        uint32_t trigram = trigramAt(text + i);
+        uint64_t bit = 1ULL << (trigram & 63);
+        if (worker->seen[trigram >> 6] & bit) continue;
+        worker->seen[trigram >> 6] |= bit;
+        if (worker->count == worker->capacity) {
+            worker->capacity = worker->capacity ? worker->capacity * 2 : 4096;
+            worker->found = checkedAlloc(realloc(worker->found, worker->capacity * sizeof(uint32_t)));
+        }
+        worker->found[worker->count++] = trigram;
+    }
+}
+
+static void collectTrigrams(const Input *in, const Token *token, const TokenFormat *format, void *context) {
+    IndexWorker *worker = context;
+    if (token->length < 3 || !typeIndexed(&worker->filter, format, token->type)) return;
+    addTrigrams(worker, tokenText(in, token), token->length);
+}
+
+static void collectSymbol(const Symbol *symbol, void *context) {
+    IndexWorker *worker = context;
+    addTrigrams(worker, nameText(symbol->name), nameLength(symbol->name));
+    addTrigrams(worker, nameText(symbol->parent), nameLength(symbol->parent));
+}
+
+static int compareTrigrams(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void growSlots(IndexBuild *build) {
+    PostingBuilder *old = build->slots;
+    size_t oldCount = build->slotCount;
+    build->slotCount = oldCount ? oldCount * 2 : TRIGRAM_FIRST_SLOTS;
+    build->slots = checkedAlloc(calloc(build->slotCount, sizeof(PostingBuilder)));
+    size_t mask = build->slotCount - 1;
+    for (size_t i = 0; i < oldCount; i++) {
+        if (!old[i].fileCount) continue;
+        size_t j = (old[i].trigram * 2654435761u) & mask;
+        while (build->slots[j].fileCount) j = (j + 1) & mask;
+        build->slots[j] = old[i];
+    }
+    free(old);
+}
+
+static void addPosting(IndexBuild *build, uint32_t trigram, uint32_t file) {
+    if ((build->used + 1) * 2 > build->slotCount) growSlots(build);
+    size_t mask = build->slotCount - 1;
+    size_t i = (trigram * 2654435761u) & mask;
+    while (build->slots[i].fileCount && build->slots[i].trigram != trigram) i = (i + 1) & mask;
+    PostingBuilder *list = &build->slots[i];
+    if (!list->fileCount) {
+        list->trigram = trigram;
+        build->used++;
+    }
+
+    // Files are numbered as they finish, so each list only grows upwards
+    uint32_t gap = list->fileCount ? file - list->lastFile : file;
+    if (list->capacity - list->used < 5) {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->bytes = checkedAlloc(realloc(list->bytes, list->capacity));
+    }
+    while (gap >= 0x80) {
+        list->bytes[list->used++] = (unsigned char)(gap | 0x80);
+        gap >>= 7;
+    }
+    list->bytes[list->used++] = (unsigned char)gap;
+    list->lastFile = file;
+    list->fileCount++;
+}
+
+static void indexTask(int task, int worker, void *context) {
+    IndexBuild *build = context;
+    IndexWorker *state = &build->workers[worker];
+    const char *path = build->paths[task];
+    const Analyzer *analyzer = build->forced ? findLanguage(build->forced) : routeByExtension(path);
+    if (!analyzer || access(path, R_OK) != 0) {
+        if (analyzer) perror(path);
+        else fprintf(stderr, "No analyzer for %s (use --lang)\n", path);
+        pthread_mutex_lock(&build->lock);
+        build->failed = 1;
+        pthread_mutex_unlock(&build->lock);
+        return;
+    }
+
+    TokenStream stream;
+    streamOpen(&stream, NULL, STREAM_TEXT);
+    stream.visit = collectTrigrams;
+    stream.visitContext = state;
+    lexWatch = &stream;
+    int status = analyzer->analyzeFile(path, &stream);
+    lexWatch = NULL;
+    streamClose(&stream);
+    if (analyzer->listSymbols) analyzer->listSymbols(collectSymbol, state);
+    if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+
+    qsort(state->found, state->count, sizeof(uint32_t), compareTrigrams);
+    for (size_t i = 0; i < state->count; i++) {
+        state->seen[state->found[i] >> 6] &= ~(1ULL << (state->found[i] & 63));
+    }
+
+    pthread_mutex_lock(&build->lock);
+    if (status != 0) {
+        build->failed = 1;
+        pthread_mutex_unlock(&build->lock);
+        state->count = 0;
+        return;
+    }
+    uint32_t file = build->fileCount++;
+    build->filePaths[file] = path;
+    build->fileLanguages[file] = build->forced ? build->forced : languages[languageIndex(analyzer)].key;
+    for (size_t i = 0; i < state->count; i++) addPosting(build, state->found[i], file);
+    pthread_mutex_unlock(&build->lock);
+    state->count = 0;
+}
+
+typedef struct {
+    char *text;
+    size_t used;
+    size_t capacity;
+} StringTable;
+
+static uint32_t addString(StringTable *table, const char *text) {
+    size_t length = strlen(text);
+    if (table->used + length + 1 > table->capacity) {
+        while (table->used + length + 1 > table->capacity) {
+            table->capacity = table->capacity ? table->capacity * 2 : 64 * 1024;
+        }
+        table->text = checkedAlloc(realloc(table->text, table->capacity));
+    }
+    uint32_t offset = table->used;
+    memcpy(table->text + table->used, text, length + 1);
+    table->used += length + 1;
+    return offset;
+}
+
+static int compareBuilders(const void *a, const void *b) {
+    const PostingBuilder *x = a, *y = b;
+    return x->trigram < y->trigram ? -1 : x->trigram > y->trigram;
+}
+
+static int writeSection(FILE *out, const void *data, size_t size) {
+    return size == 0 || fwrite(data, 1, size, out) == size;
+}
+
+// Packs the posting lists and writes them beside the old index, renaming
+// over it so that searches already running keep their map
+static int writeIndex(IndexBuild *build, const char *indexPath) {
+    size_t count = 0;
+    for (size_t i = 0; i < build->slotCount; i++) {
+        if (build->slots[i].fileCount) build->slots[count++] = build->slots[i];
+    }
+    qsort(build->slots, count, sizeof(PostingBuilder), compareBuilders);
+
+    StringTable strings = {0};
+    addString(&strings, "");
+    TrigramFile *files = checkedAlloc(malloc((build->fileCount + 1) * sizeof(TrigramFile)));
+    for (uint32_t i = 0; i < build->fileCount; i++) {
+        files[i].path = addString(&strings, build->filePaths[i]);
+        files[i].language = addString(&strings, build->fileLanguages[i]);
+    }
+    TrigramEntry *entries = checkedAlloc(malloc((count + 1) * sizeof(TrigramEntry)));
+    uint64_t postingsSize = 0;
+    for (size_t i = 0; i < count; i++) {
+        entries[i].trigram = build->slots[i].trigram;
+        entries[i].fileCount = build->slots[i].fileCount;
+        entries[i].postings = postingsSize;
+        postingsSize += build->slots[i].used;
+    }
+
+    TrigramHeader header = {.magic = TRIGRAM_MAGIC, .version = TRIGRAM_VERSION};
+    header.fileCount = build->fileCount;
+    header.trigramCount = count;
+    header.filesOffset = sizeof(header);
+    header.trigramsOffset = header.filesOffset + (uint64_t)build->fileCount * sizeof(TrigramFile);
+    header.postingsOffset = header.trigramsOffset + (uint64_t)count * sizeof(TrigramEntry);
+    header.postingsSize = postingsSize;
+    header.stringsOffset = header.postingsOffset + postingsSize;
+    header.stringsSize = strings.used;
+
+    int status = 1;
+    char temporary[4096];
+    if (strings.used > UINT32_MAX) {
+        fprintf(stderr, "%s: paths exceed 4 GB\n", indexPath);
+        goto done;
+    }
+    if (snprintf(temporary, sizeof(temporary), "%s.XXXXXX", indexPath) >= (int)sizeof(temporary)) {
+        fprintf(stderr, "%s: path too long\n", indexPath);
+        goto done;
+    }
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        perror(temporary);
+        goto done;
+    }
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    FILE *out = fdopen(fd, "wb");
+    if (!out) {
+        perror(temporary);
+        close(fd);
+        unlink(temporary);
+        goto done;
+    }
+    int written = writeSection(out, &header, sizeof(header)) &&
+                  writeSection(out, files, (size_t)build->fileCount * sizeof(TrigramFile)) &&
+                  writeSection(out, entries, count * sizeof(TrigramEntry));
+    for (size_t i = 0; written && i < count; i++) {
+        written = writeSection(out, build->slots[i].bytes, build->slots[i].used);
+    }
+    written = written && writeSection(out, strings.text, strings.used);
+    if (fclose(out) != 0) written = 0;
+    if (!written) {
+        perror(temporary);
+        unlink(temporary);
+    } else if (rename(temporary, indexPath) != 0) {
+        perror(indexPath);
+        unlink(temporary);
+    } else {
+        status = 0;
+        fprintf(stderr, "Indexed %u files, %zu trigrams, %llu bytes of postings\n",
+                build->fileCount, count, (unsigned long long)postingsSize);
+    }
+
+done:
+    for (size_t i = 0; i < count; i++) free(build->slots[i].bytes);
+    free(strings.text);
+    free(files);
+    free(entries);
+    return status;
+}
+
+int trigramBuild(const char *indexPath, char *const *paths, int pathCount, int jobs,
+                 const char *forced) {
+    double start = now();
+    IndexBuild build = {0};
+    build.paths = paths;
+    build.forced = forced;
+    pthread_mutex_init(&build.lock, NULL);
+    build.workers = checkedAlloc(calloc(jobs, sizeof(IndexWorker)));
+    for (int i = 0; i < jobs; i++) {
+        build.workers[i].seen = checkedAlloc(calloc(TRIGRAM_SPACE / 64, sizeof(uint64_t)));
+    }
+    build.filePaths = checkedAlloc(malloc((pathCount + 1) * sizeof(char *)));
+    build.fileLanguages = checkedAlloc(malloc((pathCount + 1) * sizeof(char *)));
+    growSlots(&build);
+
+    poolRun(jobs, pathCount, indexTask, &build);
+    int status = writeIndex(&build, indexPath) || build.failed;
+    fprintf(stderr, "Index built in %.2f s\n", now() - start);
+
+    for (int i = 0; i < jobs; i++) {
+        free(build.workers[i].seen);
+        free(build.workers[i].found);
+    }
+    free(build.workers);
+    free(build.slots);
+    free(build.filePaths);
+    free(build.fileLanguages);
+    pthread_mutex_destroy(&build.lock);
+    return status;
+}
+
+static void closeIndex(TrigramIndex *index) {
+    munmap(index->map, index->size);
+}
+
+// Whether a section of `count` items of `size` bytes lies inside the file
+static int sectionFits(const TrigramIndex *index, uint64_t offset, uint64_t count, size_t size) {
+    return offset <= index->size && count <= (index->size - offset) / size;
+}
+
+static int openIndex(TrigramIndex *index, const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(TrigramHeader)) {
+        fprintf(stderr, "%s: not a trigram index\n", path);
+        close(fd);
+        return -1;
+    }
+    index->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (index->map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    index->size = st.st_size;
+
+    const TrigramHeader *header = index->header = index->map;
+    const char *base = index->map;
+    const char *problem = NULL;
+    if (memcmp(header->magic, TRIGRAM_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a trigram index";
+    } else if (header->version != TRIGRAM_VERSION) {
+        problem = "trigram index of another version; rebuild it";
+    } else if (!sectionFits(index, header->filesOffset, header->fileCount, sizeof(TrigramFile)) ||
+               !sectionFits(index, header->trigramsOffset, header->trigramCount, sizeof(TrigramEntry)) ||
+               !sectionFits(index, header->postingsOffset, header->postingsSize, 1) ||
+               header->stringsSize == 0 || !sectionFits(index, header->stringsOffset, header->stringsSize, 1) ||
+               base[header->stringsOffset + header->stringsSize - 1] != '\0') {
+        problem = "trigram index is damaged; rebuild it";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        closeIndex(index);
+        return -1;
+    }
+    index->files = (const TrigramFile *)(base + header->filesOffset);
+    index->trigrams = (const TrigramEntry *)(base + header->trigramsOffset);
+    index->postings = (const unsigned char *)(base + header->postingsOffset);
+    index->strings = base + header->stringsOffset;
+    return 0;
+}
+
+static const char *indexString(const TrigramIndex *index, uint32_t offset) {
+    return offset < index->header->stringsSize ? index->strings + offset : "";
+}
+
+static const TrigramEntry *findTrigram(const TrigramIndex *index, uint32_t trigram) {
+    size_t low = 0, high = index->header->trigramCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        uint32_t found = index->trigrams[middle].trigram;
+        if (found == trigram) return &index->trigrams[middle];
+        if (found < trigram) low = middle + 1;
+        else high = middle;
+    }
+    return NULL;
+}
+
+// Decodes a posting list into `files`, which has room for entry->fileCount.
+// Returns how many were decoded; a damaged list stops early.
+static uint32_t decodePostings(const TrigramIndex *index, const TrigramEntry *entry, uint32_t *files) {
+    uint64_t position = entry->postings, end = index->header->postingsSize;
+    uint32_t file = 0, count = 0;
+    while (count < entry->fileCount && position < end) {
+        uint32_t gap = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = index->postings[position++];
+            if (shift < 32) gap |= (uint32_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && position < end);
+        file = count ? file + gap : gap;
+        files[count++] = file;
+    }
+    return count;
+}
+
+static int compareEntries(const void *a, const void *b) {
+    const TrigramEntry *x = *(const TrigramEntry *const *)a, *y = *(const TrigramEntry *const *)b;
+    return x->fileCount < y->fileCount ? -1 : x->fileCount > y->fileCount;
+}
+
+// The files that contain every trigram of the query, rarest trigram first
+// so the candidate list only shrinks. Returns the count, or every file if
+// the query is too short to have trigrams.
+static uint32_t findCandidates(const TrigramIndex *index, const char *query, uint32_t **result) {
+    size_t length = strlen(query);
+    size_t trigramCount = length >= 3 ? length - 2 : 0;
+    const TrigramEntry **entries = checkedAlloc(malloc((trigramCount + 1) * sizeof(TrigramEntry *)));
+    for (size_t i = 0; i < trigramCount; i++) {
+        entries[i] = findTrigram(index, trigramAt(query + i));
+        if (!entries[i]) {
+            free(entries);
+            *result = NULL;
+            return 0;
+        }
+    }
+    qsort(entries, trigramCount, sizeof(TrigramEntry *), compareEntries);
+
+    uint32_t count;
+    uint32_t *candidates;
+    if (trigramCount == 0) {
+        count = index->header->fileCount;
+        candidates = checkedAlloc(malloc((count + 1) * sizeof(uint32_t)));
+        for (uint32_t i = 0; i < count; i++) candidates[i] = i;
+    } else {
+        candidates = checkedAlloc(malloc((entries[0]->fileCount + 1) * sizeof(uint32_t)));
+        count = decodePostings(index, entries[0], candidates);
+    }
+
+    uint32_t *list = NULL;
+    size_t listCapacity = 0;
+    for (size_t t = 1; t < trigramCount && count > 0; t++) {
+        if (entries[t] == entries[t - 1]) continue;
+        if (entries[t]->fileCount > listCapacity) {
+            listCapacity = entries[t]->fileCount;
+            list = checkedAlloc(realloc(list, listCapacity * sizeof(uint32_t)));
+        }
+        uint32_t listCount = decodePostings(index, entries[t], list);
+        uint32_t kept = 0, j = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            while (j < listCount && list[j] < candidates[i]) j++;
+            if (j == listCount) break;
+            if (list[j] == candidates[i]) candidates[kept++] = candidates[i];
+        }
+        count = kept;
+    }
+    free(list);
+    free(entries);
+    *result = candidates;
+    return count;
+}
+
+static int containsQuery(const char *text, size_t length, const char *query, size_t queryLength,
+                         int ignoreCase) {
+    if (!ignoreCase) return memmem(text, length, query, queryLength) != NULL;
+    for (size_t i = 0; i + queryLength <= length; i++) {
+        size_t j = 0;
+        while (j < queryLength && foldByte(text[i + j]) == foldByte(query[j])) j++;
+        if (j == queryLength) return 1;
+    }
+    return 0;
+}
+
+static void matchToken(const Input *in, const Token *token, const TokenFormat *format, void *context) {
+    SearchFile *file = context;
+    if (token->offset < file->passed) return;
+    file->passed = token->offset + 1;
+    if (!typeIndexed(&file->filter, format, token->type)) return;
+    const char *text = tokenText(in, token);
+    if (!containsQuery(text, token->length, file->query, file->queryLength, file->ignoreCase)) return;
+
+    // Tokens normally arrive in order, so lines are counted only once
+    if (token->offset < file->lineOffset) {
+        file->lineOffset = 0;
+        file->line = 1;
+    }
+    for (size_t i = file->lineOffset; i < token->offset; i++) file->line += in->data[i] == '\n';
+    file->lineOffset = token->offset;
+
+    fprintf(file->out, "%s:%d\t", file->path, file->line);
+    for (size_t i = 0; i < token->length; i++) {
+        fputc(text[i] == '\t' || text[i] == '\n' || text[i] == '\r' ? ' ' : text[i], file->out);
+    }
+    fprintf(file->out, "\t%s\n", format->typeNames[token->type]);
+    file->matches++;
+}
+
+static void searchTask(int task, int worker, void *context) {
+    (void)worker;               // each candidate writes to its own result
+    Search *search = context;
+    const TrigramIndex *index = search->index;
+    const TrigramFile *entry = &index->files[search->candidates[task]];
+    const char *path = indexString(index, entry->path);
+    const Analyzer *analyzer = findLanguage(indexString(index, entry->language));
+    if (!analyzer) return;
+
+    SearchFile file = {.query = search->query, .queryLength = strlen(search->query),
+                       .ignoreCase = search->ignoreCase, .path = path, .line = 1};
+    file.out = open_memstream(&search->results[task], &search->resultLengths[task]);
+    if (!file.out) {
+        perror("open_memstream");
+        return;
+    }
+    TokenStream stream;
+    streamOpen(&stream, NULL, STREAM_TEXT);
+    stream.visit = matchToken;
+    stream.visitContext = &file;
+    lexWatch = &stream;
+    analyzer->analyzeFile(path, &stream);
+    lexWatch = NULL;
+    streamClose(&stream);
+    if (analyzer->resetSymbolTable) analyzer->resetSymbolTable();
+    fclose(file.out);
+    search->matches[task] = file.matches;
+}
+
+int trigramSearch(const char *indexPath, const char *query, int ignoreCase, int jobs) {
+    double start = now();
+    TrigramIndex index;
+    if (openIndex(&index, indexPath) != 0) return 2;
+    // Posting lists are read in one pass each, the rest is jumped around in
+    madvise(index.map, index.size, MADV_RANDOM);
+
+    uint32_t *candidates;
+    uint32_t count = findCandidates(&index, query, &candidates);
+    double filtered = now();
+
+    Search search = {.index = &index, .candidates = candidates, .query = query, .ignoreCase = ignoreCase};
+    search.results = checkedAlloc(calloc(count + 1, sizeof(char *)));
+    search.resultLengths = checkedAlloc(calloc(count + 1, sizeof(size_t)));
+    search.matches = checkedAlloc(calloc(count + 1, sizeof(int)));
+    poolRun(jobs, count, searchTask, &search);
+
+    int matches = 0, matchedFiles = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (search.results[i]) fwrite(search.results[i], 1, search.resultLengths[i], stdout);
+        free(search.results[i]);
+        matches += search.matches[i];
+        matchedFiles += search.matches[i] > 0;
+    }
+    fprintf(stderr, "%d matches in %d files; %u of %u files lexed (lookup %.1f ms, total %.1f ms)\n",
+            matches, matchedFiles, count, index.header->fileCount,
+            (filtered - start) * 1e3, (now() - start) * 1e3);
+
+    free(search.results);
+    free(search.resultLengths);
+    free(search.matches);
+    free(candidates);
+    closeIndex(&index);
+    return matches ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#ifndef CDLAB_TRIGRAM_H
+#define CDLAB_TRIGRAM_H
+
+// A trigram index over the lexers' tokens, for finding identifiers and
+// string literals without lexing every file. "cdlab index" records, for
+// each file, every three-byte sequence inside its name-like tokens:
+// identifiers, string literals and the language-specific kinds of name
+// (functions, variables, labels, tags...), but not keywords, operators,
+// numbers, punctuation or comments. Tokens are taken as the lexer returns
+// them (see lexWatch in COMMON/tokenstream.h), so the ones that symbol
+// extraction reads without writing are indexed too, and so are the symbol
+// listing's names and parents. "cdlab search" looks up the query's
+// trigrams, intersects their posting lists, and lexes only the files left
+// to confirm each match, so the answer is exactly what the lexer sees.
+//
+// Trigrams are folded to lower case, so one index serves case-sensitive
+// and case-insensitive searches. A query shorter than three bytes has no
+// trigrams and is confirmed against every indexed file.
+//
+// Layout (native-endian; header offsets are uint64 from the start of the
+// file, everything else uint32 unless noted):
+//
+//   header    "CDTRIGR\0" version fileCount trigramCount pad filesOffset
+//             trigramsOffset postingsOffset postingsSize stringsOffset
+//             stringsSize
+//   files     (path language)*fileCount                 string offsets
+//   trigrams  (trigram fileCount postings:uint64)*trigramCount
+//   postings  LEB128 varints: each list's first file, then the gaps
+//   strings   NUL-terminated paths and --lang names
+//
+// Trigrams are sorted, and found by binary search; a trigram is its three
+// bytes big-end first. Files are numbered in the order they were indexed.
+#define TRIGRAM_MAGIC "CDTRIGR"
+#define TRIGRAM_VERSION 2
+
+// Lexes `paths` on `jobs` threads and writes the index to `indexPath`,
+// replacing it by rename. With `forced`, every file is lexed in that
+// language. Returns 0, or 1 if a file or the index could not be written.
+int trigramBuild(const char *indexPath, char *const *paths, int pathCount, int jobs,
+                 const char *forced);
+
+// Prints "path:line\tlexeme\tTYPE" for every token containing `query`, in
+// index order, and a summary on stderr. Returns 0 if anything matched, 1
+// if nothing did and 2 if the index could not be read.
+int trigramSearch(const char *indexPath, const char *query, int ignoreCase, int jobs);
+
+#endif
@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "../COMMON/alloc.h"
+#include "watch.h"
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                    IN_DELETE_SELF | IN_ONLYDIR)
+#define WATCH_READ_SIZE (64 * 1024)
+#define PENDING_FIRST_SLOTS 256
+
+struct Watcher {
+    int inotify;
+    int stopPipe[2];
+    pthread_t thread;
+    WatchCallback callback;
+    void *context;
+    int debounceMs;
+    char **roots;
+    int rootCount;
+
+    char **directories;         // by watch descriptor
+    int directoryCapacity;
+    int directoryCount;         // only read from other threads, hence atomic
+    long long eventCount;
+    int limitReported;
+
+    // Paths waiting for the tree to go quiet, each once
+    char **pending;
+    int pendingCount;
+    int pendingCapacity;
+    int *slots;                 // index + 1 into pending, by path hash
+    int slotCount;
+    double firstPending;        // when the oldest pending path arrived
+    double lastEvent;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// FNV-1a
+static unsigned hashPath(const char *path) {
+    unsigned hash = 2166136261u;
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 16777619u;
+    return hash;
+}
+
+static void rehashPending(Watcher *watcher) {
+    free(watcher->slots);
+    watcher->slots = checkedAlloc(calloc(watcher->slotCount, sizeof(int)));
+    for (int i = 0; i < watcher->pendingCount; i++) {
+        unsigned slot = hashPath(watcher->pending[i]) & (watcher->slotCount - 1);
+        while (watcher->slots[slot]) slot = (slot + 1) & (watcher->slotCount - 1);
+        watcher->slots[slot] = i + 1;
+    }
+}
+
+static void schedule(Watcher *watcher, const char *path) {
+    unsigned slot = hashPath(path) & (watcher->slotCount - 1);
+    for (; watcher->slots[slot]; slot = (slot + 1) & (watcher->slotCount - 1)) {
+        if (strcmp(watcher->pending[watcher->slots[slot] - 1], path) == 0) return;
+    }
+    if (watcher->pendingCount == 0) watcher->firstPending = now();
+    if (watcher->pendingCount == watcher->pendingCapacity) {
+        watcher->pendingCapacity = watcher->pendingCapacity ? watcher->pendingCapacity * 2 : 64;
+        watcher->pending = checkedAlloc(realloc(watcher->pending, watcher->pendingCapacity * sizeof(char *)));
+    }
+    watcher->pending[watcher->pendingCount++] = checkedAlloc(strdup(path));
+    watcher->slots[slot] = watcher->pendingCount;
+    if (watcher->pendingCount * 2 > watcher->slotCount) {
+        watcher->slotCount *= 2;
+        rehashPending(watcher);
+    }
+}
+
+static void flushPending(Watcher *watcher) {
+    for (int i = 0; i < watcher->pendingCount; i++) {
+        watcher->callback(watcher->pending[i], watcher->context);
+        free(watcher->pending[i]);
+    }
+    watcher->pendingCount = 0;
+    memset(watcher->slots, 0, watcher->slotCount * sizeof(int));
+}
+
+// Watches a directory and everything under it. With `report`, the files
+// found are scheduled too, since they may have been written before the
+// watch was in place.
+static void watchTree(Watcher *watcher, const char *directory, int report) {
+    int wd = inotify_add_watch(watcher->inotify, directory, WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC && !watcher->limitReported) {
+            fprintf(stderr, "Out of inotify watches at %s; raise fs.inotify.max_user_watches\n", directory);
+            watcher->limitReported = 1;
+        } else if (errno != ENOSPC && errno != ENOENT) {
+            perror(directory);
+        }
+        return;
+    }
+    if (wd >= watcher->directoryCapacity) {
+        int capacity = watcher->directoryCapacity ? watcher->directoryCapacity : 256;
+        while (capacity <= wd) capacity *= 2;
+        watcher->directories = checkedAlloc(realloc(watcher->directories, capacity * sizeof(char *)));
+        memset(watcher->directories + watcher->directoryCapacity, 0,
+               (capacity - watcher->directoryCapacity) * sizeof(char *));
+        watcher->directoryCapacity = capacity;
+    }
+    if (!watcher->directories[wd]) __atomic_add_fetch(&watcher->directoryCount, 1, __ATOMIC_RELAXED);
+    free(watcher->directories[wd]);
+    watcher->directories[wd] = checkedAlloc(strdup(directory));
+
+    DIR *dir = opendir(directory);
+    if (!dir) return;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            strcmp(entry->d_name, ".git") == 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name) >= (int)sizeof(path)) continue;
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) watchTree(watcher, path, report);
+        else if (report && S_ISREG(st.st_mode)) schedule(watcher, path);
+    }
+    closedir(dir);
+}
+
+static void forgetDirectory(Watcher *watcher, int wd) {
+    if (wd < 0 || wd >= watcher->directoryCapacity || !watcher->directories[wd]) return;
+    free(watcher->directories[wd]);
+    watcher->directories[wd] = NULL;
+    __atomic_sub_fetch(&watcher->directoryCount, 1, __ATOMIC_RELAXED);
+}
+
+// A directory moved out from under the roots keeps its watches, which
+// would then report paths that no longer exist; drop them
+static void unwatchTree(Watcher *watcher, const char *directory) {
+    size_t length = strlen(directory);
+    for (int wd = 0; wd < watcher->directoryCapacity; wd++) {
+        const char *watched = watcher->directories[wd];
+        if (watched && strncmp(watched, directory, length) == 0 &&
+            (watched[length] == '\0' || watched[length] == '/')) {
+            inotify_rm_watch(watcher->inotify, wd);
+            forgetDirectory(watcher, wd);
+        }
+    }
+}
+
+static void handleEvent(Watcher *watcher, const struct inotify_event *event) {
+    __atomic_add_fetch(&watcher->eventCount, 1, __ATOMIC_RELAXED);
+    if (event->mask & IN_Q_OVERFLOW) {
+        // The files still there are rescanned; the roots themselves are
+        // reported for whatever went while events were lost
+        fprintf(stderr, "inotify queue overflowed; rescanning\n");
+        for (int i = 0; i < watcher->rootCount; i++) {
+            watchTree(watcher, watcher->roots[i], 1);
+            schedule(watcher, watcher->roots[i]);
+        }
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        forgetDirectory(watcher, event->wd);
+        return;
+    }
+    if (event->wd < 0 || event->wd >= watcher->directoryCapacity || !watcher->directories[event->wd]) return;
+    const char *directory = watcher->directories[event->wd];
+    if (event->mask & IN_DELETE_SELF) {
+        schedule(watcher, directory);
+        return;
+    }
+    if (event->len == 0 || strcmp(event->name, ".git") == 0) return;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", directory, event->name) >= (int)sizeof(path)) return;
+    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+        watchTree(watcher, path, 1);
+        return;
+    }
+    if ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM)) unwatchTree(watcher, path);
+    schedule(watcher, path);
+}
+
+static void *watchMain(void *argument) {
+    Watcher *watcher = argument;
+    char buffer[WATCH_READ_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd waiting[2] = {{watcher->inotify, POLLIN, 0}, {watcher->stopPipe[0], POLLIN, 0}};
+
+    for (;;) {
+        // Sleep until the tree has been quiet long enough, or the oldest
+        // pending path has waited as long as it may
+        int timeout = -1;
+        if (watcher->pendingCount) {
+            double due = watcher->lastEvent + watcher->debounceMs / 1e3;
+            double deadline = watcher->firstPending + WATCH_MAX_DELAY_MS / 1e3;
+            if (deadline < due) due = deadline;
+            double wait = due - now();
+            timeout = wait > 0 ? (int)(wait * 1e3) + 1 : 0;
+        }
+        int ready = poll(waiting, 2, timeout);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (waiting[1].revents) break;
+        if (ready <= 0) {
+            if (watcher->pendingCount) flushPending(watcher);
+            continue;
+        }
+
+        ssize_t length = read(watcher->inotify, buffer, sizeof(buffer));
+        if (length <= 0) continue;
+        for (char *cur = buffer; cur < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *)cur;
+            handleEvent(watcher, event);
+            cur += sizeof(struct inotify_event) + event->len;
+        }
+        watcher->lastEvent = now();
+    }
+    return NULL;
+}
+
+Watcher *watchStart(char *const *roots, int rootCount, int debounceMs, WatchCallback callback,
+                    void *context) {
+    Watcher *watcher = checkedAlloc(calloc(1, sizeof(Watcher)));
+    watcher->inotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (watcher->inotify < 0 || pipe2(watcher->stopPipe, O_CLOEXEC) != 0) {
+        perror("inotify");
+        if (watcher->inotify >= 0) close(watcher->inotify);
+        free(watcher);
+        return NULL;
+    }
+    watcher->callback = callback;
+    watcher->context = context;
+    watcher->debounceMs = debounceMs;
+    watcher->slotCount = PENDING_FIRST_SLOTS;
+    watcher->slots = checkedAlloc(calloc(watcher->slotCount, sizeof(int)));
+    watcher->roots = checkedAlloc(calloc(rootCount + 1, sizeof(char *)));
+
+    // Index paths are resolved, so the watched ones are as well
+    for (int i = 0; i < rootCount; i++) {
+        char resolved[PATH_MAX];
+        struct stat st;
+        if (!realpath(roots[i], resolved) || stat(resolved, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        watcher->roots[watcher->rootCount++] = checkedAlloc(strdup(resolved));
+        watchTree(watcher, resolved, 0);
+    }
+
+    // Signals are left to the thread that started the watcher
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    int started = pthread_create(&watcher->thread, NULL, watchMain, watcher);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (started != 0) {
+        perror("pthread_create");
+        watcher->thread = 0;
+        watchStop(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+void watchStop(Watcher *watcher) {
+    if (!watcher) return;
+    if (watcher->thread) {
+        if (write(watcher->stopPipe[1], "", 1) < 0) perror("write");
+        pthread_join(watcher->thread, NULL);
+    }
+    close(watcher->inotify);
+    close(watcher->stopPipe[0]);
+    close(watcher->stopPipe[1]);
+    for (int i = 0; i < watcher->directoryCapacity; i++) free(watcher->directories[i]);
+    for (int i = 0; i < watcher->pendingCount; i++) free(watcher->pending[i]);
+    for (int i = 0; i < watcher->rootCount; i++) free(watcher->roots[i]);
+    free(watcher->directories);
+    free(watcher->pending);
+    free(watcher->slots);
+    free(watcher->roots);
+    free(watcher);
+}
+
+int watchDirectoryCount(Watcher *watcher) {
+    return __atomic_load_n(&watcher->directoryCount, __ATOMIC_RELAXED);
+}
+
+long long watchEventCount(Watcher *watcher) {
+    return __atomic_load_n(&watcher->eventCount, __ATOMIC_RELAXED);
+}
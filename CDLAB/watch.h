@@ -0,0 +1,40 @@
+#ifndef CDLAB_WATCH_H
+#define CDLAB_WATCH_H
+
+#define WATCH_DEFAULT_DEBOUNCE_MS 200
+#define WATCH_MAX_DELAY_MS 2000         // a tree that never goes quiet is still flushed this often
+
+// Watches directory trees with inotify on a thread of its own and reports
+// the paths that changed: written, created, moved in or out, or deleted.
+// New subdirectories are watched as they appear, and the files already in
+// them are reported.
+//
+// Events are debounced: paths collect, each once, until nothing has
+// happened for `debounceMs`, and are then reported together, so a burst of
+// writes to one file is analyzed once. If the tree never goes quiet, what
+// has collected is reported every WATCH_MAX_DELAY_MS regardless. If the
+// kernel's event queue overflows, every file under the roots is reported,
+// and so are the roots.
+//
+// The callback runs on the watcher's thread. It is given the path as it
+// is now, so it must stat it to learn whether it is a file, a directory or
+// gone; a directory that is gone takes everything under it along. A
+// directory that is still there may have lost files without a word, so
+// whatever the callback knows of under it must be checked again.
+typedef void (*WatchCallback)(const char *path, void *context);
+
+typedef struct Watcher Watcher;
+
+// Returns NULL (after printing why) if inotify cannot be set up. Roots that
+// are not directories are skipped.
+Watcher *watchStart(char *const *roots, int rootCount, int debounceMs, WatchCallback callback,
+                    void *context);
+
+// Reports nothing more, stops the thread and frees the watcher
+void watchStop(Watcher *watcher);
+
+// Directories watched and events seen so far
+int watchDirectoryCount(Watcher *watcher);
+long long watchEventCount(Watcher *watcher);
+
+#endif
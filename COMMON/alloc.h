@@ -0,0 +1,19 @@
+#ifndef CDLAB_ALLOC_H
+#define CDLAB_ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Takes the result of an allocation that the caller cannot go on without.
+// NULL prints an error and exits, as every allocation failure in the tree
+// does:
+//   Entry *entries = checkedAlloc(malloc(count * sizeof(Entry)));
+static inline void *checkedAlloc(void *pointer) {
+    if (!pointer) {
+        perror("malloc");
+        exit(1);
+    }
+    return pointer;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CDLAB_ANALYZER_H
+#define CDLAB_ANALYZER_H
+
+#include <stdio.h>
+
+#include "tokenstream.h"
+#include "document.h"
+#include "symbols.h"
+
+// Entry points the cdlab driver uses to run one language's analyzer.
+// Every analyzer source defines one of these next to its main().
+//
+// Tokens go to the caller's stream and the symbol table is printed to
+// `out`. Each analyzer's symbol table is thread-local, so different files
+// may be analyzed on different threads at the same time.
+//
+// Languages with a `document` can also be kept open in an editor and
+// updated edit by edit; see COMMON/document.h.
+typedef struct {
+    const char *name;                           // shown in output and accepted by --lang
+    int (*analyzeFile)(const char *filename, TokenStream *stream);  // -1 if the file could not be read
+    void (*displaySymbolTable)(FILE *out);      // NULL if the language keeps no table
+    void (*resetSymbolTable)(void);             // NULL if the language keeps no table
+    int (*symbolCount)(void);                   // entries in the table; NULL likewise
+    void (*listSymbols)(SymbolVisitor visit, void *context);   // NULL likewise
+    int version;                                // bump when the report for a file changes
+    const DocumentLanguage *document;           // NULL if edits cannot be re-lexed incrementally
+} Analyzer;
+
+extern const Analyzer sqlAnalyzer;
+extern const Analyzer plsqlAnalyzer;
+extern const Analyzer verilogAnalyzer;
+extern const Analyzer assemblyAnalyzer;
+extern const Analyzer cshellAnalyzer;
+extern const Analyzer jqueryAnalyzer;
+extern const Analyzer matlabAnalyzer;
+extern const Analyzer powershellAnalyzer;
+extern const Analyzer shellAnalyzer;
+extern const Analyzer phpAnalyzer;
+extern const Analyzer jsAnalyzer;
+extern const Analyzer htmlAnalyzer;
+extern const Analyzer javaAnalyzer;
+extern const Analyzer pythonAnalyzer;
+extern const Analyzer cppAnalyzer;
+extern const Analyzer perlAnalyzer;
+extern const Analyzer cssAnalyzer;
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "arena.h"
+
+#define ARENA_FIRST_BLOCK 4096
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+struct ArenaBlock {
+    ArenaBlock *next;           // the block allocated before this one
+    size_t size;
+    max_align_t data[];
+};
+
+static void arenaAddBlock(Arena *arena, size_t needed) {
+    size_t size = arena->head ? arena->head->size * 2 :
+                  arena->firstBlock ? arena->firstBlock : ARENA_FIRST_BLOCK;
+    while (size < needed) size *= 2;
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        perror("malloc");
+        exit(1);
+    }
+    block->next = arena->head;
+    block->size = size;
+    arena->head = block;
+    arena->used = 0;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (!arena->head || size > arena->head->size - arena->used) arenaAddBlock(arena, size);
+    void *p = (char *)arena->head->data + arena->used;
+    arena->used += size;
+    return p;
+}
+
+char *arenaStrndup(Arena *arena, const char *text, size_t length) {
+    char *copy = arenaAlloc(arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char *arenaPrintf(Arena *arena, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length < 0) length = 0;
+
+    char *text = arenaAlloc(arena, length + 1);
+    va_start(args, format);
+    vsnprintf(text, length + 1, format, args);
+    va_end(args);
+    return text;
+}
+
+void *arenaGrowArray(Arena *arena, void *array, int *capacity, int needed, size_t itemSize) {
+    if (needed <= *capacity) return array;
+
+    int grown = *capacity ? *capacity * 2 : 8;
+    while (grown < needed) grown *= 2;
+    void *moved = arenaAlloc(arena, grown * itemSize);
+    if (*capacity) memcpy(moved, array, *capacity * itemSize);
+    *capacity = grown;
+    return moved;
+}
+
+void arenaReset(Arena *arena) {
+    while (arena->head) {
+        ArenaBlock *older = arena->head->next;
+        free(arena->head);
+        arena->head = older;
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CDLAB_ARENA_H
+#define CDLAB_ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for symbol tables. Everything an analyzer records about a
+// file lives in one arena and goes away with a single arenaReset(), so the
+// tables need neither fixed-size slots nor per-entry frees. Blocks grow
+// geometrically, which keeps memory proportional to what was recorded.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;           // block being filled; older blocks follow
+    size_t used;                // bytes used in head
+    size_t firstBlock;          // size of the first block; 0 for the default
+} Arena;
+
+#define ARENA_INIT {NULL, 0, 0}
+
+// For arenas that usually hold a few small allocations, such as one symbol
+// table entry, where the default first block would be mostly waste
+#define ARENA_INIT_SIZED(bytes) {NULL, 0, (bytes)}
+
+// Allocation failures print an error and exit, like the rest of the tree
+void *arenaAlloc(Arena *arena, size_t size);
+char *arenaStrndup(Arena *arena, const char *text, size_t length);
+char *arenaPrintf(Arena *arena, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Returns `array` with room for at least `needed` items of `itemSize` bytes,
+// moving it to a larger arena allocation (twice the size) if it is full
+void *arenaGrowArray(Arena *arena, void *array, int *capacity, int needed, size_t itemSize);
+
+// Appends one item to a growable array and evaluates to its address:
+//   Function *f = ARENA_PUSH(&arena, symbolTable, functionCount, functionCapacity);
+#define ARENA_PUSH(arena, array, count, capacity) \
+    ((array) = arenaGrowArray((arena), (array), &(capacity), (count) + 1, sizeof(*(array))), \
+     &(array)[(count)++])
+
+// Frees every block; the arena can be used again straight away. Tables are
+// reset after each file, so threads that exit leave nothing behind.
+void arenaReset(Arena *arena);
+
+#endif
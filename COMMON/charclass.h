@@ -0,0 +1,52 @@
+#ifndef CDLAB_CHARCLASS_H
+#define CDLAB_CHARCLASS_H
+
+// Byte classes for the lexers, replacing the <ctype.h> calls. Each analyzer
+// describes its identifier, number, operator and quote bytes with a
+// CHAR_CLASS(c) expression and expands it into a 256-entry table at compile
+// time, so classifying a byte is one load and one mask:
+//
+//   #define CHAR_CLASS(c) (CC_ASCII(c) | CC_IF((c) == '"', CC_QUOTE) | ...)
+//   static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+//
+// Only ASCII is classified. Bytes 0x80-0xff belong to no class, whatever the
+// locale, and so does EOF, which charIs() folds onto 0xff.
+enum {
+    CC_SPACE = 1 << 0,          // ' ' and '\t' through '\r'
+    CC_DIGIT = 1 << 1,          // '0' through '9'
+    CC_ALPHA = 1 << 2,          // ASCII letters
+    CC_IDSTART = 1 << 3,        // may start an identifier
+    CC_IDCONT = 1 << 4,         // may continue an identifier
+    CC_NUMCONT = 1 << 5,        // may continue a number
+    CC_OPERATOR = 1 << 6,       // may start an operator
+    CC_QUOTE = 1 << 7,          // opens a string literal
+};
+
+#define CC_ALNUM (CC_ALPHA | CC_DIGIT)
+
+#define CC_IS_LETTER(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+#define CC_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define CC_IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+#define CC_IF(condition, classes) ((condition) ? (classes) : 0)
+
+// The classes that mean the same in every language
+#define CC_ASCII(c) (CC_IF(CC_IS_SPACE(c), CC_SPACE) | CC_IF(CC_IS_DIGIT(c), CC_DIGIT) | \
+                     CC_IF(CC_IS_LETTER(c), CC_ALPHA))
+
+#define CC_ROW(F, n) \
+    F((n) + 0x0), F((n) + 0x1), F((n) + 0x2), F((n) + 0x3), \
+    F((n) + 0x4), F((n) + 0x5), F((n) + 0x6), F((n) + 0x7), \
+    F((n) + 0x8), F((n) + 0x9), F((n) + 0xa), F((n) + 0xb), \
+    F((n) + 0xc), F((n) + 0xd), F((n) + 0xe), F((n) + 0xf)
+
+#define CHAR_CLASS_TABLE(F) { \
+    CC_ROW(F, 0x00), CC_ROW(F, 0x10), CC_ROW(F, 0x20), CC_ROW(F, 0x30), \
+    CC_ROW(F, 0x40), CC_ROW(F, 0x50), CC_ROW(F, 0x60), CC_ROW(F, 0x70), \
+    CC_ROW(F, 0x80), CC_ROW(F, 0x90), CC_ROW(F, 0xa0), CC_ROW(F, 0xb0), \
+    CC_ROW(F, 0xc0), CC_ROW(F, 0xd0), CC_ROW(F, 0xe0), CC_ROW(F, 0xf0) }
+
+// Tests `ch` (a byte, or EOF) against the including file's charClass table
+#define charIs(ch, classes) ((charClass[(unsigned char)(ch)] & (classes)) != 0)
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "chunklex.h"
+#include "tokenstream.h"
+
+#define CHUNK_LEX_SIZE (4 << 20)    // most bytes one thread lexes per round
+
+size_t chunkLexThreshold = 0;
+int chunkLexThreads = 1;
+
+static void growTokens(Token **tokens, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) return;
+    size_t grown = *capacity ? *capacity * 2 : 4096;
+    while (grown < needed) grown *= 2;
+    Token *moved = realloc(*tokens, grown * sizeof(Token));
+    if (!moved) {
+        perror("realloc");
+        exit(1);
+    }
+    *tokens = moved;
+    *capacity = grown;
+}
+
+static void *lexChunk(void *argument) {
+    Chunk *chunk = argument;
+    Input in = *chunk->in;
+    in.cur = in.data + chunk->start;
+    chunk->count = 0;
+    chunk->after = chunk->start;
+
+    Token token;
+    while (chunk->lex(&in, &token) && token.offset < chunk->end) {
+        growTokens(&chunk->tokens, &chunk->capacity, chunk->count + 1);
+        chunk->tokens[chunk->count++] = token;
+        chunk->after = inputTell(&in);
+    }
+    return NULL;
+}
+
+// The first line start at or after `offset`, so that a chunk does not open
+// in the middle of a line, where strings and comments usually are
+static size_t lineStart(const Input *in, size_t offset) {
+    if (offset >= in->size) return in->size;
+    const char *newline = memchr(in->data + offset, '\n', in->size - offset);
+    return newline ? (size_t)(newline - in->data) + 1 : in->size;
+}
+
+static void startRound(ChunkLexer *lexer) {
+    size_t remaining = lexer->in->size - lexer->position;
+    size_t chunkSize = (remaining + lexer->chunkCount - 1) / lexer->chunkCount;
+    if (chunkSize > CHUNK_LEX_SIZE) chunkSize = CHUNK_LEX_SIZE;
+
+    size_t start = lexer->position;
+    for (int k = 0; k < lexer->chunkCount; k++) {
+        Chunk *chunk = &lexer->chunks[k];
+        chunk->start = start;
+        chunk->end = k == lexer->chunkCount - 1 && remaining <= chunkSize * lexer->chunkCount
+                     ? lexer->in->size : lineStart(lexer->in, start + chunkSize);
+        start = chunk->end;
+
+        // Without a thread the chunk is simply lexed here
+        if (pthread_create(&chunk->thread, NULL, lexChunk, chunk) != 0) {
+            lexChunk(chunk);
+            chunk->thread = pthread_self();
+        }
+    }
+    lexer->lexing = 1;
+}
+
+static void waitRound(ChunkLexer *lexer) {
+    for (int k = 0; k < lexer->chunkCount; k++) {
+        if (!pthread_equal(lexer->chunks[k].thread, pthread_self())) {
+            pthread_join(lexer->chunks[k].thread, NULL);
+        }
+    }
+    lexer->lexing = 0;
+}
+
+static void appendTokens(ChunkLexer *lexer, const Token *tokens, size_t count) {
+    growTokens(&lexer->tokens, &lexer->capacity, lexer->count + count);
+    memcpy(lexer->tokens + lexer->count, tokens, count * sizeof(Token));
+    lexer->count += count;
+}
+
+// Index of the token starting at `offset`, or -1
+static long findToken(const Chunk *chunk, size_t offset) {
+    size_t low = 0, high = chunk->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (chunk->tokens[middle].offset < offset) low = middle + 1;
+        else high = middle;
+    }
+    return low < chunk->count && chunk->tokens[low].offset == offset ? (long)low : -1;
+}
+
+// Joins the chunks of the finished round into lexer->tokens, re-lexing
+// from the true position wherever a chunk's starting guess was wrong. A
+// token lexed past one chunk's end is held for the chunk it starts in, so
+// a comment or string that spans several chunks is lexed once, not again
+// for every chunk it covers.
+static void stitchRound(ChunkLexer *lexer) {
+    size_t position = lexer->position;
+    lexer->count = lexer->next = 0;
+    Input in = *lexer->in;
+    Token token;
+    int held = 0;               // 1 while `token` waits for the chunk it starts in
+    int ended = 0;              // 1 once the lexer has reached the end of the input
+
+    for (int k = 0; k < lexer->chunkCount && !ended; k++) {
+        const Chunk *chunk = &lexer->chunks[k];
+        if (k == 0) {
+            // Started at the true position, so nothing to check
+            appendTokens(lexer, chunk->tokens, chunk->count);
+            if (chunk->count) position = chunk->after;
+            continue;
+        }
+
+        for (;;) {
+            if (!held) {
+                in.cur = in.data + position;
+                if (!lexer->lex(&in, &token)) {
+                    ended = 1;
+                    break;
+                }
+                held = 1;
+            }
+            if (token.offset >= chunk->end) break;
+            held = 0;
+            long match = findToken(chunk, token.offset);
+            if (match >= 0) {
+                appendTokens(lexer, chunk->tokens + match, chunk->count - match);
+                position = chunk->after;
+                break;
+            }
+            appendTokens(lexer, &token, 1);
+            position = inputTell(&in);
+        }
+    }
+    // The next round starts at a token still held, which lexes the same
+    // from its own offset, or past everything if nothing is left
+    if (held) position = token.offset;
+    if (ended) position = lexer->in->size;
+    lexer->position = position;
+}
+
+int chunkLexStart(ChunkLexer *lexer, const Input *in, LexFunction lex) {
+    if (chunkLexThreshold == 0 || chunkLexThreads < 2 || in->size < chunkLexThreshold) return 0;
+
+    memset(lexer, 0, sizeof(*lexer));
+    lexer->in = in;
+    lexer->lex = lex;
+    lexer->chunkCount = chunkLexThreads;
+    lexer->chunks = calloc(lexer->chunkCount, sizeof(Chunk));
+    if (!lexer->chunks) {
+        perror("calloc");
+        exit(1);
+    }
+    for (int k = 0; k < lexer->chunkCount; k++) {
+        lexer->chunks[k].in = in;
+        lexer->chunks[k].lex = lex;
+    }
+    startRound(lexer);
+    return 1;
+}
+
+int chunkLexNext(ChunkLexer *lexer, Token *token) {
+    while (lexer->next == lexer->count) {
+        if (!lexer->lexing) return 0;
+        waitRound(lexer);
+        stitchRound(lexer);
+        // Rounds continue until one has reached the end of the input
+        if (lexer->chunks[lexer->chunkCount - 1].end < lexer->in->size) startRound(lexer);
+    }
+    *token = lexer->tokens[lexer->next++];
+    // The chunks were lexed on other threads, so the watch sees them here
+    return tokenLexed(1, lexer->in, token);
+}
+
+void chunkLexFinish(ChunkLexer *lexer) {
+    if (lexer->lexing) waitRound(lexer);
+    for (int k = 0; k < lexer->chunkCount; k++) free(lexer->chunks[k].tokens);
+    free(lexer->chunks);
+    free(lexer->tokens);
+}
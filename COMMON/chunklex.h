@@ -0,0 +1,74 @@
+#ifndef CDLAB_CHUNKLEX_H
+#define CDLAB_CHUNKLEX_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "input.h"
+#include "token.h"
+
+// Parallel lexing of one large file. The input is cut into chunks at line
+// starts and every chunk is lexed on its own thread as if no string or
+// comment were open there. Those guesses are checked as the chunks are
+// stitched back together, in order. The sequential lexer resumes where
+// the previous chunk really ended and runs until it produces a token that
+// starts at the same offset as a token in the next chunk. From that token
+// on the two must agree, because a lexer's next token depends only on the
+// offset it starts from. Only a wrong guess costs anything: the tokens up
+// to the resynchronization point are lexed again.
+//
+// Chunks are processed a round at a time, so memory stays proportional to
+// the round rather than the file. The next round is lexed while the caller
+// consumes the current one, so symbol extraction and output overlap with
+// lexing.
+//
+// A lexer can use this if each token depends only on the bytes from the
+// offset it starts at, with no state carried over from earlier tokens.
+
+typedef struct {
+    size_t start;               // where this chunk's lexer starts (a guess unless first)
+    size_t end;                 // tokens starting at or after this belong to the next chunk
+    size_t after;               // lexer position after the last token
+    Token *tokens;
+    size_t count;
+    size_t capacity;
+    const Input *in;
+    LexFunction lex;
+    pthread_t thread;
+} Chunk;
+
+typedef struct {
+    const Input *in;
+    LexFunction lex;
+    int chunkCount;             // chunks per round, one per thread
+    Chunk *chunks;
+    int lexing;                 // 1 while the chunk threads run
+    size_t position;            // lexer position where the next round starts
+
+    // The round being consumed
+    Token *tokens;
+    size_t count;
+    size_t capacity;
+    size_t next;
+} ChunkLexer;
+
+// Files of at least chunkLexThreshold bytes are lexed in chunks on
+// chunkLexThreads threads. A threshold of 0 (the default) or a single
+// thread lexes every file sequentially. Set these before any file is
+// analyzed.
+extern size_t chunkLexThreshold;
+extern int chunkLexThreads;
+
+// Starts lexing `in` in chunks and returns 1, or returns 0 if `in` is below
+// the threshold and should be lexed sequentially. `in` must stay open until
+// chunkLexFinish.
+int chunkLexStart(ChunkLexer *lexer, const Input *in, LexFunction lex);
+
+// Hands out the same tokens, in the same order, as calling `lex` from the
+// start of the input would. The Input's cursor is not moved.
+int chunkLexNext(ChunkLexer *lexer, Token *token);
+
+// Waits for any chunks still being lexed and frees everything
+void chunkLexFinish(ChunkLexer *lexer);
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "document.h"
+
+#define DOCUMENT_FIRST_TOKENS 1024
+#define DOCUMENT_FIRST_SECTIONS 64
+#define DOCUMENT_SECTION_ARENA 256  // first block of a section's arena
+
+static void *grow(void *array, size_t capacity, size_t itemSize) {
+    void *moved = realloc(array, capacity * itemSize);
+    if (!moved) {
+        perror("realloc");
+        exit(1);
+    }
+    return moved;
+}
+
+Input documentInput(const Document *doc) {
+    Input in = {doc->text, doc->text, doc->text + doc->size, doc->size, 0, 0};
+    return in;
+}
+
+static void replaceText(Document *doc, size_t offset, size_t removed, const char *text, size_t inserted) {
+    size_t size = doc->size - removed + inserted;
+    if (size > doc->textCapacity) {
+        size_t capacity = doc->textCapacity ? doc->textCapacity * 2 : 4096;
+        while (capacity < size) capacity *= 2;
+        doc->text = grow(doc->text, capacity, 1);
+        doc->textCapacity = capacity;
+    }
+    memmove(doc->text + offset + inserted, doc->text + offset + removed, doc->size - offset - removed);
+    memcpy(doc->text + offset, text, inserted);
+    doc->size = size;
+}
+
+// Doubles a gap buffer, keeping the items after the gap at its end
+static void *growGap(void *items, size_t itemSize, size_t *gapEnd, size_t *capacity, size_t firstCapacity) {
+    size_t after = *capacity - *gapEnd;
+    size_t grown = *capacity ? *capacity * 2 : firstCapacity;
+    char *moved = grow(items, grown, itemSize);
+    memmove(moved + (grown - after) * itemSize, moved + *gapEnd * itemSize, after * itemSize);
+    *gapEnd = grown - after;
+    *capacity = grown;
+    return moved;
+}
+
+// Moves the token gap so that it starts at token `index`
+static void moveTokenGap(Document *doc, size_t index) {
+    while (doc->tokenGapStart > index) {
+        Token *token = &doc->tokens[--doc->tokenGapEnd];
+        *token = doc->tokens[--doc->tokenGapStart];
+        token->offset = doc->size - token->offset;
+    }
+    while (doc->tokenGapStart < index) {
+        Token *token = &doc->tokens[doc->tokenGapStart++];
+        *token = doc->tokens[doc->tokenGapEnd++];
+        token->offset = doc->size - token->offset;
+    }
+}
+
+static void insertToken(Document *doc, const Token *token) {
+    if (doc->tokenGapStart == doc->tokenGapEnd) {
+        doc->tokens = growGap(doc->tokens, sizeof(Token), &doc->tokenGapEnd, &doc->tokenCapacity,
+                              DOCUMENT_FIRST_TOKENS);
+    }
+    doc->tokens[doc->tokenGapStart++] = *token;
+}
+
+static void moveSectionGap(Document *doc, size_t index) {
+    while (doc->sectionGapStart > index) {
+        DocumentSection *section = &doc->sections[--doc->sectionGapEnd];
+        *section = doc->sections[--doc->sectionGapStart];
+        section->offset = doc->size - section->offset;
+        section->end = doc->size - section->end;
+    }
+    while (doc->sectionGapStart < index) {
+        DocumentSection *section = &doc->sections[doc->sectionGapStart++];
+        *section = doc->sections[doc->sectionGapEnd++];
+        section->offset = doc->size - section->offset;
+        section->end = doc->size - section->end;
+    }
+}
+
+static void insertSection(Document *doc, const DocumentSection *section) {
+    if (doc->sectionGapStart == doc->sectionGapEnd) {
+        doc->sections = growGap(doc->sections, sizeof(DocumentSection), &doc->sectionGapEnd,
+                                &doc->sectionCapacity, DOCUMENT_FIRST_SECTIONS);
+    }
+    doc->sections[doc->sectionGapStart++] = *section;
+}
+
+// Frees the first section after the gap
+static void dropSection(Document *doc) {
+    arenaReset(&doc->sections[doc->sectionGapEnd++].arena);
+}
+
+size_t documentFindToken(const Document *doc, size_t offset) {
+    size_t low = 0, high = documentTokenCount(doc);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (documentToken(doc, middle).offset < offset) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+// Index of the first token that ends at or after `offset`. Lexers read one
+// byte past a token to find where it ends, so that token may change when
+// the byte at `offset` does.
+static size_t findTokenEndingAt(const Document *doc, size_t offset) {
+    size_t low = 0, high = documentTokenCount(doc);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        Token token = documentToken(doc, middle);
+        if (token.offset + token.length < offset) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+// Index of the first section that ends at or after `offset`
+static size_t findSectionEndingAt(const Document *doc, size_t offset) {
+    size_t low = 0, high = documentSectionCount(doc);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (documentSection(doc, middle).end < offset) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+// Re-lexes the tokens from `resume` until they line up with the old tokens
+// after the edit, which ends at `editEnd`. Returns the offset from which
+// the old tokens were kept, or the size of the text if none were.
+static size_t relex(Document *doc, size_t resume, size_t editEnd) {
+    Input in = documentInput(doc);
+    inputSeek(&in, resume);
+
+    Token token;
+    while (doc->language->lex(&in, &token)) {
+        if (token.offset >= editEnd) {
+            // Old tokens are ordered by offset, so by falling distance
+            size_t distance = doc->size - token.offset;
+            while (doc->tokenGapEnd < doc->tokenCapacity && doc->tokens[doc->tokenGapEnd].offset > distance) {
+                doc->tokenGapEnd++;
+            }
+            if (doc->tokenGapEnd < doc->tokenCapacity && doc->tokens[doc->tokenGapEnd].offset == distance) {
+                return token.offset;
+            }
+        }
+        insertToken(doc, &token);
+    }
+    doc->tokenGapEnd = doc->tokenCapacity;
+    return doc->size;
+}
+
+// Scans the top level of the token stream from token `index`, extracting
+// sections again, until it reaches a token at or after `kept` that the old
+// scan also saw at the top level. The old sections up to there, which
+// follow the section gap, are replaced by the new ones.
+static void rescan(Document *doc, size_t index, size_t kept) {
+    const DocumentLanguage *language = doc->language;
+    Input in = documentInput(doc);
+
+    size_t count = documentTokenCount(doc);
+    while (index < count) {
+        Token token = documentToken(doc, index);
+        if (token.offset >= kept) {
+            // Distances from the end compare old sections with new tokens
+            size_t distance = doc->size - token.offset;
+            while (doc->sectionGapEnd < doc->sectionCapacity &&
+                   doc->sections[doc->sectionGapEnd].end >= distance) {
+                dropSection(doc);
+            }
+            if (doc->sectionGapEnd == doc->sectionCapacity ||
+                doc->sections[doc->sectionGapEnd].offset <= distance) {
+                return;
+            }
+        }
+
+        if (!language->opensSection(&in, &token)) {
+            index++;
+            continue;
+        }
+        DocumentSection section = {token.offset, 0, NULL, ARENA_INIT_SIZED(DOCUMENT_SECTION_ARENA)};
+        inputSeek(&in, token.offset + token.length);
+        section.entry = language->extractSection(&section.arena, &in, &token);
+        section.end = inputTell(&in);
+        insertSection(doc, &section);
+        index = documentFindToken(doc, section.end);
+    }
+    while (doc->sectionGapEnd < doc->sectionCapacity) dropSection(doc);
+}
+
+void documentEdit(Document *doc, size_t offset, size_t removed, const char *text, size_t inserted) {
+    if (offset > doc->size) offset = doc->size;
+    if (removed > doc->size - offset) removed = doc->size - offset;
+    if (removed == 0 && inserted == 0) return;
+
+    // Everything before the first token that may change stays as it is
+    size_t first = findTokenEndingAt(doc, offset);
+    size_t resume = 0;
+    if (first > 0) {
+        Token previous = documentToken(doc, first - 1);
+        resume = previous.offset + previous.length;
+    }
+    size_t firstOffset = first < documentTokenCount(doc) ? documentToken(doc, first).offset : doc->size;
+
+    // The top-level scan restarts at that token, or at the section that
+    // contains it, which has to be extracted again
+    size_t section = findSectionEndingAt(doc, offset);
+    size_t restart = first;
+    if (section < documentSectionCount(doc)) {
+        size_t sectionOffset = documentSection(doc, section).offset;
+        if (sectionOffset < firstOffset) restart = documentFindToken(doc, sectionOffset);
+    }
+
+    moveTokenGap(doc, first);
+    moveSectionGap(doc, section);
+    replaceText(doc, offset, removed, text, inserted);
+    size_t kept = relex(doc, resume, offset + inserted);
+    rescan(doc, restart, kept);
+}
+
+void documentOpen(Document *doc, const DocumentLanguage *language, const char *text, size_t size) {
+    memset(doc, 0, sizeof(*doc));
+    doc->language = language;
+    documentEdit(doc, 0, 0, text, size);
+}
+
+void documentClose(Document *doc) {
+    moveSectionGap(doc, documentSectionCount(doc));
+    for (size_t i = 0; i < doc->sectionGapStart; i++) arenaReset(&doc->sections[i].arena);
+    free(doc->sections);
+    free(doc->tokens);
+    free(doc->text);
+    memset(doc, 0, sizeof(*doc));
+}
+
+void documentDisplaySymbols(const Document *doc, FILE *out) {
+    doc->language->displayHeading(out);
+    for (size_t i = 0; i < documentSectionCount(doc); i++) {
+        DocumentSection section = documentSection(doc, i);
+        if (section.entry) doc->language->displayEntry(out, section.entry);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef CDLAB_DOCUMENT_H
+#define CDLAB_DOCUMENT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "input.h"
+#include "token.h"
+#include "arena.h"
+#include "tokenstream.h"
+
+// A lexed buffer that is kept up to date as it is edited, for editors that
+// want tokens and symbols after every keystroke without re-running a whole
+// analyze*File.
+//
+// An edit re-lexes from the end of the last token that ends before the
+// edit until the lexer emits a token at the same offset as an old token
+// past the edit. From there on the old tokens are still right, as in
+// COMMON/chunklex.h, so only the tokens around the edit are lexed again.
+// The tokens live in a gap buffer kept at the last edit, so an edit does
+// not have to move or renumber the tokens after it.
+//
+// Symbols are kept per section: a section is the span one call of the
+// language's extractor reads, from the token that opens it (a query, a
+// module, a block) to the last token it consumed. An edit re-extracts the
+// sections it touches and scans for new ones only until the top level of
+// the token stream lines up with the old one again.
+
+// How one language lexes and extracts symbols; streamed input uses it too
+// (see COMMON/window.h). The lexer must not carry state from one token to
+// the next. The extractor must read only tokens that follow `first`, by
+// lexing from `in`.
+typedef struct {
+    LexFunction lex;
+    int (*opensSection)(const Input *in, const Token *token);
+    // Returns the symbol table entry, allocated from `arena`, or NULL
+    void *(*extractSection)(Arena *arena, Input *in, const Token *first);
+    // The same text as the analyzer's displaySymbolTable
+    void (*displayHeading)(FILE *out);
+    void (*displayEntry)(FILE *out, const void *entry);
+    const TokenFormat *tokenFormat;
+} DocumentLanguage;
+
+typedef struct {
+    size_t offset;              // the token that opens the section
+    size_t end;                 // lexer position after the last token read
+    void *entry;                // NULL if the extractor found nothing
+    Arena arena;                // holds entry
+} DocumentSection;
+
+// Tokens and sections are both kept in gap buffers. Items before the gap
+// hold their offsets; items after it hold the distance from their offsets
+// to the end of the text.
+typedef struct {
+    const DocumentLanguage *language;
+    char *text;
+    size_t size;
+    size_t textCapacity;
+
+    Token *tokens;
+    size_t tokenGapStart;
+    size_t tokenGapEnd;
+    size_t tokenCapacity;
+
+    DocumentSection *sections;
+    size_t sectionGapStart;
+    size_t sectionGapEnd;
+    size_t sectionCapacity;
+} Document;
+
+// Copies `text` and lexes it. Allocation failures print an error and exit.
+void documentOpen(Document *doc, const DocumentLanguage *language, const char *text, size_t size);
+void documentClose(Document *doc);
+
+// Replaces the `removed` bytes at `offset` with `inserted` bytes of `text`.
+// Ranges past the end of the document are clipped to it.
+void documentEdit(Document *doc, size_t offset, size_t removed, const char *text, size_t inserted);
+
+// An Input over the current text, for tokenText() and friends. It is valid
+// until the next edit.
+Input documentInput(const Document *doc);
+
+static inline size_t documentTokenCount(const Document *doc) {
+    return doc->tokenGapStart + (doc->tokenCapacity - doc->tokenGapEnd);
+}
+
+static inline Token documentToken(const Document *doc, size_t index) {
+    if (index < doc->tokenGapStart) return doc->tokens[index];
+    Token token = doc->tokens[doc->tokenGapEnd + (index - doc->tokenGapStart)];
+    token.offset = doc->size - token.offset;
+    return token;
+}
+
+// Sections in the order the analyzer's symbol table would list them
+static inline size_t documentSectionCount(const Document *doc) {
+    return doc->sectionGapStart + (doc->sectionCapacity - doc->sectionGapEnd);
+}
+
+static inline DocumentSection documentSection(const Document *doc, size_t index) {
+    if (index < doc->sectionGapStart) return doc->sections[index];
+    DocumentSection section = doc->sections[doc->sectionGapEnd + (index - doc->sectionGapStart)];
+    section.offset = doc->size - section.offset;
+    section.end = doc->size - section.end;
+    return section;
+}
+
+// Index of the first token that starts at or after `offset`
+size_t documentFindToken(const Document *doc, size_t offset);
+
+// Prints the symbol table as the analyzer would for the current text
+void documentDisplaySymbols(const Document *doc, FILE *out);
+
+#endif
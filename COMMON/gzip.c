@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "gzip.h"
+
+#define GZIP_WINDOW (1 << 15)           // the furthest back deflate refers
+#define GZIP_INPUT_SIZE (64 << 10)
+#define MAX_CODE_BITS 15
+#define FAST_BITS 10                    // codes this short decode in one lookup
+#define MAX_LENGTH_CODES 288
+#define MAX_DISTANCE_CODES 30
+
+typedef enum {
+    GZIP_HEADER,        // at the start of a member
+    GZIP_BLOCK,         // at the start of a block
+    GZIP_STORED,
+    GZIP_CODES,
+    GZIP_TRAILER,
+    GZIP_DONE
+} GzipState;
+
+// A canonical Huffman code. Codes up to FAST_BITS long are looked up by
+// their (bit-reversed) next bits in `fast`; longer ones are walked one bit
+// at a time through `count` and `symbol`.
+typedef struct {
+    uint16_t fast[1 << FAST_BITS];     // symbol << 4 | length, or 0 if longer
+    uint16_t count[MAX_CODE_BITS + 1]; // number of codes of each length
+    uint16_t symbol[MAX_LENGTH_CODES]; // symbols in code order
+} Huffman;
+
+struct GzipReader {
+    int fd;
+    GzipState state;
+    int error;                  // errno once something failed
+
+    unsigned char input[GZIP_INPUT_SIZE];
+    size_t inputPos;
+    size_t inputEnd;
+    int inputDone;
+    uint64_t bits;              // next bits of input, first in the low bit
+    int bitCount;
+
+    int members;                // members started so far
+    int lastBlock;
+    size_t stored;              // bytes left in a stored block
+    int matchLength;            // bytes left to copy from matchDistance back
+    int matchDistance;
+    Huffman lengths;            // literal/length code of the current block
+    Huffman distances;
+
+    unsigned char window[GZIP_WINDOW];
+    uint64_t total;             // bytes output by this member
+    uint32_t crc;
+};
+
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// The order code length code lengths are sent in
+static const uint8_t codeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void crcInit(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[i] = c;
+    }
+}
+
+static uint32_t crcUpdate(uint32_t crc, const unsigned char *data, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void fail(GzipReader *reader, int error) {
+    if (!reader->error) reader->error = error;
+}
+
+// Makes at least `count` bits available. Returns 0 if the input ends
+// first, leaving what there was.
+static int needBits(GzipReader *reader, int count) {
+    while (reader->bitCount < count) {
+        if (reader->inputPos == reader->inputEnd) {
+            if (reader->inputDone) return 0;
+            ssize_t n;
+            do {
+                n = read(reader->fd, reader->input, sizeof(reader->input));
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                reader->inputDone = 1;
+                if (n < 0) fail(reader, errno);
+                return 0;
+            }
+            reader->inputPos = 0;
+            reader->inputEnd = n;
+        }
+        reader->bits |= (uint64_t)reader->input[reader->inputPos++] << reader->bitCount;
+        reader->bitCount += 8;
+    }
+    return 1;
+}
+
+static unsigned getBits(GzipReader *reader, int count) {
+    if (!needBits(reader, count)) {
+        fail(reader, EBADMSG);
+        return 0;
+    }
+    unsigned value = reader->bits & ((1u << count) - 1);
+    reader->bits >>= count;
+    reader->bitCount -= count;
+    return value;
+}
+
+// Drops the rest of the current byte
+static void alignToByte(GzipReader *reader) {
+    getBits(reader, reader->bitCount & 7);
+}
+
+// Builds a code from each symbol's code length. Returns 0, or -1 if the
+// lengths describe more codes than fit. Incomplete codes are allowed, as
+// deflate uses them for a single distance code.
+static int buildHuffman(Huffman *huffman, const uint8_t *lengths, int symbols) {
+    uint16_t offsets[MAX_CODE_BITS + 1];
+    memset(huffman->count, 0, sizeof(huffman->count));
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    for (int i = 0; i < symbols; i++) huffman->count[lengths[i]]++;
+    huffman->count[0] = 0;
+
+    int left = 1;
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+        left = (left << 1) - huffman->count[length];
+        if (left < 0) return -1;
+    }
+    offsets[1] = 0;
+    for (int length = 1; length < MAX_CODE_BITS; length++) {
+        offsets[length + 1] = offsets[length] + huffman->count[length];
+    }
+    for (int i = 0; i < symbols; i++) {
+        if (lengths[i]) huffman->symbol[offsets[lengths[i]]++] = i;
+    }
+
+    // Codes are sent high bit first but read low bit first, so the table
+    // is indexed by each code reversed, once for every value of the bits
+    // after it
+    unsigned code = 0;
+    int index = 0;
+    for (int length = 1; length <= FAST_BITS; length++) {
+        for (int n = 0; n < huffman->count[length]; n++, code++, index++) {
+            unsigned reversed = 0;
+            for (int bit = 0; bit < length; bit++) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            for (unsigned slot = reversed; slot < (1u << FAST_BITS); slot += 1u << length) {
+                huffman->fast[slot] = huffman->symbol[index] << 4 | length;
+            }
+        }
+        code <<= 1;
+    }
+    return 0;
+}
+
+// Returns the next symbol, or -1 if the bits are not a code
+static int decodeSymbol(GzipReader *reader, const Huffman *huffman) {
+    // The last code of a stream may be followed by fewer than
+    // MAX_CODE_BITS bits, so take what there is
+    needBits(reader, MAX_CODE_BITS);
+    unsigned entry = huffman->fast[reader->bits & ((1u << FAST_BITS) - 1)];
+    if (entry && (int)(entry & 15) <= reader->bitCount) {
+        reader->bits >>= entry & 15;
+        reader->bitCount -= entry & 15;
+        return entry >> 4;
+    }
+
+    int code = 0, first = 0, index = 0;
+    for (int length = 1; length <= MAX_CODE_BITS && length <= reader->bitCount; length++) {
+        code |= (reader->bits >> (length - 1)) & 1;
+        int count = huffman->count[length];
+        if (code - count < first) {
+            reader->bits >>= length;
+            reader->bitCount -= length;
+            return huffman->symbol[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void readFixedCodes(GzipReader *reader) {
+    uint8_t lengths[MAX_LENGTH_CODES];
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < MAX_LENGTH_CODES; i++) lengths[i] = 8;
+    buildHuffman(&reader->lengths, lengths, MAX_LENGTH_CODES);
+    for (i = 0; i < MAX_DISTANCE_CODES; i++) lengths[i] = 5;
+    buildHuffman(&reader->distances, lengths, MAX_DISTANCE_CODES);
+}
+
+static void readDynamicCodes(GzipReader *reader) {
+    int lengthCount = getBits(reader, 5) + 257;
+    int distanceCount = getBits(reader, 5) + 1;
+    int codeLengthCount = getBits(reader, 4) + 4;
+    if (lengthCount > 286 || distanceCount > MAX_DISTANCE_CODES) {
+        fail(reader, EBADMSG);
+        return;
+    }
+
+    uint8_t lengths[MAX_LENGTH_CODES + MAX_DISTANCE_CODES];
+    memset(lengths, 0, 19);
+    for (int i = 0; i < codeLengthCount; i++) lengths[codeLengthOrder[i]] = getBits(reader, 3);
+    Huffman codeLengths;
+    if (buildHuffman(&codeLengths, lengths, 19) != 0) {
+        fail(reader, EBADMSG);
+        return;
+    }
+
+    // Literal/length and distance code lengths run together, with runs
+    // that may cross from one to the other
+    for (int i = 0; i < lengthCount + distanceCount && !reader->error;) {
+        int symbol = decodeSymbol(reader, &codeLengths);
+        if (symbol < 0) {
+            fail(reader, EBADMSG);
+            return;
+        }
+        if (symbol < 16) {
+            lengths[i++] = symbol;
+            continue;
+        }
+        int value = 0, repeat;
+        if (symbol == 16) {
+            if (i == 0) {
+                fail(reader, EBADMSG);
+                return;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + getBits(reader, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + getBits(reader, 3);
+        } else {
+            repeat = 11 + getBits(reader, 7);
+        }
+        if (i + repeat > lengthCount + distanceCount) {
+            fail(reader, EBADMSG);
+            return;
+        }
+        while (repeat--) lengths[i++] = value;
+    }
+    if (reader->error) return;
+    if (lengths[256] == 0 ||
+        buildHuffman(&reader->lengths, lengths, lengthCount) != 0 ||
+        buildHuffman(&reader->distances, lengths + lengthCount, distanceCount) != 0) {
+        fail(reader, EBADMSG);
+    }
+}
+
+static void readBlockHeader(GzipReader *reader) {
+    reader->lastBlock = getBits(reader, 1);
+    switch (getBits(reader, 2)) {
+    case 0: {
+        alignToByte(reader);
+        unsigned length = getBits(reader, 16), complement = getBits(reader, 16);
+        if (length != (~complement & 0xffff)) fail(reader, EBADMSG);
+        reader->stored = length;
+        reader->state = GZIP_STORED;
+        break;
+    }
+    case 1:
+        readFixedCodes(reader);
+        reader->state = GZIP_CODES;
+        break;
+    case 2:
+        readDynamicCodes(reader);
+        reader->state = GZIP_CODES;
+        break;
+    default:
+        fail(reader, EBADMSG);
+    }
+}
+
+// Reads a member header, or notices that the input has ended
+static void readHeader(GzipReader *reader) {
+    // The input may end after a member, but not before the first
+    if (!needBits(reader, 8)) {
+        if (reader->members == 0) fail(reader, EBADMSG);
+        reader->state = GZIP_DONE;
+        return;
+    }
+    reader->members++;
+    if (getBits(reader, 8) != 0x1f || getBits(reader, 8) != 0x8b || getBits(reader, 8) != 8) {
+        fail(reader, EBADMSG);
+        return;
+    }
+    unsigned flags = getBits(reader, 8);
+    for (int i = 0; i < 6; i++) getBits(reader, 8);      // mtime, extra flags, OS
+    if (flags & 4) {                                    // FEXTRA
+        for (unsigned length = getBits(reader, 16); length > 0 && !reader->error; length--) getBits(reader, 8);
+    }
+    if (flags & 8) while (getBits(reader, 8) && !reader->error);     // FNAME
+    if (flags & 16) while (getBits(reader, 8) && !reader->error);    // FCOMMENT
+    if (flags & 2) getBits(reader, 16);                 // FHCRC
+    reader->total = 0;
+    reader->crc = 0;
+    reader->state = GZIP_BLOCK;
+}
+
+static void readTrailer(GzipReader *reader) {
+    alignToByte(reader);
+    uint32_t crc = getBits(reader, 16);
+    crc |= (uint32_t)getBits(reader, 16) << 16;
+    uint32_t size = getBits(reader, 16);
+    size |= (uint32_t)getBits(reader, 16) << 16;
+    if (!reader->error && (crc != reader->crc || size != (uint32_t)reader->total)) fail(reader, EBADMSG);
+    reader->state = GZIP_HEADER;
+}
+
+#define EMIT(byte) do { \
+        unsigned char emitted_ = (byte); \
+        out[produced++] = emitted_; \
+        reader->window[reader->total++ & (GZIP_WINDOW - 1)] = emitted_; \
+    } while (0)
+
+// Decodes a Huffman block until it ends or `out` is full
+static size_t inflateCodes(GzipReader *reader, unsigned char *out, size_t produced, size_t size) {
+    while (produced < size && !reader->error) {
+        if (reader->matchLength) {
+            size_t count = size - produced < (size_t)reader->matchLength ? size - produced
+                                                                         : (size_t)reader->matchLength;
+            reader->matchLength -= count;
+            while (count--) EMIT(reader->window[(reader->total - reader->matchDistance) & (GZIP_WINDOW - 1)]);
+            continue;
+        }
+        int symbol = decodeSymbol(reader, &reader->lengths);
+        if (symbol < 0) {
+            fail(reader, EBADMSG);
+        } else if (symbol < 256) {
+            EMIT(symbol);
+        } else if (symbol == 256) {
+            reader->state = reader->lastBlock ? GZIP_TRAILER : GZIP_BLOCK;
+            break;
+        } else if (symbol - 257 >= 29) {
+            fail(reader, EBADMSG);
+        } else {
+            symbol -= 257;
+            int length = lengthBase[symbol] + getBits(reader, lengthExtra[symbol]);
+            int code = decodeSymbol(reader, &reader->distances);
+            if (code < 0 || code >= MAX_DISTANCE_CODES) {
+                fail(reader, EBADMSG);
+                break;
+            }
+            int distance = distanceBase[code] + getBits(reader, distanceExtra[code]);
+            if ((uint64_t)distance > reader->total) {
+                fail(reader, EBADMSG);
+                break;
+            }
+            reader->matchLength = length;
+            reader->matchDistance = distance;
+        }
+    }
+    return produced;
+}
+
+GzipReader *gzipOpen(int fd) {
+    pthread_once(&crcOnce, crcInit);
+    GzipReader *reader = calloc(1, sizeof(GzipReader));
+    if (!reader) {
+        perror("calloc");
+        exit(1);
+    }
+    reader->fd = fd;
+    reader->state = GZIP_HEADER;
+    return reader;
+}
+
+void gzipClose(GzipReader *reader) {
+    free(reader);
+}
+
+ssize_t gzipRead(GzipReader *reader, void *buffer, size_t size) {
+    unsigned char *out = buffer;
+    size_t produced = 0, checked = 0;     // output up to `checked` is in the CRC
+
+    while (produced < size && !reader->error) {
+        switch (reader->state) {
+        case GZIP_HEADER:
+            readHeader(reader);
+            break;
+        case GZIP_BLOCK:
+            readBlockHeader(reader);
+            break;
+        case GZIP_STORED:
+            while (reader->stored && produced < size && !reader->error) {
+                EMIT(getBits(reader, 8));
+                reader->stored--;
+            }
+            if (!reader->stored) reader->state = reader->lastBlock ? GZIP_TRAILER : GZIP_BLOCK;
+            break;
+        case GZIP_CODES:
+            produced = inflateCodes(reader, out, produced, size);
+            break;
+        case GZIP_TRAILER:
+            reader->crc = crcUpdate(reader->crc, out + checked, produced - checked);
+            checked = produced;
+            readTrailer(reader);
+            break;
+        case GZIP_DONE:
+            reader->crc = crcUpdate(reader->crc, out + checked, produced - checked);
+            return produced;
+        }
+    }
+    if (reader->error) {
+        errno = reader->error;
+        return -1;
+    }
+    reader->crc = crcUpdate(reader->crc, out + checked, produced - checked);
+    return produced;
+}
+
+int gzipPath(const char *path) {
+    size_t length = strlen(path), suffix = strlen(GZIP_SUFFIX);
+    return length > suffix && strcasecmp(path + length - suffix, GZIP_SUFFIX) == 0;
+}
@@ -0,0 +1,31 @@
+#ifndef CDLAB_GZIP_H
+#define CDLAB_GZIP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// A pull decoder for gzip files (RFC 1952) and the deflate data in them
+// (RFC 1951), so archived dumps can be lexed without unpacking them to
+// disk first. Compressed bytes are read from the fd as the text is asked
+// for, and the decoder holds only the 32 KB history deflate refers back
+// to and one read buffer, however large the file. Concatenated members,
+// as written by "cat a.gz b.gz" or pigz, read as one text. Each member's
+// CRC-32 and length are checked at its end.
+typedef struct GzipReader GzipReader;
+
+#define GZIP_SUFFIX ".gz"
+
+// Allocation failures print an error and exit. The fd is not closed by
+// gzipClose.
+GzipReader *gzipOpen(int fd);
+void gzipClose(GzipReader *reader);
+
+// Reads up to `size` bytes of text. Returns the number read, 0 at the end,
+// or -1 with errno set: EBADMSG if the data is not gzip or is corrupt or
+// cut short, or whatever reading the fd failed with.
+ssize_t gzipRead(GzipReader *reader, void *buffer, size_t size);
+
+// 1 if `path` names a gzip file, by its suffix
+int gzipPath(const char *path);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "input.h"
+#include "gzip.h"
+#include "stats.h"
+
+#define READ_CHUNK (64 * 1024)
+
+// The file lent to this thread, if any
+static _Thread_local const char *lentName;
+static _Thread_local const char *lentData;
+static _Thread_local size_t lentSize;
+
+static void inputSet(Input *in, const char *data, size_t size, int mapped) {
+    in->data = data;
+    in->cur = data;
+    in->end = data + size;
+    in->size = size;
+    in->mapped = mapped;
+    in->borrowed = 0;
+}
+
+// Reads everything left on fd into one malloc'd buffer, first sized for
+// `expected` bytes
+static int inputSlurp(Input *in, int fd, size_t expected) {
+    size_t capacity = expected >= READ_CHUNK ? expected + 1 : READ_CHUNK, size = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer) return -1;
+
+    for (;;) {
+        if (size == capacity) {
+            char *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                return -1;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, buffer + size, capacity - size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            int saved = errno;
+            free(buffer);
+            errno = saved;
+            return -1;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+
+    inputSet(in, buffer, size, 0);
+    return 0;
+}
+
+// Inflates a whole gzip file into one malloc'd buffer
+static int inputInflate(Input *in, int fd) {
+    GzipReader *reader = gzipOpen(fd);
+    size_t capacity = READ_CHUNK, size = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        gzipClose(reader);
+        return -1;
+    }
+
+    for (;;) {
+        if (size == capacity) {
+            char *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                gzipClose(reader);
+                return -1;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        ssize_t n = gzipRead(reader, buffer + size, capacity - size);
+        if (n < 0) {
+            int saved = errno;
+            free(buffer);
+            gzipClose(reader);
+            errno = saved;
+            return -1;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+
+    gzipClose(reader);
+    inputSet(in, buffer, size, 0);
+    return 0;
+}
+
+static int inputOpenFd(Input *in, int fd, int map) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    if (!S_ISREG(st.st_mode)) return inputSlurp(in, fd, 0);
+
+    if (st.st_size == 0) {
+        inputSet(in, "", 0, 0);
+        in->mapped = 1;   // nothing to free
+        return 0;
+    }
+    if (map) {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+            inputSet(in, mapping, st.st_size, 1);
+            return 0;
+        }
+        // fall back to reading, e.g. on filesystems without mmap support
+    }
+    return inputSlurp(in, fd, st.st_size);
+}
+
+static int inputOpenPath(Input *in, const char *filename, int map) {
+    if (lentName && strcmp(filename, lentName) == 0) {
+        inputSet(in, lentData, lentSize, 0);
+        in->borrowed = 1;
+        return 0;
+    }
+    if (strcmp(filename, "-") == 0) return inputOpenFd(in, STDIN_FILENO, map);
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    int result = gzipPath(filename) ? inputInflate(in, fd) : inputOpenFd(in, fd, map);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return result;
+}
+
+static int inputOpenCounted(Input *in, const char *filename, int map) {
+    int phase = statsEnter(PHASE_READ);
+    int result = inputOpenPath(in, filename, map);
+    if (result == 0 && statsCurrent) statsCurrent->bytes += in->size;
+    statsLeave(phase);
+    return result;
+}
+
+int inputOpen(Input *in, const char *filename) {
+    return inputOpenCounted(in, filename, 1);
+}
+
+int inputRead(Input *in, const char *filename) {
+    return inputOpenCounted(in, filename, 0);
+}
+
+int inputOpenStream(Input *in, FILE *stream) {
+    return inputOpenFd(in, fileno(stream), 1);
+}
+
+void inputLend(const char *filename, const char *data, size_t size) {
+    lentName = filename;
+    lentData = data;
+    lentSize = size;
+}
+
+void inputLendEnd(void) {
+    lentName = NULL;
+    lentData = NULL;
+    lentSize = 0;
+}
+
+void inputClose(Input *in) {
+    if (in->borrowed) {
+        // the lender frees it
+    } else if (in->mapped) {
+        if (in->size > 0) munmap((void *)in->data, in->size);
+    } else {
+        free((void *)in->data);
+    }
+    inputSet(in, NULL, 0, 0);
+}
@@ -0,0 +1,64 @@
+#ifndef CDLAB_INPUT_H
+#define CDLAB_INPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Whole-file input shared by all lexers. Regular files are memory-mapped,
+// pipes and terminals are read into one buffer, and the lexers walk the
+// bytes through a plain pointer cursor instead of fgetc/ungetc.
+typedef struct {
+    const char *data;   // first byte of the input
+    const char *cur;    // next byte to be read
+    const char *end;    // one past the last byte
+    size_t size;
+    int mapped;         // 1 if data is an mmap, 0 if it was read into memory
+    int borrowed;       // 1 if data was lent with inputLend and is not ours to free
+} Input;
+
+// Returns 0 on success, -1 with errno set on failure. "-" reads stdin. A
+// file named *.gz is inflated as it is read (see gzip.h), so the lexers
+// see its text.
+int inputOpen(Input *in, const char *filename);
+
+// inputOpen, but a regular file is read into memory instead of mapped. A
+// mapping faults with SIGBUS once another process truncates the file under
+// it, so processes that stay up while others edit the files they analyze
+// (the daemon, programs linking libcdlab) read them instead.
+int inputRead(Input *in, const char *filename);
+
+// Until inputLendEnd, inputOpen of `filename` on this thread returns the
+// lent bytes instead of touching the file, so a file loaded ahead of time
+// reaches whichever analyzer opens it. The caller keeps ownership of
+// `data` and frees it after inputLendEnd.
+void inputLend(const char *filename, const char *data, size_t size);
+void inputLendEnd(void);
+int inputOpenStream(Input *in, FILE *stream);
+void inputClose(Input *in);
+
+static inline int inputGet(Input *in) {
+    return in->cur < in->end ? (unsigned char)*in->cur++ : EOF;
+}
+
+// Steps back over ch, which must be the byte inputGet just returned
+static inline void inputUnget(Input *in, int ch) {
+    if (ch != EOF) in->cur--;
+}
+
+static inline int inputPeek(const Input *in, size_t ahead) {
+    return (size_t)(in->end - in->cur) > ahead ? (unsigned char)in->cur[ahead] : EOF;
+}
+
+static inline size_t inputTell(const Input *in) {
+    return in->cur - in->data;
+}
+
+static inline void inputSeek(Input *in, size_t offset) {
+    in->cur = in->data + (offset < in->size ? offset : in->size);
+}
+
+static inline void inputRewind(Input *in) {
+    in->cur = in->data;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "alloc.h"
+#include "intern.h"
+
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+#define INTERN_FIRST_SLOTS 256
+#define INTERN_PAGE_BITS 14             // IDs per page of the ID table
+#define INTERN_PAGE_SIZE (1 << INTERN_PAGE_BITS)
+#define INTERN_PAGES (1 << 18)          // 2^32 IDs in all
+#define INTERN_BLOCK_SIZE (64 * 1024)   // name text is carved out of these
+
+typedef struct {
+    const char *text;
+    size_t length;
+} NameEntry;
+
+// The hash is kept next to the ID so that most probes never touch the text
+typedef struct {
+    unsigned hash;
+    NameId id;                  // NAME_EMPTY if the slot is free
+} InternSlot;
+
+typedef struct {
+    pthread_mutex_t lock;
+    InternSlot *slots;
+    size_t slotCount;
+    size_t used;
+    char *block;                // free space for new names' text
+    size_t blockLeft;
+    char *blocks;               // every allocation holding text, chained through its first bytes
+} InternShard;
+
+struct NamePool {
+    InternShard shards[INTERN_SHARDS];
+    // Pages are created on demand and never move, so nameText can read
+    // them without a lock
+    NameEntry *pages[INTERN_PAGES];
+    pthread_mutex_t pageLock;
+    NameId nextId;
+};
+
+static NamePool sharedPool = {.pageLock = PTHREAD_MUTEX_INITIALIZER, .nextId = 1};
+static pthread_once_t sharedReady = PTHREAD_ONCE_INIT;
+
+_Thread_local NamePool *namePoolCurrent = NULL;
+
+static void initShards(NamePool *pool) {
+    for (int i = 0; i < INTERN_SHARDS; i++) pthread_mutex_init(&pool->shards[i].lock, NULL);
+}
+
+static void initShared(void) {
+    initShards(&sharedPool);
+}
+
+static NamePool *currentPool(void) {
+    if (namePoolCurrent) return namePoolCurrent;
+    pthread_once(&sharedReady, initShared);
+    return &sharedPool;
+}
+
+NamePool *namePoolCreate(void) {
+    NamePool *pool = checkedAlloc(calloc(1, sizeof(NamePool)));
+    initShards(pool);
+    pthread_mutex_init(&pool->pageLock, NULL);
+    pool->nextId = 1;
+    return pool;
+}
+
+void namePoolClear(NamePool *pool) {
+    for (int i = 0; i < INTERN_SHARDS; i++) {
+        InternShard *shard = &pool->shards[i];
+        while (shard->blocks) {
+            char *next = *(char **)shard->blocks;
+            free(shard->blocks);
+            shard->blocks = next;
+        }
+        shard->block = NULL;
+        shard->blockLeft = 0;
+        if (shard->slots) memset(shard->slots, 0, shard->slotCount * sizeof(InternSlot));
+        shard->used = 0;
+    }
+    pool->nextId = 1;
+}
+
+void namePoolFree(NamePool *pool) {
+    if (!pool) return;
+    namePoolClear(pool);
+    for (int i = 0; i < INTERN_SHARDS; i++) {
+        free(pool->shards[i].slots);
+        pthread_mutex_destroy(&pool->shards[i].lock);
+    }
+    for (size_t i = 0; i < INTERN_PAGES && pool->pages[i]; i++) free(pool->pages[i]);
+    pthread_mutex_destroy(&pool->pageLock);
+    free(pool);
+}
+
+// FNV-1a; the top bits pick the shard and the low bits the slot
+static unsigned long long hashName(const char *text, size_t length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+    return hash;
+}
+
+static NameEntry *entryFor(NamePool *pool, NameId id) {
+    NameEntry *page = __atomic_load_n(&pool->pages[id >> INTERN_PAGE_BITS], __ATOMIC_ACQUIRE);
+    return &page[id & (INTERN_PAGE_SIZE - 1)];
+}
+
+static InternSlot *findSlot(NamePool *pool, InternShard *shard, unsigned hash, const char *text,
+                            size_t length) {
+    size_t mask = shard->slotCount - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        InternSlot *slot = &shard->slots[i];
+        if (slot->id == NAME_EMPTY) return slot;
+        if (slot->hash != hash) continue;
+        NameEntry *entry = entryFor(pool, slot->id);
+        if (entry->length == length && memcmp(entry->text, text, length) == 0) return slot;
+    }
+}
+
+static void growShard(InternShard *shard) {
+    InternSlot *old = shard->slots;
+    size_t oldCount = shard->slotCount;
+    shard->slotCount = oldCount ? oldCount * 2 : INTERN_FIRST_SLOTS;
+    shard->slots = checkedAlloc(calloc(shard->slotCount, sizeof(InternSlot)));
+    size_t mask = shard->slotCount - 1;
+    for (size_t i = 0; i < oldCount; i++) {
+        if (old[i].id == NAME_EMPTY) continue;
+        size_t j = old[i].hash & mask;
+        while (shard->slots[j].id != NAME_EMPTY) j = (j + 1) & mask;
+        shard->slots[j] = old[i];
+    }
+    free(old);
+}
+
+// Chains a new allocation for text onto the shard, so a pool can free it
+static char *newBlock(InternShard *shard, size_t size) {
+    char *block = checkedAlloc(malloc(sizeof(char *) + size));
+    *(char **)block = shard->blocks;
+    shard->blocks = block;
+    return block + sizeof(char *);
+}
+
+static const char *storeText(InternShard *shard, const char *text, size_t length) {
+    char *copy;
+    if (length + 1 > INTERN_BLOCK_SIZE / 4) {
+        copy = newBlock(shard, length + 1);
+    } else {
+        if (length + 1 > shard->blockLeft) {
+            shard->block = newBlock(shard, INTERN_BLOCK_SIZE);
+            shard->blockLeft = INTERN_BLOCK_SIZE;
+        }
+        copy = shard->block;
+        shard->block += length + 1;
+        shard->blockLeft -= length + 1;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static NameEntry *newEntry(NamePool *pool, NameId id) {
+    size_t page = id >> INTERN_PAGE_BITS;
+    if (page >= INTERN_PAGES) {
+        fprintf(stderr, "Too many distinct names\n");
+        exit(1);
+    }
+    if (!__atomic_load_n(&pool->pages[page], __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&pool->pageLock);
+        if (!pool->pages[page]) {
+            NameEntry *created = checkedAlloc(calloc(INTERN_PAGE_SIZE, sizeof(NameEntry)));
+            __atomic_store_n(&pool->pages[page], created, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&pool->pageLock);
+    }
+    return entryFor(pool, id);
+}
+
+NameId internName(const char *text, size_t length) {
+    if (length == 0) return NAME_EMPTY;
+    NamePool *pool = currentPool();
+
+    unsigned long long hash = hashName(text, length);
+    InternShard *shard = &pool->shards[hash >> (64 - INTERN_SHARD_BITS)];
+    pthread_mutex_lock(&shard->lock);
+    if ((shard->used + 1) * 2 > shard->slotCount) growShard(shard);
+    InternSlot *slot = findSlot(pool, shard, (unsigned)hash, text, length);
+    if (slot->id == NAME_EMPTY) {
+        NameId id = __atomic_fetch_add(&pool->nextId, 1, __ATOMIC_RELAXED);
+        NameEntry *entry = newEntry(pool, id);
+        entry->text = storeText(shard, text, length);
+        entry->length = length;
+        slot->hash = (unsigned)hash;
+        slot->id = id;
+        shard->used++;
+    }
+    NameId id = slot->id;
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+}
+
+NameId nameFind(const char *text, size_t length) {
+    if (length == 0) return NAME_EMPTY;
+    NamePool *pool = currentPool();
+
+    unsigned long long hash = hashName(text, length);
+    InternShard *shard = &pool->shards[hash >> (64 - INTERN_SHARD_BITS)];
+    pthread_mutex_lock(&shard->lock);
+    NameId id = NAME_NONE;
+    if (shard->slotCount > 0) {
+        InternSlot *slot = findSlot(pool, shard, (unsigned)hash, text, length);
+        if (slot->id != NAME_EMPTY) id = slot->id;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+}
+
+const char *nameText(NameId id) {
+    return id == NAME_EMPTY ? "" : entryFor(currentPool(), id)->text;
+}
+
+size_t nameLength(NameId id) {
+    return id == NAME_EMPTY ? 0 : entryFor(currentPool(), id)->length;
+}
+
+size_t nameCount(void) {
+    return __atomic_load_n(&currentPool()->nextId, __ATOMIC_RELAXED) - 1;
+}
@@ -0,0 +1,47 @@
+#ifndef CDLAB_INTERN_H
+#define CDLAB_INTERN_H
+
+#include <stddef.h>
+
+// One pool of names shared by every analyzer and thread. Each distinct
+// lexeme is stored once and gets a small integer ID, so symbol tables hold
+// four-byte IDs, equal names compare as equal integers, and memory grows
+// with the number of distinct names rather than how often they appear.
+// Names live until the process exits.
+//
+// A program that analyzes for a long time can give a thread a pool of its
+// own instead, and free the names with it when it is done with them.
+//
+// The pool is split into shards by hash, each with its own lock, so threads
+// interning different names seldom wait for each other. Looking up the
+// text of an ID takes no lock at all.
+typedef unsigned int NameId;
+typedef struct NamePool NamePool;
+
+#define NAME_EMPTY 0                // "" is always 0
+#define NAME_NONE 0xffffffffu       // from nameFind, for names never interned
+
+// Returns the name's ID, adding it to the pool if it is new. Allocation
+// failures print an error and exit.
+NameId internName(const char *text, size_t length);
+
+// The ID of a name already in the pool, or NAME_NONE; never adds it
+NameId nameFind(const char *text, size_t length);
+
+// The NUL-terminated text of an ID that internName returned
+const char *nameText(NameId id);
+size_t nameLength(NameId id);
+
+// Distinct names interned so far, not counting ""
+size_t nameCount(void);
+
+// While set, the functions above use this pool on this thread instead of
+// the shared one. IDs from one pool mean nothing in another.
+extern _Thread_local NamePool *namePoolCurrent;
+
+// Allocation failures print an error and exit
+NamePool *namePoolCreate(void);
+void namePoolClear(NamePool *pool);     // forgets every name; IDs start again at 1
+void namePoolFree(NamePool *pool);
+
+#endif
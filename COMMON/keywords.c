@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "alloc.h"
+#include "keywords.h"
+#include "stats.h"
+
+#define MAX_SEED_ATTEMPTS 256
+#define MAX_DISPLACEMENT (1u << 16)
+#define KEYS_PER_BUCKET 4
+
+// Serialises the one-time build when several threads hit a fresh set
+static pthread_mutex_t buildLock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+// FNV-1a with a 64-bit finaliser; the top half picks the bucket and the
+// bottom half, mixed with the bucket's displacement, picks the slot
+static inline uint64_t keywordHash(const char *text, size_t length, int ignoreCase, uint32_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = text[i];
+        if (ignoreCase) c = foldCase(c);
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint32_t bucketOf(const KeywordSet *set, uint64_t h) {
+    return (uint32_t)(((h >> 32) * set->bucketCount) >> 32);
+}
+
+static inline uint32_t slotOf(const KeywordSet *set, uint64_t h, uint32_t displacement) {
+    return (((uint32_t)h ^ displacement) * 0x9E3779B1u) >> set->shift;
+}
+
+static int sameWord(const KeywordSet *set, const char *a, const char *b) {
+    return set->ignoreCase ? strcasecmp(a, b) == 0 : strcmp(a, b) == 0;
+}
+
+// Places every bucket, largest first, by searching for a displacement that
+// sends all of its words to free slots. Returns 0 if some bucket cannot be
+// placed with this seed.
+static int placeBuckets(KeywordSet *set, const uint64_t *hashes, const int *unique,
+                        int *members, uint32_t slotCount) {
+    int *bucketSize = checkedAlloc(calloc(set->bucketCount, sizeof(int)));
+    int largest = 0;
+    for (int i = 0; i < set->count; i++) {
+        if (!unique[i]) continue;
+        int size = ++bucketSize[bucketOf(set, hashes[i])];
+        if (size > largest) largest = size;
+    }
+
+    for (uint32_t i = 0; i < slotCount; i++) set->slots[i] = -1;
+
+    int placed = 1;
+    for (int size = largest; size > 0 && placed; size--) {
+        for (uint32_t b = 0; b < set->bucketCount && placed; b++) {
+            if (bucketSize[b] != size) continue;
+
+            int memberCount = 0;
+            for (int i = 0; i < set->count; i++) {
+                if (unique[i] && bucketOf(set, hashes[i]) == b) members[memberCount++] = i;
+            }
+
+            placed = 0;
+            for (uint32_t d = 0; d < MAX_DISPLACEMENT && !placed; d++) {
+                int m;
+                for (m = 0; m < memberCount; m++) {
+                    uint32_t slot = slotOf(set, hashes[members[m]], d);
+                    if (set->slots[slot] >= 0) break;
+                    set->slots[slot] = members[m];
+                }
+                if (m == memberCount) {
+                    set->displacement[b] = d;
+                    placed = 1;
+                } else {
+                    while (m-- > 0) set->slots[slotOf(set, hashes[members[m]], d)] = -1;
+                }
+            }
+        }
+    }
+
+    free(bucketSize);
+    return placed;
+}
+
+static void keywordSetBuild(KeywordSet *set) {
+    pthread_mutex_lock(&buildLock);
+    if (set->ready) {
+        pthread_mutex_unlock(&buildLock);
+        return;
+    }
+
+    // Duplicate entries would never separate, so only the first is hashed
+    int *unique = checkedAlloc(calloc(set->count, sizeof(int)));
+    set->lengths = checkedAlloc(calloc(set->count, sizeof(uint16_t)));
+    int uniqueCount = 0;
+    for (int i = 0; i < set->count; i++) {
+        size_t length = strlen(set->words[i]);
+        set->lengths[i] = length;
+        if (length > set->maxLength) set->maxLength = length;
+        unique[i] = 1;
+        for (int j = 0; j < i && unique[i]; j++) {
+            if (sameWord(set, set->words[i], set->words[j])) unique[i] = 0;
+        }
+        uniqueCount += unique[i];
+    }
+
+    uint32_t slotCount = 2;
+    while (slotCount < 2 * (uint32_t)uniqueCount) slotCount *= 2;
+    set->bucketCount = uniqueCount / KEYS_PER_BUCKET + 1;
+
+    uint64_t *hashes = checkedAlloc(calloc(set->count, sizeof(uint64_t)));
+    int *members = checkedAlloc(calloc(set->count, sizeof(int)));
+    set->displacement = checkedAlloc(calloc(set->bucketCount, sizeof(uint32_t)));
+
+    int built = 0;
+    for (uint32_t attempt = 0; attempt < MAX_SEED_ATTEMPTS && !built; attempt++) {
+        // Grow the table every so often in case the load is what blocks us
+        if (attempt > 0 && attempt % 32 == 0) slotCount *= 2;
+        free(set->slots);
+        set->slots = checkedAlloc(calloc(slotCount, sizeof(int16_t)));
+        set->shift = 32 - __builtin_ctz(slotCount);
+        set->seed = attempt * 0x9E3779B9u;
+
+        for (int i = 0; i < set->count; i++) {
+            hashes[i] = keywordHash(set->words[i], set->lengths[i], set->ignoreCase, set->seed);
+        }
+        built = placeBuckets(set, hashes, unique, members, slotCount);
+    }
+    if (!built) {
+        fprintf(stderr, "keywordSetBuild: no perfect hash for table starting \"%s\"\n",
+                set->count ? set->words[0] : "");
+        exit(1);
+    }
+
+    free(hashes);
+    free(members);
+    free(unique);
+    __atomic_store_n(&set->ready, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&buildLock);
+}
+
+static int keywordSetLookup(KeywordSet *set, const char *text, size_t length) {
+    if (!__atomic_load_n(&set->ready, __ATOMIC_ACQUIRE)) keywordSetBuild(set);
+    if (length == 0 || length > set->maxLength) return -1;
+
+    uint64_t h = keywordHash(text, length, set->ignoreCase, set->seed);
+    int index = set->slots[slotOf(set, h, set->displacement[bucketOf(set, h)])];
+    if (index < 0 || set->lengths[index] != length) return -1;
+
+    const char *word = set->words[index];
+    if (set->ignoreCase) {
+        return strncasecmp(text, word, length) == 0 ? index : -1;
+    }
+    return memcmp(text, word, length) == 0 ? index : -1;
+}
+
+int keywordSetFind(KeywordSet *set, const char *text, size_t length) {
+    if (!statsCurrent) return keywordSetLookup(set, text, length);
+
+    int phase = statsEnter(PHASE_KEYWORDS);
+    statsCurrent->keywordLookups++;
+    int index = keywordSetLookup(set, text, length);
+    statsLeave(phase);
+    return index;
+}
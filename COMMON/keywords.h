@@ -0,0 +1,38 @@
+#ifndef CDLAB_KEYWORDS_H
+#define CDLAB_KEYWORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Perfect-hash lookup over a static word table. The analyzers keep their
+// plain `static const char *keywords[]` arrays; the first lookup builds a
+// collision-free table for them (hash-and-displace, seed searched), after
+// which every lookup is one hash of the lexeme and one compare.
+typedef struct {
+    const char *const *words;
+    int count;
+    int ignoreCase;     // ASCII case-insensitive (SQL, PL/SQL, PowerShell, asm)
+
+    // Filled in by the first lookup
+    int ready;
+    uint32_t seed;
+    uint32_t bucketCount;
+    int shift;          // 32 - log2(slot count)
+    uint32_t *displacement;
+    int16_t *slots;     // word index, or -1 for an empty slot
+    uint16_t *lengths;
+    size_t maxLength;
+} KeywordSet;
+
+// The lookup fields start zeroed; naming them keeps -Wextra quiet
+#define KEYWORD_SET(table, wordCount, caseless) \
+    { .words = (table), .count = (int)(wordCount), .ignoreCase = (caseless), .ready = 0 }
+
+// Returns the index of the matching word in the table, or -1
+int keywordSetFind(KeywordSet *set, const char *text, size_t length);
+
+static inline int keywordSetContains(KeywordSet *set, const char *text, size_t length) {
+    return keywordSetFind(set, text, length) >= 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <stddef.h>
+
+#include "scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && !defined(CDLAB_NO_SIMD)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// isspace() in the C locale: ' ' and '\t' through '\r'
+static inline int isSpaceByte(unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static const char *scanSpaceScalar(const char *p, const char *end) {
+    while (p < end && isSpaceByte(*p)) p++;
+    return p;
+}
+
+static const char *scanPairScalar(const char *p, const char *end, int a, int b) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == (char)a && p[1] == (char)b) return p;
+    }
+    return end;
+}
+
+#ifdef SCAN_X86
+
+// A byte is whitespace if it is ' ' or (c - '\t') <= 4 unsigned; min_epu8
+// does the unsigned compare that SSE2 lacks
+static const char *scanSpaceSSE2(const char *p, const char *end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i span = _mm_set1_epi8('\r' - '\t');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i shifted = _mm_sub_epi8(v, tab);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, span), shifted);
+        __m128i blank = _mm_or_si128(control, _mm_cmpeq_epi8(v, space));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(blank) & 0xffff;
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return scanSpaceScalar(p, end);
+}
+
+static const char *scanPairSSE2(const char *p, const char *end, int a, int b) {
+    const __m128i first = _mm_set1_epi8((char)a);
+    const __m128i second = _mm_set1_epi8((char)b);
+    while (end - p >= 17) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 1));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(v0, first), _mm_cmpeq_epi8(v1, second));
+        unsigned mask = _mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return scanPairScalar(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char *scanSpaceAVX2(const char *p, const char *end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i span = _mm256_set1_epi8('\r' - '\t');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i shifted = _mm256_sub_epi8(v, tab);
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, span), shifted);
+        __m256i blank = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, space));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(blank);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scanSpaceSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanPairAVX2(const char *p, const char *end, int a, int b) {
+    const __m256i first = _mm256_set1_epi8((char)a);
+    const __m256i second = _mm256_set1_epi8((char)b);
+    while (end - p >= 33) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(v0, first), _mm256_cmpeq_epi8(v1, second));
+        unsigned mask = _mm256_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scanPairSSE2(p, end, a, b);
+}
+
+// Chosen once before main() so the lexer threads only ever read them
+static const char *(*scanSpaceKernel)(const char *, const char *) = scanSpaceSSE2;
+static const char *(*scanPairKernel)(const char *, const char *, int, int) = scanPairSSE2;
+
+__attribute__((constructor))
+static void scanSelectKernels(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanSpaceKernel = scanSpaceAVX2;
+        scanPairKernel = scanPairAVX2;
+    }
+}
+
+#else
+
+static const char *(*const scanSpaceKernel)(const char *, const char *) = scanSpaceScalar;
+static const char *(*const scanPairKernel)(const char *, const char *, int, int) = scanPairScalar;
+
+#endif
+
+// Most runs are a single space or a newline and some indentation, so the
+// first byte is tested before paying for a kernel call
+const char *scanSpace(const char *p, const char *end) {
+    if (p == end || !isSpaceByte(*p)) return p;
+    return scanSpaceKernel(p + 1, end);
+}
+
+const char *scanPair(const char *p, const char *end, int a, int b) {
+    return scanPairKernel(p, end, a, b);
+}
@@ -0,0 +1,58 @@
+#ifndef CDLAB_SCAN_H
+#define CDLAB_SCAN_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "input.h"
+
+// Skip kernels shared by the lexers. Whitespace runs and comment bodies are
+// where a lexer spends most of its bytes, so instead of testing one byte per
+// inputGet() these compare 16 (SSE2) or 32 (AVX2) bytes at a time. AVX2 is
+// picked at startup when the CPU has it; other targets, and builds with
+// -DCDLAB_NO_SIMD, use the scalar loops.
+
+// First byte in [p, end) that is not C-locale isspace(), or end
+const char *scanSpace(const char *p, const char *end);
+
+// First `a` in [p, end) immediately followed by `b`, or end
+const char *scanPair(const char *p, const char *end, int a, int b);
+
+// Moves past a run of whitespace
+static inline void inputSkipSpace(Input *in) {
+    in->cur = scanSpace(in->cur, in->end);
+}
+
+// Moves to the next `c` without consuming it, or to the end of the input.
+// glibc's memchr is already a vector search, so single bytes go through it.
+static inline void inputSkipTo(Input *in, int c) {
+    const char *found = memchr(in->cur, c, in->end - in->cur);
+    in->cur = found ? found : in->end;
+}
+
+// Moves past the end of a line comment, newline included
+static inline void inputSkipLine(Input *in) {
+    inputSkipTo(in, '\n');
+    if (in->cur < in->end) in->cur++;
+}
+
+// Moves past the next `terminator` (two or more bytes, e.g. "*/", "#>",
+// "-->"), or to the end of the input if the comment is never closed
+static inline void inputSkipPast(Input *in, const char *terminator) {
+    size_t length = strlen(terminator);
+    const char *p = in->cur;
+    for (;;) {
+        p = scanPair(p, in->end, terminator[0], terminator[1]);
+        if ((size_t)(in->end - p) < length) {
+            in->cur = in->end;
+            return;
+        }
+        if (memcmp(p, terminator, length) == 0) {
+            in->cur = p + length;
+            return;
+        }
+        p++;
+    }
+}
+
+#endif
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE             // RUSAGE_THREAD
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "stats.h"
+
+_Thread_local FileStats *statsCurrent = NULL;
+
+static const char *const phaseNames[PHASE_COUNT] = {
+    [PHASE_LEX] = "lex",
+    [PHASE_READ] = "read",
+    [PHASE_KEYWORDS] = "keywords",
+    [PHASE_SYMBOLS] = "symbols",
+    [PHASE_OUTPUT] = "output",
+};
+
+// Phase switches happen per token, so they read the TSC where there is one
+// and convert to seconds once per file against the monotonic clock
+static inline uint64_t statsTicks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static double wallClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void statsBegin(FileStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        stats->minorFaults = -usage.ru_minflt;
+        stats->majorFaults = -usage.ru_majflt;
+    }
+    stats->phase = PHASE_LEX;
+    stats->startTime = wallClock();
+    stats->startTicks = stats->phaseStart = statsTicks();
+    statsCurrent = stats;
+}
+
+void statsEnd(FileStats *stats) {
+    uint64_t now = statsTicks();
+    stats->ticks[stats->phase] += now - stats->phaseStart;
+    statsCurrent = NULL;
+
+    double elapsed = wallClock() - stats->startTime;
+    uint64_t ticks = now - stats->startTicks;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        stats->seconds[i] = ticks ? elapsed * stats->ticks[i] / ticks : 0;
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        stats->minorFaults += usage.ru_minflt;
+        stats->majorFaults += usage.ru_majflt;
+    }
+    if (getrusage(RUSAGE_SELF, &usage) == 0) stats->peakKB = usage.ru_maxrss;
+}
+
+StatsPhase statsSwitch(StatsPhase phase) {
+    FileStats *stats = statsCurrent;
+    uint64_t now = statsTicks();
+    StatsPhase previous = stats->phase;
+    stats->ticks[previous] += now - stats->phaseStart;
+    stats->phaseStart = now;
+    stats->phase = phase;
+    return previous;
+}
+
+static const char *typeName(const TokenFormat *format, int type) {
+    if (format && type >= 0 && type < format->typeCount && format->typeNames[type]) {
+        return format->typeNames[type];
+    }
+    return "UNKNOWN";
+}
+
+// Keeps `list` sorted longest first; ties keep the earlier token
+static void keepLongest(LongToken *list, const LongToken *candidate) {
+    int at = STATS_LONGEST;
+    while (at > 0 && list[at - 1].length < candidate->length) at--;
+    if (at == STATS_LONGEST) return;
+    memmove(&list[at + 1], &list[at], (STATS_LONGEST - 1 - at) * sizeof(LongToken));
+    list[at] = *candidate;
+}
+
+void statsToken(const Input *in, const Token *token, const TokenFormat *format) {
+    FileStats *stats = statsCurrent;
+    stats->tokens++;
+    stats->format = format;
+    if (token->type >= 0 && token->type < STATS_MAX_TYPES) stats->typeCounts[token->type]++;
+
+    if (token->length <= stats->longest[STATS_LONGEST - 1].length) return;
+    LongToken candidate = { token->length, token->offset, typeName(format, token->type), NULL, "" };
+    const char *text = tokenText(in, token);
+    size_t shown = token->length < sizeof(candidate.text) - 1 ? token->length : sizeof(candidate.text) - 1;
+    for (size_t i = 0; i < shown; i++) {
+        unsigned char c = text[i];
+        candidate.text[i] = (c < ' ' || c == 0x7f) ? ' ' : c;
+    }
+    candidate.text[shown] = '\0';
+    keepLongest(stats->longest, &candidate);
+}
+
+static void addTypeCount(StatsTotals *totals, const char *name, long long count) {
+    for (int i = 0; i < totals->typeCount; i++) {
+        if (strcmp(totals->types[i].name, name) == 0) {
+            totals->types[i].count += count;
+            return;
+        }
+    }
+    if (totals->typeCount == STATS_MAX_TYPE_NAMES) return;
+    totals->types[totals->typeCount].name = name;
+    totals->types[totals->typeCount].count = count;
+    totals->typeCount++;
+}
+
+void statsAdd(StatsTotals *totals, const FileStats *stats, const char *path) {
+    totals->files++;
+    for (int i = 0; i < PHASE_COUNT; i++) totals->seconds[i] += stats->seconds[i];
+    totals->bytes += stats->bytes;
+    totals->tokens += stats->tokens;
+    totals->keywordLookups += stats->keywordLookups;
+    totals->symbols += stats->symbols;
+    totals->minorFaults += stats->minorFaults;
+    totals->majorFaults += stats->majorFaults;
+    for (int type = 0; type < STATS_MAX_TYPES; type++) {
+        if (stats->typeCounts[type]) {
+            addTypeCount(totals, typeName(stats->format, type), stats->typeCounts[type]);
+        }
+    }
+    for (int i = 0; i < STATS_LONGEST && stats->longest[i].length; i++) {
+        LongToken token = stats->longest[i];
+        token.path = path;
+        keepLongest(totals->longest, &token);
+    }
+}
+
+void statsMerge(StatsTotals *into, const StatsTotals *from) {
+    into->files += from->files;
+    for (int i = 0; i < PHASE_COUNT; i++) into->seconds[i] += from->seconds[i];
+    into->bytes += from->bytes;
+    into->tokens += from->tokens;
+    into->keywordLookups += from->keywordLookups;
+    into->symbols += from->symbols;
+    into->minorFaults += from->minorFaults;
+    into->majorFaults += from->majorFaults;
+    for (int i = 0; i < from->typeCount; i++) {
+        addTypeCount(into, from->types[i].name, from->types[i].count);
+    }
+    for (int i = 0; i < STATS_LONGEST && from->longest[i].length; i++) {
+        keepLongest(into->longest, &from->longest[i]);
+    }
+}
+
+// Each file's block is written under the stream lock so that parallel
+// workers do not interleave
+void statsPrintFile(FILE *out, const FileStats *stats, const char *path, const char *language) {
+    flockfile(out);
+    fprintf(out, "stats: %s [%s] %lld bytes, %lld tokens, %d symbols, %lld keyword lookups\n",
+            path, language, stats->bytes, stats->tokens, stats->symbols, stats->keywordLookups);
+    fprintf(out, "  ms:");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(out, " %s %.3f", phaseNames[i], stats->seconds[i] * 1e3);
+    }
+    fprintf(out, "; faults %ld/%ld; peak RSS %ld KB\n",
+            stats->minorFaults, stats->majorFaults, stats->peakKB);
+
+    fprintf(out, "  types:");
+    for (int type = 0; type < STATS_MAX_TYPES; type++) {
+        if (stats->typeCounts[type]) {
+            fprintf(out, " %s %lld", typeName(stats->format, type), stats->typeCounts[type]);
+        }
+    }
+    fprintf(out, "\n");
+    for (int i = 0; i < STATS_LONGEST && stats->longest[i].length; i++) {
+        fprintf(out, "  longest: %zu %s at %zu \"%s\"\n", stats->longest[i].length,
+                stats->longest[i].type, stats->longest[i].offset, stats->longest[i].text);
+    }
+    funlockfile(out);
+}
+
+static int compareTypeCounts(const void *a, const void *b) {
+    const TypeCount *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+void statsPrintTotals(FILE *out, const StatsTotals *totals) {
+    double seconds = 0;
+    for (int i = 0; i < PHASE_COUNT; i++) seconds += totals->seconds[i];
+
+    fprintf(out, "\nStats for %d analyzed files: %lld bytes, %lld tokens, %lld symbols, "
+                 "%lld keyword lookups\n", totals->files, totals->bytes, totals->tokens,
+            totals->symbols, totals->keywordLookups);
+    fprintf(out, "  %-10s %12s %7s\n", "phase", "seconds", "share");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(out, "  %-10s %12.6f %6.1f%%\n", phaseNames[i], totals->seconds[i],
+                seconds > 0 ? 100 * totals->seconds[i] / seconds : 0);
+    }
+    fprintf(out, "  %-10s %12.6f\n", "total", seconds);
+    if (seconds > 0) {
+        fprintf(out, "  %.1f MB/s, %.0f tokens/s\n",
+                totals->bytes / seconds / (1 << 20), totals->tokens / seconds);
+    }
+
+    struct rusage usage;
+    long peakKB = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    fprintf(out, "  page faults %ld minor, %ld major; peak RSS %ld KB\n",
+            totals->minorFaults, totals->majorFaults, peakKB);
+
+    TypeCount types[STATS_MAX_TYPE_NAMES];
+    memcpy(types, totals->types, totals->typeCount * sizeof(TypeCount));
+    qsort(types, totals->typeCount, sizeof(TypeCount), compareTypeCounts);
+    fprintf(out, "  Token types:\n");
+    for (int i = 0; i < totals->typeCount; i++) {
+        fprintf(out, "    %-20s %12lld %6.1f%%\n", types[i].name, types[i].count,
+                totals->tokens ? 100.0 * types[i].count / totals->tokens : 0);
+    }
+    fprintf(out, "  Longest tokens:\n");
+    for (int i = 0; i < STATS_LONGEST && totals->longest[i].length; i++) {
+        const LongToken *token = &totals->longest[i];
+        fprintf(out, "    %8zu %-16s %s:%zu \"%s\"\n", token->length, token->type,
+                token->path, token->offset, token->text);
+    }
+}
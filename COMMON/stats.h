@@ -0,0 +1,109 @@
+#ifndef CDLAB_STATS_H
+#define CDLAB_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "input.h"
+#include "token.h"
+#include "tokenstream.h"
+
+// Opt-in instrumentation behind cdlab --stats. A thread collects numbers
+// only while it has a FileStats attached with statsBegin(); otherwise every
+// hook below is a thread-local load and a not-taken branch.
+//
+// Time is charged to exactly one phase at a time. Whatever an analyzer does
+// outside the other phases counts as lexing; the hooks in inputOpen,
+// keywordSetFind, the extract* calls and the token stream switch to their
+// own phase and back.
+typedef enum {
+    PHASE_LEX,
+    PHASE_READ,
+    PHASE_KEYWORDS,
+    PHASE_SYMBOLS,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+} StatsPhase;
+
+#define STATS_LONGEST 5             // longest tokens kept per file and overall
+#define STATS_LONGEST_TEXT 40       // bytes of each long token kept for display
+#define STATS_MAX_TYPES 32          // token types counted per file
+#define STATS_MAX_TYPE_NAMES 64     // distinct type names in the totals
+
+typedef struct {
+    size_t length;
+    size_t offset;
+    const char *type;
+    const char *path;               // filled in by statsAdd
+    char text[STATS_LONGEST_TEXT];
+} LongToken;
+
+typedef struct {
+    double seconds[PHASE_COUNT];
+    long long bytes;
+    long long tokens;
+    long long keywordLookups;
+    long long typeCounts[STATS_MAX_TYPES];
+    const TokenFormat *format;      // names the types in typeCounts
+    LongToken longest[STATS_LONGEST];   // longest first
+    int symbols;                    // symbol table entries found
+    long minorFaults;
+    long majorFaults;
+    long peakKB;                    // process peak RSS when the file finished
+
+    // Clock state while attached
+    StatsPhase phase;
+    uint64_t ticks[PHASE_COUNT];
+    uint64_t phaseStart;
+    uint64_t startTicks;
+    double startTime;
+} FileStats;
+
+typedef struct {
+    const char *name;
+    long long count;
+} TypeCount;
+
+// Sums over every analyzed file
+typedef struct {
+    int files;
+    double seconds[PHASE_COUNT];
+    long long bytes;
+    long long tokens;
+    long long keywordLookups;
+    long long symbols;
+    long minorFaults;
+    long majorFaults;
+    TypeCount types[STATS_MAX_TYPE_NAMES];
+    int typeCount;
+    LongToken longest[STATS_LONGEST];
+} StatsTotals;
+
+extern _Thread_local FileStats *statsCurrent;
+
+// Zeroes `stats`, attaches it to this thread and starts the lexing clock
+void statsBegin(FileStats *stats);
+// Stops the clock, converts it to seconds and detaches
+void statsEnd(FileStats *stats);
+
+// Charges the time so far to the running phase and starts `phase`;
+// returns the phase that was running
+StatsPhase statsSwitch(StatsPhase phase);
+void statsToken(const Input *in, const Token *token, const TokenFormat *format);
+
+static inline int statsEnter(StatsPhase phase) {
+    return statsCurrent ? (int)statsSwitch(phase) : -1;
+}
+
+static inline void statsLeave(int previous) {
+    if (previous >= 0) statsSwitch((StatsPhase)previous);
+}
+
+// `path` must outlive the totals
+void statsAdd(StatsTotals *totals, const FileStats *stats, const char *path);
+void statsMerge(StatsTotals *into, const StatsTotals *from);
+
+void statsPrintFile(FILE *out, const FileStats *stats, const char *path, const char *language);
+void statsPrintTotals(FILE *out, const StatsTotals *totals);
+
+#endif
@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "symbols.h"
+
+static const char *const kindNames[] = {
+    [SYMBOL_FUNCTION] = "function",
+    [SYMBOL_PROCEDURE] = "procedure",
+    [SYMBOL_PACKAGE] = "package",
+    [SYMBOL_MODULE] = "module",
+    [SYMBOL_PORT] = "port",
+    [SYMBOL_TABLE] = "table",
+    [SYMBOL_COLUMN] = "column",
+    [SYMBOL_LABEL] = "label",
+    [SYMBOL_ALIAS] = "alias",
+    [SYMBOL_TAG] = "tag",
+};
+
+const char *symbolKindName(SymbolKind kind) {
+    return kind < SYMBOL_KIND_COUNT ? kindNames[kind] : "unknown";
+}
+
+int symbolKindFind(const char *name) {
+    for (int i = 0; i < SYMBOL_KIND_COUNT; i++) {
+        if (strcmp(name, kindNames[i]) == 0) return i;
+    }
+    return -1;
+}
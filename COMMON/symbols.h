@@ -0,0 +1,38 @@
+#ifndef CDLAB_SYMBOLS_H
+#define CDLAB_SYMBOLS_H
+
+#include "intern.h"
+
+// The names each analyzer's symbol table records, in one shape for every
+// language, for indexes and queries that span languages. The tables
+// themselves keep their own structs; listSymbols() walks them.
+typedef enum {
+    SYMBOL_FUNCTION,
+    SYMBOL_PROCEDURE,
+    SYMBOL_PACKAGE,
+    SYMBOL_MODULE,
+    SYMBOL_PORT,                // parent is the module
+    SYMBOL_TABLE,
+    SYMBOL_COLUMN,              // parent is the table, or "" if the query named none
+    SYMBOL_LABEL,
+    SYMBOL_ALIAS,
+    SYMBOL_TAG,
+    SYMBOL_KIND_COUNT
+} SymbolKind;
+
+typedef struct {
+    SymbolKind kind;
+    NameId name;
+    NameId parent;              // NAME_EMPTY for top-level symbols
+} Symbol;
+
+// Called once per symbol
+typedef void (*SymbolVisitor)(const Symbol *symbol, void *context);
+
+// "function", "module", ... as used in queries and listings
+const char *symbolKindName(SymbolKind kind);
+
+// The kind with that name, or -1
+int symbolKindFind(const char *name);
+
+#endif
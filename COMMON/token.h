@@ -0,0 +1,64 @@
+#ifndef CDLAB_TOKEN_H
+#define CDLAB_TOKEN_H
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#include "input.h"
+#include "arena.h"
+#include "intern.h"
+
+// A token is a span of the input plus the analyzer's TokenType. The text is
+// only copied out when it is stored in a symbol table.
+typedef struct {
+    size_t offset;      // first byte of the lexeme in the input
+    size_t length;
+    int type;
+} Token;
+
+// An analyzer's lexer: stores the next token and returns 1, or returns 0 at
+// the end of the input. It leaves the cursor at the end of the token.
+typedef int (*LexFunction)(Input *in, Token *token);
+
+// Ends the token at the input cursor
+static inline void tokenSpan(Token *token, const Input *in, size_t start) {
+    token->offset = start;
+    token->length = inputTell(in) - start;
+}
+
+static inline const char *tokenText(const Input *in, const Token *token) {
+    return in->data + token->offset;
+}
+
+static inline int spanEquals(const char *text, size_t length, const char *word) {
+    return strlen(word) == length && memcmp(text, word, length) == 0;
+}
+
+static inline int spanEqualsIgnoreCase(const char *text, size_t length, const char *word) {
+    return strlen(word) == length && strncasecmp(text, word, length) == 0;
+}
+
+static inline int tokenIs(const Input *in, const Token *token, const char *word) {
+    return spanEquals(tokenText(in, token), token->length, word);
+}
+
+// Copies the lexeme into dst, truncating it to fit; returns the copied length
+static inline size_t tokenCopy(const Input *in, const Token *token, char *dst, size_t size) {
+    size_t length = token->length < size ? token->length : size - 1;
+    memcpy(dst, tokenText(in, token), length);
+    dst[length] = '\0';
+    return length;
+}
+
+// Copies the whole lexeme into the arena
+static inline char *tokenSave(Arena *arena, const Input *in, const Token *token) {
+    return arenaStrndup(arena, tokenText(in, token), token->length);
+}
+
+// The lexeme's ID in the shared name pool, for symbol table names
+static inline NameId tokenIntern(const Input *in, const Token *token) {
+    return internName(tokenText(in, token), token->length);
+}
+
+#endif
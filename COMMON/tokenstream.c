@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tokenstream.h"
+#include "stats.h"
+
+#define RULE "------------------------\n"
+
+_Thread_local TokenStream *lexWatch = NULL;
+
+void streamOpen(TokenStream *stream, FILE *out, StreamFormat format) {
+    stream->out = out;
+    stream->format = format;
+    stream->tokenFormat = NULL;
+    stream->lastOffset = 0;
+    stream->used = 0;
+    stream->tokenCount = 0;
+    stream->visit = NULL;
+    stream->visitContext = NULL;
+    stream->buffer = malloc(STREAM_BUFFER_SIZE);
+    if (!stream->buffer) {
+        perror("malloc");
+        exit(1);
+    }
+}
+
+void streamFlush(TokenStream *stream) {
+    if (stream->used && stream->out) fwrite(stream->buffer, 1, stream->used, stream->out);
+    stream->used = 0;
+}
+
+void streamClose(TokenStream *stream) {
+    streamFlush(stream);
+    free(stream->buffer);
+    stream->buffer = NULL;
+}
+
+void streamWrite(TokenStream *stream, const void *data, size_t length) {
+    if (length > STREAM_BUFFER_SIZE - stream->used) {
+        streamFlush(stream);
+        // Anything as big as the buffer goes straight through
+        if (length >= STREAM_BUFFER_SIZE) {
+            if (stream->out) fwrite(data, 1, length, stream->out);
+            return;
+        }
+    }
+    memcpy(stream->buffer + stream->used, data, length);
+    stream->used += length;
+}
+
+static inline void streamByte(TokenStream *stream, unsigned char byte) {
+    if (stream->used == STREAM_BUFFER_SIZE) streamFlush(stream);
+    stream->buffer[stream->used++] = byte;
+}
+
+static inline void streamString(TokenStream *stream, const char *text) {
+    streamWrite(stream, text, strlen(text));
+}
+
+static inline void streamVarint(TokenStream *stream, uint64_t value) {
+    while (value >= 0x80) {
+        streamByte(stream, (unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    streamByte(stream, (unsigned char)value);
+}
+
+static void streamBytes(TokenStream *stream, const char *text, size_t length) {
+    streamVarint(stream, length);
+    streamWrite(stream, text, length);
+}
+
+void streamWriteHeader(FILE *out, StreamFormat format) {
+    if (format == STREAM_TEXT) return;
+    fwrite(STREAM_MAGIC, 1, 4, out);
+    fputc(STREAM_VERSION, out);
+}
+
+void streamBeginFile(TokenStream *stream, const char *path, const char *language) {
+    if (stream->format == STREAM_TEXT) {
+        streamString(stream, "\n==> ");
+        streamString(stream, path);
+        streamString(stream, " [");
+        streamString(stream, language);
+        streamString(stream, "] <==\n");
+        return;
+    }
+    streamByte(stream, 'F');
+    streamBytes(stream, path, strlen(path));
+    streamBytes(stream, language, strlen(language));
+    streamByte(stream, stream->format == STREAM_BINARY_LEXEMES ? STREAM_FLAG_LEXEMES : 0);
+}
+
+void streamBeginTokens(TokenStream *stream, const TokenFormat *format) {
+    stream->tokenFormat = format;
+    stream->lastOffset = 0;
+
+    if (stream->format == STREAM_TEXT) {
+        // The padded layout keeps its header one tab wider
+        streamString(stream, "\nLexical Analysis Output:\n" RULE);
+        streamString(stream, format->lexemeWidth ? "Lexeme\t\t\tType\n" : "Lexeme\t\tType\n");
+        streamString(stream, RULE);
+        return;
+    }
+    streamByte(stream, 'N');
+    streamVarint(stream, format->typeCount);
+    for (int i = 0; i < format->typeCount; i++) {
+        const char *name = format->typeNames[i] ? format->typeNames[i] : "";
+        const char *placeholder = format->placeholders && format->placeholders[i]
+                                  ? format->placeholders[i] : "";
+        streamBytes(stream, name, strlen(name));
+        streamBytes(stream, placeholder, strlen(placeholder));
+    }
+    streamVarint(stream, format->lexemeWidth);
+}
+
+static inline void writeToken(TokenStream *stream, const Input *in, const Token *token) {
+    const TokenFormat *format = stream->tokenFormat;
+    const char *text = tokenText(in, token);
+
+    if (stream->format != STREAM_TEXT) {
+        int64_t delta = (int64_t)token->offset - (int64_t)stream->lastOffset;
+        stream->lastOffset = token->offset;
+        streamByte(stream, 'T');
+        streamVarint(stream, token->type);
+        streamVarint(stream, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        streamVarint(stream, token->length);
+        if (stream->format == STREAM_BINARY_LEXEMES) streamWrite(stream, text, token->length);
+        return;
+    }
+
+    int known = token->type >= 0 && token->type < format->typeCount;
+    size_t length = token->length;
+    if (known && format->placeholders && format->placeholders[token->type]) {
+        text = format->placeholders[token->type];
+        length = strlen(text);
+    }
+    const char *name = known && format->typeNames[token->type]
+                       ? format->typeNames[token->type] : "UNKNOWN";
+
+    streamWrite(stream, text, length);
+    if (format->lexemeWidth) {
+        for (size_t i = length; i < (size_t)format->lexemeWidth; i++) streamByte(stream, ' ');
+        streamByte(stream, '\t');
+    } else {
+        streamWrite(stream, "\t\t", 2);
+    }
+    streamString(stream, name);
+    streamByte(stream, '\n');
+}
+
+void streamToken(TokenStream *stream, const Input *in, const Token *token) {
+    stream->tokenCount++;
+    if (stream->visit) stream->visit(in, token, stream->tokenFormat, stream->visitContext);
+    if (!stream->out) return;
+    if (!statsCurrent) {
+        writeToken(stream, in, token);
+        return;
+    }
+
+    int phase = statsEnter(PHASE_OUTPUT);
+    statsToken(in, token, stream->tokenFormat);
+    writeToken(stream, in, token);
+    statsLeave(phase);
+}
+
+void streamSymbols(TokenStream *stream, const char *text, size_t length) {
+    if (stream->format == STREAM_TEXT) {
+        streamWrite(stream, text, length);
+        return;
+    }
+    streamByte(stream, 'S');
+    streamBytes(stream, text, length);
+}
+
+void streamEndFile(TokenStream *stream) {
+    if (stream->format != STREAM_TEXT) streamByte(stream, 'E');
+}
@@ -0,0 +1,94 @@
+#ifndef CDLAB_TOKENSTREAM_H
+#define CDLAB_TOKENSTREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "input.h"
+#include "token.h"
+
+// Where analyzers send their tokens. The stream renders them either as the
+// familiar "Lexeme\t\tType" table or as a compact binary record stream, and
+// buffers its output so that a token costs a few memcpys, not two printfs.
+//
+// Binary layout (integers are LEB128 varints; a string is a varint length
+// followed by that many bytes):
+//
+//   stream  "CDTK" version:u8 file*
+//   file    'F' path:str language:str flags:u8  record*  'E'
+//   record  'N' typeCount (name:str placeholder:str)*typeCount lexemeWidth
+//         | 'T' type offsetDelta length [lexeme bytes if flags & STREAM_FLAG_LEXEMES]
+//         | 'S' symbolTable:str
+//
+// offsetDelta is the token's offset minus the previous token's offset in
+// the same file, zigzag-encoded. 'N' describes the text table for the
+// tokens that follow it, so a decoder can reproduce that table exactly.
+#define STREAM_MAGIC "CDTK"
+#define STREAM_VERSION 1
+#define STREAM_FLAG_LEXEMES 1
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+typedef enum {
+    STREAM_TEXT,
+    STREAM_BINARY,              // offsets and lengths only; lexemes come from the source
+    STREAM_BINARY_LEXEMES       // every token carries its lexeme bytes
+} StreamFormat;
+
+// How one analyzer's tokens look in the text table
+typedef struct {
+    const char *const *typeNames;       // indexed by the analyzer's TokenType
+    int typeCount;
+    const char *const *placeholders;    // optional; shown instead of the lexeme, per type
+    int lexemeWidth;                    // pad lexemes to this width, or 0 for "lexeme\t\tTYPE"
+} TokenFormat;
+
+// Sees each token as it is written; for indexes that want the tokens but
+// not the output
+typedef void (*TokenVisitor)(const Input *in, const Token *token, const TokenFormat *format,
+                             void *context);
+
+// `out` may be NULL to discard the output and only visit the tokens
+typedef struct {
+    FILE *out;
+    StreamFormat format;
+    const TokenFormat *tokenFormat;
+    size_t lastOffset;
+    char *buffer;
+    size_t used;
+    size_t tokenCount;          // tokens written since streamOpen
+    TokenVisitor visit;         // NULL unless the caller sets it
+    void *visitContext;
+} TokenStream;
+
+// While set, every token a lexer on this thread returns is also shown to
+// this stream's visitor, including the ones that symbol extraction reads
+// and never writes. A token the analyzer writes is seen twice, and one it
+// reads again after backing up is seen again, so visitors that count
+// tokens must skip offsets they have passed.
+extern _Thread_local TokenStream *lexWatch;
+
+// Each lexer's getNextToken returns through here
+static inline int tokenLexed(int found, const Input *in, const Token *token) {
+    if (found && lexWatch && lexWatch->visit) {
+        lexWatch->visit(in, token, lexWatch->tokenFormat, lexWatch->visitContext);
+    }
+    return found;
+}
+
+void streamOpen(TokenStream *stream, FILE *out, StreamFormat format);
+void streamFlush(TokenStream *stream);
+void streamClose(TokenStream *stream);
+
+// Written once at the very start of a binary stream; nothing for text
+void streamWriteHeader(FILE *out, StreamFormat format);
+
+void streamBeginFile(TokenStream *stream, const char *path, const char *language);
+void streamBeginTokens(TokenStream *stream, const TokenFormat *format);
+void streamToken(TokenStream *stream, const Input *in, const Token *token);
+void streamSymbols(TokenStream *stream, const char *text, size_t length);
+void streamEndFile(TokenStream *stream);
+
+// Copies bytes that are already in this stream's format
+void streamWrite(TokenStream *stream, const void *data, size_t length);
+
+#endif
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "window.h"
+#include "stats.h"
+
+// Lexers look a few bytes past a token to see where it ends, so a token
+// this close to the end of the bytes read so far may not be finished
+#define WINDOW_MARGIN 16
+
+_Thread_local InputWindow *windowCurrent = NULL;
+
+void windowOpen(InputWindow *window, int fd, size_t capacity, TokenStream *stream) {
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        perror("malloc");
+        exit(1);
+    }
+    Input in = {buffer, buffer, buffer, 0, 0, 0};
+    window->in = in;
+    window->fd = fd;
+    window->gzip = NULL;
+    window->capacity = capacity;
+    window->base = 0;
+    window->eof = 0;
+    window->error = 0;
+    window->stream = stream;
+}
+
+void windowClose(InputWindow *window) {
+    if (window->gzip) gzipClose(window->gzip);
+    free((void *)window->in.data);
+    memset(window, 0, sizeof(*window));
+}
+
+// Drops the bytes before `offset`, which must not be past the cursor
+static void windowSlide(InputWindow *window, size_t offset) {
+    Input *in = &window->in;
+    char *data = (char *)in->data;
+    memmove(data, data + offset, in->size - offset);
+    in->size -= offset;
+    in->end = data + in->size;
+    in->cur -= offset;
+    window->base += offset;
+    // Unsigned wraparound still leaves the right delta to the next token
+    if (window->stream) window->stream->lastOffset -= offset;
+}
+
+// Reads whatever the stream has ready into the free end of the window. The
+// output so far is flushed first, since the read may block for a while.
+static void windowRead(InputWindow *window) {
+    Input *in = &window->in;
+    if (window->stream) {
+        streamFlush(window->stream);
+        fflush(window->stream->out);
+    }
+
+    int phase = statsEnter(PHASE_READ);
+    char *end = (char *)in->data + in->size;
+    size_t room = window->capacity - in->size;
+    ssize_t n;
+    do {
+        n = window->gzip ? gzipRead(window->gzip, end, room) : read(window->fd, end, room);
+    } while (n < 0 && errno == EINTR);
+    statsLeave(phase);
+
+    if (n <= 0) {
+        window->eof = 1;
+        if (n < 0) window->error = errno;
+        return;
+    }
+    in->size += n;
+    in->end = in->data + in->size;
+    if (statsCurrent) statsCurrent->bytes += n;
+}
+
+int windowLex(InputWindow *window, LexFunction lex, Token *token, int slide) {
+    Input *in = &window->in;
+    if (slide && inputTell(in) > window->capacity / 2) windowSlide(window, inputTell(in));
+
+    for (;;) {
+        size_t start = inputTell(in);
+        int found = lex(in, token);
+        if (window->eof || inputTell(in) + WINDOW_MARGIN < in->size) return found;
+
+        // The lexer ran into the end of what has been read, not necessarily
+        // the end of the token, so lex it again with more bytes behind it
+        if (in->size == window->capacity) {
+            if (!slide || start == 0) return found;     // it does not fit
+            windowSlide(window, start);
+            start = 0;
+        }
+        windowRead(window);
+        inputSeek(in, start);
+    }
+}
+
+int windowAnalyze(int fd, int gzip, size_t capacity, const DocumentLanguage *language, TokenStream *stream) {
+    InputWindow window;
+    windowOpen(&window, fd, capacity, stream);
+    if (gzip) window.gzip = gzipOpen(fd);
+    Arena arena = ARENA_INIT_SIZED(4096);
+    int headed = 0;
+
+    Token token;
+    streamBeginTokens(stream, language->tokenFormat);
+    while (windowLex(&window, language->lex, &token, 1)) {
+        streamToken(stream, &window.in, &token);
+        if (!language->opensSection(&window.in, &token)) continue;
+
+        windowCurrent = &window;
+        int phase = statsEnter(PHASE_SYMBOLS);
+        void *entry = language->extractSection(&arena, &window.in, &token);
+        statsLeave(phase);
+        windowCurrent = NULL;
+
+        // Each entry goes out as soon as it is complete and is then freed
+        if (entry) {
+            char *text = NULL;
+            size_t length = 0;
+            FILE *out = open_memstream(&text, &length);
+            if (!out) {
+                perror("open_memstream");
+                exit(1);
+            }
+            if (!headed) language->displayHeading(out);
+            headed = 1;
+            language->displayEntry(out, entry);
+            fclose(out);
+            streamSymbols(stream, text, length);
+            free(text);
+        }
+        arenaReset(&arena);
+    }
+
+    if (!headed) {
+        char *text = NULL;
+        size_t length = 0;
+        FILE *out = open_memstream(&text, &length);
+        if (out) {
+            language->displayHeading(out);
+            fclose(out);
+            streamSymbols(stream, text, length);
+            free(text);
+        }
+    }
+
+    int error = window.error;
+    windowClose(&window);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
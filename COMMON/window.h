@@ -0,0 +1,61 @@
+#ifndef CDLAB_WINDOW_H
+#define CDLAB_WINDOW_H
+
+#include <stddef.h>
+
+#include "input.h"
+#include "token.h"
+#include "tokenstream.h"
+#include "document.h"
+#include "gzip.h"
+
+// Bounded-memory input for stdin, pipes and FIFOs, whose text cannot be
+// mapped and should not be read whole. The lexers walk contiguous bytes
+// through a pointer cursor, so rather than wrapping around like a ring the
+// buffer slides: when it runs out of room, the bytes before the token
+// being lexed are dropped and the rest moved to the front.
+//
+// Reading is on demand. A lexer that gets within a few bytes of the end of
+// what has been read so far is run again once more has arrived, so a token
+// never ends early at a read boundary. Token offsets are relative to the
+// window, which starts `base` bytes into the stream; sliding moves them,
+// and the TokenStream's offsets are moved with them.
+//
+// Memory stays at `capacity` bytes however long the input is. The price is
+// that a token longer than the window is cut at its end, and a section (a
+// query, block or module) is cut where the rest no longer fits: at least
+// half the window is always free when a section starts.
+typedef struct {
+    Input in;
+    int fd;
+    GzipReader *gzip;           // inflates what is read from fd, or NULL
+    size_t capacity;
+    unsigned long long base;    // stream offset of in.data[0]
+    int eof;
+    int error;                  // errno of a failed read, or 0
+    TokenStream *stream;        // flushed before reading, adjusted on sliding
+} InputWindow;
+
+#define WINDOW_DEFAULT_SIZE (1 << 20)
+#define WINDOW_MINIMUM_SIZE 4096
+
+// Set while a section is extracted from a window. The analyzers' token
+// wrappers read through it, because extractors lex on their own.
+extern _Thread_local InputWindow *windowCurrent;
+
+// Allocation failures print an error and exit
+void windowOpen(InputWindow *window, int fd, size_t capacity, TokenStream *stream);
+void windowClose(InputWindow *window);
+
+// Lexes the next token, reading more of the stream as the lexer needs it.
+// With `slide`, the window may slide to make room; without it, tokens
+// already handed out keep their offsets.
+int windowLex(InputWindow *window, LexFunction lex, Token *token, int slide);
+
+// Analyzes everything on fd in `language`, writing each token as it is
+// lexed and each symbol table entry as soon as its section has been read.
+// With `gzip`, fd holds a gzip stream, inflated a block at a time into the
+// window. Returns 0, or -1 with errno set if reading failed.
+int windowAnalyze(int fd, int gzip, size_t capacity, const DocumentLanguage *language, TokenStream *stream);
+
+#endif
@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_ALIASES 100
-#define MAX_PARAMS 20
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT,
@@ -15,20 +19,18 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char command[MAX_TOKEN_LEN];
+    NameId name;
+    const char *command;
 } Alias;
 
-Alias symbolTable[MAX_ALIASES];
-int aliasCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Alias *symbolTable = NULL;
+static _Thread_local int aliasCount = 0;
+static _Thread_local int aliasCapacity = 0;
 
 // C Shell specific keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "alias", "unalias", "if", "then", "else", "endif", "foreach",
     "end", "while", "switch", "case", "breaksw", "default", "goto",
     "continue", "setenv", "unsetenv", "source", "rehash", "repeat",
@@ -37,255 +39,278 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // C Shell built-in commands
-const char *builtins[] = {
+static const char *builtins[] = {
     "echo", "pwd", "ls", "mkdir", "rmdir", "touch", "cp", "mv",
     "rm", "cat", "grep", "set", "unset", "time", "nice", "nohup",
     "kill", "jobs", "fg", "bg", "wait", "which", "where"
 };
 #define BUILTINS_COUNT (sizeof(builtins) / sizeof(builtins[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isBuiltin(const char *lexeme) {
-    for (int i = 0; i < BUILTINS_COUNT; i++) {
-        if (strcmp(lexeme, builtins[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet builtinSet = KEYWORD_SET(builtins, BUILTINS_COUNT, 0);
+
+static int isBuiltin(const char *lexeme, size_t length) {
+    return keywordSetContains(&builtinSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch;
-    while ((ch = fgetc(file)) != EOF && ch != '\n');
+// Words may contain '_' and '.' (file names, commands); redirections and
+// pipes are the operators
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_' || (c) == '.', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '>' || (c) == '<' || (c) == '|' || (c) == '&', CC_OPERATOR) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    inputSkipLine(in);
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '#') {
-            skipComments(file);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle history references (!, !!, !$, !*)
     if (ch == '!') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if (ch == '!' || ch == '$' || ch == '*' || isdigit(ch) || isalpha(ch)) {
-            buffer[bufIndex++] = ch;
-            if (isalpha(ch)) {
-                while ((ch = fgetc(file)) != EOF && isalnum(ch)) {
-                    buffer[bufIndex++] = ch;
-                }
-                ungetc(ch, file);
+        ch = inputGet(in);
+        if (ch == '!' || ch == '$' || ch == '*' || charIs(ch, CC_ALNUM)) {
+            if (charIs(ch, CC_ALPHA)) {
+                while ((ch = inputGet(in)) != EOF && charIs(ch, CC_ALNUM));
+                inputUnget(in, ch);
             }
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = HISTORY_REF;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle variables ($var, $?var, ${var})
     if (ch == '$') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '?' || ch == '#' || ch == '$' || ch == '!') {
-            buffer[bufIndex++] = ch;
+            // single-character special variable, already consumed
         } else if (ch == '{') {
-            buffer[bufIndex++] = ch;
-            while ((ch = fgetc(file)) != EOF && ch != '}') {
-                buffer[bufIndex++] = ch;
-            }
-            if (ch == '}') buffer[bufIndex++] = ch;
+            while ((ch = inputGet(in)) != EOF && ch != '}');
         } else {
-            while (ch != EOF && (isalnum(ch) || ch == '_')) {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+            while (ch != EOF && (charIs(ch, CC_ALNUM) || ch == '_')) {
+                ch = inputGet(in);
             }
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = VARIABLE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings (both single and double quotes)
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '\\') {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                ch = inputGet(in);
             }
-            buffer[bufIndex++] = ch;
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle redirections and pipes
-    if (ch == '>' || ch == '<' || ch == '|' || ch == '&') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if ((buffer[0] == '>' && (ch == '>' || ch == '&')) || 
-            (buffer[0] == '<' && (ch == '<' || ch == '&')) ||
-            (buffer[0] == '|' && ch == '&') ||
-            (buffer[0] == '&' && ch == '&')) {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        char first = ch;
+        ch = inputGet(in);
+        if (!((first == '>' && (ch == '>' || ch == '&')) || 
+              (first == '<' && (ch == '<' || ch == '&')) ||
+              (first == '|' && ch == '&') ||
+              (first == '&' && ch == '&'))) {
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
-        token->type = (buffer[0] == '|') ? PIPE : REDIRECTION;
-        strcpy(token->lexeme, buffer);
+        tokenSpan(token, in, start);
+        token->type = (first == '|') ? PIPE : REDIRECTION;
         return 1;
     }
 
     // Handle identifiers, keywords, and commands
-    if (isalpha(ch) || ch == '_' || ch == '.') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_' || ch == '.')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isBuiltin(buffer)) {
+        } else if (isBuiltin(tokenText(in, token), token->length)) {
             token->type = BUILTIN_COMMAND;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special characters
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractAlias(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractAlias(Input *in) {
     Token token;
-    char aliasName[MAX_TOKEN_LEN];
-    char aliasCommand[MAX_TOKEN_LEN];
+    Alias alias;
 
     // Get alias name
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(aliasName, token.lexeme);
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        alias.name = tokenIntern(in, &token);
         
         // Get alias command
-        if (getNextToken(file, &token)) {
-            strcpy(aliasCommand, token.lexeme);
-            while (getNextToken(file, &token) && token.lexeme[0] != '\n') {
-                strcat(aliasCommand, " ");
-                strcat(aliasCommand, token.lexeme);
+        if (getNextToken(in, &token)) {
+            char *command = tokenSave(&symbolArena, in, &token);
+            size_t used = token.length;
+            int capacity = used + 1;
+            // getNextToken skips newlines, so the line end is found up front
+            const char *newline = memchr(in->cur, '\n', in->end - in->cur);
+            size_t lineEnd = newline ? (size_t)(newline - in->data) : in->size;
+            while (getNextToken(in, &token)) {
+                if (token.offset >= lineEnd) {
+                    inputSeek(in, token.offset);  // leave the next line to the caller
+                    break;
+                }
+                command = arenaGrowArray(&symbolArena, command, &capacity,
+                                         used + token.length + 2, 1);
+                command[used++] = ' ';
+                memcpy(command + used, tokenText(in, &token), token.length);
+                used += token.length;
+                command[used] = '\0';
             }
+            alias.command = command;
             
             // Store in symbol table
-            strcpy(symbolTable[aliasCount].name, aliasName);
-            strcpy(symbolTable[aliasCount].command, aliasCommand);
-            aliasCount++;
+            *ARENA_PUSH(&symbolArena, symbolTable, aliasCount, aliasCapacity) = alias;
         }
     }
 }
 
-void analyzeCShellFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [VARIABLE] = "VARIABLE",
+    [COMMAND] = "COMMAND",
+    [ALIAS] = "ALIAS",
+    [REDIRECTION] = "REDIRECTION",
+    [PIPE] = "PIPE",
+    [BUILTIN_COMMAND] = "BUILTIN COMMAND",
+    [ENV_VARIABLE] = "ENVIRONMENT VARIABLE",
+    [HISTORY_REF] = "HISTORY REFERENCE",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeCShellFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            case COMMAND: printf("COMMAND"); break;
-            case ALIAS: printf("ALIAS"); break;
-            case REDIRECTION: printf("REDIRECTION"); break;
-            case PIPE: printf("PIPE"); break;
-            case BUILTIN_COMMAND: printf("BUILTIN COMMAND"); break;
-            case ENV_VARIABLE: printf("ENVIRONMENT VARIABLE"); break;
-            case HISTORY_REF: printf("HISTORY REFERENCE"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
         // Process aliases
-        if (token.type == KEYWORD && strcmp(token.lexeme, "alias") == 0) {
-            extractAlias(file);
+        if (token.type == KEYWORD && tokenIs(&in, &token, "alias")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractAlias(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nC Shell Alias Table:\n");
-    printf("------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nC Shell Alias Table:\n");
+    fprintf(out, "------------------------\n");
     for (int i = 0; i < aliasCount; i++) {
-        printf("Alias: %s\n", symbolTable[i].name);
-        printf("Command: %s\n", symbolTable[i].command);
-        printf("------------------------\n");
+        fprintf(out, "Alias: %s\n", nameText(symbolTable[i].name));
+        fprintf(out, "Command: %s\n", symbolTable[i].command);
+        fprintf(out, "------------------------\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    aliasCount = aliasCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return aliasCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < aliasCount; i++) {
+        Symbol symbol = {SYMBOL_ALIAS, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer cshellAnalyzer = {
+    "C Shell", analyzeCShellFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the C Shell script name: ");
     scanf("%s", filename);
-    analyzeCShellFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeCShellFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
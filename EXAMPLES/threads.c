@@ -0,0 +1,159 @@
+// cdlab-threads: libcdlab from several threads at once.
+//
+//   cdlab-threads [-j N] [--rounds N] FILE...
+//
+// Each of N threads (default 4) opens contexts of its own and analyzes
+// every FILE, ROUNDS times over (default 2), alternating between two
+// contexts so that one thread's analyses interleave as well. Every result
+// is reduced to a summary: the language, the token and symbol counts, and
+// a hash of the tokens, the symbols and the symbol table. The summaries
+// must agree across threads, rounds and contexts; the program prints one
+// line per file and exits 1 if any of them differ or a file fails.
+//
+// Build it against the library as the README shows, e.g.
+//
+//   gcc -O2 -pthread -o cdlab-threads EXAMPLES/threads.c -L. -lcdlab
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../CDLAB/libcdlab.h"
+
+#define MAX_THREADS 256
+#define DEFAULT_THREADS 4
+#define DEFAULT_ROUNDS 2
+
+typedef struct {
+    const char *language;
+    size_t tokens;
+    size_t symbols;
+    unsigned long long hash;
+    int failed;
+} Summary;
+
+typedef struct {
+    char *const *paths;
+    int pathCount;
+    int rounds;
+    Summary *summaries;         // by path, from the last round
+    int mismatches;
+} Worker;
+
+// FNV-1a over one field, with a separator so "ab","c" and "a","bc" differ
+static unsigned long long hashBytes(unsigned long long hash, const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+    return (hash ^ 0xff) * 1099511628211ULL;
+}
+
+static unsigned long long hashText(unsigned long long hash, const char *text) {
+    return hashBytes(hash, text, strlen(text));
+}
+
+static void summarize(const Cdlab *cdlab, Summary *summary) {
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t count;
+    const CdlabToken *tokens = cdlabTokens(cdlab, &count);
+    summary->tokens = count;
+    for (size_t i = 0; i < count; i++) {
+        hash = hashBytes(hash, tokens[i].text, tokens[i].length);
+        hash = hashText(hash, tokens[i].type);
+    }
+    const CdlabSymbol *symbols = cdlabSymbols(cdlab, &count);
+    summary->symbols = count;
+    for (size_t i = 0; i < count; i++) {
+        hash = hashText(hash, symbols[i].kind);
+        hash = hashText(hash, symbols[i].name);
+        hash = hashText(hash, symbols[i].parent);
+    }
+    summary->hash = hashText(hash, cdlabSymbolTable(cdlab));
+    summary->language = cdlabLanguage(cdlab);
+    summary->failed = 0;
+}
+
+static int sameSummary(const Summary *a, const Summary *b) {
+    if (a->failed || b->failed) return a->failed == b->failed;
+    return strcmp(a->language, b->language) == 0 && a->tokens == b->tokens &&
+           a->symbols == b->symbols && a->hash == b->hash;
+}
+
+static void *runWorker(void *argument) {
+    Worker *worker = argument;
+    Cdlab *contexts[2] = {cdlabOpen(NULL), cdlabOpen(NULL)};
+    int turn = 0;
+    for (int round = 0; round < worker->rounds; round++) {
+        for (int i = 0; i < worker->pathCount; i++) {
+            Cdlab *cdlab = contexts[turn];
+            turn = !turn;
+            Summary summary = {0};
+            if (cdlabAnalyzeFile(cdlab, worker->paths[i]) != 0) {
+                summary.failed = 1;
+            } else {
+                summarize(cdlab, &summary);
+            }
+            if (round > 0 && !sameSummary(&summary, &worker->summaries[i])) worker->mismatches++;
+            worker->summaries[i] = summary;
+        }
+    }
+    cdlabClose(contexts[0]);
+    cdlabClose(contexts[1]);
+    return NULL;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: cdlab-threads [-j N] [--rounds N] FILE...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int threads = DEFAULT_THREADS, rounds = DEFAULT_ROUNDS, first = 1;
+    while (first < argc && argv[first][0] == '-') {
+        if (first + 1 >= argc) usage();
+        if (strcmp(argv[first], "-j") == 0) threads = atoi(argv[first + 1]);
+        else if (strcmp(argv[first], "--rounds") == 0) rounds = atoi(argv[first + 1]);
+        else usage();
+        first += 2;
+    }
+    if (first == argc || threads < 1 || threads > MAX_THREADS || rounds < 1) usage();
+
+    int pathCount = argc - first;
+    Worker workers[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (Worker){argv + first, pathCount, rounds, NULL, 0};
+        workers[t].summaries = calloc(pathCount, sizeof(Summary));
+        if (!workers[t].summaries) {
+            perror("calloc");
+            exit(1);
+        }
+        if (pthread_create(&ids[t], NULL, runWorker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+
+    int status = 0;
+    for (int i = 0; i < pathCount; i++) {
+        const Summary *summary = &workers[0].summaries[i];
+        int agreed = 1;
+        for (int t = 1; t < threads; t++) agreed &= sameSummary(summary, &workers[t].summaries[i]);
+        if (summary->failed) {
+            printf("%s\tfailed\n", argv[first + i]);
+            status = 1;
+        } else {
+            printf("%s\t%s\t%zu tokens\t%zu symbols\t%016llx%s\n", argv[first + i], summary->language,
+                   summary->tokens, summary->symbols, summary->hash, agreed ? "" : "\tMISMATCH");
+        }
+        if (!agreed) status = 1;
+    }
+    for (int t = 0; t < threads; t++) {
+        if (workers[t].mismatches) {
+            fprintf(stderr, "Thread %d: %d results changed between rounds\n", t, workers[t].mismatches);
+            status = 1;
+        }
+        free(workers[t].summaries);
+    }
+    return status;
+}
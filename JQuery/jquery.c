@@ -1,7 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 #define MAX_TOKEN_LEN 100
 #define MAX_FUNCTIONS 100
@@ -16,13 +22,8 @@ typedef enum {
     JQUERY_FUNCTION
 } TokenType;
 
-typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
 // JavaScript and jQuery Keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "if", "else", "var", "let", "const", "function", "return",
     "true", "false", "null", "undefined", "new", "this", "typeof",
     "break", "continue", "for", "while", "do", "switch", "case"
@@ -30,7 +31,7 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // jQuery Functions
-const char *jqueryFunctions[] = {
+static const char *jqueryFunctions[] = {
     "$", "jQuery", "ready", "click", "hover", "on", "off",
     "hide", "show", "toggle", "ajax", "get", "post", "find",
     "children", "parent", "append", "remove", "addClass", "removeClass"
@@ -38,218 +39,215 @@ const char *jqueryFunctions[] = {
 #define JQUERY_FUNCTIONS_COUNT (sizeof(jqueryFunctions) / sizeof(jqueryFunctions[0]))
 
 // Operators
-const char *operators[] = {
+static const char *operators[] = {
     "==", "===", "!=", "!==", ">=", "<=", "&&", "||",
     "++", "--", "+=", "-=", "*=", "/=", "%=", "=",
     "+", "-", "*", "/", "%", ">", "<", "!"
 };
 #define OPERATORS_COUNT (sizeof(operators) / sizeof(operators[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isJQueryFunction(const char *lexeme) {
-    for (int i = 0; i < JQUERY_FUNCTIONS_COUNT; i++) {
-        if (strcmp(lexeme, jqueryFunctions[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet jQueryFunctionSet = KEYWORD_SET(jqueryFunctions, JQUERY_FUNCTIONS_COUNT, 0);
+
+static int isJQueryFunction(const char *lexeme, size_t length) {
+    return keywordSetContains(&jQueryFunctionSet, lexeme, length);
 }
 
-int isOperator(const char *lexeme) {
-    for (int i = 0; i < OPERATORS_COUNT; i++) {
-        if (strcmp(lexeme, operators[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet operatorSet = KEYWORD_SET(operators, OPERATORS_COUNT, 0);
+
+static int isOperator(const char *lexeme, size_t length) {
+    return keywordSetContains(&operatorSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// '$' is an identifier byte; numbers continue through hex digits, 'x' and '.'
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_' || (c) == '$', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '.' || (c) == 'x' || ((c) >= 'a' && (c) <= 'f') || ((c) >= 'A' && (c) <= 'F'), \
+            CC_NUMCONT) \
+    | CC_IF((c) == '+' || (c) == '-' || (c) == '*' || (c) == '/' || (c) == '%' || (c) == '=' || \
+            (c) == '<' || (c) == '>' || (c) == '!' || (c) == '&' || (c) == '|' || (c) == '.' || \
+            (c) == ',' || (c) == ';' || (c) == '(' || (c) == ')' || (c) == '{' || (c) == '}' || \
+            (c) == '[' || (c) == ']' || (c) == '?' || (c) == ':', CC_OPERATOR) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '/') {  // Single line comment
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (ch == '*') {  // Multi-line comment
-            int done = 0;
-            while (!done && (ch = fgetc(file)) != EOF) {
-                if (ch == '*') {
-                    if ((ch = fgetc(file)) == '/') done = 1;
-                    else ungetc(ch, file);
-                }
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
     // Skip whitespace and comments
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle jQuery selector ($) and jQuery object
     if (ch == '$' || ch == '.') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
+        ch = inputGet(in);
         
         if (ch == '(') {
-            buffer[bufIndex++] = ch;
             // Read until matching closing parenthesis
             int parentheses = 1;
-            while ((ch = fgetc(file)) != EOF && parentheses > 0) {
-                buffer[bufIndex++] = ch;
+            while (parentheses > 0 && (ch = inputGet(in)) != EOF) {
                 if (ch == '(') parentheses++;
                 if (ch == ')') parentheses--;
             }
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
         
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = JQUERY_FUNCTION;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '\\') {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                ch = inputGet(in);
             }
-            buffer[bufIndex++] = ch;
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers (including hex and decimals)
-    if (isdigit(ch) || (ch == '.' && isdigit(fgetc(file)))) {
-        ungetc(ch, file);
-        while ((ch = fgetc(file)) != EOF && 
-               (isdigit(ch) || ch == '.' || ch == 'x' || 
-                (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F'))) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT) || (ch == '.' && charIs(inputGet(in), CC_DIGIT))) {
+        inputUnget(in, ch);
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle identifiers and keywords
-    if (isalpha(ch) || ch == '_' || ch == '$') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_' || ch == '$')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isJQueryFunction(buffer)) {
+        } else if (isJQueryFunction(tokenText(in, token), token->length)) {
             token->type = JQUERY_FUNCTION;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special symbols
-    if (strchr("+-*/%=<>!&|.,;(){}[]?:", ch)) {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
+    if (charIs(ch, CC_OPERATOR)) {
+        ch = inputGet(in);
         
         // Check for two-character operators
-        if (strchr("=&|<>!", ch)) {
-            buffer[bufIndex++] = ch;
-            if (ch == '=' && buffer[0] == '=' || buffer[0] == '!') {
-                ch = fgetc(file);
-                if (ch == '=') buffer[bufIndex++] = ch;
-                else ungetc(ch, file);
+        if (ch == '=' || ch == '&' || ch == '|' || ch == '<' || ch == '>' || ch == '!') {
+            if (ch == '=' && (in->data[start] == '=' || in->data[start] == '!')) {
+                ch = inputGet(in);
+                if (ch != '=') inputUnget(in, ch);
             }
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
         
-        buffer[bufIndex] = '\0';
-        token->type = isOperator(buffer) ? OPERATOR : SPECIAL_SYMBOL;
-        strcpy(token->lexeme, buffer);
+        tokenSpan(token, in, start);
+        token->type = isOperator(tokenText(in, token), token->length) ? OPERATOR : SPECIAL_SYMBOL;
         return 1;
     }
 
     // Handle any other single-character tokens
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void analyzeJQueryFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [JQUERY_FUNCTION] = "JQUERY FUNCTION",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 20
+};
+
+int analyzeJQueryFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%-20s\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case JQUERY_FUNCTION: printf("JQUERY FUNCTION"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
+const Analyzer jqueryAnalyzer = {
+    "jQuery", analyzeJQueryFile, NULL, NULL, NULL, NULL, 1,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the jQuery file name (.js): ");
     scanf("%s", filename);
-    analyzeJQueryFile(filename);
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeJQueryFile(filename, &stream);
+    streamClose(&stream);
     return 0;
 }
+#endif
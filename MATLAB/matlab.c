@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 20
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT,
@@ -14,22 +18,20 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
     int is_script;  // 1 if script file, 0 if function
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
 // MATLAB keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "function", "end", "if", "else", "elseif", "while", "for",
     "break", "continue", "return", "switch", "case", "otherwise",
     "try", "catch", "global", "persistent", "classdef", "properties",
@@ -38,7 +40,7 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // MATLAB scientific functions
-const char *scientific_functions[] = {
+static const char *scientific_functions[] = {
     "sin", "cos", "tan", "exp", "log", "sqrt", "abs", "real",
     "imag", "angle", "conj", "round", "floor", "ceil", "fix",
     "mean", "std", "var", "max", "min", "sum", "prod"
@@ -46,198 +48,188 @@ const char *scientific_functions[] = {
 #define SCIENTIFIC_FUNCTIONS_COUNT (sizeof(scientific_functions) / sizeof(scientific_functions[0]))
 
 // MATLAB matrix operators
-const char *matrix_operators[] = {
+static const char *matrix_operators[] = {
     ".*", ".^", "./", ".\\", "'", ".'", "*", "/", "\\", "^",
     "+=", "-=", "*=", "/=", ".+=", ".-=", ".*=", "./="
 };
 #define MATRIX_OPERATORS_COUNT (sizeof(matrix_operators) / sizeof(matrix_operators[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isScientificFunction(const char *lexeme) {
-    for (int i = 0; i < SCIENTIFIC_FUNCTIONS_COUNT; i++) {
-        if (strcmp(lexeme, scientific_functions[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet scientificFunctionSet = KEYWORD_SET(scientific_functions, SCIENTIFIC_FUNCTIONS_COUNT, 0);
+
+static int isScientificFunction(const char *lexeme, size_t length) {
+    return keywordSetContains(&scientificFunctionSet, lexeme, length);
 }
 
-int isMatrixOperator(const char *lexeme) {
-    for (int i = 0; i < MATRIX_OPERATORS_COUNT; i++) {
-        if (strcmp(lexeme, matrix_operators[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet matrixOperatorSet = KEYWORD_SET(matrix_operators, MATRIX_OPERATORS_COUNT, 0);
+
+static int isMatrixOperator(const char *lexeme, size_t length) {
+    return keywordSetContains(&matrixOperatorSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// Element-wise and matrix operators start with these bytes; '.' also starts
+// a number, which the number path sees first
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '+' || (c) == '-' || (c) == '*' || (c) == '/' || (c) == '<' || (c) == '>' || \
+            (c) == '=' || (c) == '!' || (c) == '&' || (c) == '|' || (c) == '^' || (c) == '%' || \
+            (c) == '.' || (c) == '[' || (c) == '\\' || (c) == ']', CC_OPERATOR) \
+    | CC_IF((c) == '\'' || (c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '%') {  // Single line comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
-    } else if (ch == '{' && (ch = fgetc(file)) == '%') {  // Block comment
-        while ((ch = fgetc(file)) != EOF) {
-            if (ch == '%' && (ch = fgetc(file)) == '}') break;
-        }
+        inputSkipLine(in);
+    } else if (ch == '{' && (ch = inputGet(in)) == '%') {  // Block comment
+        inputSkipPast(in, "%}");
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '%' || ch == '{') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle identifiers and keywords
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isScientificFunction(buffer)) {
+        } else if (isScientificFunction(tokenText(in, token), token->length)) {
             token->type = SCIENTIFIC_FUNCTION;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers (including complex and scientific notation)
-    if (isdigit(ch) || ch == '.') {
-        buffer[bufIndex++] = ch;
+    if (charIs(ch, CC_DIGIT) || ch == '.') {
         int hasDecimal = (ch == '.');
         
-        while ((ch = fgetc(file)) != EOF) {
-            if (isdigit(ch)) {
-                buffer[bufIndex++] = ch;
+        while ((ch = inputGet(in)) != EOF) {
+            if (charIs(ch, CC_DIGIT)) {
+                continue;
             } else if (ch == '.' && !hasDecimal) {
-                buffer[bufIndex++] = ch;
                 hasDecimal = 1;
             } else if ((ch == 'e' || ch == 'E') && 
-                      (isdigit(buffer[bufIndex-1]) || buffer[bufIndex-1] == '.')) {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                      (charIs(in->cur[-2], CC_DIGIT) || in->cur[-2] == '.')) {
+                ch = inputGet(in);
                 if (ch == '+' || ch == '-') {
-                    buffer[bufIndex++] = ch;
-                    ch = fgetc(file);
+                    ch = inputGet(in);
                 }
-                if (isdigit(ch)) {
-                    buffer[bufIndex++] = ch;
-                    while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-                        buffer[bufIndex++] = ch;
-                    }
+                if (charIs(ch, CC_DIGIT)) {
+                    while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
                 }
                 break;
             } else if (ch == 'i' || ch == 'j') {  // Complex numbers
-                buffer[bufIndex++] = ch;
                 break;
             } else {
                 break;
             }
         }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings (both single and double quotes)
-    if (ch == '\'' || ch == '"') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '\\') {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                ch = inputGet(in);
             }
-            buffer[bufIndex++] = ch;
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle matrix operators and other operators
-    if (strchr("+-*/<>=!&|^%.[\\]", ch)) {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if (ch == '.' || ch == '=' || ch == '*' || ch == '/' || 
-            ch == '\\' || ch == '+' || ch == '-' || ch == '\'' ||
-            ch == '&' || ch == '|') {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        ch = inputGet(in);
+        if (!(ch == '.' || ch == '=' || ch == '*' || ch == '/' || 
+              ch == '\\' || ch == '+' || ch == '-' || ch == '\'' ||
+              ch == '&' || ch == '|')) {
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         
-        if (isMatrixOperator(buffer)) {
+        if (isMatrixOperator(tokenText(in, token), token->length)) {
             token->type = MATRIX_OPERATOR;
         } else {
             token->type = OPERATOR;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
     int isScript = 1;  // Assume script until function keyword found
 
     // Check if it's a function or script
-    if (getNextToken(file, &token) && token.type == KEYWORD && 
-        strcmp(token.lexeme, "function") == 0) {
+    if (getNextToken(in, &token) && token.type == KEYWORD && 
+        tokenIs(in, &token, "function")) {
         isScript = 0;
         
         // Handle output arguments
-        if (getNextToken(file, &token)) {
-            if (token.lexeme[0] == '[') {
-                while (getNextToken(file, &token) && token.lexeme[0] != ']');
-                getNextToken(file, &token);
+        if (getNextToken(in, &token)) {
+            if (tokenText(in, &token)[0] == '[') {
+                while (getNextToken(in, &token) && tokenText(in, &token)[0] != ']');
+                getNextToken(in, &token);
+                if (tokenText(in, &token)[0] == '=') getNextToken(in, &token);
             }
             
             if (token.type == IDENTIFIER) {
-                strcpy(functionName, token.lexeme);
+                functionName = tokenIntern(in, &token);
                 
                 // Handle input arguments
-                if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-                    while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+                if (getNextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+                    while (getNextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                         if (token.type == IDENTIFIER) {
-                            strcpy(parameters[paramCount++], token.lexeme);
+                            *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                                tokenIntern(in, &token);
                         }
                     }
                 }
@@ -245,84 +237,113 @@ void extractFunction(FILE *file) {
         }
     } else {
         // It's a script file
-        strcpy(functionName, "script");
+        functionName = internName("script", 6);
     }
 
     // Store in symbol table
-    strcpy(symbolTable[functionCount].name, functionName);
-    symbolTable[functionCount].param_count = paramCount;
-    symbolTable[functionCount].is_script = isScript;
-    for (int i = 0; i < paramCount; i++) {
-        strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-    }
-    functionCount++;
+    Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+    function->name = functionName;
+    function->parameters = parameters;
+    function->param_count = paramCount;
+    function->is_script = isScript;
 }
 
-void analyzeMATLABFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [FUNCTION_NAME] = "FUNCTION NAME",
+    [MATRIX_OPERATOR] = "MATRIX OPERATOR",
+    [SCIENTIFIC_FUNCTION] = "SCIENTIFIC FUNCTION",
+    [COMMAND] = "COMMAND",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeMATLABFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
+    streamBeginTokens(stream, &tokenFormat);
 
     // First pass to determine if it's a function or script
-    extractFunction(file);
-    rewind(file);
+    int phase = statsEnter(PHASE_SYMBOLS);
+    extractFunction(&in);
+    statsLeave(phase);
+    inputRewind(&in);
 
     // Second pass for detailed analysis
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case FUNCTION_NAME: printf("FUNCTION NAME"); break;
-            case MATRIX_OPERATOR: printf("MATRIX OPERATOR"); break;
-            case SCIENTIFIC_FUNCTION: printf("SCIENTIFIC FUNCTION"); break;
-            case COMMAND: printf("COMMAND"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nMATLAB Analysis:\n");
-    printf("------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nMATLAB Analysis:\n");
+    fprintf(out, "------------------------\n");
     for (int i = 0; i < functionCount; i++) {
         if (symbolTable[i].is_script) {
-            printf("Script File\n");
+            fprintf(out, "Script File\n");
         } else {
-            printf("Function: %s\n", symbolTable[i].name);
+            fprintf(out, "Function: %s\n", nameText(symbolTable[i].name));
             if (symbolTable[i].param_count > 0) {
-                printf("Parameters: ");
+                fprintf(out, "Parameters: ");
                 for (int j = 0; j < symbolTable[i].param_count; j++) {
-                    printf("%s", symbolTable[i].parameters[j]);
-                    if (j < symbolTable[i].param_count - 1) printf(", ");
+                    fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+                    if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
                 }
-                printf("\n");
+                fprintf(out, "\n");
             }
         }
-        printf("------------------------\n");
+        fprintf(out, "------------------------\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        if (symbolTable[i].is_script) continue;
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer matlabAnalyzer = {
+    "MATLAB", analyzeMATLABFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the MATLAB file name: ");
     scanf("%s", filename);
-    analyzeMATLABFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeMATLABFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
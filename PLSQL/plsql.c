@@ -1,11 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_BLOCKS 100
-#define MAX_PARAMS 20
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
+#include "../COMMON/chunklex.h"
+#include "../COMMON/window.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT,
@@ -15,23 +21,26 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
+    NameId name;
+    NameId type;
+} Parameter;
 
 typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char type[MAX_TOKEN_LEN];  // PACKAGE, PROCEDURE, FUNCTION
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    char return_type[MAX_TOKEN_LEN];
+    NameId name;
+    const char *type;          // PACKAGE, PROCEDURE, FUNCTION
+    Parameter *parameters;
+    NameId return_type;
     int param_count;
 } Block;
 
-Block symbolTable[MAX_BLOCKS];
-int blockCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Block *symbolTable = NULL;
+static _Thread_local int blockCount = 0;
+static _Thread_local int blockCapacity = 0;
 
 // PL/SQL specific keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "PACKAGE", "PROCEDURE", "FUNCTION", "BEGIN", "END", "IF", "THEN", "ELSE",
     "ELSIF", "LOOP", "WHILE", "FOR", "IN", "OUT", "INOUT", "RETURN", "EXIT",
     "CONTINUE", "GOTO", "NULL", "RAISE", "DECLARE", "EXCEPTION", "WHEN",
@@ -43,281 +52,331 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // PL/SQL datatypes
-const char *datatypes[] = {
+static const char *datatypes[] = {
     "VARCHAR2", "NUMBER", "DATE", "TIMESTAMP", "BOOLEAN", "INTEGER", "FLOAT",
     "CHAR", "CLOB", "BLOB", "XMLTYPE", "REF", "CURSOR", "BINARY_INTEGER",
     "PLS_INTEGER", "NATURAL", "POSITIVE", "ROWID", "UROWID", "REAL"
 };
 #define DATATYPES_COUNT (sizeof(datatypes) / sizeof(datatypes[0]))
 
-int isKeyword(const char *lexeme) {
-    char upperLexeme[MAX_TOKEN_LEN];
-    strcpy(upperLexeme, lexeme);
-    for(int i = 0; upperLexeme[i]; i++) {
-        upperLexeme[i] = toupper(upperLexeme[i]);
-    }
-    
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(upperLexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 1);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isDatatype(const char *lexeme) {
-    char upperLexeme[MAX_TOKEN_LEN];
-    strcpy(upperLexeme, lexeme);
-    for(int i = 0; upperLexeme[i]; i++) {
-        upperLexeme[i] = toupper(upperLexeme[i]);
-    }
-    
-    for (int i = 0; i < DATATYPES_COUNT; i++) {
-        if (strcmp(upperLexeme, datatypes[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet datatypeSet = KEYWORD_SET(datatypes, DATATYPES_COUNT, 1);
+
+static int isDatatype(const char *lexeme, size_t length) {
+    return keywordSetContains(&datatypeSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
-    if (ch == '-' && (ch = fgetc(file)) == '-') {  // Single line comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
-    } else if (ch == '/' && (ch = fgetc(file)) == '*') {  // Multi-line comment
-        while ((ch = fgetc(file)) != EOF) {
-            if (ch == '*' && (ch = fgetc(file)) == '/') break;
-        }
+// '$' and '#' are legal in PL/SQL identifiers; numbers may carry an exponent
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_' || (c) == '$' || (c) == '#', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '.' || (c) == 'e' || (c) == 'E' || (c) == '+' || (c) == '-', CC_NUMCONT) \
+    | CC_IF((c) == '+' || (c) == '-' || (c) == '*' || (c) == '/' || (c) == '<' || (c) == '>' || \
+            (c) == '=' || (c) == '!' || (c) == '&' || (c) == '|' || (c) == '^' || (c) == '%', CC_OPERATOR) \
+    | CC_IF((c) == '\'' || (c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
+    if (ch == '-' && (ch = inputGet(in)) == '-') {  // Single line comment
+        inputSkipLine(in);
+    } else if (ch == '/' && (ch = inputGet(in)) == '*') {  // Multi-line comment
+        inputSkipPast(in, "*/");
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '-' || ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle identifiers, keywords, datatypes
-    if (isalpha(ch) || ch == '_' || ch == '$' || ch == '#') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_' || ch == '$' || ch == '#')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isDatatype(buffer)) {
+        } else if (isDatatype(tokenText(in, token), token->length)) {
             token->type = DATATYPE;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers
-    if (isdigit(ch) || ch == '.') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isdigit(ch) || ch == '.' || ch == 'e' || ch == 'E' || 
-                ch == '+' || ch == '-')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT) || ch == '.') {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle string literals
-    if (ch == '\'' || ch == '"') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
-            if (ch == quote && (ch = fgetc(file)) == quote) {  // Handle doubled quotes
-                buffer[bufIndex++] = ch;
-                buffer[bufIndex++] = ch;
-                continue;
-            }
-            if (ch != quote) {
-                buffer[bufIndex++] = ch;
-            }
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '\\') {
-                ch = fgetc(file);
-                buffer[bufIndex++] = ch;
+                inputGet(in);
             }
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special symbols
-    if (strchr("+-*/<>=!&|^%", ch)) {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if (strchr("=<>", ch)) {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        ch = inputGet(in);
+        if (ch != '=' && ch != '<' && ch != '>') {
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = OPERATOR;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractBlock(FILE *file, const char *blockType) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+// Set while a large file is lexed in parallel chunks; the tokens then come
+// from there instead of from getNextToken. Streamed input is read through
+// windowCurrent (see COMMON/window.h).
+static _Thread_local ChunkLexer *chunkLexer = NULL;
+
+static int nextToken(Input *in, Token *token) {
+    if (chunkLexer) return chunkLexNext(chunkLexer, token);
+    if (windowCurrent) return windowLex(windowCurrent, getNextToken, token, 0);
+    return getNextToken(in, token);
+}
+
+// The kind of block a keyword opens, or NULL
+static const char *blockType(const Input *in, const Token *token) {
+    if (token->type != KEYWORD) return NULL;
+    if (tokenIs(in, token, "PACKAGE")) return "PACKAGE";
+    if (tokenIs(in, token, "PROCEDURE")) return "PROCEDURE";
+    if (tokenIs(in, token, "FUNCTION")) return "FUNCTION";
+    return NULL;
+}
+
+static int opensBlock(const Input *in, const Token *token) {
+    return blockType(in, token) != NULL;
+}
+
+// Reads the name, parameters and return type of the block that follows its
+// keyword into `block`, with its parameter list in `arena`. Returns 0 if no
+// block name follows.
+static int extractBlock(Arena *arena, Input *in, const char *type, Block *block) {
     Token token;
-    char blockName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    char paramTypes[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
-    char returnType[MAX_TOKEN_LEN] = "";
+    int paramCapacity = 0;
+
+    memset(block, 0, sizeof(*block));
+    block->type = type;
 
     // Get block name
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(blockName, token.lexeme);
+    if (nextToken(in, &token) && token.type == IDENTIFIER) {
+        block->name = tokenIntern(in, &token);
         
         // Check for parameters
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+        if (nextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+            while (nextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == IDENTIFIER) {
-                    strcpy(parameters[paramCount], token.lexeme);
+                    Token name = token;
                     
                     // Get parameter type
-                    if (getNextToken(file, &token) && 
+                    if (nextToken(in, &token) && 
                         (token.type == DATATYPE || token.type == IDENTIFIER)) {
-                        strcpy(paramTypes[paramCount], token.lexeme);
-                        paramCount++;
+                        Parameter *parameter =
+                            ARENA_PUSH(arena, block->parameters, block->param_count, paramCapacity);
+                        parameter->name = tokenIntern(in, &name);
+                        parameter->type = tokenIntern(in, &token);
                     }
                 }
             }
         }
 
         // Check for return type (for functions)
-        if (strcmp(blockType, "FUNCTION") == 0) {
-            while (getNextToken(file, &token)) {
-                if (token.type == RETURN) {
-                    if (getNextToken(file, &token) && 
+        if (strcmp(type, "FUNCTION") == 0) {
+            while (nextToken(in, &token)) {
+                if (token.type == KEYWORD && tokenIs(in, &token, "RETURN")) {
+                    if (nextToken(in, &token) && 
                         (token.type == DATATYPE || token.type == IDENTIFIER)) {
-                        strcpy(returnType, token.lexeme);
+                        block->return_type = tokenIntern(in, &token);
                         break;
                     }
                 }
                 if (token.type == KEYWORD && 
-                    (strcmp(token.lexeme, "IS") == 0 || 
-                     strcmp(token.lexeme, "AS") == 0)) {
+                    (tokenIs(in, &token, "IS") || 
+                     tokenIs(in, &token, "AS"))) {
                     break;
                 }
             }
         }
-
-        // Store in symbol table
-        strcpy(symbolTable[blockCount].name, blockName);
-        strcpy(symbolTable[blockCount].type, blockType);
-        symbolTable[blockCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            sprintf(symbolTable[blockCount].parameters[i], "%s %s", 
-                    parameters[i], paramTypes[i]);
-        }
-        strcpy(symbolTable[blockCount].return_type, returnType);
-        blockCount++;
+        return 1;
     }
+    return 0;
 }
 
-void analyzePLSQLFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [DATATYPE] = "DATATYPE",
+    [PACKAGE_NAME] = "PACKAGE NAME",
+    [PROCEDURE_NAME] = "PROCEDURE NAME",
+    [FUNCTION_NAME] = "FUNCTION NAME",
+    [VARIABLE] = "VARIABLE",
+    [PARAMETER] = "PARAMETER",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzePLSQLFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case DATATYPE: printf("DATATYPE"); break;
-            case PACKAGE_NAME: printf("PACKAGE NAME"); break;
-            case PROCEDURE_NAME: printf("PROCEDURE NAME"); break;
-            case FUNCTION_NAME: printf("FUNCTION NAME"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            case PARAMETER: printf("PARAMETER"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
-
-        if (token.type == KEYWORD) {
-            if (strcmp(token.lexeme, "PACKAGE") == 0) {
-                extractBlock(file, "PACKAGE");
-            } else if (strcmp(token.lexeme, "PROCEDURE") == 0) {
-                extractBlock(file, "PROCEDURE");
-            } else if (strcmp(token.lexeme, "FUNCTION") == 0) {
-                extractBlock(file, "FUNCTION");
+    ChunkLexer chunks;
+    if (chunkLexStart(&chunks, &in, getNextToken)) chunkLexer = &chunks;
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (nextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
+
+        const char *type = blockType(&in, &token);
+        if (type) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            Block block;
+            if (extractBlock(&symbolArena, &in, type, &block)) {
+                *ARENA_PUSH(&symbolArena, symbolTable, blockCount, blockCapacity) = block;
             }
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    if (chunkLexer) {
+        chunkLexFinish(&chunks);
+        chunkLexer = NULL;
+    }
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (PL/SQL Blocks):\n");
-    printf("--------------------------------------\n");
-    for (int i = 0; i < blockCount; i++) {
-        printf("Type: %s\n", symbolTable[i].type);
-        printf("Name: %s\n", symbolTable[i].name);
-        if (symbolTable[i].param_count > 0) {
-            printf("Parameters:\n");
-            for (int j = 0; j < symbolTable[i].param_count; j++) {
-                printf("  %s\n", symbolTable[i].parameters[j]);
-            }
-        }
-        if (strlen(symbolTable[i].return_type) > 0) {
-            printf("Return Type: %s\n", symbolTable[i].return_type);
+static void displayHeading(FILE *out) {
+    fprintf(out, "\nSymbol Table (PL/SQL Blocks):\n");
+    fprintf(out, "--------------------------------------\n");
+}
+
+static void displayBlock(FILE *out, const void *entry) {
+    const Block *block = entry;
+    fprintf(out, "Type: %s\n", block->type);
+    fprintf(out, "Name: %s\n", nameText(block->name));
+    if (block->param_count > 0) {
+        fprintf(out, "Parameters:\n");
+        for (int j = 0; j < block->param_count; j++) {
+            fprintf(out, "  %s %s\n", nameText(block->parameters[j].name), nameText(block->parameters[j].type));
         }
-        printf("--------------------------------------\n");
     }
+    if (block->return_type != NAME_EMPTY) {
+        fprintf(out, "Return Type: %s\n", nameText(block->return_type));
+    }
+    fprintf(out, "--------------------------------------\n");
 }
 
+static void displaySymbolTable(FILE *out) {
+    displayHeading(out);
+    for (int i = 0; i < blockCount; i++) {
+        displayBlock(out, &symbolTable[i]);
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    blockCount = blockCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return blockCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < blockCount; i++) {
+        const char *type = symbolTable[i].type;
+        Symbol symbol = {strcmp(type, "PACKAGE") == 0 ? SYMBOL_PACKAGE :
+                         strcmp(type, "PROCEDURE") == 0 ? SYMBOL_PROCEDURE : SYMBOL_FUNCTION,
+                         symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+// Each block is one section of an incrementally edited document
+static void *extractBlockSection(Arena *arena, Input *in, const Token *first) {
+    Block block;
+    if (!extractBlock(arena, in, blockType(in, first), &block)) return NULL;
+    Block *entry = arenaAlloc(arena, sizeof(*entry));
+    *entry = block;
+    return entry;
+}
+
+static const DocumentLanguage documentLanguage = {
+    getNextToken, opensBlock, extractBlockSection, displayHeading, displayBlock, &tokenFormat
+};
+
+const Analyzer plsqlAnalyzer = {
+    "PL/SQL", analyzePLSQLFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    &documentLanguage
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the PL/SQL file name: ");
     scanf("%s", filename);
-    analyzePLSQLFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzePLSQLFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 10
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, 
@@ -14,21 +18,19 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
 // PowerShell specific keywords and cmdlets
-const char *keywords[] = {
+static const char *keywords[] = {
     "function", "if", "else", "elseif", "while", "do", "for",
     "foreach", "switch", "break", "continue", "return", "param",
     "begin", "process", "end", "try", "catch", "finally",
@@ -36,7 +38,7 @@ const char *keywords[] = {
 };
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
-const char *cmdlets[] = {
+static const char *cmdlets[] = {
     "Get-Item", "Set-Item", "New-Item", "Remove-Item",
     "Get-Content", "Set-Content", "Write-Host", "Write-Output",
     "Get-Process", "Start-Process", "Stop-Process",
@@ -44,159 +46,150 @@ const char *cmdlets[] = {
 };
 #define CMDLETS_COUNT (sizeof(cmdlets) / sizeof(cmdlets[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcasecmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 1);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isCmdlet(const char *lexeme) {
-    for (int i = 0; i < CMDLETS_COUNT; i++) {
-        if (strcasecmp(lexeme, cmdlets[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet cmdletSet = KEYWORD_SET(cmdlets, CMDLETS_COUNT, 1);
+
+static int isCmdlet(const char *lexeme, size_t length) {
+    return keywordSetContains(&cmdletSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// Cmdlet names are Verb-Noun, so '-' continues an identifier
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c) || (c) == '-', CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c) || (c) == '.', CC_NUMCONT) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '#') {  // Single line comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
-    } else if (ch == '<' && (ch = fgetc(file)) == '#') {  // Multi-line comment
-        while ((ch = fgetc(file)) != EOF) {
-            if (ch == '#' && (ch = fgetc(file)) == '>') break;
-        }
+        inputSkipLine(in);
+    } else if (ch == '<' && (ch = inputGet(in)) == '#') {  // Multi-line comment
+        inputSkipPast(in, "#>");
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '#' || ch == '<') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle variables (starting with $)
     if (ch == '$') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && (charIs(ch, CC_ALNUM) || ch == '_'));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = VARIABLE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle parameters (starting with -)
     if (ch == '-') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && (charIs(ch, CC_ALNUM) || ch == '_'));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = PARAMETER;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle identifiers, keywords, and cmdlets
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_' || ch == '-')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isCmdlet(buffer)) {
+        } else if (isCmdlet(tokenText(in, token), token->length)) {
             token->type = CMDLET;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isdigit(ch) || ch == '.')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings (single and double quotes)
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '`') {  // Handle PowerShell escape character
-                ch = fgetc(file);
+                ch = inputGet(in);
                 if (ch == EOF) break;
             }
-            buffer[bufIndex++] = ch;
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
 
     // Skip to function name
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
         
         // Look for param block or parameters
-        if (getNextToken(file, &token)) {
-            if (strcmp(token.lexeme, "(") == 0) {
+        if (getNextToken(in, &token)) {
+            if (tokenIs(in, &token, "(")) {
                 // Parse parameters
-                while (getNextToken(file, &token) && strcmp(token.lexeme, ")") != 0) {
+                while (getNextToken(in, &token) && !tokenIs(in, &token, ")")) {
                     if (token.type == VARIABLE) {
-                        strcpy(parameters[paramCount++], token.lexeme);
+                        *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                            tokenIntern(in, &token);
                     }
                 }
-            } else if (token.type == KEYWORD && strcmp(token.lexeme, "param") == 0) {
+            } else if (token.type == KEYWORD && tokenIs(in, &token, "param")) {
                 // Parse param block
-                if (getNextToken(file, &token) && strcmp(token.lexeme, "(") == 0) {
-                    while (getNextToken(file, &token) && strcmp(token.lexeme, ")") != 0) {
+                if (getNextToken(in, &token) && tokenIs(in, &token, "(")) {
+                    while (getNextToken(in, &token) && !tokenIs(in, &token, ")")) {
                         if (token.type == VARIABLE) {
-                            strcpy(parameters[paramCount++], token.lexeme);
+                            *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                                tokenIntern(in, &token);
                         }
                     }
                 }
@@ -204,70 +197,98 @@ void extractFunction(FILE *file) {
         }
 
         // Store in symbol table
-        strcpy(symbolTable[functionCount].name, functionName);
-        symbolTable[functionCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-        }
-        functionCount++;
+        Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+        function->name = functionName;
+        function->parameters = parameters;
+        function->param_count = paramCount;
     }
 }
 
-void analyzePowerShellFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [VARIABLE] = "VARIABLE",
+    [CMDLET] = "CMDLET",
+    [PARAMETER] = "PARAMETER",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzePowerShellFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            case CMDLET: printf("CMDLET"); break;
-            case PARAMETER: printf("PARAMETER"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "function") == 0) {
-            extractFunction(file);
+        if (token.type == KEYWORD && tokenIs(&in, &token, "function")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nSymbol Table (Functions and Parameters):\n");
-    printf("--------------------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nSymbol Table (Functions and Parameters):\n");
+    fprintf(out, "--------------------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s(", symbolTable[i].name);
+        fprintf(out, "Function: %s(", nameText(symbolTable[i].name));
         for (int j = 0; j < symbolTable[i].param_count; j++) {
-            printf("%s", symbolTable[i].parameters[j]);
-            if (j < symbolTable[i].param_count - 1) printf(", ");
+            fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+            if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
         }
-        printf(")\n");
+        fprintf(out, ")\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer powershellAnalyzer = {
+    "PowerShell", analyzePowerShellFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the PowerShell file name: ");
     scanf("%s", filename);
-    analyzePowerShellFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzePowerShellFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_FUNCTIONS 100
-#define MAX_PARAMS 20
+#include "../../COMMON/analyzer.h"
+#include "../../COMMON/input.h"
+#include "../../COMMON/token.h"
+#include "../../COMMON/keywords.h"
+#include "../../COMMON/stats.h"
+#include "../../COMMON/arena.h"
+#include "../../COMMON/scan.h"
+#include "../../COMMON/charclass.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT,
@@ -15,21 +19,19 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
+    NameId name;
+    NameId *parameters;
     int param_count;
 } Function;
 
-Function symbolTable[MAX_FUNCTIONS];
-int functionCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Function *symbolTable = NULL;
+static _Thread_local int functionCount = 0;
+static _Thread_local int functionCapacity = 0;
 
 // Shell keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "if", "then", "else", "elif", "fi", "case", "esac",
     "for", "while", "until", "do", "done", "in", "select",
     "function", "time", "coproc", "return", "break", "continue",
@@ -39,54 +41,57 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // Built-in commands
-const char *commands[] = {
+static const char *commands[] = {
     "echo", "cd", "pwd", "ls", "mkdir", "rmdir", "touch",
     "cp", "mv", "rm", "cat", "grep", "sed", "awk", "find",
     "tar", "gzip", "chmod", "chown", "kill", "ps", "top"
 };
 #define COMMANDS_COUNT (sizeof(commands) / sizeof(commands[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isCommand(const char *lexeme) {
-    for (int i = 0; i < COMMANDS_COUNT; i++) {
-        if (strcmp(lexeme, commands[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet commandSet = KEYWORD_SET(commands, COMMANDS_COUNT, 0);
+
+static int isCommand(const char *lexeme, size_t length) {
+    return keywordSetContains(&commandSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch;
-    while ((ch = fgetc(file)) != EOF && ch != '\n');
+// Redirections and pipes are the operators
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '>' || (c) == '<' || (c) == '|', CC_OPERATOR) \
+    | CC_IF((c) == '"' || (c) == '\'', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    inputSkipLine(in);
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
-        if (ch == '#' && bufIndex == 0) {
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
+        if (ch == '#') {
             // Check for shebang
-            if ((ch = fgetc(file)) == '!') {
-                buffer[bufIndex++] = '#';
-                buffer[bufIndex++] = '!';
-                while ((ch = fgetc(file)) != EOF && ch != '\n') {
-                    buffer[bufIndex++] = ch;
-                }
-                buffer[bufIndex] = '\0';
+            size_t hash = inputTell(in) - 1;
+            if ((ch = inputGet(in)) == '!') {
+                inputSkipTo(in, '\n');
+                tokenSpan(token, in, hash);
                 token->type = SHEBANG;
-                strcpy(token->lexeme, buffer);
                 return 1;
             } else {
-                ungetc(ch, file);
-                skipComments(file);
+                inputUnget(in, ch);
+                skipComments(in);
                 continue;
             }
         }
@@ -94,220 +99,222 @@ int getNextToken(FILE *file, Token *token) {
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle variables ($var, ${var}, $1, etc.)
     if (ch == '$') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '{') {
-            buffer[bufIndex++] = ch;
-            while ((ch = fgetc(file)) != EOF && ch != '}') {
-                buffer[bufIndex++] = ch;
-            }
-            if (ch == '}') buffer[bufIndex++] = ch;
-        } else if (isdigit(ch) || ch == '#' || ch == '@' || ch == '*' || 
+            while ((ch = inputGet(in)) != EOF && ch != '}');
+        } else if (charIs(ch, CC_DIGIT) || ch == '#' || ch == '@' || ch == '*' || 
                   ch == '?' || ch == '-' || ch == '$' || ch == '!') {
-            buffer[bufIndex++] = ch;
+            // single-character special parameter, already consumed
         } else {
-            while (ch != EOF && (isalnum(ch) || ch == '_')) {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+            while (ch != EOF && charIs(ch, CC_IDCONT)) {
+                ch = inputGet(in);
             }
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = VARIABLE;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle strings (both single and double quotes)
-    if (ch == '"' || ch == '\'') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
+        while ((ch = inputGet(in)) != EOF && ch != quote) {
             if (ch == '\\') {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                ch = inputGet(in);
             }
-            buffer[bufIndex++] = ch;
         }
-        if (ch == quote) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle redirections and pipes
-    if (ch == '>' || ch == '<' || ch == '|') {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if ((buffer[0] == '>' && ch == '>') || 
-            (buffer[0] == '<' && ch == '<')) {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        char first = ch;
+        ch = inputGet(in);
+        if (!((first == '>' && ch == '>') || (first == '<' && ch == '<'))) {
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
-        token->type = (buffer[0] == '|') ? PIPE : REDIRECTION;
-        strcpy(token->lexeme, buffer);
+        tokenSpan(token, in, start);
+        token->type = (first == '|') ? PIPE : REDIRECTION;
         return 1;
     }
 
     // Handle command substitution $(command) or `command`
-    if (ch == '`' || (ch == '$' && (ch = fgetc(file)) == '(')) {
+    if (ch == '`' || (ch == '$' && (ch = inputGet(in)) == '(')) {
         char end = (ch == '`') ? '`' : ')';
-        buffer[bufIndex++] = '$';
-        if (end == ')') buffer[bufIndex++] = '(';
-        while ((ch = fgetc(file)) != EOF && ch != end) {
-            buffer[bufIndex++] = ch;
-        }
-        if (ch == end) buffer[bufIndex++] = ch;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != end);
+        tokenSpan(token, in, start);
         token->type = COMMAND;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle identifiers, keywords, and commands
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isCommand(buffer)) {
+        } else if (isCommand(tokenText(in, token), token->length)) {
             token->type = COMMAND;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers
-    if (isdigit(ch)) {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && isdigit(ch)) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_DIGIT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special characters
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractFunction(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+static void extractFunction(Input *in) {
     Token token;
-    char functionName[MAX_TOKEN_LEN];
-    char parameters[MAX_PARAMS][MAX_TOKEN_LEN];
-    int paramCount = 0;
+    NameId functionName = NAME_EMPTY;
+    NameId *parameters = NULL;
+    int paramCount = 0, paramCapacity = 0;
 
     // Get function name
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(functionName, token.lexeme);
+    if (getNextToken(in, &token) && token.type == IDENTIFIER) {
+        functionName = tokenIntern(in, &token);
         
         // Look for () or parameters
-        if (getNextToken(file, &token)) {
-            if (token.lexeme[0] == '(') {
-                getNextToken(file, &token); // Skip )
+        if (getNextToken(in, &token)) {
+            if (tokenText(in, &token)[0] == '(') {
+                getNextToken(in, &token); // Skip )
             } else if (token.type == PARAMETER) {
-                strcpy(parameters[paramCount++], token.lexeme);
-                while (getNextToken(file, &token) && token.type == PARAMETER) {
-                    strcpy(parameters[paramCount++], token.lexeme);
+                *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                    tokenIntern(in, &token);
+                while (getNextToken(in, &token) && token.type == PARAMETER) {
+                    *ARENA_PUSH(&symbolArena, parameters, paramCount, paramCapacity) =
+                        tokenIntern(in, &token);
                 }
             }
         }
 
         // Store in symbol table
-        strcpy(symbolTable[functionCount].name, functionName);
-        symbolTable[functionCount].param_count = paramCount;
-        for (int i = 0; i < paramCount; i++) {
-            strcpy(symbolTable[functionCount].parameters[i], parameters[i]);
-        }
-        functionCount++;
+        Function *function = ARENA_PUSH(&symbolArena, symbolTable, functionCount, functionCapacity);
+        function->name = functionName;
+        function->parameters = parameters;
+        function->param_count = paramCount;
     }
 }
 
-void analyzeShellFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [VARIABLE] = "VARIABLE",
+    [COMMAND] = "COMMAND",
+    [PARAMETER] = "PARAMETER",
+    [REDIRECTION] = "REDIRECTION",
+    [PIPE] = "PIPE",
+    [FUNCTION_NAME] = "FUNCTION NAME",
+    [ENV_VARIABLE] = "ENVIRONMENT VARIABLE",
+    [SHEBANG] = "SHEBANG",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeShellFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case VARIABLE: printf("VARIABLE"); break;
-            case COMMAND: printf("COMMAND"); break;
-            case PARAMETER: printf("PARAMETER"); break;
-            case REDIRECTION: printf("REDIRECTION"); break;
-            case PIPE: printf("PIPE"); break;
-            case FUNCTION_NAME: printf("FUNCTION NAME"); break;
-            case ENV_VARIABLE: printf("ENVIRONMENT VARIABLE"); break;
-            case SHEBANG: printf("SHEBANG"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (getNextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "function") == 0) {
-            extractFunction(file);
+        if (token.type == KEYWORD && tokenIs(&in, &token, "function")) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            extractFunction(&in);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    inputClose(&in);
+    return 0;
 }
 
-void displaySymbolTable() {
-    printf("\nShell Script Analysis:\n");
-    printf("------------------------\n");
+static void displaySymbolTable(FILE *out) {
+    fprintf(out, "\nShell Script Analysis:\n");
+    fprintf(out, "------------------------\n");
     for (int i = 0; i < functionCount; i++) {
-        printf("Function: %s\n", symbolTable[i].name);
+        fprintf(out, "Function: %s\n", nameText(symbolTable[i].name));
         if (symbolTable[i].param_count > 0) {
-            printf("Parameters: ");
+            fprintf(out, "Parameters: ");
             for (int j = 0; j < symbolTable[i].param_count; j++) {
-                printf("%s", symbolTable[i].parameters[j]);
-                if (j < symbolTable[i].param_count - 1) printf(", ");
+                fprintf(out, "%s", nameText(symbolTable[i].parameters[j]));
+                if (j < symbolTable[i].param_count - 1) fprintf(out, ", ");
             }
-            printf("\n");
+            fprintf(out, "\n");
         }
-        printf("------------------------\n");
+        fprintf(out, "------------------------\n");
     }
 }
 
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    functionCount = functionCapacity = 0;
+}
+
+static int symbolCount(void) {
+    return functionCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
+    for (int i = 0; i < functionCount; i++) {
+        Symbol symbol = {SYMBOL_FUNCTION, symbolTable[i].name, NAME_EMPTY};
+        visit(&symbol, context);
+    }
+}
+
+const Analyzer shellAnalyzer = {
+    "Shell", analyzeShellFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    NULL
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Shell script name: ");
     scanf("%s", filename);
-    analyzeShellFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeShellFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,11 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_QUERIES 100
-#define MAX_COLUMNS 20
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
+#include "../COMMON/chunklex.h"
+#include "../COMMON/window.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT, 
@@ -13,22 +19,20 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
-
-typedef struct {
-    char queryType[MAX_TOKEN_LEN];     // SELECT, INSERT, UPDATE, etc.
-    char tableName[MAX_TOKEN_LEN];     // Target table
-    char columns[MAX_COLUMNS][MAX_TOKEN_LEN];  // Columns involved
+    NameId queryType;          // SELECT, INSERT, UPDATE, etc.
+    NameId tableName;          // Target table
+    NameId *columns;           // Columns involved
     int column_count;
 } SQLQuery;
 
-SQLQuery symbolTable[MAX_QUERIES];
-int queryCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local SQLQuery *symbolTable = NULL;
+static _Thread_local int queryCount = 0;
+static _Thread_local int queryCapacity = 0;
 
 // SQL specific keywords
-const char *keywords[] = { 
+static const char *keywords[] = { 
     "SELECT", "FROM", "WHERE", "INSERT", "INTO", "VALUES",
     "UPDATE", "SET", "DELETE", "CREATE", "TABLE", "DROP",
     "ALTER", "INDEX", "GROUP", "BY", "HAVING", "ORDER",
@@ -38,213 +42,282 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // SQL specific operators
-const char *operators[] = {
+static const char *operators[] = {
     "=", "<", ">", "<=", ">=", "<>", "!=", "+", "-", "*", "/"
 };
 #define OPERATORS_COUNT (sizeof(operators) / sizeof(operators[0]))
 
-int isKeyword(const char *lexeme) {
-    char upperLexeme[MAX_TOKEN_LEN];
-    strcpy(upperLexeme, lexeme);
-    for(int i = 0; upperLexeme[i]; i++) {
-        upperLexeme[i] = toupper(upperLexeme[i]);
-    }
-    
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(upperLexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 1);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isOperator(const char *lexeme) {
-    for (int i = 0; i < OPERATORS_COUNT; i++) {
-        if (strcmp(lexeme, operators[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet operatorSet = KEYWORD_SET(operators, OPERATORS_COUNT, 0);
+
+static int isOperator(const char *lexeme, size_t length) {
+    return keywordSetContains(&operatorSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
-    if (ch == '-' && (ch = fgetc(file)) == '-') {  // Single line comment
-        while ((ch = fgetc(file)) != EOF && ch != '\n');
-    } else if (ch == '/' && (ch = fgetc(file)) == '*') {  // Multi-line comment
-        while ((ch = fgetc(file)) != EOF) {
-            if (ch == '*' && (ch = fgetc(file)) == '/') break;
-        }
+// '@' is part of T-SQL variable names; '<', '>', '!' and '=' start the
+// operators that can take a second byte
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_' || (c) == '@', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c), CC_IDCONT | CC_NUMCONT) \
+    | CC_IF((c) == '.', CC_NUMCONT) \
+    | CC_IF((c) == '<' || (c) == '>' || (c) == '!' || (c) == '=', CC_OPERATOR) \
+    | CC_IF((c) == '\'' || (c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
+    if (ch == '-' && (ch = inputGet(in)) == '-') {  // Single line comment
+        inputSkipLine(in);
+    } else if (ch == '/' && (ch = inputGet(in)) == '*') {  // Multi-line comment
+        inputSkipPast(in, "*/");
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
     // Skip whitespace and comments
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '-' || ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle identifiers and keywords
-    if (isalpha(ch) || ch == '_' || ch == '@') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_' || ch == '@')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
-        token->type = isKeyword(buffer) ? KEYWORD : IDENTIFIER;
-        strcpy(token->lexeme, buffer);
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
+        token->type = isKeyword(tokenText(in, token), token->length) ? KEYWORD : IDENTIFIER;
         return 1;
     }
 
     // Handle numbers
-    if (isdigit(ch) || ch == '.') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && (isdigit(ch) || ch == '.')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_NUMCONT)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle string literals
-    if (ch == '\'' || ch == '"') {
+    if (charIs(ch, CC_QUOTE)) {
         char quote = ch;
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != quote) {
-            buffer[bufIndex++] = ch;
-        }
-        buffer[bufIndex++] = quote;
-        buffer[bufIndex] = '\0';
+        while ((ch = inputGet(in)) != EOF && ch != quote);
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special symbols
-    buffer[bufIndex++] = ch;
-    if (ch == '<' || ch == '>' || ch == '!' || ch == '=') {
-        ch = fgetc(file);
-        if (ch == '=' || (ch == '>' && buffer[0] == '<')) {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        ch = inputGet(in);
+        if (ch != '=' && !(ch == '>' && in->data[start] == '<')) {
+            inputUnget(in, ch);
         }
     }
-    buffer[bufIndex] = '\0';
-    
-    token->type = isOperator(buffer) ? OPERATOR : SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
+    tokenSpan(token, in, start);
+    token->type = isOperator(tokenText(in, token), token->length) ? OPERATOR : SPECIAL_SYMBOL;
     return 1;
 }
 
-void extractQuery(FILE *file, Token firstToken) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+// Set while a large file is lexed in parallel chunks; the tokens then come
+// from there instead of from getNextToken. Streamed input is read through
+// windowCurrent (see COMMON/window.h).
+static _Thread_local ChunkLexer *chunkLexer = NULL;
+
+static int nextToken(Input *in, Token *token) {
+    if (chunkLexer) return chunkLexNext(chunkLexer, token);
+    if (windowCurrent) return windowLex(windowCurrent, getNextToken, token, 0);
+    return getNextToken(in, token);
+}
+
+static int opensQuery(const Input *in, const Token *token) {
+    return token->type == KEYWORD && 
+           (tokenIs(in, token, "SELECT") || 
+            tokenIs(in, token, "INSERT") ||
+            tokenIs(in, token, "UPDATE") ||
+            tokenIs(in, token, "DELETE") ||
+            tokenIs(in, token, "CREATE") ||
+            tokenIs(in, token, "DROP"));
+}
+
+// Reads the query that `firstToken` opens, up to its ';', keeping its
+// column list in `arena`
+static SQLQuery extractQuery(Arena *arena, Input *in, Token firstToken) {
     Token token;
     SQLQuery currentQuery = {0};
-    int columnIndex = 0;
+    int columnCapacity = 0;
     
     // Store query type (SELECT, INSERT, etc.)
-    strcpy(currentQuery.queryType, firstToken.lexeme);
+    currentQuery.queryType = tokenIntern(in, &firstToken);
+    currentQuery.tableName = NAME_EMPTY;
     
     // Parse the query
-    while (getNextToken(file, &token)) {
+    while (nextToken(in, &token)) {
         if (token.type == KEYWORD) {
-            if (strcmp(token.lexeme, "FROM") == 0 || 
-                strcmp(token.lexeme, "INTO") == 0) {
+            if (tokenIs(in, &token, "FROM") || 
+                tokenIs(in, &token, "INTO")) {
                 // Next token should be table name
-                if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-                    strcpy(currentQuery.tableName, token.lexeme);
+                if (nextToken(in, &token) && token.type == IDENTIFIER) {
+                    currentQuery.tableName = tokenIntern(in, &token);
                 }
             }
         } else if (token.type == IDENTIFIER) {
             // Store column names
-            if (columnIndex < MAX_COLUMNS) {
-                strcpy(currentQuery.columns[columnIndex++], token.lexeme);
-            }
-        } else if (token.type == SPECIAL_SYMBOL && token.lexeme[0] == ';') {
+            *ARENA_PUSH(arena, currentQuery.columns, currentQuery.column_count, columnCapacity) =
+                tokenIntern(in, &token);
+        } else if (token.type == SPECIAL_SYMBOL && tokenText(in, &token)[0] == ';') {
             break;  // End of query
         }
     }
     
-    currentQuery.column_count = columnIndex;
-    symbolTable[queryCount++] = currentQuery;
+    return currentQuery;
 }
 
-void analyzeSQLFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [FUNCTION] = "FUNCTION",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeSQLFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case FUNCTION: printf("FUNCTION"); break;
-            default: printf("UNKNOWN"); break;
-        }
-        printf("\n");
+    ChunkLexer chunks;
+    if (chunkLexStart(&chunks, &in, getNextToken)) chunkLexer = &chunks;
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (nextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
 
         // Extract query information when a query-initiating keyword is found
-        if (token.type == KEYWORD && 
-            (strcmp(token.lexeme, "SELECT") == 0 || 
-             strcmp(token.lexeme, "INSERT") == 0 ||
-             strcmp(token.lexeme, "UPDATE") == 0 ||
-             strcmp(token.lexeme, "DELETE") == 0 ||
-             strcmp(token.lexeme, "CREATE") == 0 ||
-             strcmp(token.lexeme, "DROP") == 0)) {
-            extractQuery(file, token);
+        if (opensQuery(&in, &token)) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            *ARENA_PUSH(&symbolArena, symbolTable, queryCount, queryCapacity) =
+                extractQuery(&symbolArena, &in, token);
+            statsLeave(phase);
         }
     }
 
-    fclose(file);
+    if (chunkLexer) {
+        chunkLexFinish(&chunks);
+        chunkLexer = NULL;
+    }
+    inputClose(&in);
+    return 0;
+}
+
+static void displayHeading(FILE *out) {
+    fprintf(out, "\nQuery Analysis Table:\n");
+    fprintf(out, "------------------------\n");
+}
+
+static void displayQuery(FILE *out, const void *entry) {
+    const SQLQuery *query = entry;
+    fprintf(out, "Query Type: %s\n", nameText(query->queryType));
+    fprintf(out, "Table: %s\n", nameText(query->tableName));
+    fprintf(out, "Columns: ");
+    for (int j = 0; j < query->column_count; j++) {
+        fprintf(out, "%s", nameText(query->columns[j]));
+        if (j < query->column_count - 1) fprintf(out, ", ");
+    }
+    fprintf(out, "\n------------------------\n");
+}
+
+static void displaySymbolTable(FILE *out) {
+    displayHeading(out);
+    for (int i = 0; i < queryCount; i++) {
+        displayQuery(out, &symbolTable[i]);
+    }
+}
+
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    queryCount = queryCapacity = 0;
 }
 
-void displaySymbolTable() {
-    printf("\nQuery Analysis Table:\n");
-    printf("------------------------\n");
+static int symbolCount(void) {
+    return queryCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
     for (int i = 0; i < queryCount; i++) {
-        printf("Query Type: %s\n", symbolTable[i].queryType);
-        printf("Table: %s\n", symbolTable[i].tableName);
-        printf("Columns: ");
-        for (int j = 0; j < symbolTable[i].column_count; j++) {
-            printf("%s", symbolTable[i].columns[j]);
-            if (j < symbolTable[i].column_count - 1) printf(", ");
+        const SQLQuery *query = &symbolTable[i];
+        if (query->tableName != NAME_EMPTY) {
+            Symbol table = {SYMBOL_TABLE, query->tableName, NAME_EMPTY};
+            visit(&table, context);
+        }
+        for (int j = 0; j < query->column_count; j++) {
+            Symbol column = {SYMBOL_COLUMN, query->columns[j], query->tableName};
+            visit(&column, context);
         }
-        printf("\n------------------------\n");
     }
 }
 
+// Each query is one section of an incrementally edited document
+static void *extractQuerySection(Arena *arena, Input *in, const Token *first) {
+    SQLQuery *entry = arenaAlloc(arena, sizeof(*entry));
+    *entry = extractQuery(arena, in, *first);
+    return entry;
+}
+
+static const DocumentLanguage documentLanguage = {
+    getNextToken, opensQuery, extractQuerySection, displayHeading, displayQuery, &tokenFormat
+};
+
+const Analyzer sqlAnalyzer = {
+    "SQL", analyzeSQLFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    &documentLanguage
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the SQL file name: ");
     scanf("%s", filename);
-    analyzeSQLFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeSQLFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif
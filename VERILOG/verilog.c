@@ -1,11 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#define MAX_TOKEN_LEN 100
-#define MAX_MODULES 100
-#define MAX_PORTS 50
+#include "../COMMON/analyzer.h"
+#include "../COMMON/input.h"
+#include "../COMMON/token.h"
+#include "../COMMON/keywords.h"
+#include "../COMMON/stats.h"
+#include "../COMMON/arena.h"
+#include "../COMMON/scan.h"
+#include "../COMMON/charclass.h"
+#include "../COMMON/chunklex.h"
+#include "../COMMON/window.h"
 
 typedef enum {
     KEYWORD, IDENTIFIER, OPERATOR, NUMERIC_CONSTANT,
@@ -15,23 +21,25 @@ typedef enum {
 } TokenType;
 
 typedef struct {
-    char lexeme[MAX_TOKEN_LEN];
-    TokenType type;
-} Token;
+    NameId name;
+    NameId type;               // input, output, inout
+    NameId net;                // wire, reg
+} Port;
 
 typedef struct {
-    char name[MAX_TOKEN_LEN];
-    char ports[MAX_PORTS][MAX_TOKEN_LEN];
-    char port_types[MAX_PORTS][MAX_TOKEN_LEN];  // input, output, inout
-    char port_nets[MAX_PORTS][MAX_TOKEN_LEN];   // wire, reg
+    NameId name;
+    Port *ports;
     int port_count;
 } Module;
 
-Module symbolTable[MAX_MODULES];
-int moduleCount = 0;
+// The table and everything it points to live in symbolArena
+static _Thread_local Arena symbolArena = ARENA_INIT;
+static _Thread_local Module *symbolTable = NULL;
+static _Thread_local int moduleCount = 0;
+static _Thread_local int moduleCapacity = 0;
 
 // Verilog keywords
-const char *keywords[] = {
+static const char *keywords[] = {
     "module", "endmodule", "input", "output", "inout", "wire", "reg",
     "always", "assign", "begin", "end", "case", "endcase", "default",
     "else", "for", "if", "initial", "parameter", "localparam", "posedge",
@@ -41,225 +49,229 @@ const char *keywords[] = {
 #define KEYWORDS_COUNT (sizeof(keywords) / sizeof(keywords[0]))
 
 // Port types
-const char *port_types[] = {"input", "output", "inout"};
+static const char *port_types[] = {"input", "output", "inout"};
 #define PORT_TYPES_COUNT (sizeof(port_types) / sizeof(port_types[0]))
 
 // Net types
-const char *net_types[] = {
+static const char *net_types[] = {
     "wire", "reg", "tri", "tri0", "tri1", "supply0",
     "supply1", "wand", "wor", "trireg"
 };
 #define NET_TYPES_COUNT (sizeof(net_types) / sizeof(net_types[0]))
 
 // Gate types
-const char *gate_types[] = {
+static const char *gate_types[] = {
     "and", "nand", "or", "nor", "xor", "xnor", "not",
     "buf", "bufif0", "bufif1", "notif0", "notif1"
 };
 #define GATE_TYPES_COUNT (sizeof(gate_types) / sizeof(gate_types[0]))
 
-int isKeyword(const char *lexeme) {
-    for (int i = 0; i < KEYWORDS_COUNT; i++) {
-        if (strcmp(lexeme, keywords[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet keywordSet = KEYWORD_SET(keywords, KEYWORDS_COUNT, 0);
+
+static int isKeyword(const char *lexeme, size_t length) {
+    return keywordSetContains(&keywordSet, lexeme, length);
 }
 
-int isPortType(const char *lexeme) {
-    for (int i = 0; i < PORT_TYPES_COUNT; i++) {
-        if (strcmp(lexeme, port_types[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet portTypeSet = KEYWORD_SET(port_types, PORT_TYPES_COUNT, 0);
+
+static int isPortType(const char *lexeme, size_t length) {
+    return keywordSetContains(&portTypeSet, lexeme, length);
 }
 
-int isNetType(const char *lexeme) {
-    for (int i = 0; i < NET_TYPES_COUNT; i++) {
-        if (strcmp(lexeme, net_types[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet netTypeSet = KEYWORD_SET(net_types, NET_TYPES_COUNT, 0);
+
+static int isNetType(const char *lexeme, size_t length) {
+    return keywordSetContains(&netTypeSet, lexeme, length);
 }
 
-int isGateType(const char *lexeme) {
-    for (int i = 0; i < GATE_TYPES_COUNT; i++) {
-        if (strcmp(lexeme, gate_types[i]) == 0) return 1;
-    }
-    return 0;
+static KeywordSet gateTypeSet = KEYWORD_SET(gate_types, GATE_TYPES_COUNT, 0);
+
+static int isGateType(const char *lexeme, size_t length) {
+    return keywordSetContains(&gateTypeSet, lexeme, length);
 }
 
-void skipComments(FILE *file) {
-    char ch = fgetc(file);
+// '$' may continue an identifier and '_' separates digits; every operator
+// and punctuation byte goes through the operator path
+#define CHAR_CLASS(c) (CC_ASCII(c) \
+    | CC_IF(CC_IS_LETTER(c) || (c) == '_', CC_IDSTART | CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c) || (c) == '$', CC_IDCONT) \
+    | CC_IF(CC_IS_DIGIT(c) || (c) == '.' || (c) == '_' || (c) == 'e' || (c) == 'E', CC_NUMCONT) \
+    | CC_IF((c) == '+' || (c) == '-' || (c) == '*' || (c) == '/' || (c) == '<' || (c) == '>' || \
+            (c) == '=' || (c) == '!' || (c) == '&' || (c) == '|' || (c) == '^' || (c) == '%' || \
+            (c) == '(' || (c) == ')' || (c) == '[' || (c) == ']' || (c) == '{' || (c) == '}' || \
+            (c) == ',' || (c) == ';' || (c) == ':' || (c) == '#' || (c) == '.', CC_OPERATOR) \
+    | CC_IF((c) == '"', CC_QUOTE))
+
+static const unsigned char charClass[256] = CHAR_CLASS_TABLE(CHAR_CLASS);
+
+static void skipComments(Input *in) {
+    int ch = inputGet(in);
     if (ch == '/') {
-        ch = fgetc(file);
+        ch = inputGet(in);
         if (ch == '/') {  // Single line comment
-            while ((ch = fgetc(file)) != EOF && ch != '\n');
+            inputSkipLine(in);
         } else if (ch == '*') {  // Multi-line comment
-            while ((ch = fgetc(file)) != EOF) {
-                if (ch == '*' && (ch = fgetc(file)) == '/') break;
-            }
+            inputSkipPast(in, "*/");
         } else {
-            ungetc(ch, file);
+            inputUnget(in, ch);
         }
     } else {
-        ungetc(ch, file);
+        inputUnget(in, ch);
     }
 }
 
-int getNextToken(FILE *file, Token *token) {
-    char ch;
-    char buffer[MAX_TOKEN_LEN];
-    int bufIndex = 0;
+static int lexToken(Input *in, Token *token) {
+    int ch;
 
-    while ((ch = fgetc(file)) != EOF) {
-        if (isspace(ch)) continue;
+    while ((ch = inputGet(in)) != EOF) {
+        if (charIs(ch, CC_SPACE)) {
+            inputSkipSpace(in);
+            continue;
+        }
         if (ch == '/') {
-            ungetc(ch, file);
-            skipComments(file);
+            inputUnget(in, ch);
+            skipComments(in);
             continue;
         }
         break;
     }
 
     if (ch == EOF) return 0;
+    size_t start = inputTell(in) - 1;
 
     // Handle identifiers, keywords, etc.
-    if (isalpha(ch) || ch == '_') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && 
-               (isalnum(ch) || ch == '_' || ch == '$')) {
-            buffer[bufIndex++] = ch;
-        }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+    if (charIs(ch, CC_IDSTART)) {
+        while ((ch = inputGet(in)) != EOF && charIs(ch, CC_IDCONT));
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         
-        if (isKeyword(buffer)) {
+        if (isKeyword(tokenText(in, token), token->length)) {
             token->type = KEYWORD;
-        } else if (isPortType(buffer)) {
+        } else if (isPortType(tokenText(in, token), token->length)) {
             token->type = PORT_TYPE;
-        } else if (isNetType(buffer)) {
+        } else if (isNetType(tokenText(in, token), token->length)) {
             token->type = NET_TYPE;
-        } else if (isGateType(buffer)) {
+        } else if (isGateType(tokenText(in, token), token->length)) {
             token->type = GATE_TYPE;
         } else {
             token->type = IDENTIFIER;
         }
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle numbers including base specifiers
-    if (isdigit(ch) || ch == '\'') {
-        buffer[bufIndex++] = ch;
+    if (charIs(ch, CC_DIGIT) || ch == '\'') {
         if (ch == '\'') {
-            ch = fgetc(file);
+            ch = inputGet(in);
             if (ch == 'b' || ch == 'B' || ch == 'h' || ch == 'H' || 
                 ch == 'd' || ch == 'D' || ch == 'o' || ch == 'O') {
-                buffer[bufIndex++] = ch;
-                while ((ch = fgetc(file)) != EOF && 
-                       (isalnum(ch) || ch == '_' || ch == 'x' || ch == 'X' || ch == 'z' || ch == 'Z')) {
-                    buffer[bufIndex++] = ch;
-                }
+                // Digits, x and z, and '_' separators
+                while ((ch = inputGet(in)) != EOF && (charIs(ch, CC_ALNUM) || ch == '_'));
             }
         } else {
-            while ((ch = fgetc(file)) != EOF && 
-                   (isdigit(ch) || ch == '.' || ch == '_' || 
-                    ch == 'e' || ch == 'E')) {
-                buffer[bufIndex++] = ch;
-            }
+            while ((ch = inputGet(in)) != EOF && charIs(ch, CC_NUMCONT));
         }
-        ungetc(ch, file);
-        buffer[bufIndex] = '\0';
+        inputUnget(in, ch);
+        tokenSpan(token, in, start);
         token->type = NUMERIC_CONSTANT;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle string literals
-    if (ch == '"') {
-        buffer[bufIndex++] = ch;
-        while ((ch = fgetc(file)) != EOF && ch != '"') {
+    if (charIs(ch, CC_QUOTE)) {
+        while ((ch = inputGet(in)) != EOF && ch != '"') {
             if (ch == '\\') {
-                buffer[bufIndex++] = ch;
-                ch = fgetc(file);
+                ch = inputGet(in);
             }
-            buffer[bufIndex++] = ch;
         }
-        buffer[bufIndex++] = '"';
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = STRING_LITERAL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
     // Handle operators and special symbols
-    if (strchr("+-*/<>=!&|^%()[]{},;:#.", ch)) {
-        buffer[bufIndex++] = ch;
-        ch = fgetc(file);
-        if (strchr("=<>&|", ch)) {
-            buffer[bufIndex++] = ch;
-        } else {
-            ungetc(ch, file);
+    if (charIs(ch, CC_OPERATOR)) {
+        ch = inputGet(in);
+        if (ch != '=' && ch != '<' && ch != '>' && ch != '&' && ch != '|') {
+            inputUnget(in, ch);
         }
-        buffer[bufIndex] = '\0';
+        tokenSpan(token, in, start);
         token->type = SPECIAL_SYMBOL;
-        strcpy(token->lexeme, buffer);
         return 1;
     }
 
-    buffer[bufIndex++] = ch;
-    buffer[bufIndex] = '\0';
+    tokenSpan(token, in, start);
     token->type = SPECIAL_SYMBOL;
-    strcpy(token->lexeme, buffer);
     return 1;
 }
 
-void extractModule(FILE *file) {
+static int getNextToken(Input *in, Token *token) {
+    return tokenLexed(lexToken(in, token), in, token);
+}
+
+// Set while a large file is lexed in parallel chunks; the tokens then come
+// from there instead of from getNextToken. Streamed input is read through
+// windowCurrent (see COMMON/window.h).
+static _Thread_local ChunkLexer *chunkLexer = NULL;
+
+static int nextToken(Input *in, Token *token) {
+    if (chunkLexer) return chunkLexNext(chunkLexer, token);
+    if (windowCurrent) return windowLex(windowCurrent, getNextToken, token, 0);
+    return getNextToken(in, token);
+}
+
+static int opensModule(const Input *in, const Token *token) {
+    return token->type == KEYWORD && tokenIs(in, token, "module");
+}
+
+// Reads the module that follows the "module" keyword into `module`, with its
+// ports in `arena`. Returns 0 if no module name follows.
+static int extractModule(Arena *arena, Input *in, Module *module) {
     Token token;
-    char moduleName[MAX_TOKEN_LEN];
-    char ports[MAX_PORTS][MAX_TOKEN_LEN];
-    char portTypes[MAX_PORTS][MAX_TOKEN_LEN];
-    char portNets[MAX_PORTS][MAX_TOKEN_LEN];
-    int portCount = 0;
+    int portCapacity = 0;
+    memset(module, 0, sizeof(*module));
 
     // Get module name
-    if (getNextToken(file, &token) && token.type == IDENTIFIER) {
-        strcpy(moduleName, token.lexeme);
+    if (nextToken(in, &token) && token.type == IDENTIFIER) {
+        module->name = tokenIntern(in, &token);
         
         // Parse port list
-        if (getNextToken(file, &token) && token.lexeme[0] == '(') {
-            while (getNextToken(file, &token) && token.lexeme[0] != ')') {
+        if (nextToken(in, &token) && tokenText(in, &token)[0] == '(') {
+            while (nextToken(in, &token) && tokenText(in, &token)[0] != ')') {
                 if (token.type == IDENTIFIER) {
-                    strcpy(ports[portCount], token.lexeme);
-                    strcpy(portTypes[portCount], "");  // Will be filled later
-                    strcpy(portNets[portCount], "");   // Will be filled later
-                    portCount++;
+                    Port *port = ARENA_PUSH(arena, module->ports, module->port_count, portCapacity);
+                    port->name = tokenIntern(in, &token);
+                    port->type = NAME_EMPTY;  // Will be filled later
+                    port->net = NAME_EMPTY;   // Will be filled later
                 }
             }
         }
 
         // Parse port declarations
-        while (getNextToken(file, &token)) {
-            if (token.type == KEYWORD && strcmp(token.lexeme, "endmodule") == 0) {
+        while (nextToken(in, &token)) {
+            if (token.type == KEYWORD && tokenIs(in, &token, "endmodule")) {
                 break;
             }
             
             if (token.type == PORT_TYPE) {
-                char currentType[MAX_TOKEN_LEN];
-                strcpy(currentType, token.lexeme);
+                NameId currentType = tokenIntern(in, &token);
                 
                 // Get net type if specified
-                char currentNet[MAX_TOKEN_LEN] = "";
-                if (getNextToken(file, &token) && token.type == NET_TYPE) {
-                    strcpy(currentNet, token.lexeme);
-                    getNextToken(file, &token);
+                NameId currentNet = NAME_EMPTY;
+                if (nextToken(in, &token) && token.type == NET_TYPE) {
+                    currentNet = tokenIntern(in, &token);
+                    nextToken(in, &token);
                 }
                 
-                // Update port information
+                // Update port information; names are interned, so the
+                // port is found by comparing IDs
                 if (token.type == IDENTIFIER) {
-                    for (int i = 0; i < portCount; i++) {
-                        if (strcmp(ports[i], token.lexeme) == 0) {
-                            strcpy(portTypes[i], currentType);
-                            if (strlen(currentNet) > 0) {
-                                strcpy(portNets[i], currentNet);
+                    NameId name = nameFind(tokenText(in, &token), token.length);
+                    for (int i = 0; i < module->port_count; i++) {
+                        if (module->ports[i].name == name) {
+                            module->ports[i].type = currentType;
+                            if (currentNet != NAME_EMPTY) {
+                                module->ports[i].net = currentNet;
                             }
                             break;
                         }
@@ -267,83 +279,141 @@ void extractModule(FILE *file) {
                 }
             }
         }
-
-        // Store in symbol table
-        strcpy(symbolTable[moduleCount].name, moduleName);
-        symbolTable[moduleCount].port_count = portCount;
-        for (int i = 0; i < portCount; i++) {
-            strcpy(symbolTable[moduleCount].ports[i], ports[i]);
-            strcpy(symbolTable[moduleCount].port_types[i], portTypes[i]);
-            strcpy(symbolTable[moduleCount].port_nets[i], portNets[i]);
-        }
-        moduleCount++;
+        return 1;
     }
+    return 0;
 }
 
-void analyzeVerilogFile(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+static const char *const tokenTypeNames[] = {
+    [KEYWORD] = "KEYWORD",
+    [IDENTIFIER] = "IDENTIFIER",
+    [OPERATOR] = "OPERATOR",
+    [NUMERIC_CONSTANT] = "NUMERIC CONSTANT",
+    [STRING_LITERAL] = "STRING LITERAL",
+    [SPECIAL_SYMBOL] = "SPECIAL SYMBOL",
+    [PORT_TYPE] = "PORT TYPE",
+    [MODULE_NAME] = "MODULE NAME",
+    [NET_TYPE] = "NET TYPE",
+    [STRENGTH] = "STRENGTH",
+    [TIME_UNIT] = "TIME UNIT",
+    [PARAMETER] = "PARAMETER",
+    [GATE_TYPE] = "GATE TYPE",
+};
+
+static const TokenFormat tokenFormat = {
+    tokenTypeNames, sizeof(tokenTypeNames) / sizeof(tokenTypeNames[0]), NULL, 0
+};
+
+int analyzeVerilogFile(const char *filename, TokenStream *stream) {
+    Input in;
+    if (inputOpen(&in, filename) != 0) {
         perror("Error opening file");
-        return;
+        return -1;
     }
 
     Token token;
-    printf("\nLexical Analysis Output:\n");
-    printf("------------------------\n");
-    printf("Lexeme\t\tType\n");
-    printf("------------------------\n");
-
-    while (getNextToken(file, &token)) {
-        printf("%s\t\t", token.lexeme);
-        switch (token.type) {
-            case KEYWORD: printf("KEYWORD"); break;
-            case IDENTIFIER: printf("IDENTIFIER"); break;
-            case OPERATOR: printf("OPERATOR"); break;
-            case NUMERIC_CONSTANT: printf("NUMERIC CONSTANT"); break;
-            case STRING_LITERAL: printf("STRING LITERAL"); break;
-            case SPECIAL_SYMBOL: printf("SPECIAL SYMBOL"); break;
-            case PORT_TYPE: printf("PORT TYPE"); break;
-            case MODULE_NAME: printf("MODULE NAME"); break;
-            case NET_TYPE: printf("NET TYPE"); break;
-            case STRENGTH: printf("STRENGTH"); break;
-            case TIME_UNIT: printf("TIME UNIT"); break;
-            case PARAMETER: printf("PARAMETER"); break;
-            case GATE_TYPE: printf("GATE TYPE"); break;
-            default: printf("UNKNOWN"); break;
+    ChunkLexer chunks;
+    if (chunkLexStart(&chunks, &in, getNextToken)) chunkLexer = &chunks;
+    streamBeginTokens(stream, &tokenFormat);
+
+    while (nextToken(&in, &token)) {
+        streamToken(stream, &in, &token);
+
+        if (opensModule(&in, &token)) {
+            int phase = statsEnter(PHASE_SYMBOLS);
+            Module module;
+            if (extractModule(&symbolArena, &in, &module)) {
+                *ARENA_PUSH(&symbolArena, symbolTable, moduleCount, moduleCapacity) = module;
+            }
+            statsLeave(phase);
         }
-        printf("\n");
+    }
 
-        if (token.type == KEYWORD && strcmp(token.lexeme, "module") == 0) {
-            extractModule(file);
+    if (chunkLexer) {
+        chunkLexFinish(&chunks);
+        chunkLexer = NULL;
+    }
+    inputClose(&in);
+    return 0;
+}
+
+static void displayHeading(FILE *out) {
+    fprintf(out, "\nVerilog Module Analysis:\n");
+    fprintf(out, "------------------------\n");
+}
+
+static void displayModule(FILE *out, const void *entry) {
+    const Module *module = entry;
+    fprintf(out, "Module: %s\n", nameText(module->name));
+    fprintf(out, "Ports:\n");
+    for (int j = 0; j < module->port_count; j++) {
+        fprintf(out, "  %s: %s", nameText(module->ports[j].name), 
+               nameText(module->ports[j].type));
+        if (module->ports[j].net != NAME_EMPTY) {
+            fprintf(out, " (%s)", nameText(module->ports[j].net));
         }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "------------------------\n");
+}
+
+static void displaySymbolTable(FILE *out) {
+    displayHeading(out);
+    for (int i = 0; i < moduleCount; i++) {
+        displayModule(out, &symbolTable[i]);
     }
+}
 
-    fclose(file);
+static void resetSymbolTable() {
+    arenaReset(&symbolArena);
+    symbolTable = NULL;
+    moduleCount = moduleCapacity = 0;
 }
 
-void displaySymbolTable() {
-    printf("\nVerilog Module Analysis:\n");
-    printf("------------------------\n");
+static int symbolCount(void) {
+    return moduleCount;
+}
+
+static void listSymbols(SymbolVisitor visit, void *context) {
     for (int i = 0; i < moduleCount; i++) {
-        printf("Module: %s\n", symbolTable[i].name);
-        printf("Ports:\n");
+        Symbol module = {SYMBOL_MODULE, symbolTable[i].name, NAME_EMPTY};
+        visit(&module, context);
         for (int j = 0; j < symbolTable[i].port_count; j++) {
-            printf("  %s: %s", symbolTable[i].ports[j], 
-                   symbolTable[i].port_types[j]);
-            if (strlen(symbolTable[i].port_nets[j]) > 0) {
-                printf(" (%s)", symbolTable[i].port_nets[j]);
-            }
-            printf("\n");
+            Symbol port = {SYMBOL_PORT, symbolTable[i].ports[j].name, symbolTable[i].name};
+            visit(&port, context);
         }
-        printf("------------------------\n");
     }
 }
 
+// Each module is one section of an incrementally edited document
+static void *extractModuleSection(Arena *arena, Input *in, const Token *first) {
+    (void)first;
+    Module module;
+    if (!extractModule(arena, in, &module)) return NULL;
+    Module *entry = arenaAlloc(arena, sizeof(*entry));
+    *entry = module;
+    return entry;
+}
+
+static const DocumentLanguage documentLanguage = {
+    getNextToken, opensModule, extractModuleSection, displayHeading, displayModule, &tokenFormat
+};
+
+const Analyzer verilogAnalyzer = {
+    "Verilog", analyzeVerilogFile, displaySymbolTable, resetSymbolTable, symbolCount, listSymbols, 2,
+    &documentLanguage
+};
+
+#ifndef CDLAB_NO_MAIN
 int main() {
     char filename[100];
     printf("Enter the Verilog file name: ");
     scanf("%s", filename);
-    analyzeVerilogFile(filename);
-    displaySymbolTable();
+    TokenStream stream;
+    streamOpen(&stream, stdout, STREAM_TEXT);
+    analyzeVerilogFile(filename, &stream);
+    streamClose(&stream);
+    displaySymbolTable(stdout);
     return 0;
-}
\ No newline at end of file
+}
+#endif